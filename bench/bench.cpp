@@ -0,0 +1,976 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#ifdef GEOMETRY_LAB_BENCH_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <OpenMesh/Core/Mesh/TriMesh_ArrayKernelT.hh>
+#include <OpenMesh/Tools/Decimater/DecimaterT.hh>
+#include <OpenMesh/Tools/Decimater/ModNormalFlippingT.hh>
+#include <OpenMesh/Tools/Decimater/ModQuadricT.hh>
+#include <core/arap.hpp>
+#include <core/closest_point.hpp>
+#include <core/decimation.hpp>
+#include <core/face_frames.hpp>
+#include <core/geodesics.hpp>
+#include <core/laplacian.hpp>
+#include <core/mesh_cache.hpp>
+#include <core/parallel.hpp>
+#include <core/parameterization.hpp>
+#include <core/simd.hpp>
+#include <core/subdivision.hpp>
+#include <core/trimesh.hpp>
+#include <render/loader.hpp>
+#include <render/scene_renderer.hpp>
+#include <render/render_config.hpp>
+
+#include "mesh_generator.hpp"
+
+using geometry_lab::GeneratedMesh;
+using geometry_lab::TriMesh;
+using geometry_lab::TriMeshLoader;
+using OpenMeshTriMesh = OpenMesh::TriMesh_ArrayKernelT<>;
+// ========== Options ==========
+struct Options {
+  std::vector<std::string> meshes = {"grid", "sphere", "torus", "scan"};
+  std::vector<size_t> faces = {10000, 100000, 1000000};
+  std::vector<size_t> threads;
+  int repeat = 3;
+  std::string json;
+  bool render = true;
+  std::string tmp_dir = std::filesystem::temp_directory_path().string();
+};
+struct Result {
+  std::string kernel, mesh;
+  size_t faces, vertices, threads, elements;
+  double seconds;
+  /// Peak RSS while the kernel runs, including what was resident before
+  size_t peak_rss;
+  /// Growth of the peak RSS over the RSS at the start of the kernel
+  size_t rss_growth;
+};
+std::vector<Result> results;
+// ========== Utils ==========
+/**
+ * @brief Start a new high water mark of the resident memory, so that
+ *  PeakRss() reports the peak of the next kernel only. Linux resets it
+ *  to the current RSS through /proc/self/clear_refs.
+ * @return Whether the peak was reset, otherwise PeakRss() keeps the
+ *  peak of the whole process.
+*/
+bool ResetPeakRss() {
+#if defined(__linux__)
+  FILE* file = fopen("/proc/self/clear_refs", "w");
+  if (!file)
+    return false;
+  const bool ok = fputs("5", file) >= 0;
+  return fclose(file) == 0 && ok;
+#else
+  return false;
+#endif
+}
+/// Read a "Key:  value kB" line of /proc/self/status, in bytes
+size_t ReadProcStatus(const char* key) {
+  size_t rst = 0;
+  FILE* file = fopen("/proc/self/status", "r");
+  if (!file)
+    return rst;
+  char line[256];
+  const size_t length = strlen(key);
+  while (fgets(line, sizeof(line), file)) {
+    if (strncmp(line, key, length) == 0 && line[length] == ':') {
+      rst = static_cast<size_t>(strtoull(line + length + 1, nullptr, 10)) *
+            1024;
+      break;
+    }
+  }
+  fclose(file);
+  return rst;
+}
+/// Resident memory of the process now
+size_t CurrentRss() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+  return counters.WorkingSetSize;
+#elif defined(__linux__)
+  return ReadProcStatus("VmRSS");
+#else
+  return 0;
+#endif
+}
+/// Peak resident memory since the last successful ResetPeakRss()
+size_t PeakRss() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+  return counters.PeakWorkingSetSize;
+#else
+#if defined(__linux__)
+  if (const size_t hwm = ReadProcStatus("VmHWM"))
+    return hwm;
+#endif
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return static_cast<size_t>(usage.ru_maxrss);
+#else
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+template <typename T>
+std::vector<T> ParseList(const std::string& text,
+                         std::function<T(const std::string&)> parse) {
+  std::vector<T> rst;
+  size_t begin = 0;
+  while (begin <= text.size()) {
+    size_t end = text.find(',', begin);
+    if (end == std::string::npos)
+      end = text.size();
+    if (end > begin)
+      rst.push_back(parse(text.substr(begin, end - begin)));
+    begin = end + 1;
+  }
+  return rst;
+}
+bool ParseOptions(int argc, char** argv, Options& opt) {
+  auto to_size = [](const std::string& s) {
+    return static_cast<size_t>(std::stod(s));
+  };
+  auto to_string = [](const std::string& s) { return s; };
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--mesh" && has_value) {
+      opt.meshes = ParseList<std::string>(argv[++i], to_string);
+      if (opt.meshes.size() == 1 && opt.meshes[0] == "all")
+        opt.meshes = Options().meshes;
+    } else if (arg == "--faces" && has_value) {
+      opt.faces = ParseList<size_t>(argv[++i], to_size);
+    } else if (arg == "--threads" && has_value) {
+      opt.threads = ParseList<size_t>(argv[++i], to_size);
+    } else if (arg == "--repeat" && has_value) {
+      opt.repeat = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--json" && has_value) {
+      opt.json = argv[++i];
+    } else if (arg == "--tmp" && has_value) {
+      opt.tmp_dir = argv[++i];
+    } else if (arg == "--no-render") {
+      opt.render = false;
+    } else {
+      printf(
+          "Usage: geometry-lab-bench [options]\n"
+          "  --mesh grid,sphere,torus,scan|all\n"
+          "  --faces 10000,1e6,5e7     approximate number of triangles\n"
+          "  --threads 1,2,4           thread counts for the scaling\n"
+          "  --repeat 3                runs per kernel, the best is kept\n"
+          "  --json out.json           machine-readable output, - for "
+          "stdout\n"
+          "  --tmp dir                 directory of the generated .obj\n"
+          "  --no-render               skip the render benchmarks\n");
+      return false;
+    }
+  }
+  if (opt.threads.empty()) {
+    const size_t n = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t t = 1; t < n; t *= 2)
+      opt.threads.push_back(t);
+    opt.threads.push_back(n);
+  }
+  return true;
+}
+/**
+ * @brief Run a kernel several times and record the best time, and the
+ *  memory the kernel holds at its peak over all runs. Where the high water
+ *  mark cannot be reset, the peak is the one of the process and the
+ *  growth only counts what goes beyond the previous kernels.
+ * @param setup[in] - Called before each run, not timed.
+ * @param kernel[in] - The timed function.
+*/
+void Measure(const std::string& name, const GeneratedMesh& mesh,
+             size_t threads, size_t elements, int repeat,
+             const std::function<void()>& setup,
+             const std::function<void()>& kernel) {
+  const bool reset = ResetPeakRss();
+  const size_t rss_start = reset ? CurrentRss() : PeakRss();
+  double best = 1e30;
+  for (int r = 0; r < repeat; ++r) {
+    setup();
+    auto start = std::chrono::steady_clock::now();
+    kernel();
+    std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, seconds.count());
+  }
+  const size_t peak = PeakRss();
+  const size_t growth = peak > rss_start ? peak - rss_start : 0;
+  results.push_back({name, mesh.name_, mesh.n_faces(), mesh.n_vertices(),
+                     threads, elements, best, peak, growth});
+  printf("%-40s %-7s %10zu faces %3zu threads %12.4f ms %10.2f M/s"
+         " %9.1f MB\n",
+         name.c_str(), mesh.name_.c_str(), mesh.n_faces(), threads,
+         1e3 * best, elements / std::max(best, 1e-12) / 1e6, growth / 1e6);
+  fflush(stdout);
+}
+void RemoveHalfedgeDifferenceAndFaceArea(TriMesh& mesh) {
+  OpenMesh::HPropHandleT<Eigen::Vector2d> diff_handle;
+  if (mesh.get_property_handle(diff_handle, TriMesh::kPropHalfedgeDiff.data()))
+    mesh.remove_property(diff_handle);
+  OpenMesh::FPropHandleT<double> area_handle;
+  if (mesh.get_property_handle(area_handle, TriMesh::kPropFaceArea.data()))
+    mesh.remove_property(area_handle);
+}
+/**
+ * @brief Move 1% of the vertices a little, as an interactive edit
+ *  would, for the incremental updates.
+*/
+void MoveSomeVertices(TriMesh& mesh) {
+  for (size_t i = 0; i < mesh.n_vertices(); i += 100) {
+    const auto vh = mesh.vertex_handle(static_cast<unsigned>(i));
+    mesh.set_point(vh, mesh.point(vh) * 1.001f);
+  }
+}
+/**
+ * @brief Primary rays of a square image looking at the mesh along -z,
+ *  as a ray caster or a picking pass would shoot them.
+*/
+std::vector<geometry_lab::Bvh::Ray> CameraRays(const TriMesh& mesh,
+                                               size_t resolution) {
+  const geometry_lab::BoundingBox& box = mesh.ComputeBoundingBox();
+  const Eigen::Vector3f center = box.center();
+  const float radius = box.half_extent().norm();
+  const Eigen::Vector3f eye = center + Eigen::Vector3f(0, 0, 3 * radius);
+  std::vector<geometry_lab::Bvh::Ray> rays(resolution * resolution);
+  for (size_t i = 0; i < resolution; ++i) {
+    for (size_t j = 0; j < resolution; ++j) {
+      const Eigen::Vector3f target =
+          center + radius * Eigen::Vector3f(2.0f * i / resolution - 1.0f,
+                                            2.0f * j / resolution - 1.0f, 0);
+      rays[i * resolution + j].origin = eye;
+      rays[i * resolution + j].direction = target - eye;
+    }
+  }
+  return rays;
+}
+/**
+ * @brief Plain OpenMesh triangle mesh of the generated triangles, for
+ *  the reference implementations.
+*/
+void BuildOpenMeshTriMesh(const GeneratedMesh& gen, OpenMeshTriMesh& mesh) {
+  mesh = OpenMeshTriMesh();
+  std::vector<OpenMeshTriMesh::VertexHandle> vertices(gen.n_vertices());
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    vertices[i] = mesh.add_vertex(OpenMeshTriMesh::Point(
+        gen.positions_[3 * i], gen.positions_[3 * i + 1],
+        gen.positions_[3 * i + 2]));
+  }
+  for (size_t f = 0; f < gen.n_faces(); ++f) {
+    mesh.add_face(vertices[gen.indices_[3 * f]],
+                  vertices[gen.indices_[3 * f + 1]],
+                  vertices[gen.indices_[3 * f + 2]]);
+  }
+}
+// ========== Reference kernels ==========
+// Serial implementations of the first version of TriMesh, walking the
+// OpenMesh kernel with smart handles, to compare the flat snapshot
+// kernels against.
+void ReferenceBoundingBox(const TriMesh& mesh, OpenMesh::Vec3f& min,
+                          OpenMesh::Vec3f& max) {
+  max = min = mesh.point(*mesh.vertices_begin());
+  for (const auto& v : mesh.vertices()) {
+    const auto& p = mesh.point(v);
+    for (int i = 0; i < 3; ++i) {
+      if (p[i] > max[i])
+        max[i] = p[i];
+      if (p[i] < min[i])
+        min[i] = p[i];
+    }
+  }
+}
+void ReferenceNormalizePositions(TriMesh& mesh, float a) {
+  using vecf3 = OpenMesh::VectorT<float, 3>;
+  vecf3 max, min;
+  ReferenceBoundingBox(mesh, min, max);
+  vecf3 translate = -(max + min) / 2.0f;
+  vecf3 scale_vec = (max - min) / 2.0f;
+  float scale =
+      std::max<float>({scale_vec[0], scale_vec[1], scale_vec[2]}) / a;
+  for (const auto& v : mesh.vertices()) {
+    const vecf3& p = mesh.point(v);
+    mesh.point(v) = (p + translate) / scale;
+  }
+  mesh.MarkGeometryChanged();
+}
+void ReferenceVertexNormals(TriMesh& mesh) {
+  if (!mesh.has_vertex_normals())
+    mesh.request_vertex_normals();
+  mesh.request_face_normals();
+  mesh.update_normals();
+  mesh.release_face_normals();
+}
+void ReferenceHalfedgeDifferenceAndFaceArea(TriMesh& mesh) {
+  using vecf3 = OpenMesh::VectorT<float, 3>;
+  auto halfedge_diff =
+      OpenMesh::HProp<Eigen::Vector2d>(mesh, TriMesh::kPropHalfedgeDiff.data());
+  auto face_area = OpenMesh::FProp<double>(mesh, TriMesh::kPropFaceArea.data());
+  vecf3 dx01, dx02;
+  double l01, l02, cos0, sin0;
+  for (const auto& fh : mesh.faces()) {
+    const auto& hh01 = fh.halfedge();
+    const auto& hh20 = hh01.next().next();
+    dx01 = mesh.point(hh01.to()) - mesh.point(hh01.from());
+    dx02 = mesh.point(hh20.from()) - mesh.point(hh20.to());
+    l01 = dx01.norm();
+    l02 = dx02.norm();
+    cos0 = dx01.dot(dx02) / (l01 * l02);
+    sin0 = sqrt(1.0 - cos0 * cos0);
+    halfedge_diff[hh01] << l01, 0;
+    halfedge_diff[hh01.next()] << l02 * cos0 - l01, l02 * sin0;
+    halfedge_diff[hh20] = -halfedge_diff[hh01] - halfedge_diff[hh01.next()];
+    face_area[fh] = 0.5 * l01 * l02 * sin0;
+  }
+}
+std::priority_queue<TriMesh::Boundary> ReferenceBoundaries(TriMesh& mesh) {
+  std::priority_queue<TriMesh::Boundary> rst;
+  auto visited = OpenMesh::HProp<bool>(false, mesh);
+  for (const auto& hh : mesh.halfedges()) {
+    if (hh.is_boundary() && !visited[hh]) {
+      TriMesh::Boundary bdr(hh);
+      bdr.Visit([&](const OpenMesh::SmartHalfedgeHandle& it) {
+        visited[it] = true;
+        bdr.length_ += 1;
+      });
+      rst.push(bdr);
+    }
+  }
+  return rst;
+}
+// ========== Core kernels ==========
+void BenchCore(const Options& opt, const GeneratedMesh& gen) {
+  // The .obj file is written once for all thread counts
+  const std::string obj =
+      (std::filesystem::path(opt.tmp_dir) /
+       ("geometry_lab_bench_" + gen.name_ + std::to_string(gen.n_faces()) +
+        ".obj"))
+          .string();
+  const bool has_obj = gen.WriteObj(obj);
+  std::error_code ec;
+  std::filesystem::remove(geometry_lab::MeshCache::PathFor(obj), ec);
+  // The elements of the loads are the bytes of the file, in MB/s
+  const size_t obj_bytes = has_obj ? std::filesystem::file_size(obj, ec) : 0;
+  for (const size_t t : opt.threads) {
+    geometry_lab::SetParallelThreadCount(t);
+    TriMesh mesh;
+    if (has_obj) {
+      Measure("LoadFromFile(OpenMesh)", gen, t, obj_bytes, opt.repeat, [] {},
+              [&] { mesh.LoadFromFile(obj, true, false); });
+      Measure("LoadFromFile", gen, t, obj_bytes, opt.repeat, [] {},
+              [&] { mesh.LoadFromFile(obj, true); });
+    }
+    Measure("BuildFromPolygons", gen, t, gen.n_faces(), opt.repeat, [] {},
+            [&] { mesh.BuildFromPolygons(gen.positions_, gen.indices_); });
+    Measure("TriMeshSoA::Build", gen, t, mesh.n_halfedges(), opt.repeat,
+            [&] { mesh.MarkTopologyChanged(); }, [&] { mesh.soa(); });
+    // The serial references run once, next to the first thread count
+    const bool reference = t == opt.threads.front();
+    // The box alone after a move, the snapshot is refreshed untimed
+    if (reference) {
+      OpenMesh::Vec3f min, max;
+      Measure("ComputeBoundingBox(OpenMesh)", gen, t, mesh.n_vertices(),
+              opt.repeat, [] {}, [&] { ReferenceBoundingBox(mesh, min, max); });
+    }
+    Measure("ComputeBoundingBox", gen, t, mesh.n_vertices(), opt.repeat,
+            [&] {
+              mesh.MarkGeometryChanged();
+              mesh.soa();
+            },
+            [&] { mesh.ComputeBoundingBox(); });
+    if (reference)
+      Measure("NormalizePositions(OpenMesh)", gen, t, mesh.n_vertices(),
+              opt.repeat, [] {},
+              [&] { ReferenceNormalizePositions(mesh, 1.0f); });
+    Measure("NormalizePositions", gen, t, mesh.n_vertices(), opt.repeat,
+            [] {}, [&] { mesh.NormalizePositions(1.0f); });
+    if (reference)
+      Measure("ComputeVertexNormalWithFace(OpenMesh)", gen, t,
+              mesh.n_vertices(), opt.repeat, [] {},
+              [&] { ReferenceVertexNormals(mesh); });
+    Measure("ComputeVertexNormalWithFace", gen, t, mesh.n_vertices(),
+            opt.repeat, [] {}, [&] { mesh.ComputeVertexNormalWithFace(); });
+    if (reference)
+      Measure("ComputeHalfedgeDifferenceAndFaceArea(OpenMesh)", gen, t,
+              mesh.n_faces(), opt.repeat,
+              [&] { RemoveHalfedgeDifferenceAndFaceArea(mesh); },
+              [&] { ReferenceHalfedgeDifferenceAndFaceArea(mesh); });
+    Measure("ComputeHalfedgeDifferenceAndFaceArea", gen, t, mesh.n_faces(),
+            opt.repeat, [&] { RemoveHalfedgeDifferenceAndFaceArea(mesh); },
+            [&] { mesh.ComputeHalfedgeDifferenceAndFaceArea(); });
+    // Derived data after moving 1% of the vertices
+    Measure("UpdateVertexNormals/1%", gen, t, mesh.n_vertices() / 100,
+            opt.repeat, [&] { MoveSomeVertices(mesh); },
+            [&] { mesh.UpdateVertexNormals(); });
+    Measure("ComputeHalfedgeDifferenceAndFaceArea/1%", gen, t,
+            mesh.n_vertices() / 100, opt.repeat,
+            [&] { MoveSomeVertices(mesh); },
+            [&] { mesh.ComputeHalfedgeDifferenceAndFaceArea(); });
+    geometry_lab::FaceFrames frames;
+    Measure("FaceFrames::Compute", gen, t, mesh.n_faces(), opt.repeat, [] {},
+            [&] { frames.Compute(mesh.soa()); });
+    // The loops are cached until the topology changes
+    auto touch_topology = [&] {
+      mesh.MarkTopologyChanged();
+      mesh.soa();
+    };
+    // Values of the Laplacian after a move, then a factorization
+    // reusing the symbolic analysis
+    Measure("ComputeLaplacian", gen, t, mesh.n_faces(), opt.repeat,
+            [&] {
+              mesh.MarkGeometryChanged();
+              mesh.ComputeHalfedgeDifferenceAndFaceArea();
+            },
+            [&] { mesh.ComputeLaplacian(); });
+    Measure("ComputeCurvature", gen, t, mesh.n_vertices(), opt.repeat,
+            [&] {
+              mesh.MarkGeometryChanged();
+              mesh.ComputeHalfedgeDifferenceAndFaceArea();
+            },
+            [&] { mesh.ComputeCurvature(); });
+    geometry_lab::LaplacianSolver solver;
+    solver.Factorize(mesh.ComputeLaplacian(), 1.0, 1e-3);
+    Measure("LaplacianSolver::Factorize", gen, t, mesh.n_vertices(),
+            opt.repeat, [] {},
+            [&] { solver.Factorize(mesh.ComputeLaplacian(), 1.0, 1e-3); });
+    // Parameterization of the open meshes, factorized once then a new
+    // boundary shape only costs the solves
+    if (mesh.ComputeBoundaryLoops().size() > 0) {
+      using geometry_lab::HarmonicParameterization;
+      HarmonicParameterization parameterization;
+      Measure("HarmonicParameterization::Compute", gen, t, mesh.n_vertices(),
+              opt.repeat, [&] { MoveSomeVertices(mesh); },
+              [&] { parameterization.Compute(mesh); });
+      Measure("HarmonicParameterization::Compute/boundary", gen, t,
+              mesh.n_vertices(), opt.repeat, [] {}, [&] {
+                parameterization.Compute(
+                    mesh, HarmonicParameterization::Weighting::kCotan,
+                    HarmonicParameterization::Boundary::kSquare);
+              });
+      // One local-global iteration, warm started from the last one
+      geometry_lab::ArapParameterization arap;
+      arap.Initialize(mesh);
+      arap.uv_ = parameterization.uv_;
+      Measure("ArapParameterization::Iterate", gen, t, mesh.n_faces(),
+              opt.repeat, [] {}, [&] { arap.Iterate(1); });
+      if (!arap.history_.empty()) {
+        const auto& last = arap.history_.back();
+        printf("  ARAP energy %.6g -> %.6g in %zu iterations, local %.3f ms"
+               " global %.3f ms\n",
+               arap.history_.front().energy, last.energy,
+               arap.history_.size(), last.local_ms, last.global_ms);
+      }
+    }
+    // Geodesic distances, the setup factorizes both systems once and
+    // the latency of a query after it is two back-substitutions, for
+    // one source then a batch of 16 single sources
+    {
+      geometry_lab::HeatGeodesics geodesics;
+      Measure("HeatGeodesics::Initialize", gen, t, mesh.n_vertices(), 1,
+              [&] { mesh.MarkGeometryChanged(); },
+              [&] { geodesics.Initialize(mesh); });
+      const int32_t n_v = static_cast<int32_t>(mesh.n_vertices());
+      std::vector<std::vector<int32_t>> sources;
+      for (int32_t i = 0; i < 16; ++i)
+        sources.push_back({i * (n_v / 16)});
+      Measure("HeatGeodesics::Compute", gen, t, mesh.n_vertices(),
+              opt.repeat, [] {},
+              [&] { geodesics.Compute(mesh, sources[0]); });
+      Measure("HeatGeodesics::Compute/batch16", gen, t,
+              sources.size() * mesh.n_vertices(), opt.repeat, [] {},
+              [&] { geodesics.Compute(mesh, sources); });
+      const auto& report = geodesics.report_;
+      printf("  Heat geodesics setup %.3f ms, batch heat %.3f ms field %.3f"
+             " ms poisson %.3f ms\n",
+             report.setup_ms, report.heat_ms, report.field_ms,
+             report.poisson_ms);
+    }
+    // Two levels of Loop subdivision, the tables are built once per
+    // topology and a moved cage only evaluates them again
+    {
+      geometry_lab::LoopSubdivision subdivision;
+      Measure("LoopSubdivision::Build", gen, t, mesh.n_faces(), opt.repeat,
+              touch_topology, [&] { subdivision.Build(mesh, 2); });
+      Measure("LoopSubdivision::Evaluate", gen, t, 16 * mesh.n_faces(),
+              opt.repeat,
+              [&] {
+                mesh.MarkGeometryChanged();
+                mesh.soa();
+              },
+              [&] { subdivision.Evaluate(mesh); });
+    }
+    // Ray casting, the refit follows a small edit of the positions
+    geometry_lab::Bvh bvh;
+    Measure("Bvh::Build", gen, t, mesh.n_faces(), opt.repeat, [] {},
+            [&] { bvh.Build(mesh.soa()); });
+    Measure("Bvh::Refit", gen, t, mesh.n_faces(), opt.repeat,
+            [&] {
+              MoveSomeVertices(mesh);
+              mesh.soa();
+            },
+            [&] { bvh.Refit(mesh.soa()); });
+    const auto rays = CameraRays(mesh, 1000);
+    std::vector<geometry_lab::Bvh::Hit> hits(rays.size());
+    Measure("Bvh::Intersect", gen, t, rays.size(), opt.repeat, [] {},
+            [&] { bvh.Intersect(rays.data(), rays.size(), hits.data()); });
+    // Distances from the vertices pushed off the surface, in mesh order
+    {
+      const geometry_lab::TriMeshSoA& soa = mesh.soa();
+      const Eigen::Vector3f center = mesh.ComputeBoundingBox().center();
+      std::vector<float> x(soa.n_vertices()), y(x.size()), z(x.size());
+      for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = center.x() + 1.05f * (soa.x_[i] - center.x());
+        y[i] = center.y() + 1.05f * (soa.y_[i] - center.y());
+        z[i] = center.z() + 1.05f * (soa.z_[i] - center.z());
+      }
+      geometry_lab::ClosestPointQuery query;
+      Measure("ClosestPointQuery::Compute", gen, t, x.size(), opt.repeat,
+              [&] { mesh.ComputeBvh(); },
+              [&] {
+                query.Compute(mesh, x.data(), y.data(), z.data(), x.size());
+              });
+      Measure("ClosestPointQuery::Compute/signed", gen, t, x.size(),
+              opt.repeat, [&] { mesh.ComputeBvh(); },
+              [&] {
+                query.Compute(mesh, x.data(), y.data(), z.data(), x.size(),
+                              true);
+              });
+    }
+    if (reference)
+      Measure("ComputeBoundaries(OpenMesh)", gen, t, mesh.n_halfedges(),
+              opt.repeat, [] {}, [&] { ReferenceBoundaries(mesh); });
+    Measure("ComputeBoundaries", gen, t, mesh.n_halfedges(), opt.repeat,
+            touch_topology, [&] { mesh.ComputeBoundaries(); });
+    Measure("ComputeBoundaryLoops", gen, t, mesh.n_halfedges(), opt.repeat,
+            touch_topology, [&] { mesh.ComputeBoundaryLoops(); });
+    // Decimation to 10% of the faces against OpenMesh's Decimater
+    // with the same quadrics and normal test, the elements are the
+    // collapses. The boundary may move in both.
+    {
+      const size_t target = gen.n_faces() / 10;
+      const size_t collapses = (gen.n_faces() - target) / 2;
+      TriMesh decimated;
+      geometry_lab::QuadricDecimater decimater;
+      decimater.preserve_boundary_ = false;
+      Measure("QuadricDecimater::Decimate", gen, t, collapses, opt.repeat,
+              [&] {
+                decimated.BuildFromPolygons(gen.positions_, gen.indices_);
+                decimated.soa();
+              },
+              [&] { decimater.Decimate(decimated, target); });
+      printf("  QEM %zu collapses, error %.3g, setup %.3f ms collapse %.3f"
+             " ms compact %.3f ms\n",
+             decimater.report_.collapses, decimater.report_.error,
+             decimater.report_.setup_ms, decimater.report_.collapse_ms,
+             decimater.report_.compact_ms);
+      OpenMeshTriMesh reference;
+      Measure("OpenMesh::Decimater", gen, t, collapses, opt.repeat,
+              [&] { BuildOpenMeshTriMesh(gen, reference); },
+              [&] {
+                using OpenMesh::Decimater::DecimaterT;
+                using OpenMesh::Decimater::ModNormalFlippingT;
+                using OpenMesh::Decimater::ModQuadricT;
+                DecimaterT<OpenMeshTriMesh> om_decimater(reference);
+                ModQuadricT<OpenMeshTriMesh>::Handle quadric;
+                ModNormalFlippingT<OpenMeshTriMesh>::Handle flipping;
+                om_decimater.add(quadric);
+                om_decimater.add(flipping);
+                om_decimater.module(flipping).set_max_normal_deviation(
+                    static_cast<float>(decimater.max_normal_angle_));
+                om_decimater.initialize();
+                om_decimater.decimate_to_faces(0, target);
+                reference.garbage_collection();
+              });
+    }
+    // Render side without GL
+    auto shared = std::make_shared<TriMesh>(mesh);
+    TriMeshLoader loader("bench", shared);
+    Measure("TriMeshLoader::GeneratePainter", gen, t, mesh.n_faces(),
+            opt.repeat, [] {}, [&] { loader.GeneratePainter(); });
+    Measure("MeshPainter::MapColors", gen, t, mesh.n_vertices(), opt.repeat,
+            [] {}, [&] {
+              loader.painter_->MapColors(
+                  mesh.curvature_engine().mean_.data(), 1, -1.0, 1.0,
+                  geometry_lab::MeshPainter::Colormap::kCoolWarm);
+            });
+  }
+  std::filesystem::remove(obj, ec);
+}
+// ========== Render kernels ==========
+/**
+ * @brief Offscreen GL context of the render benchmarks.
+ *
+ *  A surfaceless EGL context drawing into a framebuffer object is used
+ *  when EGL is available, so no display is needed. Otherwise a hidden
+ *  GLFW window is created, which needs a display (or a virtual one
+ *  like Xvfb).
+*/
+struct GlContext {
+  /// Size of the framebuffer in pixels.
+  static constexpr int kSize = 256;
+  GLFWwindow* window = nullptr;
+#ifdef GEOMETRY_LAB_BENCH_EGL
+  EGLDisplay display = EGL_NO_DISPLAY;
+  EGLSurface surface = EGL_NO_SURFACE;
+  EGLContext context = EGL_NO_CONTEXT;
+  /// Framebuffer of the EGL context, color and depth renderbuffers.
+  GLuint fbo = 0, renderbuffers[2] = {0, 0};
+#endif
+  bool valid = false;
+  /// How the context was created, for the report.
+  const char* api = "none";
+};
+#ifdef GEOMETRY_LAB_BENCH_EGL
+/**
+ * @brief Create a surfaceless EGL context, or one with a small pbuffer
+ *  when the driver does not support surfaceless contexts.
+*/
+bool CreateEglContext(GlContext& ctx) {
+  // Prefer the surfaceless platform of Mesa, then the default display
+  const char* client = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  auto get_platform_display =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+          eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  if (client && strstr(client, "EGL_MESA_platform_surfaceless") &&
+      get_platform_display) {
+    ctx.display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                       EGL_DEFAULT_DISPLAY, nullptr);
+  }
+  if (ctx.display == EGL_NO_DISPLAY)
+    ctx.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (ctx.display == EGL_NO_DISPLAY ||
+      !eglInitialize(ctx.display, nullptr, nullptr)) {
+    ctx.display = EGL_NO_DISPLAY;
+    return false;
+  }
+  const char* extensions = eglQueryString(ctx.display, EGL_EXTENSIONS);
+  const bool surfaceless =
+      extensions && strstr(extensions, "EGL_KHR_surfaceless_context");
+  const EGLint config_attributes[] = {
+      EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  const EGLint context_attributes[] = {
+      EGL_CONTEXT_MAJOR_VERSION, GEOMETRY_LAB_GLFW_CONTEXT_VERSION_MAJOR,
+      EGL_CONTEXT_MINOR_VERSION, GEOMETRY_LAB_GLFW_CONTEXT_VERSION_MINOR,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE};
+  const EGLint pbuffer_attributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+  EGLConfig config;
+  EGLint n_configs = 0;
+  if (!eglBindAPI(EGL_OPENGL_API) ||
+      !eglChooseConfig(ctx.display, config_attributes, &config, 1,
+                       &n_configs) ||
+      n_configs == 0)
+    return false;
+  ctx.context = eglCreateContext(ctx.display, config, EGL_NO_CONTEXT,
+                                 context_attributes);
+  if (ctx.context == EGL_NO_CONTEXT)
+    return false;
+  if (!surfaceless) {
+    ctx.surface =
+        eglCreatePbufferSurface(ctx.display, config, pbuffer_attributes);
+    if (ctx.surface == EGL_NO_SURFACE)
+      return false;
+  }
+  if (!eglMakeCurrent(ctx.display, ctx.surface, ctx.surface, ctx.context) ||
+      !gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    return false;
+  // Draw into a framebuffer of the same size as the GLFW window
+  glGenFramebuffers(1, &ctx.fbo);
+  glGenRenderbuffers(2, ctx.renderbuffers);
+  glBindFramebuffer(GL_FRAMEBUFFER, ctx.fbo);
+  glBindRenderbuffer(GL_RENDERBUFFER, ctx.renderbuffers[0]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, GlContext::kSize,
+                        GlContext::kSize);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, ctx.renderbuffers[0]);
+  glBindRenderbuffer(GL_RENDERBUFFER, ctx.renderbuffers[1]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+                        GlContext::kSize, GlContext::kSize);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, ctx.renderbuffers[1]);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    return false;
+  glViewport(0, 0, GlContext::kSize, GlContext::kSize);
+  ctx.api = surfaceless ? "egl-surfaceless" : "egl-pbuffer";
+  return true;
+}
+#endif
+/**
+ * @brief Hidden GLFW window, only tried when there is a display.
+*/
+bool CreateGlfwContext(GlContext& ctx) {
+#if !defined(_WIN32) && !defined(__APPLE__)
+  if (!getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY"))
+    return false;
+#endif
+  if (!glfwInit())
+    return false;
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,
+                 GEOMETRY_LAB_GLFW_CONTEXT_VERSION_MAJOR);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,
+                 GEOMETRY_LAB_GLFW_CONTEXT_VERSION_MINOR);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  ctx.window = glfwCreateWindow(GlContext::kSize, GlContext::kSize, "bench",
+                                NULL, NULL);
+  if (!ctx.window)
+    return false;
+  glfwMakeContextCurrent(ctx.window);
+  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    return false;
+  ctx.api = "glfw";
+  return true;
+}
+void DestroyGlContext(GlContext& ctx) {
+#ifdef GEOMETRY_LAB_BENCH_EGL
+  if (ctx.display != EGL_NO_DISPLAY) {
+    if (ctx.fbo) {
+      glDeleteRenderbuffers(2, ctx.renderbuffers);
+      glDeleteFramebuffers(1, &ctx.fbo);
+    }
+    eglMakeCurrent(ctx.display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    if (ctx.context != EGL_NO_CONTEXT)
+      eglDestroyContext(ctx.display, ctx.context);
+    if (ctx.surface != EGL_NO_SURFACE)
+      eglDestroySurface(ctx.display, ctx.surface);
+    eglTerminate(ctx.display);
+  }
+#endif
+  if (ctx.window) {
+    glfwDestroyWindow(ctx.window);
+    glfwTerminate();
+  }
+  ctx = GlContext();
+}
+/**
+ * @brief Create the offscreen context, see @c GlContext.
+ * @return Success? Prints why the render benchmarks are skipped.
+*/
+bool CreateGlContext(GlContext& ctx) {
+#ifdef GEOMETRY_LAB_BENCH_EGL
+  ctx.valid = CreateEglContext(ctx);
+  if (!ctx.valid)
+    DestroyGlContext(ctx);
+#endif
+  if (!ctx.valid) {
+    ctx.valid = CreateGlfwContext(ctx);
+    if (!ctx.valid)
+      DestroyGlContext(ctx);
+  }
+  if (!ctx.valid) {
+#ifdef GEOMETRY_LAB_BENCH_EGL
+    printf("Bench::No GL context from EGL nor GLFW, render benchmarks "
+           "skipped\n");
+#else
+    printf("Bench::No GL context (built without EGL, a GLFW window needs "
+           "a display), render benchmarks skipped\n");
+#endif
+    return false;
+  }
+  glEnable(GL_DEPTH_TEST);
+  int width = GlContext::kSize, height = GlContext::kSize;
+  if (ctx.window)
+    glfwGetFramebufferSize(ctx.window, &width, &height);
+  geometry_lab::Painter::set_framebuffer_size(width, height);
+  printf("Bench::GL context from %s: %s\n", ctx.api,
+         reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+  return true;
+}
+void BenchRender(const Options& opt, const GeneratedMesh& gen) {
+  const size_t t = opt.threads.back();
+  geometry_lab::SetParallelThreadCount(t);
+  auto mesh = std::make_shared<TriMesh>();
+  mesh->BuildFromPolygons(gen.positions_, gen.indices_);
+  mesh->ComputeVertexNormalWithFace();
+  mesh->NormalizePositions(1.0f);
+  TriMeshLoader loader("bench", mesh);
+  loader.GeneratePainter();
+  loader.InitBuffers();
+  Measure("MeshPainter::LoadBuffers", gen, t, gen.n_faces(), opt.repeat,
+          [] {}, [&] {
+            loader.LoadBuffers();
+            glFinish();
+          });
+  // Streaming of a deformed mesh, every position then 1% of them
+  {
+    auto& painter = *loader.painter_;
+    std::vector<float> positions(3 * painter.vertices_.size());
+    for (size_t i = 0; i < painter.vertices_.size(); ++i) {
+      const glm::vec3 p = 1.01f * painter.vertices_[i].pos;
+      positions[3 * i] = p.x;
+      positions[3 * i + 1] = p.y;
+      positions[3 * i + 2] = p.z;
+    }
+    Measure("MeshPainter::UpdateVertexBuffer", gen, t,
+            painter.vertices_.size(), opt.repeat,
+            [&] { painter.UpdatePositions(positions); }, [&] {
+              painter.UpdateVertexBuffer();
+              glFinish();
+            });
+    const size_t n_moved = std::max<size_t>(1, painter.vertices_.size() / 100);
+    Measure("MeshPainter::UpdateVertexBuffer/1%", gen, t, n_moved,
+            opt.repeat,
+            [&] { painter.UpdatePositions(positions.data(), 0, n_moved); },
+            [&] {
+              painter.UpdateVertexBuffer();
+              glFinish();
+            });
+  }
+  // Vertex buffers with 16-bit positions, the smallest layout
+  {
+    auto& painter = *loader.painter_;
+    const auto layout = painter.layout_;
+    printf("  Vertex buffers %zu bytes / vertex", painter.vertex_bytes());
+    painter.layout_.quantize_positions = true;
+    printf(", %zu with 16-bit positions\n", painter.vertex_bytes());
+    Measure("MeshPainter::LoadVertexBuffer(16-bit)", gen, t,
+            painter.vertices_.size(), opt.repeat, [] {}, [&] {
+              painter.LoadVertexBuffer();
+              glFinish();
+            });
+    painter.layout_ = layout;
+    painter.LoadVertexBuffer();
+  }
+  constexpr int kFrames = 10;
+  for (int mode = 0; mode < 4; ++mode) {
+    loader.painter_->fill_mode_ =
+        static_cast<geometry_lab::MeshPainter::FillMode>(mode);
+    const char* names[4] = {"MeshPainter::Draw(LineAndFill)",
+                            "MeshPainter::Draw(Line)",
+                            "MeshPainter::Draw(Fill)",
+                            "MeshPainter::Draw(FillAndWire)"};
+    Measure(names[mode], gen, t, kFrames * gen.n_faces(), opt.repeat,
+            [] { glFinish(); }, [&] {
+              for (int i = 0; i < kFrames; ++i) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                loader.painter_->Draw();
+              }
+              glFinish();
+            });
+  }
+  // The mesh instanced in a scene, packed again after an edit then
+  // drawn with one instanced draw per frame
+  {
+    constexpr int kGrid = 4;
+    geometry_lab::SceneRenderer scene;
+    loader.painter_->fill_mode_ = geometry_lab::MeshPainter::FillMode::kFill;
+    for (int i = 0; i < kGrid * kGrid; ++i) {
+      const glm::vec3 position(0.5f * (i % kGrid) - 0.75f,
+                               0.5f * (i / kGrid) - 0.75f, 0.0f);
+      scene.AddInstance(
+          loader.painter_,
+          glm::scale(glm::translate(glm::identity<glm::mat4>(), position),
+                     glm::vec3(0.2f)));
+    }
+    scene.UpdateBuffers();
+    auto& painter = *loader.painter_;
+    Measure("SceneRenderer::UpdateBuffers", gen, t, painter.vertices_.size(),
+            opt.repeat,
+            [&] { painter.MarkVerticesDirty(0, painter.vertices_.size()); },
+            [&] {
+              scene.UpdateBuffers();
+              glFinish();
+            });
+    Measure("SceneRenderer::Draw(x16)", gen, t,
+            kFrames * kGrid * kGrid * gen.n_faces(), opt.repeat,
+            [] { glFinish(); }, [&] {
+              for (int i = 0; i < kFrames; ++i) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                scene.Draw();
+              }
+              glFinish();
+            });
+  }
+}
+// ========== Report ==========
+void WriteJson(const Options& opt, const GlContext& gl) {
+  FILE* file = opt.json == "-" ? stdout : fopen(opt.json.c_str(), "w");
+  if (!file) {
+    printf("Error::Bench::Failed to write: %s\n\n", opt.json.c_str());
+    return;
+  }
+  const char* simd[3] = {"scalar", "sse", "avx2"};
+  fprintf(file, "{\n  \"hardware_threads\": %u,\n  \"simd\": \"%s\",\n",
+          std::thread::hardware_concurrency(),
+          simd[static_cast<int>(geometry_lab::SupportedSimdLevel())]);
+  fprintf(file, "  \"gl\": %s,\n  \"gl_api\": \"%s\",\n  \"results\": [",
+          gl.valid ? "true" : "false", gl.api);
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    // Speedup against the first thread count of the same kernel
+    double base = r.seconds;
+    for (const Result& o : results) {
+      if (o.kernel == r.kernel && o.mesh == r.mesh && o.faces == r.faces) {
+        base = o.seconds;
+        break;
+      }
+    }
+    fprintf(file,
+            "%s\n    {\"kernel\": \"%s\", \"mesh\": \"%s\", \"faces\": %zu, "
+            "\"vertices\": %zu, \"threads\": %zu, \"elements\": %zu, "
+            "\"seconds\": %.9g, \"elements_per_second\": %.9g, "
+            "\"speedup\": %.4g, \"peak_rss_bytes\": %zu, "
+            "\"rss_growth_bytes\": %zu}",
+            i ? "," : "", r.kernel.c_str(), r.mesh.c_str(), r.faces,
+            r.vertices, r.threads, r.elements, r.seconds,
+            r.elements / std::max(r.seconds, 1e-12),
+            base / std::max(r.seconds, 1e-12), r.peak_rss, r.rss_growth);
+  }
+  fprintf(file, "\n  ]\n}\n");
+  if (file != stdout)
+    fclose(file);
+}
+// ========== Main  ==========
+int main(int argc, char** argv) {
+  Options opt;
+  if (!ParseOptions(argc, argv, opt))
+    return 1;
+  GlContext gl;
+  if (opt.render)
+    CreateGlContext(gl);
+  for (const auto& name : opt.meshes) {
+    for (const size_t n_faces : opt.faces) {
+      const GeneratedMesh gen = geometry_lab::GenerateMesh(name, n_faces);
+      if (gen.n_faces() == 0) {
+        printf("Error::Bench::Unknown mesh: %s\n\n", name.c_str());
+        return 1;
+      }
+      BenchCore(opt, gen);
+      if (gl.valid)
+        BenchRender(opt, gen);
+    }
+  }
+  if (!opt.json.empty())
+    WriteJson(opt, gl);
+  DestroyGlContext(gl);
+  return 0;
+}
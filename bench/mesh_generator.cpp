@@ -0,0 +1,212 @@
+#include "mesh_generator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "core/parallel.hpp"
+
+namespace geometry_lab {
+
+namespace {
+
+constexpr float kPi = 3.14159265358979f;
+
+/// Stateless random number in [0, 1), so the generators can run in
+/// parallel and stay deterministic.
+float Random(uint64_t seed, uint64_t i) {
+  uint64_t z = seed * 0x9E3779B97F4A7C15ull + i + 0x632BE59BD9B4E019ull;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  z ^= z >> 31;
+  return static_cast<float>(z >> 40) / static_cast<float>(1ull << 24);
+}
+
+/**
+ * @brief Triangulate a nu x nv grid of cells, two triangles per cell.
+ * @param pos[in] - Called as pos(i, j, float* xyz) for each vertex.
+ * @param keep[in] - Called as keep(i, j) for each cell, the dropped
+ *                   cells become holes.
+*/
+template <typename Pos, typename Keep>
+void Triangulate(size_t nu, size_t nv, bool wrap_u, bool wrap_v, Pos&& pos,
+                 Keep&& keep, GeneratedMesh& mesh) {
+  const size_t vu = wrap_u ? nu : nu + 1;
+  const size_t vv = wrap_v ? nv : nv + 1;
+  mesh.positions_.resize(3 * vu * vv);
+  ParallelFor(0, vu * vv, [&](size_t k) {
+    pos(k / vv, k % vv, &mesh.positions_[3 * k]);
+  });
+  // Cells kept before each cell
+  std::vector<size_t> first(nu * nv + 1, 0);
+  ParallelFor(0, nu * nv,
+              [&](size_t c) { first[c + 1] = keep(c / nv, c % nv) ? 1 : 0; });
+  for (size_t c = 0; c < nu * nv; ++c)
+    first[c + 1] += first[c];
+  mesh.indices_.resize(6 * first.back());
+  auto id = [&](size_t i, size_t j) {
+    return static_cast<int>((i % vu) * vv + (j % vv));
+  };
+  ParallelFor(0, nu * nv, [&](size_t c) {
+    if (first[c + 1] == first[c])
+      return;
+    const size_t i = c / nv, j = c % nv;
+    // a -> b along u, a -> c along v, the normal is u x v
+    const int a = id(i, j), b = id(i + 1, j);
+    const int d = id(i + 1, j + 1), e = id(i, j + 1);
+    int* tar = &mesh.indices_[6 * first[c]];
+    tar[0] = a, tar[1] = b, tar[2] = e;
+    tar[3] = b, tar[4] = d, tar[5] = e;
+  });
+}
+
+}  // namespace
+
+bool GeneratedMesh::WriteObj(const std::string& path) const {
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file)
+    return false;
+  std::vector<char> buffer(1 << 20);
+  setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+  for (size_t i = 0; i < n_vertices(); ++i) {
+    fprintf(file, "v %.7g %.7g %.7g\n", positions_[3 * i],
+            positions_[3 * i + 1], positions_[3 * i + 2]);
+  }
+  for (size_t f = 0; f < n_faces(); ++f) {
+    fprintf(file, "f %d %d %d\n", indices_[3 * f] + 1, indices_[3 * f + 1] + 1,
+            indices_[3 * f + 2] + 1);
+  }
+  const bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+GeneratedMesh GenerateGrid(size_t n_faces) {
+  GeneratedMesh mesh;
+  mesh.name_ = "grid";
+  const size_t n = std::max<size_t>(1, std::lround(std::sqrt(n_faces / 2.0)));
+  Triangulate(
+      n, n, false, false,
+      [&](size_t i, size_t j, float* p) {
+        p[0] = static_cast<float>(i) / n;
+        p[1] = static_cast<float>(j) / n;
+        p[2] = 0.0f;
+      },
+      [](size_t, size_t) { return true; }, mesh);
+  return mesh;
+}
+
+GeneratedMesh GenerateSphere(size_t n_faces) {
+  GeneratedMesh mesh;
+  mesh.name_ = "sphere";
+  // 2 * n_seg * n_ring triangles with n_seg = 2 * n_ring
+  const size_t n_ring =
+      std::max<size_t>(2, std::lround(std::sqrt(n_faces / 4.0)));
+  const size_t n_seg = 2 * n_ring;
+  // Poles first, then the rings from north to south
+  mesh.positions_.resize(3 * (2 + n_ring * n_seg));
+  float* p = mesh.positions_.data();
+  p[0] = 0.0f, p[1] = 0.0f, p[2] = 1.0f;
+  p[3] = 0.0f, p[4] = 0.0f, p[5] = -1.0f;
+  ParallelFor(0, n_ring * n_seg, [&](size_t k) {
+    const float theta = kPi * (k / n_seg + 1) / (n_ring + 1);
+    const float phi = 2.0f * kPi * (k % n_seg) / n_seg;
+    float* tar = &mesh.positions_[3 * (2 + k)];
+    tar[0] = std::sin(theta) * std::cos(phi);
+    tar[1] = std::sin(theta) * std::sin(phi);
+    tar[2] = std::cos(theta);
+  });
+  auto id = [&](size_t r, size_t s) {
+    return static_cast<int>(2 + r * n_seg + s % n_seg);
+  };
+  mesh.indices_.resize(6 * n_seg * n_ring);
+  ParallelFor(0, n_seg * n_ring, [&](size_t k) {
+    const size_t r = k / n_seg, s = k % n_seg;
+    int* tar = &mesh.indices_[6 * k];
+    if (r + 1 < n_ring) {
+      // Quad between ring r and r + 1
+      const int a = id(r, s), b = id(r, s + 1);
+      const int c = id(r + 1, s), d = id(r + 1, s + 1);
+      tar[0] = a, tar[1] = c, tar[2] = b;
+      tar[3] = b, tar[4] = c, tar[5] = d;
+    } else {
+      // The two caps
+      tar[0] = 0, tar[1] = id(0, s), tar[2] = id(0, s + 1);
+      tar[3] = id(r, s), tar[4] = 1, tar[5] = id(r, s + 1);
+    }
+  });
+  return mesh;
+}
+
+GeneratedMesh GenerateTorus(size_t n_faces, size_t n_holes) {
+  GeneratedMesh mesh;
+  mesh.name_ = "torus";
+  const size_t nv = std::max<size_t>(4, std::lround(std::sqrt(n_faces / 4.0)));
+  const size_t nu = 2 * nv;
+  const float major = 1.0f, minor = 0.35f;
+  // Holes on a lattice of stride 4 cells, so no two holes share a
+  // vertex
+  const size_t lattice_u = nu / 4, lattice_v = nv / 4;
+  const size_t n_lattice = std::max<size_t>(1, lattice_u * lattice_v);
+  const size_t step =
+      std::max<size_t>(1, n_lattice / std::max<size_t>(1, n_holes));
+  Triangulate(
+      nu, nv, true, true,
+      [&](size_t i, size_t j, float* p) {
+        const float u = 2.0f * kPi * i / nu;
+        const float v = 2.0f * kPi * j / nv;
+        p[0] = (major + minor * std::cos(v)) * std::cos(u);
+        p[1] = (major + minor * std::cos(v)) * std::sin(u);
+        p[2] = minor * std::sin(v);
+      },
+      [&](size_t i, size_t j) {
+        if (n_holes == 0 || i % 4 != 1 || j % 4 != 1 || i / 4 >= lattice_u ||
+            j / 4 >= lattice_v)
+          return true;
+        const size_t k = (i / 4) * lattice_v + j / 4;
+        return k % step != 0 || k / step >= n_holes;
+      },
+      mesh);
+  return mesh;
+}
+
+GeneratedMesh GenerateScan(size_t n_faces, float noise, float dropout,
+                           uint64_t seed) {
+  GeneratedMesh mesh;
+  mesh.name_ = "scan";
+  const size_t n = std::max<size_t>(4, std::lround(std::sqrt(n_faces / 2.0)));
+  const float h = 1.0f / n;
+  Triangulate(
+      n, n, false, false,
+      [&](size_t i, size_t j, float* p) {
+        const uint64_t k = 3 * (i * (n + 1) + j);
+        const float x = static_cast<float>(i) / n;
+        const float y = static_cast<float>(j) / n;
+        p[0] = x + noise * h * (Random(seed, k) - 0.5f);
+        p[1] = y + noise * h * (Random(seed, k + 1) - 0.5f);
+        p[2] = 0.1f * std::sin(6.0f * x) * std::cos(4.0f * y) +
+               noise * h * (Random(seed, k + 2) - 0.5f);
+      },
+      [&](size_t i, size_t j) {
+        // Candidates on a lattice of stride 3 away from the border
+        if (i % 3 != 1 || j % 3 != 1 || i + 1 >= n || j + 1 >= n)
+          return true;
+        return Random(seed + 1, i * n + j) >= dropout;
+      },
+      mesh);
+  return mesh;
+}
+
+GeneratedMesh GenerateMesh(const std::string& name, size_t n_faces) {
+  if (name == "grid")
+    return GenerateGrid(n_faces);
+  if (name == "sphere")
+    return GenerateSphere(n_faces);
+  if (name == "torus")
+    return GenerateTorus(n_faces, std::max<size_t>(1, n_faces / 1000));
+  if (name == "scan")
+    return GenerateScan(n_faces);
+  return GeneratedMesh();
+}
+
+}  // namespace geometry_lab
@@ -0,0 +1,74 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_BENCH_MESH_GENERATOR_HPP_
+#define GEOMETRY_LAB_BENCH_MESH_GENERATOR_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace geometry_lab {
+
+/**
+ * @brief Procedural triangle mesh as a polygon soup, the input of
+ *  @c TriMesh::BuildFromPolygons().
+*/
+class GeneratedMesh {
+ public:
+  /**
+   * @brief Write the mesh into an .obj file.
+   * @param path[in] - File path
+   * @return Success?
+  */
+  bool WriteObj(const std::string& path) const;
+
+  GeneratedMesh() {}
+  size_t n_vertices() const { return positions_.size() / 3; }
+  size_t n_faces() const { return indices_.size() / 3; }
+
+  /// Kind of the mesh, e.g. "grid".
+  std::string name_;
+  /// Vertex positions, (x,y,z) in a row.
+  std::vector<float> positions_;
+  /// Vertex indices of the triangles.
+  std::vector<int> indices_;
+};
+
+/**
+ * @brief Regular grid on the unit square, open with one boundary.
+ * @param n_faces[in] - Approximate number of triangles.
+*/
+GeneratedMesh GenerateGrid(size_t n_faces);
+/**
+ * @brief Closed latitude-longitude unit sphere.
+ * @param n_faces[in] - Approximate number of triangles.
+*/
+GeneratedMesh GenerateSphere(size_t n_faces);
+/**
+ * @brief Torus with square holes punched on a regular lattice.
+ * @param n_faces[in] - Approximate number of triangles.
+ * @param n_holes[in] - Maximal number of holes.
+*/
+GeneratedMesh GenerateTorus(size_t n_faces, size_t n_holes);
+/**
+ * @brief Noisy height field with random dropouts, similar to a range
+ *  scan with thousands of small holes.
+ * @param n_faces[in] - Approximate number of triangles.
+ * @param noise[in] - Amplitude of the position noise, relative to
+ *                    the grid spacing.
+ * @param dropout[in] - Probability to drop a candidate cell.
+ * @param seed[in] - Seed of the noise.
+*/
+GeneratedMesh GenerateScan(size_t n_faces, float noise = 0.2f,
+                           float dropout = 0.5f, uint64_t seed = 1);
+/**
+ * @brief Generate a mesh by name with default parameters.
+ * @param name[in] - "grid", "sphere", "torus" or "scan".
+ * @param n_faces[in] - Approximate number of triangles.
+ * @return The mesh, empty for unknown names.
+*/
+GeneratedMesh GenerateMesh(const std::string& name, size_t n_faces);
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_BENCH_MESH_GENERATOR_HPP_
@@ -1,22 +1,87 @@
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include <ImGuiFileDialog.h>
 #include <imgui.h>
+#include <core/arap.hpp>
+#include <core/closest_point.hpp>
+#include <core/decimation.hpp>
+#include <core/geodesics.hpp>
+#include <core/parameterization.hpp>
+#include <core/subdivision.hpp>
+#include <core/trace.hpp>
 #include <core/trimesh.hpp>
 #include <render/loader.hpp>
 #include <render/main_widget.hpp>
+#include <render/scene_renderer.hpp>
 
 using geometry_lab::TriMeshLoader;
 using pTriMeshLoader = std::shared_ptr<TriMeshLoader>;
 using geometry_lab::TriMesh;
+using geometry_lab::ArapParameterization;
+using geometry_lab::ClosestPointQuery;
+using geometry_lab::HarmonicParameterization;
+using geometry_lab::HeatGeodesics;
+using geometry_lab::LoopSubdivision;
+using geometry_lab::QuadricDecimater;
+using geometry_lab::SceneRenderer;
 // ========== Flags ==========
 bool show_main_manu_bar = true;
 bool show_mesh_info_menu = true;
+bool show_trace_panel = false;
+// Draw all the meshes at once instead of the current one
+bool show_scene = false;
+// Meshes this large get their levels of detail when loaded
+constexpr size_t kAutoLevelFaces = 1000000;
 // ========== Data  ==========
 std::vector<pTriMeshLoader> meshes;
 pTriMeshLoader current_mesh = nullptr;
+HarmonicParameterization parameterization;
+int uv_weighting = 2;  // Cotan
+int uv_boundary = 0;   // Circle
+int uv_checkers = 16;
+ArapParameterization arap;
+bool run_arap = false;
+int arap_iterations = 5;
+float arap_budget_ms = 10.0f;
+bool picking = false;
+int hovered_face = -1, hovered_vertex = -1;
+// Selected face, drawn in red, and the colors it had before
+int selected_face = -1;
+TriMeshLoader* selected_mesh = nullptr;
+glm::vec3 selected_colors[3];
+ClosestPointQuery distance_query;
+int distance_target = -1;
+bool distance_signed = false;
+// Mesh of the last report, its distances to the target and back
+TriMeshLoader* distance_mesh = nullptr;
+ClosestPointQuery::Summary distance_to, distance_from;
+QuadricDecimater decimater;
+int decimation_percent = 50;
+HeatGeodesics geodesics;
+// Sources picked with Shift + click on the mesh of the last distances
+std::vector<int32_t> geodesic_sources;
+TriMeshLoader* geodesic_mesh = nullptr;
+float geodesic_time_factor = 1.0f;
+int geodesic_stripes = 20;
+int curvature_kind = 1;  // Mean
+float curvature_percentile = 95.0f;
+LoopSubdivision subdivision;
+int subdivision_levels = 2;
+// Cage of the last subdivision, its rest positions and normals, and
+// the tab of the refined mesh. The animation moves a copy of the
+// positions, the cage itself stays at rest
+TriMeshLoader* subdivision_cage = nullptr;
+TriMeshLoader* subdivision_mesh = nullptr;
+std::vector<float> cage_rest, cage_normals, cage_positions;
+bool animate_cage = false;
+float cage_amplitude = 0.02f;
+// All the meshes in a row, each one repeated in a column
+SceneRenderer scene;
+int scene_copies = 1;
 // ========== Menus ==========
 // ========== 1.MainMenuBar ==========
 void NewMeshFileDialog() {
@@ -28,11 +93,16 @@ void NewMeshFileDialog() {
           "Open..", ImGuiWindowFlags_NoCollapse, min_size, max_size)) {
     if (ImGuiFileDialog::Instance()->IsOk()) {
       std::string file = ImGuiFileDialog::Instance()->GetFilePathName();
+      GEOMETRY_LAB_TRACE_SCOPE("Demo::LoadMesh");
       auto mesh = std::make_shared<TriMesh>();
       if (mesh->LoadFromFile(file)) {
         auto& new_loader =
             meshes.emplace_back(std::make_shared<TriMeshLoader>(file, mesh));
         new_loader->GeneratePainter();
+        if (mesh->n_faces() >= kAutoLevelFaces) {
+          new_loader->GenerateLevels();
+          new_loader->painter_->layout_.quantize_positions = true;
+        }
         new_loader->InitBuffers();
         new_loader->LoadBuffers();
       }
@@ -63,12 +133,298 @@ void DataTabBar() {
   }
 }
 void ShowMainMenuBar() {
+  GEOMETRY_LAB_TRACE_SCOPE("Demo::ShowMainMenuBar");
   if (ImGui::BeginMainMenuBar()) {
+    if (ImGui::BeginMenu("View")) {
+      ImGui::MenuItem("Trace", NULL, &show_trace_panel);
+      ImGui::MenuItem("Scene", NULL, &show_scene);
+      if (show_scene)
+        ImGui::SliderInt("Copies", &scene_copies, 1, 32);
+      ImGui::EndMenu();
+    }
     DataTabBar();
     ImGui::EndMainMenuBar();
   }
 }
 // ========== 2.MeshInfoMenu ==========
+void ColorByUV(const Eigen::MatrixXd& uv) {
+  // Checkerboard in the uv domain
+  std::vector<glm::vec3> colors(uv.rows());
+  for (size_t i = 0; i < colors.size(); ++i) {
+    const int u = static_cast<int>(std::floor(uv(i, 0) * uv_checkers));
+    const int v = static_cast<int>(std::floor(uv(i, 1) * uv_checkers));
+    colors[i] = ((u + v) & 1) ? glm::vec3(0.3f, 0.4f, 0.7f)
+                              : glm::vec3(1.0f, 0.9f, 0.8f);
+  }
+  current_mesh->painter_->UpdateColors(colors);
+  current_mesh->painter_->UpdateVertexBuffer();
+  if (selected_mesh == current_mesh.get())
+    selected_face = -1;
+}
+void ColorByDistance(const float* distance, float scale) {
+  // White on the surface, red outside and blue inside
+  std::vector<glm::vec3> colors(current_mesh->mesh_->n_vertices());
+  for (size_t i = 0; i < colors.size(); ++i) {
+    const float t = std::min(std::abs(distance[i]) / scale, 1.0f);
+    const glm::vec3 tint = distance[i] < 0.0f ? glm::vec3(0.2f, 0.3f, 1.0f)
+                                              : glm::vec3(1.0f, 0.2f, 0.1f);
+    colors[i] = glm::vec3(1.0f) * (1.0f - t) + tint * t;
+  }
+  current_mesh->painter_->UpdateColors(colors);
+  current_mesh->painter_->UpdateVertexBuffer();
+  if (selected_mesh == current_mesh.get())
+    selected_face = -1;
+}
+void ColorByGeodesic(const Eigen::VectorXd& distance) {
+  // Dark stripes along the isolines over a gradient from the sources,
+  // gray where no source is reachable
+  double max = 0.0;
+  for (Eigen::Index i = 0; i < distance.size(); ++i) {
+    if (std::isfinite(distance[i]))
+      max = std::max(max, distance[i]);
+  }
+  std::vector<glm::vec3> colors(distance.size());
+  for (size_t i = 0; i < colors.size(); ++i) {
+    if (!std::isfinite(distance[i])) {
+      colors[i] = glm::vec3(0.5f);
+      continue;
+    }
+    const float t = max > 0.0 ? static_cast<float>(distance[i] / max) : 0.0f;
+    const float x = t * static_cast<float>(geodesic_stripes);
+    colors[i] = glm::vec3(1.0f, 0.9f, 0.3f) * (1.0f - t) +
+                glm::vec3(0.3f, 0.1f, 0.6f) * t;
+    if (x - std::floor(x) < 0.15f)
+      colors[i] *= 0.4f;
+  }
+  current_mesh->painter_->UpdateColors(colors);
+  current_mesh->painter_->UpdateVertexBuffer();
+  if (selected_mesh == current_mesh.get())
+    selected_face = -1;
+}
+// Color the current mesh by a curvature, the diverging colormap is
+// clamped to a percentile of the magnitudes so a few spikes of a scan
+// do not wash out the rest
+void ColorByCurvature() {
+  GEOMETRY_LAB_TRACE_SCOPE("Demo::ColorByCurvature");
+  TriMesh& mesh = *current_mesh->mesh_;
+  mesh.ComputeCurvature();
+  const auto& engine = mesh.curvature_engine();
+  const double* values[] = {engine.gaussian_.data(), engine.mean_.data(),
+                            engine.principal_.data(),
+                            engine.principal_.data() + 1};
+  const size_t strides[] = {1, 1, 2, 2};
+  const double* value = values[curvature_kind];
+  const size_t stride = strides[curvature_kind];
+  std::vector<double> magnitudes;
+  magnitudes.reserve(mesh.n_vertices());
+  for (size_t i = 0; i < mesh.n_vertices(); ++i) {
+    if (std::isfinite(value[i * stride]))
+      magnitudes.push_back(std::abs(value[i * stride]));
+  }
+  double range = 0.0;
+  if (!magnitudes.empty()) {
+    const size_t k = static_cast<size_t>(
+        curvature_percentile / 100.0f * (magnitudes.size() - 1));
+    std::nth_element(magnitudes.begin(), magnitudes.begin() + k,
+                     magnitudes.end());
+    range = magnitudes[k];
+  }
+  range = std::max(range, 1e-12);
+  current_mesh->painter_->MapColors(
+      value, stride, -range, range,
+      geometry_lab::MeshPainter::Colormap::kCoolWarm);
+  current_mesh->painter_->UpdateVertexBuffer();
+  if (selected_mesh == current_mesh.get())
+    selected_face = -1;
+}
+// Geodesic distances of the current mesh to the picked sources, the
+// factorizations are reused until the mesh changes
+bool ComputeGeodesics() {
+  if (geodesic_mesh != current_mesh.get() || geodesic_sources.empty())
+    return false;
+  GEOMETRY_LAB_TRACE_SCOPE("Demo::ComputeGeodesics");
+  geodesics.time_factor_ = geodesic_time_factor;
+  if (!geodesics.Compute(*current_mesh->mesh_, geodesic_sources))
+    return false;
+  ColorByGeodesic(geodesics.distance_.col(0));
+  return true;
+}
+void AddGeodesicSource(int32_t v) {
+  if (geodesic_mesh != current_mesh.get()) {
+    geodesic_sources.clear();
+    geodesic_mesh = current_mesh.get();
+  }
+  geodesic_sources.push_back(v);
+  ComputeGeodesics();
+}
+// Vertices of a mesh in the frame of another one, both meshes were
+// normalized apart so they meet in the frame of their files
+void VerticesInFrameOf(const TriMesh& from, const TriMesh& to,
+                       std::vector<float>& x, std::vector<float>& y,
+                       std::vector<float>& z) {
+  const auto& soa = from.soa();
+  const float scale = from.source_scale_ / to.source_scale_;
+  const Eigen::Vector3f offset =
+      (from.source_offset_ - to.source_offset_) / to.source_scale_;
+  x.resize(soa.n_vertices());
+  y.resize(soa.n_vertices());
+  z.resize(soa.n_vertices());
+  for (size_t i = 0; i < soa.n_vertices(); ++i) {
+    x[i] = soa.x_[i] * scale + offset.x();
+    y[i] = soa.y_[i] * scale + offset.y();
+    z[i] = soa.z_[i] * scale + offset.z();
+  }
+}
+// Distances measured in the frame of a mesh, in units of its file
+ClosestPointQuery::Summary InSourceUnits(ClosestPointQuery::Summary summary,
+                                         const TriMesh& mesh) {
+  summary.max *= mesh.source_scale_;
+  summary.mean *= mesh.source_scale_;
+  summary.rms *= mesh.source_scale_;
+  return summary;
+}
+// Hausdorff distances between the current mesh and the target, over
+// the vertices of each one, in the units of the files
+bool CompareCurrentMesh() {
+  distance_mesh = nullptr;
+  if (distance_target < 0 ||
+      distance_target >= static_cast<int>(meshes.size()) ||
+      meshes[distance_target] == current_mesh)
+    return false;
+  GEOMETRY_LAB_TRACE_SCOPE("Demo::CompareCurrentMesh");
+  TriMesh& mesh = *current_mesh->mesh_;
+  TriMesh& target = *meshes[distance_target]->mesh_;
+  std::vector<float> x, y, z;
+  VerticesInFrameOf(target, mesh, x, y, z);
+  distance_query.Compute(mesh, x.data(), y.data(), z.data(), x.size());
+  distance_from = InSourceUnits(distance_query.Summarize(), mesh);
+  VerticesInFrameOf(mesh, target, x, y, z);
+  distance_query.Compute(target, x.data(), y.data(), z.data(), x.size(),
+                         distance_signed);
+  const ClosestPointQuery::Summary to = distance_query.Summarize();
+  distance_to = InSourceUnits(to, target);
+  distance_mesh = current_mesh.get();
+  ColorByDistance(distance_query.distance_.data(), std::max(to.max, 1e-6f));
+  return true;
+}
+// Collapse the current mesh to a percentage of its faces and send the
+// new mesh to GL
+bool DecimateCurrentMesh() {
+  GEOMETRY_LAB_TRACE_SCOPE("Demo::DecimateCurrentMesh");
+  TriMesh& mesh = *current_mesh->mesh_;
+  const size_t target = mesh.n_faces() * decimation_percent / 100;
+  if (!decimater.Decimate(mesh, target))
+    return false;
+  current_mesh->GeneratePainter();
+  current_mesh->LoadBuffers();
+  // The face and vertex indices changed
+  if (selected_mesh == current_mesh.get())
+    selected_face = -1;
+  if (distance_mesh == current_mesh.get())
+    distance_mesh = nullptr;
+  if (geodesic_mesh == current_mesh.get())
+    geodesic_mesh = nullptr;
+  if (subdivision_cage == current_mesh.get()) {
+    subdivision_cage = nullptr;
+    animate_cage = false;
+  }
+  run_arap = false;
+  return true;
+}
+// Refine the current mesh into a new tab, which follows the cage when
+// it is animated
+bool SubdivideCurrentMesh() {
+  GEOMETRY_LAB_TRACE_SCOPE("Demo::SubdivideCurrentMesh");
+  TriMesh& cage = *current_mesh->mesh_;
+  if (!subdivision.Build(cage, subdivision_levels) ||
+      !subdivision.Evaluate(cage))
+    return false;
+  auto mesh = std::make_shared<TriMesh>();
+  const std::vector<int> indices(subdivision.indices_.begin(),
+                                 subdivision.indices_.end());
+  if (!mesh->BuildFromPolygons(subdivision.positions_, indices))
+    return false;
+  // The refined mesh lies in the frame of the cage
+  mesh->source_offset_ = cage.source_offset_;
+  mesh->source_scale_ = cage.source_scale_;
+  const std::string label = current_mesh->label_ + " (Loop " +
+                            std::to_string(subdivision_levels) + ")";
+  auto& loader =
+      meshes.emplace_back(std::make_shared<TriMeshLoader>(label, mesh));
+  loader->GeneratePainter();
+  loader->painter_->UpdateNormals(subdivision.normals_);
+  loader->InitBuffers();
+  loader->LoadBuffers();
+  subdivision_cage = current_mesh.get();
+  subdivision_mesh = loader.get();
+  cage_rest.resize(3 * cage.n_vertices());
+  cage_normals.resize(3 * cage.n_vertices());
+  for (const auto& v : cage.vertices()) {
+    for (int k = 0; k < 3; ++k) {
+      cage_rest[3 * v.idx() + k] = cage.point(v)[k];
+      cage_normals[3 * v.idx() + k] = cage.normal(v)[k];
+    }
+  }
+  return true;
+}
+// Move a copy of the cage along its normals and send the refined
+// positions to GL, the stencil tables and the element buffer are kept.
+// The cage, its painter and its caches are not touched
+void AnimateCage() {
+  if (!animate_cage || !subdivision_cage || !subdivision_mesh)
+    return;
+  GEOMETRY_LAB_TRACE_SCOPE("Demo::AnimateCage");
+  TriMesh& cage = *subdivision_cage->mesh_;
+  const float time = static_cast<float>(ImGui::GetTime());
+  cage_positions.resize(cage_rest.size());
+  for (size_t v = 0; v < cage_rest.size() / 3; ++v) {
+    const float* p = &cage_rest[3 * v];
+    const float* n = &cage_normals[3 * v];
+    const float d = cage_amplitude * std::sin(3.0f * time + 10.0f * p[1]);
+    for (int k = 0; k < 3; ++k)
+      cage_positions[3 * v + k] = p[k] + d * n[k];
+  }
+  if (!subdivision.Build(cage, subdivision_levels) || subdivision.rebuilt() ||
+      !subdivision.Evaluate(cage, cage_positions)) {
+    // Another mesh or level count was refined, subdivide again
+    animate_cage = false;
+    return;
+  }
+  auto& painter = *subdivision_mesh->painter_;
+  painter.UpdatePositions(subdivision.positions_);
+  painter.UpdateNormals(subdivision.normals_);
+  painter.UpdateVertexBuffer();
+}
+bool ParameterizeCurrentMesh() {
+  GEOMETRY_LAB_TRACE_SCOPE("Demo::ParameterizeCurrentMesh");
+  if (!parameterization.Compute(
+          *current_mesh->mesh_,
+          static_cast<HarmonicParameterization::Weighting>(uv_weighting),
+          static_cast<HarmonicParameterization::Boundary>(uv_boundary)))
+    return false;
+  ColorByUV(parameterization.uv_);
+  return true;
+}
+// A few ARAP iterations per frame, from the harmonic map of the mesh
+void StepArap() {
+  if (!run_arap || !current_mesh)
+    return;
+  GEOMETRY_LAB_TRACE_SCOPE("Demo::StepArap");
+  TriMesh& mesh = *current_mesh->mesh_;
+  if (!arap.Initialize(mesh)) {
+    run_arap = false;
+    return;
+  }
+  if (arap.history_.empty()) {
+    if (!ParameterizeCurrentMesh()) {
+      run_arap = false;
+      return;
+    }
+    arap.uv_ = parameterization.uv_;
+  }
+  if (arap.Iterate(arap_iterations, arap_budget_ms) > 0)
+    ColorByUV(arap.uv_);
+}
 void MeshInfo() {
   if (current_mesh) {
     ImGui::PushID(current_mesh->label_.c_str());
@@ -80,6 +436,11 @@ void MeshInfo() {
       ImGui::Text("Vertices : %lld", current_mesh->mesh_->n_vertices());
       ImGui::Text("Edges : %lld", current_mesh->mesh_->n_edges());
       ImGui::Text("Faces : %lld", current_mesh->mesh_->n_faces());
+      ImGui::Separator();
+      // Write the binary cache next to the source, which is picked up
+      // by TriMesh::LoadFromFile() next time
+      if (ImGui::Button("Save Cache"))
+        current_mesh->mesh_->SaveCache();
     }
     if (ImGui::CollapsingHeader("Render", NULL,
                                 ImGuiTreeNodeFlags_DefaultOpen)) {
@@ -98,11 +459,257 @@ void MeshInfo() {
       ImGui::RadioButton("Line", (int*)&current_mesh->painter_->fill_mode_, 1);
       ImGui::SameLine();
       ImGui::RadioButton("Both", (int*)&current_mesh->painter_->fill_mode_, 0);
+      ImGui::SameLine();
+      ImGui::RadioButton("Wire", (int*)&current_mesh->painter_->fill_mode_, 3);
+      if (current_mesh->painter_->fill_mode_ ==
+          geometry_lab::MeshPainter::FillMode::kFillAndWire) {
+        ImGui::SliderFloat("Wire width", &current_mesh->painter_->wire_width_,
+                           0.5f, 4.0f);
+        ImGui::ColorEdit3("Wire color",
+                          &current_mesh->painter_->wire_color_[0]);
+      }
+      ImGui::Separator();
+      auto& painter = *current_mesh->painter_;
+      ImGui::Checkbox("Levels of detail", &painter.lod_enabled_);
+      ImGui::SliderFloat("Triangles / pixel", &painter.lod_density_, 0.05f,
+                         4.0f);
+      if (ImGui::Button("Generate levels")) {
+        if (current_mesh->GenerateLevels())
+          painter.LoadElementBuffer();
+      }
+      ImGui::Text("Level %zu of %zu, %zu triangles", painter.level_,
+                  painter.n_levels(), painter.n_level_faces(painter.level_));
+      ImGui::Separator();
+      // A new layout is sent by the next upload
+      bool relayout = false;
+      relayout |= ImGui::Checkbox("16-bit positions",
+                                  &painter.layout_.quantize_positions);
+      relayout |= ImGui::Checkbox("Packed normals",
+                                  &painter.layout_.pack_normals);
+      relayout |= ImGui::Checkbox("Packed colors",
+                                  &painter.layout_.pack_colors);
+      if (relayout)
+        painter.UpdateVertexBuffer();
+      ImGui::Text("%zu bytes / vertex", painter.vertex_bytes());
+    }
+    if (ImGui::CollapsingHeader("Picking")) {
+      ImGui::TextWrapped(
+          "Hover the mesh to see the face and the vertex under the mouse, "
+          "Ctrl + click selects the face");
+      ImGui::Separator();
+      ImGui::Checkbox("Pick under the mouse", &picking);
+      if (picking) {
+        const auto& bvh = current_mesh->mesh_->ComputeBvh();
+        ImGui::Text("BVH : %zu nodes, depth %zu", bvh.nodes_.size(),
+                    bvh.depth());
+      }
+      if (selected_face >= 0 && selected_mesh == current_mesh.get())
+        ImGui::Text("Selected face : %d", selected_face);
+    }
+    if (ImGui::CollapsingHeader("Distance")) {
+      ImGui::TextWrapped(
+          "Distances from the vertices of each mesh to the surface of the "
+          "other one, in the units of the files. The mesh is colored by its "
+          "distance to the target");
+      ImGui::Separator();
+      std::vector<const char*> labels;
+      for (const auto& obj : meshes)
+        labels.push_back(obj->label_.c_str());
+      ImGui::Combo("Target", &distance_target, labels.data(),
+                   static_cast<int>(labels.size()));
+      ImGui::Checkbox("Signed", &distance_signed);
+      if (ImGui::Button("Hausdorff"))
+        CompareCurrentMesh();
+      if (distance_mesh == current_mesh.get()) {
+        ImGui::Text("To target : max %.6f", distance_to.max);
+        ImGui::Text("  mean %.6f, rms %.6f", distance_to.mean,
+                    distance_to.rms);
+        ImGui::Text("From target : max %.6f", distance_from.max);
+        ImGui::Text("  mean %.6f, rms %.6f", distance_from.mean,
+                    distance_from.rms);
+        ImGui::Text("Hausdorff : %.6f",
+                    std::max(distance_to.max, distance_from.max));
+      }
+    }
+    if (ImGui::CollapsingHeader("Curvature")) {
+      ImGui::TextWrapped(
+          "Color the vertices by a discrete curvature, blue is negative "
+          "and red is positive");
+      ImGui::Separator();
+      const char* kinds[] = {"Gaussian", "Mean", "Max principal",
+                             "Min principal"};
+      ImGui::Combo("Curvature", &curvature_kind, kinds, 4);
+      ImGui::SliderFloat("Clamp (percentile)", &curvature_percentile, 50.0f,
+                         100.0f);
+      if (ImGui::Button("Color by curvature"))
+        ColorByCurvature();
+    }
+    if (ImGui::CollapsingHeader("Geodesics")) {
+      ImGui::TextWrapped(
+          "Shift + click adds the hovered vertex as a source (needs "
+          "picking), the mesh is colored by the geodesic distance to the "
+          "sources");
+      ImGui::Separator();
+      ImGui::SliderFloat("Time factor", &geodesic_time_factor, 0.1f, 10.0f);
+      ImGui::SliderInt("Stripes", &geodesic_stripes, 1, 64);
+      if (geodesic_mesh == current_mesh.get()) {
+        ImGui::Text("%zu sources", geodesic_sources.size());
+        if (ImGui::Button("Update"))
+          ComputeGeodesics();
+        ImGui::SameLine();
+        if (ImGui::Button("Clear"))
+          geodesic_sources.clear();
+        const auto& report = geodesics.report_;
+        ImGui::Text("Setup %.1f ms", report.setup_ms);
+        ImGui::Text("Query %.1f ms : heat %.1f, field %.1f,",
+                    report.heat_ms + report.field_ms + report.poisson_ms,
+                    report.heat_ms, report.field_ms);
+        ImGui::Text("  poisson %.1f", report.poisson_ms);
+      }
+    }
+    if (ImGui::CollapsingHeader("Decimation")) {
+      ImGui::TextWrapped(
+          "Collapse the edges of least quadric error until the mesh has "
+          "the given percentage of its faces");
+      ImGui::Separator();
+      ImGui::SliderInt("Faces (%)", &decimation_percent, 1, 99);
+      ImGui::Checkbox("Preserve boundary", &decimater.preserve_boundary_);
+      if (ImGui::Button("Decimate"))
+        DecimateCurrentMesh();
+      const auto& report = decimater.report_;
+      if (report.collapses > 0) {
+        ImGui::Text("%zu collapses, error %.3g", report.collapses,
+                    report.error);
+        ImGui::Text("Setup %.1f ms, collapses %.1f ms", report.setup_ms,
+                    report.collapse_ms);
+        ImGui::Text("Compaction %.1f ms", report.compact_ms);
+      }
+    }
+    if (ImGui::CollapsingHeader("Subdivision")) {
+      ImGui::TextWrapped(
+          "Loop subdivision of the mesh into a new tab, the animated cage "
+          "only evaluates the stencils again");
+      ImGui::Separator();
+      ImGui::SliderInt("Levels", &subdivision_levels, 1, 4);
+      if (ImGui::Button("Subdivide"))
+        SubdivideCurrentMesh();
+      if (subdivision_cage == current_mesh.get()) {
+        ImGui::Checkbox("Animate cage", &animate_cage);
+        ImGui::SliderFloat("Amplitude", &cage_amplitude, 0.0f, 0.1f);
+        ImGui::Text("%zu vertices, %zu faces", subdivision.n_vertices(),
+                    subdivision.n_faces());
+      }
+    }
+    if (ImGui::CollapsingHeader("Parameterization")) {
+      ImGui::TextWrapped(
+          "Map the longest boundary loop to a circle or a square, the "
+          "mesh is colored by a checkerboard of the uv");
+      ImGui::Separator();
+      const char* weightings[] = {"Uniform", "Mean Value", "Cotan"};
+      ImGui::Combo("Weights", &uv_weighting, weightings, 3);
+      ImGui::RadioButton("Circle", &uv_boundary, 0);
+      ImGui::SameLine();
+      ImGui::RadioButton("Square", &uv_boundary, 1);
+      ImGui::SliderInt("Checkers", &uv_checkers, 2, 64);
+      if (ImGui::Button("Compute UV"))
+        ParameterizeCurrentMesh();
+      ImGui::Separator();
+      ImGui::Checkbox("Run ARAP", &run_arap);
+      ImGui::SliderInt("Iterations / frame", &arap_iterations, 1, 50);
+      ImGui::SliderFloat("Budget (ms)", &arap_budget_ms, 1.0f, 100.0f);
+      if (!arap.history_.empty()) {
+        const auto& last = arap.history_.back();
+        ImGui::Text("Iteration %zu, energy %.6f", arap.history_.size(),
+                    last.energy);
+        ImGui::Text("Local %.2f ms, global %.2f ms", last.local_ms,
+                    last.global_ms);
+      }
     }
     ImGui::PopID();
   }
 }
+// ========== 3.Scene ==========
+void UpdateScene() {
+  if (!show_scene)
+    return;
+  GEOMETRY_LAB_TRACE_SCOPE("Demo::UpdateScene");
+  float radius = 1e-6f;
+  for (const auto& obj : meshes)
+    radius = std::max(radius, obj->painter_->bounding_radius_);
+  // Shrink the meshes so that the longest side stays in the view
+  const size_t rows = static_cast<size_t>(scene_copies);
+  const float scale = 1.0f / static_cast<float>(std::max(meshes.size(), rows));
+  const float step = 2.2f * radius * scale;
+  scene.instances_.clear();
+  for (size_t i = 0; i < meshes.size(); ++i) {
+    for (size_t j = 0; j < rows; ++j) {
+      const glm::vec3 position(step * (i - 0.5f * (meshes.size() - 1)),
+                               step * (j - 0.5f * (rows - 1)), 0.0f);
+      scene.AddInstance(
+          meshes[i]->painter_,
+          glm::scale(glm::translate(glm::identity<glm::mat4>(), position),
+                     glm::vec3(scale)));
+    }
+  }
+  scene.UpdateBuffers();
+}
+// ========== 4.Picking ==========
+void RestoreSelection() {
+  if (selected_face < 0)
+    return;
+  const auto& faces = selected_mesh->mesh_->soa().faces_;
+  auto& painter = *selected_mesh->painter_;
+  for (int k = 0; k < 3; ++k) {
+    const int32_t v = faces[3 * selected_face + k];
+    painter.vertices_[v].color = selected_colors[k];
+    painter.MarkVerticesDirty(v, 1, geometry_lab::MeshPainter::kColorBit);
+  }
+  painter.UpdateVertexBuffer();
+  selected_face = -1;
+}
+void PickUnderMouse() {
+  hovered_face = hovered_vertex = -1;
+  if (!picking || !current_mesh || show_scene ||
+      ImGui::GetIO().WantCaptureMouse)
+    return;
+  GEOMETRY_LAB_TRACE_SCOPE("Demo::PickUnderMouse");
+  TriMesh& mesh = *current_mesh->mesh_;
+  glm::vec3 origin, direction;
+  current_mesh->painter_->MouseRay(origin, direction);
+  geometry_lab::Bvh::Ray ray;
+  ray.origin = Eigen::Vector3f(origin.x, origin.y, origin.z);
+  ray.direction = Eigen::Vector3f(direction.x, direction.y, direction.z);
+  ray.t_max = 1.0f;
+  const auto hit = mesh.ComputeBvh().Intersect(ray);
+  if (hit.face < 0)
+    return;
+  // The vertex of the face closest to the hit point
+  const auto& faces = mesh.soa().faces_;
+  const float weights[3] = {1.0f - hit.u - hit.v, hit.u, hit.v};
+  const int k = static_cast<int>(
+      std::max_element(weights, weights + 3) - weights);
+  hovered_face = hit.face;
+  hovered_vertex = faces[3 * hit.face + k];
+  ImGui::SetTooltip("Face %d\nVertex %d", hovered_face, hovered_vertex);
+  if (ImGui::IsMouseClicked(0) && ImGui::GetIO().KeyShift)
+    AddGeodesicSource(hovered_vertex);
+  if (ImGui::IsMouseClicked(0) && ImGui::GetIO().KeyCtrl) {
+    RestoreSelection();
+    selected_face = hit.face;
+    selected_mesh = current_mesh.get();
+    auto& vertices = current_mesh->painter_->vertices_;
+    for (int j = 0; j < 3; ++j) {
+      const int32_t v = faces[3 * selected_face + j];
+      selected_colors[j] = vertices[v].color;
+      vertices[v].color = glm::vec3(1.0f, 0.1f, 0.1f);
+      current_mesh->painter_->MarkVerticesDirty(
+          v, 1, geometry_lab::MeshPainter::kColorBit);
+    }
+    current_mesh->painter_->UpdateVertexBuffer();
+  }
+}
 void ShowMeshInfoMenu() {
+  GEOMETRY_LAB_TRACE_SCOPE("Demo::ShowMeshInfoMenu");
   const auto& viewport = ImGui::GetMainViewport();
   ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x, viewport->WorkPos.y));
   ImGui::SetNextWindowSize(ImVec2(300, viewport->WorkSize.y));
@@ -126,14 +733,24 @@ int main() {
   glfwSetWindowTitle(main_widget->main_window_, "Demo window");
   while (!main_widget->should_close()) {
     main_widget->StartNewFrame();
-    if (current_mesh)
+    if (show_scene)
+      scene.CallBack();
+    else if (current_mesh)
       current_mesh->painter_->CallBack();
+    StepArap();
+    AnimateCage();
+    PickUnderMouse();
     if (show_main_manu_bar)
       ShowMainMenuBar();
     if (show_mesh_info_menu)
       ShowMeshInfoMenu();
+    if (show_trace_panel)
+      main_widget->ShowTracePanel(&show_trace_panel);
+    UpdateScene();
     main_widget->Render();
-    if (current_mesh)
+    if (show_scene)
+      scene.Draw();
+    else if (current_mesh)
       current_mesh->painter_->Draw();
     main_widget->EndFrame();
   }
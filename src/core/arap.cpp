@@ -0,0 +1,390 @@
+#include "core/arap.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#ifdef GEOMETRY_LAB_X86
+#include <immintrin.h>
+#endif
+
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh.hpp"
+
+namespace geometry_lab {
+
+namespace {
+
+/// Raw pointers shared by the kernels of the local step.
+struct LocalData {
+  const int32_t* faces;
+  const double *u, *v;
+  const double *x0, *x1, *y1;
+  const double* weight;
+  double *rhs_x, *rhs_y;
+  size_t n_f;
+};
+
+// With e_k the uv edge and r_k the rest edge of the k-th halfedge of
+// a face, the best rotation maximizes tr(R^T S) for the covariance
+//   S = sum_k cot_k e_k r_k^T = [a b; c d]
+// so its cosine and sine are (a + d, c - b) normalized, no SVD is
+// needed in 2D.
+
+double LocalScalar(const LocalData& d, size_t begin, size_t end) {
+  double energy = 0.0;
+  for (size_t f = begin; f < end; ++f) {
+    const int32_t* v = d.faces + 3 * f;
+    const double eu[3] = {d.u[v[1]] - d.u[v[0]], d.u[v[2]] - d.u[v[1]],
+                          d.u[v[0]] - d.u[v[2]]};
+    const double ev[3] = {d.v[v[1]] - d.v[v[0]], d.v[v[2]] - d.v[v[1]],
+                          d.v[v[0]] - d.v[v[2]]};
+    const double rx[3] = {d.x0[f], d.x1[f], -d.x0[f] - d.x1[f]};
+    const double ry[3] = {0.0, d.y1[f], -d.y1[f]};
+    const double w[3] = {d.weight[f], d.weight[d.n_f + f],
+                         d.weight[2 * d.n_f + f]};
+    double a = 0.0, b = 0.0, c = 0.0, dd = 0.0;
+    for (int k = 0; k < 3; ++k) {
+      a += w[k] * eu[k] * rx[k];
+      b += w[k] * eu[k] * ry[k];
+      c += w[k] * ev[k] * rx[k];
+      dd += w[k] * ev[k] * ry[k];
+    }
+    double cs = a + dd, sn = c - b;
+    const double n = std::sqrt(cs * cs + sn * sn);
+    if (n > 0.0) {
+      cs /= n;
+      sn /= n;
+    } else {
+      cs = 1.0;
+      sn = 0.0;
+    }
+    for (int k = 0; k < 3; ++k) {
+      const double qx = cs * rx[k] - sn * ry[k];
+      const double qy = sn * rx[k] + cs * ry[k];
+      d.rhs_x[k * d.n_f + f] = 0.5 * w[k] * qx;
+      d.rhs_y[k * d.n_f + f] = 0.5 * w[k] * qy;
+      const double du = eu[k] - qx, dv = ev[k] - qy;
+      energy += 0.5 * w[k] * (du * du + dv * dv);
+    }
+  }
+  return energy;
+}
+
+#ifdef GEOMETRY_LAB_X86
+double LocalSSE(const LocalData& d, size_t begin, size_t end) {
+  const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1.0);
+  const __m128d half = _mm_set1_pd(0.5);
+  __m128d energy = zero;
+  size_t f = begin;
+  for (; f + 2 <= end; f += 2) {
+    const int32_t* v = d.faces + 3 * f;
+    __m128d u[3], w[3], vv[3];
+    for (int k = 0; k < 3; ++k) {
+      u[k] = _mm_setr_pd(d.u[v[k]], d.u[v[3 + k]]);
+      vv[k] = _mm_setr_pd(d.v[v[k]], d.v[v[3 + k]]);
+      w[k] = _mm_loadu_pd(d.weight + k * d.n_f + f);
+    }
+    const __m128d x0 = _mm_loadu_pd(d.x0 + f), x1 = _mm_loadu_pd(d.x1 + f);
+    const __m128d y1 = _mm_loadu_pd(d.y1 + f);
+    const __m128d rx[3] = {x0, x1, _mm_sub_pd(zero, _mm_add_pd(x0, x1))};
+    const __m128d ry[3] = {zero, y1, _mm_sub_pd(zero, y1)};
+    __m128d eu[3], ev[3];
+    __m128d a = zero, b = zero, c = zero, dd = zero;
+    for (int k = 0; k < 3; ++k) {
+      eu[k] = _mm_sub_pd(u[(k + 1) % 3], u[k]);
+      ev[k] = _mm_sub_pd(vv[(k + 1) % 3], vv[k]);
+      const __m128d wu = _mm_mul_pd(w[k], eu[k]);
+      const __m128d wv = _mm_mul_pd(w[k], ev[k]);
+      a = _mm_add_pd(a, _mm_mul_pd(wu, rx[k]));
+      b = _mm_add_pd(b, _mm_mul_pd(wu, ry[k]));
+      c = _mm_add_pd(c, _mm_mul_pd(wv, rx[k]));
+      dd = _mm_add_pd(dd, _mm_mul_pd(wv, ry[k]));
+    }
+    __m128d cs = _mm_add_pd(a, dd), sn = _mm_sub_pd(c, b);
+    const __m128d n =
+        _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(cs, cs), _mm_mul_pd(sn, sn)));
+    // Identity for the degenerate faces
+    const __m128d valid = _mm_cmpgt_pd(n, zero);
+    const __m128d inv = _mm_div_pd(one, n);
+    cs = _mm_or_pd(_mm_and_pd(valid, _mm_mul_pd(cs, inv)),
+                   _mm_andnot_pd(valid, one));
+    sn = _mm_and_pd(valid, _mm_mul_pd(sn, inv));
+    for (int k = 0; k < 3; ++k) {
+      const __m128d qx =
+          _mm_sub_pd(_mm_mul_pd(cs, rx[k]), _mm_mul_pd(sn, ry[k]));
+      const __m128d qy =
+          _mm_add_pd(_mm_mul_pd(sn, rx[k]), _mm_mul_pd(cs, ry[k]));
+      const __m128d hw = _mm_mul_pd(half, w[k]);
+      _mm_storeu_pd(d.rhs_x + k * d.n_f + f, _mm_mul_pd(hw, qx));
+      _mm_storeu_pd(d.rhs_y + k * d.n_f + f, _mm_mul_pd(hw, qy));
+      const __m128d du = _mm_sub_pd(eu[k], qx), dv = _mm_sub_pd(ev[k], qy);
+      energy = _mm_add_pd(
+          energy,
+          _mm_mul_pd(hw, _mm_add_pd(_mm_mul_pd(du, du), _mm_mul_pd(dv, dv))));
+    }
+  }
+  alignas(16) double lanes[2];
+  _mm_store_pd(lanes, energy);
+  return lanes[0] + lanes[1] + LocalScalar(d, f, end);
+}
+
+GEOMETRY_LAB_TARGET_AVX2
+double LocalAVX2(const LocalData& d, size_t begin, size_t end) {
+  // Offsets of the k-th vertex of 4 consecutive faces
+  const __m128i stride = _mm_setr_epi32(0, 3, 6, 9);
+  const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0);
+  const __m256d half = _mm256_set1_pd(0.5);
+  __m256d energy = zero;
+  size_t f = begin;
+  for (; f + 4 <= end; f += 4) {
+    const int* v = reinterpret_cast<const int*>(d.faces + 3 * f);
+    __m256d u[3], w[3], vv[3];
+    for (int k = 0; k < 3; ++k) {
+      const __m128i vk = _mm_i32gather_epi32(v + k, stride, 4);
+      u[k] = _mm256_i32gather_pd(d.u, vk, 8);
+      vv[k] = _mm256_i32gather_pd(d.v, vk, 8);
+      w[k] = _mm256_loadu_pd(d.weight + k * d.n_f + f);
+    }
+    const __m256d x0 = _mm256_loadu_pd(d.x0 + f);
+    const __m256d x1 = _mm256_loadu_pd(d.x1 + f);
+    const __m256d y1 = _mm256_loadu_pd(d.y1 + f);
+    const __m256d rx[3] = {x0, x1, _mm256_sub_pd(zero, _mm256_add_pd(x0, x1))};
+    const __m256d ry[3] = {zero, y1, _mm256_sub_pd(zero, y1)};
+    __m256d eu[3], ev[3];
+    __m256d a = zero, b = zero, c = zero, dd = zero;
+    for (int k = 0; k < 3; ++k) {
+      eu[k] = _mm256_sub_pd(u[(k + 1) % 3], u[k]);
+      ev[k] = _mm256_sub_pd(vv[(k + 1) % 3], vv[k]);
+      const __m256d wu = _mm256_mul_pd(w[k], eu[k]);
+      const __m256d wv = _mm256_mul_pd(w[k], ev[k]);
+      a = _mm256_add_pd(a, _mm256_mul_pd(wu, rx[k]));
+      b = _mm256_add_pd(b, _mm256_mul_pd(wu, ry[k]));
+      c = _mm256_add_pd(c, _mm256_mul_pd(wv, rx[k]));
+      dd = _mm256_add_pd(dd, _mm256_mul_pd(wv, ry[k]));
+    }
+    __m256d cs = _mm256_add_pd(a, dd), sn = _mm256_sub_pd(c, b);
+    const __m256d n = _mm256_sqrt_pd(
+        _mm256_add_pd(_mm256_mul_pd(cs, cs), _mm256_mul_pd(sn, sn)));
+    // Identity for the degenerate faces
+    const __m256d valid = _mm256_cmp_pd(n, zero, _CMP_GT_OQ);
+    const __m256d inv = _mm256_div_pd(one, n);
+    cs = _mm256_blendv_pd(one, _mm256_mul_pd(cs, inv), valid);
+    sn = _mm256_and_pd(valid, _mm256_mul_pd(sn, inv));
+    for (int k = 0; k < 3; ++k) {
+      const __m256d qx =
+          _mm256_sub_pd(_mm256_mul_pd(cs, rx[k]), _mm256_mul_pd(sn, ry[k]));
+      const __m256d qy =
+          _mm256_add_pd(_mm256_mul_pd(sn, rx[k]), _mm256_mul_pd(cs, ry[k]));
+      const __m256d hw = _mm256_mul_pd(half, w[k]);
+      _mm256_storeu_pd(d.rhs_x + k * d.n_f + f, _mm256_mul_pd(hw, qx));
+      _mm256_storeu_pd(d.rhs_y + k * d.n_f + f, _mm256_mul_pd(hw, qy));
+      const __m256d du = _mm256_sub_pd(eu[k], qx);
+      const __m256d dv = _mm256_sub_pd(ev[k], qy);
+      const __m256d sq =
+          _mm256_add_pd(_mm256_mul_pd(du, du), _mm256_mul_pd(dv, dv));
+      energy = _mm256_add_pd(energy, _mm256_mul_pd(hw, sq));
+    }
+  }
+  alignas(32) double lanes[4];
+  _mm256_store_pd(lanes, energy);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + LocalScalar(d, f, end);
+}
+#endif
+
+}  // namespace
+
+bool ArapParameterization::Initialize(TriMesh& mesh) {
+  if (mesh_ == &mesh && topology_ == mesh.topology_generation() &&
+      geometry_ == mesh.geometry_generation())
+    return true;
+  GEOMETRY_LAB_TRACE_SCOPE("ArapParameterization::Initialize");
+  mesh_ = nullptr;
+  history_.clear();
+  const TriMeshSoA& soa = mesh.soa();
+  const size_t n_v = soa.n_vertices(), n_f = soa.n_faces();
+  if (n_f == 0) {
+    printf("Error::ArapParameterization::The mesh has no face.\n\n");
+    return false;
+  }
+  // The Laplacian brings the HalfedgeDiff and FaceArea properties up
+  // to date
+  const LaplacianOperator& laplacian = mesh.ComputeLaplacian();
+  auto halfedge_diff = mesh.prop_halfedge_diff();
+  auto face_area = mesh.prop_face_area();
+  // 1. Rest frames and cotangent weights, the same as in the Laplacian
+  x0_.resize(n_f);
+  x1_.resize(n_f);
+  y1_.resize(n_f);
+  weight_.resize(3 * n_f);
+  rhs_x_.resize(3 * n_f);
+  rhs_y_.resize(3 * n_f);
+  corner_.assign(soa.n_halfedges(), -1);
+  ParallelFor(0, n_f, [&](size_t f) {
+    int32_t h[3];
+    h[0] = soa.face_halfedge_[f];
+    h[1] = soa.next_[h[0]];
+    h[2] = soa.next_[h[1]];
+    Eigen::Vector2d diff[3];
+    for (int k = 0; k < 3; ++k)
+      diff[k] = halfedge_diff[OpenMesh::HalfedgeHandle(h[k])];
+    x0_[f] = diff[0].x();
+    x1_[f] = diff[1].x();
+    y1_[f] = diff[1].y();
+    const double a = face_area[OpenMesh::FaceHandle(static_cast<int>(f))];
+    const double inv = a > 0.0 ? 0.5 / a : 0.0;
+    for (int k = 0; k < 3; ++k) {
+      weight_[k * n_f + f] = -diff[(k + 1) % 3].dot(diff[(k + 2) % 3]) * inv;
+      corner_[h[k]] = static_cast<int32_t>(k * n_f + f);
+    }
+  });
+  total_area_ = 0.0;
+  for (const auto& fh : mesh.faces())
+    total_area_ += face_area[fh];
+  // 2. Pin one vertex of each connected component
+  pinned_.clear();
+  std::vector<uint8_t> visited(n_v, 0);
+  std::vector<int32_t> stack;
+  for (size_t s = 0; s < n_v; ++s) {
+    if (visited[s])
+      continue;
+    visited[s] = 1;
+    pinned_.push_back(static_cast<int32_t>(s));
+    stack.push_back(static_cast<int32_t>(s));
+    while (!stack.empty()) {
+      const int32_t v = stack.back();
+      stack.pop_back();
+      const int32_t h0 = soa.vertex_halfedge_[v];
+      if (h0 < 0)
+        continue;
+      int32_t h = h0;
+      do {
+        const int32_t t = soa.to_vertex_[h];
+        if (!visited[t]) {
+          visited[t] = 1;
+          stack.push_back(t);
+        }
+        h = soa.next_[TriMeshSoA::opposite(h)];
+      } while (h != h0);
+    }
+  }
+  // 3. The matrix of the global step never changes
+  if (!solver_.Factorize(laplacian, 0.0, 1.0, pinned_))
+    return false;
+  rhs_.resize(n_v, 2);
+  mesh_ = &mesh;
+  topology_ = mesh.topology_generation();
+  geometry_ = mesh.geometry_generation();
+  return true;
+}
+
+size_t ArapParameterization::Iterate(size_t max_iterations, double max_ms) {
+  GEOMETRY_LAB_TRACE_SCOPE("ArapParameterization::Iterate");
+  using Clock = std::chrono::steady_clock;
+  auto ms = [](Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+  };
+  if (!mesh_ || topology_ != mesh_->topology_generation() ||
+      geometry_ != mesh_->geometry_generation()) {
+    printf("Error::ArapParameterization::Not initialized for the mesh.\n\n");
+    return 0;
+  }
+  if (static_cast<size_t>(uv_.rows()) != mesh_->n_vertices() ||
+      uv_.cols() != 2) {
+    printf("Error::ArapParameterization::No initial uv.\n\n");
+    return 0;
+  }
+  const Clock::time_point start = Clock::now();
+  size_t k = 0;
+  while (k < max_iterations) {
+    const Clock::time_point t0 = Clock::now();
+    const double energy = LocalStep();
+    const Clock::time_point t1 = Clock::now();
+    if (!GlobalStep()) {
+      printf("Error::ArapParameterization::Failed to solve.\n\n");
+      break;
+    }
+    const Clock::time_point t2 = Clock::now();
+    history_.push_back({energy / total_area_, static_cast<float>(ms(t0, t1)),
+                        static_cast<float>(ms(t1, t2))});
+    GEOMETRY_LAB_TRACE_COUNTER("ArapParameterization::Energy",
+                               history_.back().energy);
+    ++k;
+    if (max_ms > 0.0 && ms(start, t2) >= max_ms)
+      break;
+  }
+  if (!mesh_->has_vertex_texcoords2D())
+    mesh_->request_vertex_texcoords2D();
+  ParallelFor(0, mesh_->n_vertices(), [&](size_t v) {
+    mesh_->set_texcoord2D(OpenMesh::VertexHandle(static_cast<int>(v)),
+                          TriMesh::TexCoord2D(static_cast<float>(uv_(v, 0)),
+                                              static_cast<float>(uv_(v, 1))));
+  });
+  return k;
+}
+
+double ArapParameterization::LocalStep() {
+  GEOMETRY_LAB_TRACE_SCOPE("ArapParameterization::LocalStep");
+  const TriMeshSoA& mesh = mesh_->soa();
+  const size_t n_f = mesh.n_faces();
+  const LocalData data = {
+      mesh.faces_.data(), uv_.col(0).data(), uv_.col(1).data(),
+      x0_.data(),         x1_.data(),        y1_.data(),
+      weight_.data(),     rhs_x_.data(),     rhs_y_.data(),
+      n_f,
+  };
+  // Energy of each block, summed in order so it does not depend on
+  // the timing of the threads
+  std::vector<double> energy(ParallelBlockCount(n_f));
+  const SimdLevel run = DispatchSimdLevel(simd_level_);
+  ParallelBlocks(n_f, [&](size_t block, size_t begin, size_t end) {
+    switch (run) {
+#ifdef GEOMETRY_LAB_X86
+      case SimdLevel::kAVX2:
+        energy[block] = LocalAVX2(data, begin, end);
+        break;
+      case SimdLevel::kSSE:
+        energy[block] = LocalSSE(data, begin, end);
+        break;
+#endif
+      default:
+        energy[block] = LocalScalar(data, begin, end);
+    }
+  });
+  double rst = 0.0;
+  for (const double e : energy)
+    rst += e;
+  return rst;
+}
+
+bool ArapParameterization::GlobalStep() {
+  GEOMETRY_LAB_TRACE_SCOPE("ArapParameterization::GlobalStep");
+  const TriMeshSoA& mesh = mesh_->soa();
+  // Each vertex gathers its incoming halfedges minus its outgoing ones
+  ParallelFor(0, mesh.n_vertices(), [&](size_t v) {
+    double bx = 0.0, by = 0.0;
+    const int32_t h0 = mesh.vertex_halfedge_[v];
+    if (h0 >= 0) {
+      int32_t h = h0;
+      do {
+        const int32_t in = corner_[TriMeshSoA::opposite(h)];
+        const int32_t out = corner_[h];
+        if (in >= 0) {
+          bx += rhs_x_[in];
+          by += rhs_y_[in];
+        }
+        if (out >= 0) {
+          bx -= rhs_x_[out];
+          by -= rhs_y_[out];
+        }
+        h = mesh.next_[TriMeshSoA::opposite(h)];
+      } while (h != h0);
+    }
+    rhs_(v, 0) = bx;
+    rhs_(v, 1) = by;
+  });
+  return solver_.Solve(rhs_, uv_);
+}
+
+}  // namespace geometry_lab
@@ -0,0 +1,112 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_ARAP_HPP_
+#define GEOMETRY_LAB_CORE_ARAP_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "core/laplacian.hpp"
+#include "core/simd.hpp"
+
+namespace geometry_lab {
+
+class TriMesh;
+
+/**
+ * @brief As-Rigid-As-Possible parameterization, local-global solver.
+ *
+ *  The rest shape of every face is its 2D frame in the @c HalfedgeDiff
+ *  property. Each iteration minimizes
+ *    E = 1/2 sum_h cot(h) |uv(h) - R_f(h) x(h)|^2
+ *  first over the rotation R_f of every face (local step, the closest
+ *  rotation to a 2x2 covariance, vectorized over the faces), then
+ *  over the uv (global step, L uv = b with the cotangent Laplacian L).
+ *  L does not depend on the uv, it is factorized once in
+ *  @c Initialize() and every global step is a back-substitution for
+ *  the u and v columns together.
+ *
+ *  The solver starts from @c uv_ (e.g. a harmonic parameterization)
+ *  and every @c Iterate() continues from the last result, so it can
+ *  be run a few iterations per frame.
+*/
+class ArapParameterization {
+ public:
+  /**
+   * @brief Statistics of one iteration.
+  */
+  struct Iteration {
+    /// Energy of the uv the iteration started from, with the best
+    /// rotations, divided by the total area.
+    double energy;
+    /// Time of the local and global steps.
+    float local_ms, global_ms;
+  };
+  /**
+   * @brief Prepare the rest shapes and factorize the Laplacian, only
+   *  done again when the mesh, its connectivity or its positions
+   *  changed. One vertex of each connected component keeps its uv,
+   *  the energy does not change with a translation.
+   * @param mesh[in] - The mesh.
+   * @return Success?
+  */
+  bool Initialize(TriMesh& mesh);
+  /**
+   * @brief Run local-global iterations from @c uv_, which must hold
+   *  one row per vertex, then write the uv into the vertex texcoords2D
+   *  of the mesh.
+   * @param max_iterations[in] - Most iterations to run.
+   * @param max_ms[in] - Time budget in milliseconds, checked after
+   *                     each iteration, 0 for none.
+   * @return Number of iterations run.
+  */
+  size_t Iterate(size_t max_iterations, double max_ms = 0.0);
+
+  ArapParameterization() {}
+  /// Energy of the last iteration, see @c Iteration::energy.
+  double energy() const {
+    return history_.empty() ? 0.0 : history_.back().energy;
+  }
+
+  /// (u, v) of each vertex, the initial guess in and the result out.
+  Eigen::MatrixXd uv_;
+  /// Statistics of the iterations since the last change of the mesh.
+  std::vector<Iteration> history_;
+  /// The best instruction set of the local step.
+  SimdLevel simd_level_ = SimdLevel::kAVX2;
+
+ private:
+  /// Best rotations of the faces, their part of the right-hand side
+  /// in @c rhs_x_ / @c rhs_y_.
+  /// @return The energy.
+  double LocalStep();
+  /// Gather the right-hand side per vertex and solve for the uv.
+  bool GlobalStep();
+
+  /// Rest frame of each face: diff(h0) = (x0_, 0), diff(h1) =
+  /// (x1_, y1_), diff(h2) = -diff(h0) - diff(h1).
+  AlignedVector<double> x0_, x1_, y1_;
+  /// Cotangent weight of the k-th halfedge of face f at k * n_f + f.
+  AlignedVector<double> weight_;
+  /// Part of the right-hand side of each halfedge, 1/2 cot(h) R x(h),
+  /// same layout as @c weight_.
+  AlignedVector<double> rhs_x_, rhs_y_;
+  /// Entry of each halfedge in @c weight_, -1 on the boundary.
+  std::vector<int32_t> corner_;
+  /// Vertices that keep their uv, one per connected component.
+  std::vector<int32_t> pinned_;
+  /// Right-hand side of the global step.
+  Eigen::MatrixXd rhs_;
+  LaplacianSolver solver_;
+  double total_area_ = 0.0;
+  /// Mesh the solver was initialized for.
+  TriMesh* mesh_ = nullptr;
+  uint64_t topology_ = UINT64_MAX, geometry_ = UINT64_MAX;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_ARAP_HPP_
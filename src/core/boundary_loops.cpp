@@ -0,0 +1,82 @@
+#include "core/boundary_loops.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh_soa.hpp"
+
+namespace geometry_lab {
+
+void BoundaryLoops::Compute(const TriMeshSoA& mesh) {
+  GEOMETRY_LAB_TRACE_SCOPE("BoundaryLoops::Compute");
+  const size_t n_h = mesh.n_halfedges();
+  offsets_.assign(1, 0);
+  halfedges_.clear();
+  visited_.resize((n_h + 63) / 64, 0);
+  // 1. Collect the boundary halfedges in increasing order, every
+  //    thread counts its block first and then writes at its offset
+  const size_t n_blocks = ParallelBlockCount(n_h);
+  block_counts_.assign(n_blocks + 1, 0);
+  ParallelBlocks(n_h, [&](size_t block, size_t begin, size_t end) {
+    size_t count = 0;
+    for (size_t h = begin; h < end; ++h)
+      count += mesh.is_boundary(static_cast<int32_t>(h));
+    block_counts_[block + 1] = count;
+  });
+  std::partial_sum(block_counts_.begin(), block_counts_.end(),
+                   block_counts_.begin());
+  const size_t n_boundary = block_counts_.back();
+  if (n_boundary == 0)
+    return;
+  halfedges_.resize(n_boundary);
+  ParallelBlocks(n_h, [&](size_t block, size_t begin, size_t end) {
+    size_t k = block_counts_[block];
+    for (size_t h = begin; h < end; ++h) {
+      if (mesh.is_boundary(static_cast<int32_t>(h)))
+        halfedges_[k++] = static_cast<int32_t>(h);
+    }
+  });
+  // 2. Walk the loops from their smallest halfedge
+  unsorted_offsets_.assign(1, 0);
+  unsorted_halfedges_.resize(n_boundary);
+  size_t k = 0;
+  for (const int32_t hh : halfedges_) {
+    if (visited_[hh >> 6] >> (hh & 63) & 1)
+      continue;
+    int32_t it = hh;
+    do {
+      visited_[it >> 6] |= uint64_t(1) << (it & 63);
+      unsorted_halfedges_[k++] = it;
+      it = mesh.next_[it];
+    } while (it != hh && k < n_boundary);
+    unsorted_offsets_.push_back(static_cast<int32_t>(k));
+  }
+  // Clear the bits for the next call
+  for (const int32_t hh : halfedges_)
+    visited_[hh >> 6] = 0;
+  // 3. Sort the loops from the longest to the shortest, the loops of
+  //    the same length stay in walking order. std::sort with the index
+  //    as tie-break, std::stable_sort would allocate a buffer
+  const size_t n_loops = unsorted_offsets_.size() - 1;
+  auto loop_length = [&](int32_t i) {
+    return unsorted_offsets_[i + 1] - unsorted_offsets_[i];
+  };
+  order_.resize(n_loops);
+  std::iota(order_.begin(), order_.end(), 0);
+  std::sort(order_.begin(), order_.end(), [&](int32_t a, int32_t b) {
+    const int32_t la = loop_length(a), lb = loop_length(b);
+    return la != lb ? la > lb : a < b;
+  });
+  offsets_.resize(n_loops + 1);
+  for (size_t i = 0; i < n_loops; ++i)
+    offsets_[i + 1] = offsets_[i] + loop_length(order_[i]);
+  for (size_t i = 0; i < n_loops; ++i) {
+    std::copy(unsorted_halfedges_.begin() + unsorted_offsets_[order_[i]],
+              unsorted_halfedges_.begin() + unsorted_offsets_[order_[i] + 1],
+              halfedges_.begin() + offsets_[i]);
+  }
+}
+
+}  // namespace geometry_lab
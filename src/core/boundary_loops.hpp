@@ -0,0 +1,74 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_BOUNDARY_LOOPS_HPP_
+#define GEOMETRY_LAB_CORE_BOUNDARY_LOOPS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace geometry_lab {
+
+class TriMeshSoA;
+
+/**
+ * @brief All the boundary loops of a mesh in compressed form.
+ *
+ *  Loop i is made of the boundary halfedges
+ *  halfedges_[offsets_[i]], ..., halfedges_[offsets_[i+1] - 1]
+ *  in walking order, starting at its smallest halfedge index. The
+ *  loops are sorted by length, from the longest to the shortest. The
+ *  buffers are reused by the next @c Compute(), so extracting the
+ *  loops again does not allocate.
+*/
+class BoundaryLoops {
+ public:
+  /**
+   * @brief Find all the boundary loops.
+   *
+   *  The boundary halfedges are collected by a parallel scan, then
+   *  every loop is walked once with a scratch bitset marking the
+   *  visited halfedges.
+   *
+   * @param mesh[in] - Flat snapshot of the mesh.
+  */
+  void Compute(const TriMeshSoA& mesh);
+  /**
+   * @brief Visit the halfedges of one loop in walking order.
+   * @param i[in] - Index of the loop.
+   * @param fun[in] - Called as fun(halfedge index).
+  */
+  template <typename F>
+  void Visit(size_t i, F&& fun) const {
+    for (int32_t k = offsets_[i]; k < offsets_[i + 1]; ++k)
+      fun(halfedges_[k]);
+  }
+
+  BoundaryLoops() {}
+  /// Number of loops.
+  size_t size() const { return offsets_.empty() ? 0 : offsets_.size() - 1; }
+  /// Number of halfedges of loop i.
+  size_t length(size_t i) const { return offsets_[i + 1] - offsets_[i]; }
+  /// First halfedge of loop i.
+  int32_t start(size_t i) const { return halfedges_[offsets_[i]]; }
+
+  /// Start of each loop in @c halfedges_, with one more element at
+  /// the end.
+  std::vector<int32_t> offsets_;
+  /// Halfedges of all the loops.
+  std::vector<int32_t> halfedges_;
+
+ private:
+  /// Visited halfedges, all zero between two calls.
+  std::vector<uint64_t> visited_;
+  /// Boundary halfedges found by each thread.
+  std::vector<size_t> block_counts_;
+  /// Loops before sorting.
+  std::vector<int32_t> unsorted_offsets_, unsorted_halfedges_;
+  /// Loop order after sorting.
+  std::vector<int32_t> order_;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_BOUNDARY_LOOPS_HPP_
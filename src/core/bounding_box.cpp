@@ -0,0 +1,178 @@
+#include "core/bounding_box.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Eigenvalues>
+#include <Eigen/Geometry>
+
+#include "core/parallel.hpp"
+#include "core/simd.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh_soa.hpp"
+
+#ifdef GEOMETRY_LAB_X86
+#include <immintrin.h>
+#endif
+
+namespace geometry_lab {
+
+namespace {
+
+/// Partial result of one thread, on its own cache line.
+struct alignas(64) BoxPartial {
+  float min[3], max[3];
+  double sum[3];
+};
+
+/// The float lanes of the sums are flushed into double every
+/// @c kSumChunk points to keep the centroid accurate.
+constexpr size_t kSumChunk = 1024;
+
+void ReduceBlock(const float* const p[3], size_t begin, size_t end,
+                 BoxPartial& out) {
+  for (int k = 0; k < 3; ++k) {
+    out.min[k] = std::numeric_limits<float>::infinity();
+    out.max[k] = -std::numeric_limits<float>::infinity();
+    out.sum[k] = 0.0;
+  }
+  size_t i = begin;
+#ifdef GEOMETRY_LAB_X86
+  if (end - begin >= 4) {
+    for (int k = 0; k < 3; ++k) {
+      __m128 lo = _mm_set1_ps(out.min[k]);
+      __m128 hi = _mm_set1_ps(out.max[k]);
+      size_t j = begin;
+      while (j + 4 <= end) {
+        const size_t chunk_end = std::min(end, j + kSumChunk);
+        __m128 sum = _mm_setzero_ps();
+        for (; j + 4 <= chunk_end; j += 4) {
+          const __m128 v = _mm_loadu_ps(p[k] + j);
+          lo = _mm_min_ps(lo, v);
+          hi = _mm_max_ps(hi, v);
+          sum = _mm_add_ps(sum, v);
+        }
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, sum);
+        out.sum[k] += double(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+      }
+      alignas(16) float lo_lanes[4], hi_lanes[4];
+      _mm_store_ps(lo_lanes, lo);
+      _mm_store_ps(hi_lanes, hi);
+      out.min[k] = *std::min_element(lo_lanes, lo_lanes + 4);
+      out.max[k] = *std::max_element(hi_lanes, hi_lanes + 4);
+      i = j;
+    }
+  }
+#endif
+  // Scalar tail
+  for (; i < end; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      out.min[k] = std::min(out.min[k], p[k][i]);
+      out.max[k] = std::max(out.max[k], p[k][i]);
+      out.sum[k] += p[k][i];
+    }
+  }
+}
+
+}  // namespace
+
+void BoundingBox::Compute(const TriMeshSoA& mesh) {
+  GEOMETRY_LAB_TRACE_SCOPE("BoundingBox::Compute");
+  Compute(mesh.x_.data(), mesh.y_.data(), mesh.z_.data(), mesh.n_vertices());
+}
+
+void BoundingBox::Compute(const float* x, const float* y, const float* z,
+                          size_t n) {
+  *this = BoundingBox();
+  if (n == 0)
+    return;
+  const float* const p[3] = {x, y, z};
+  std::vector<BoxPartial> partials(ParallelBlockCount(n));
+  ParallelBlocks(n, [&](size_t block, size_t begin, size_t end) {
+    ReduceBlock(p, begin, end, partials[block]);
+  });
+  // Merge the partials
+  Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+  min_.setConstant(std::numeric_limits<float>::infinity());
+  max_.setConstant(-std::numeric_limits<float>::infinity());
+  for (const auto& partial : partials) {
+    for (int k = 0; k < 3; ++k) {
+      min_[k] = std::min(min_[k], partial.min[k]);
+      max_[k] = std::max(max_[k], partial.max[k]);
+      sum[k] += partial.sum[k];
+    }
+  }
+  centroid_ = sum / static_cast<double>(n);
+  count_ = n;
+}
+
+void OrientedBox::Compute(const TriMeshSoA& mesh, const BoundingBox& aabb) {
+  GEOMETRY_LAB_TRACE_SCOPE("OrientedBox::Compute");
+  *this = OrientedBox();
+  const size_t n = mesh.n_vertices();
+  if (n == 0)
+    return;
+  const Eigen::Vector3d c = aabb.centroid_;
+  // 1. Covariance of the vertices
+  struct alignas(64) CovPartial {
+    Eigen::Matrix3d cov;
+  };
+  std::vector<CovPartial> cov_partials(ParallelBlockCount(n));
+  ParallelBlocks(n, [&](size_t block, size_t begin, size_t end) {
+    double xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+    for (size_t i = begin; i < end; ++i) {
+      const double dx = mesh.x_[i] - c[0];
+      const double dy = mesh.y_[i] - c[1];
+      const double dz = mesh.z_[i] - c[2];
+      xx += dx * dx;
+      xy += dx * dy;
+      xz += dx * dz;
+      yy += dy * dy;
+      yz += dy * dz;
+      zz += dz * dz;
+    }
+    cov_partials[block].cov << xx, xy, xz, xy, yy, yz, xz, yz, zz;
+  });
+  Eigen::Matrix3d cov = Eigen::Matrix3d::Zero();
+  for (const auto& partial : cov_partials)
+    cov += partial.cov;
+  // 2. Principal axes, the eigenvalues are in increasing order
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(cov);
+  Eigen::Matrix3d axes = solver.eigenvectors().rowwise().reverse();
+  axes.col(2) = axes.col(0).cross(axes.col(1));
+  axes_ = axes.cast<float>();
+  // 3. Extent along the axes
+  struct alignas(64) ExtentPartial {
+    float min[3], max[3];
+  };
+  std::vector<ExtentPartial> extent_partials(ParallelBlockCount(n));
+  ParallelBlocks(n, [&](size_t block, size_t begin, size_t end) {
+    auto& out = extent_partials[block];
+    std::fill(out.min, out.min + 3, std::numeric_limits<float>::infinity());
+    std::fill(out.max, out.max + 3, -std::numeric_limits<float>::infinity());
+    for (size_t i = begin; i < end; ++i) {
+      const Eigen::Vector3f q =
+          axes_.transpose() * Eigen::Vector3f(mesh.x_[i], mesh.y_[i],
+                                              mesh.z_[i]);
+      for (int k = 0; k < 3; ++k) {
+        out.min[k] = std::min(out.min[k], q[k]);
+        out.max[k] = std::max(out.max[k], q[k]);
+      }
+    }
+  });
+  Eigen::Vector3f lo = Eigen::Vector3f::Constant(
+      std::numeric_limits<float>::infinity());
+  Eigen::Vector3f hi = -lo;
+  for (const auto& partial : extent_partials) {
+    for (int k = 0; k < 3; ++k) {
+      lo[k] = std::min(lo[k], partial.min[k]);
+      hi[k] = std::max(hi[k], partial.max[k]);
+    }
+  }
+  center_ = axes_ * (0.5f * (lo + hi));
+  half_extent_ = 0.5f * (hi - lo);
+}
+
+}  // namespace geometry_lab
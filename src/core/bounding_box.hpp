@@ -0,0 +1,88 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_BOUNDING_BOX_HPP_
+#define GEOMETRY_LAB_CORE_BOUNDING_BOX_HPP_
+
+#include <cstddef>
+
+#include <Eigen/Core>
+
+namespace geometry_lab {
+
+class TriMeshSoA;
+
+/**
+ * @brief Axis-aligned bounding box and centroid of a point set.
+*/
+class BoundingBox {
+ public:
+  /**
+   * @brief Compute the box and centroid of the vertices of a mesh.
+   * @param mesh[in] - Flat snapshot of the mesh.
+  */
+  void Compute(const TriMeshSoA& mesh);
+  /**
+   * @brief Compute the box and centroid of n points in one parallel
+   *  pass. Every thread reduces its own block with SIMD min/max lanes
+   *  into a partial result, the partials are merged at the end.
+   * @param x[in] - x coordinates of the points.
+   * @param y[in] - y coordinates of the points.
+   * @param z[in] - z coordinates of the points.
+   * @param n[in] - Number of points.
+  */
+  void Compute(const float* x, const float* y, const float* z, size_t n);
+
+  BoundingBox() {}
+  /// Is there no point in the box?
+  bool empty() const { return count_ == 0; }
+  /// Center of the box.
+  Eigen::Vector3f center() const { return 0.5f * (min_ + max_); }
+  /// Half of the size of the box.
+  Eigen::Vector3f half_extent() const { return 0.5f * (max_ - min_); }
+
+  /// Corners of the box.
+  Eigen::Vector3f min_ = Eigen::Vector3f::Zero();
+  Eigen::Vector3f max_ = Eigen::Vector3f::Zero();
+  /// Average of the points.
+  Eigen::Vector3d centroid_ = Eigen::Vector3d::Zero();
+  /// Number of points.
+  size_t count_ = 0;
+};
+
+/**
+ * @brief Oriented bounding box along the principal axes of a point
+ *  set.
+*/
+class OrientedBox {
+ public:
+  /**
+   * @brief Compute the box of the vertices of a mesh. The axes are
+   *  the eigenvectors of the covariance matrix of the vertices, both
+   *  passes run in parallel with per-thread partials.
+   * @param mesh[in] - Flat snapshot of the mesh.
+   * @param aabb[in] - Axis-aligned box of the same mesh, for the
+   *                   centroid.
+  */
+  void Compute(const TriMeshSoA& mesh, const BoundingBox& aabb);
+
+  OrientedBox() {}
+  /**
+   * @param p[in] - A point in the world frame.
+   * @return Coordinates of the point in the box frame.
+  */
+  Eigen::Vector3f ToLocal(const Eigen::Vector3f& p) const {
+    return axes_.transpose() * (p - center_);
+  }
+
+  /// Center of the box.
+  Eigen::Vector3f center_ = Eigen::Vector3f::Zero();
+  /// Axes of the box in columns, right-handed, from the largest
+  /// variance to the smallest.
+  Eigen::Matrix3f axes_ = Eigen::Matrix3f::Identity();
+  /// Half of the size of the box along each axis.
+  Eigen::Vector3f half_extent_ = Eigen::Vector3f::Zero();
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_BOUNDING_BOX_HPP_
@@ -0,0 +1,682 @@
+#include "core/bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include <Eigen/Geometry>
+
+#ifdef GEOMETRY_LAB_X86
+#include <immintrin.h>
+#endif
+
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh_soa.hpp"
+
+namespace geometry_lab {
+
+namespace {
+
+constexpr float kInf = std::numeric_limits<float>::infinity();
+/// Number of bins per axis of the SAH.
+constexpr int kBins = 16;
+/// Leaves are never larger, the SAH may stop before.
+constexpr size_t kMaxLeafSize = 16;
+/// Below this depth the splits are object medians, which bounds the
+/// depth of the tree.
+constexpr size_t kMedianDepth = 32;
+/// Marks a node of the top tree standing for a parallel subtree.
+constexpr uint16_t kTaskAxis = 0xFFFF;
+
+struct Box {
+  Eigen::Vector3f min = Eigen::Vector3f::Constant(kInf);
+  Eigen::Vector3f max = Eigen::Vector3f::Constant(-kInf);
+  void Grow(const Eigen::Vector3f& p) {
+    min = min.cwiseMin(p);
+    max = max.cwiseMax(p);
+  }
+  void Grow(const Box& b) {
+    min = min.cwiseMin(b.min);
+    max = max.cwiseMax(b.max);
+  }
+  /// Half of the surface area, 0 when empty.
+  float HalfArea() const {
+    const Eigen::Vector3f d = max - min;
+    if (d.x() < 0.0f)
+      return 0.0f;
+    return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+  }
+};
+
+void SetBox(Bvh::Node& node, const Box& box) {
+  for (int a = 0; a < 3; ++a) {
+    node.min[a] = box.min[a];
+    node.max[a] = box.max[a];
+  }
+}
+
+Box NodeBox(const Bvh::Node& node) {
+  Box box;
+  box.min = Eigen::Vector3f(node.min[0], node.min[1], node.min[2]);
+  box.max = Eigen::Vector3f(node.max[0], node.max[1], node.max[2]);
+  return box;
+}
+
+/// Faces being sorted into the tree.
+struct BuildData {
+  std::vector<Box> boxes;
+  std::vector<Eigen::Vector3f> centers;
+  std::vector<int32_t> refs;
+  size_t leaf_size;
+};
+
+/// Boxes of the faces and of their centers in a range.
+struct RangeBounds {
+  Box box, centers;
+};
+
+RangeBounds Bounds(const BuildData& data, size_t begin, size_t end,
+                   bool parallel) {
+  auto reduce = [&](size_t b, size_t e) {
+    RangeBounds rst;
+    for (size_t i = b; i < e; ++i) {
+      const int32_t f = data.refs[i];
+      rst.box.Grow(data.boxes[f]);
+      rst.centers.Grow(data.centers[f]);
+    }
+    return rst;
+  };
+  if (!parallel)
+    return reduce(begin, end);
+  std::vector<RangeBounds> partial(ParallelBlockCount(end - begin));
+  ParallelBlocks(end - begin, [&](size_t block, size_t b, size_t e) {
+    partial[block] = reduce(begin + b, begin + e);
+  });
+  RangeBounds rst;
+  for (const RangeBounds& p : partial) {
+    rst.box.Grow(p.box);
+    rst.centers.Grow(p.centers);
+  }
+  return rst;
+}
+
+struct Bins {
+  Box box[3][kBins];
+  size_t count[3][kBins] = {};
+};
+
+/// Best binned SAH split of a range.
+struct Split {
+  int axis = -1;
+  int bin = 0;
+  float cost = kInf;
+};
+
+int BinOf(const Eigen::Vector3f& c, const RangeBounds& bounds, int axis) {
+  const float extent = bounds.centers.max[axis] - bounds.centers.min[axis];
+  const int k = static_cast<int>((c[axis] - bounds.centers.min[axis]) *
+                                 (kBins / extent));
+  return std::min(std::max(k, 0), kBins - 1);
+}
+
+Split FindSplit(const BuildData& data, size_t begin, size_t end,
+                const RangeBounds& bounds, bool parallel) {
+  auto fill = [&](Bins& bins, size_t b, size_t e) {
+    for (size_t i = b; i < e; ++i) {
+      const int32_t f = data.refs[i];
+      for (int a = 0; a < 3; ++a) {
+        if (bounds.centers.max[a] <= bounds.centers.min[a])
+          continue;
+        const int k = BinOf(data.centers[f], bounds, a);
+        bins.box[a][k].Grow(data.boxes[f]);
+        ++bins.count[a][k];
+      }
+    }
+  };
+  Bins bins;
+  if (parallel) {
+    std::vector<Bins> partial(ParallelBlockCount(end - begin));
+    ParallelBlocks(end - begin, [&](size_t block, size_t b, size_t e) {
+      fill(partial[block], begin + b, begin + e);
+    });
+    for (const Bins& p : partial) {
+      for (int a = 0; a < 3; ++a) {
+        for (int k = 0; k < kBins; ++k) {
+          bins.box[a][k].Grow(p.box[a][k]);
+          bins.count[a][k] += p.count[a][k];
+        }
+      }
+    }
+  } else {
+    fill(bins, begin, end);
+  }
+  // Sweep the bins from both sides
+  Split rst;
+  for (int a = 0; a < 3; ++a) {
+    if (bounds.centers.max[a] <= bounds.centers.min[a])
+      continue;
+    float right_area[kBins];
+    size_t right_count[kBins];
+    Box box;
+    size_t count = 0;
+    for (int k = kBins - 1; k > 0; --k) {
+      box.Grow(bins.box[a][k]);
+      count += bins.count[a][k];
+      right_area[k] = box.HalfArea();
+      right_count[k] = count;
+    }
+    box = Box();
+    count = 0;
+    for (int k = 0; k < kBins - 1; ++k) {
+      box.Grow(bins.box[a][k]);
+      count += bins.count[a][k];
+      if (count == 0 || right_count[k + 1] == 0)
+        continue;
+      const float cost = count * box.HalfArea() +
+                         right_count[k + 1] * right_area[k + 1];
+      if (cost < rst.cost) {
+        rst.axis = a;
+        rst.bin = k;
+        rst.cost = cost;
+      }
+    }
+  }
+  return rst;
+}
+
+/**
+ * @brief Split a range in two, or decide it is a leaf.
+ * @return The middle of the split, @c begin for a leaf.
+*/
+size_t Partition(BuildData& data, size_t begin, size_t end, size_t depth,
+                 const RangeBounds& bounds, bool parallel, int& axis) {
+  const size_t count = end - begin;
+  if (count <= data.leaf_size)
+    return begin;
+  size_t mid = begin;
+  if (depth < kMedianDepth) {
+    const Split split = FindSplit(data, begin, end, bounds, parallel);
+    // No split is cheaper than intersecting all the faces
+    if (split.axis >= 0 && count <= kMaxLeafSize &&
+        split.cost >= count * bounds.box.HalfArea())
+      return begin;
+    if (split.axis >= 0) {
+      axis = split.axis;
+      mid = std::partition(data.refs.begin() + begin,
+                           data.refs.begin() + end,
+                           [&](int32_t f) {
+                             return BinOf(data.centers[f], bounds, axis) <=
+                                    split.bin;
+                           }) -
+            data.refs.begin();
+    }
+  }
+  if (mid == begin || mid == end) {
+    // Object median along the largest extent of the centers, also
+    // for faces with the same center
+    const Eigen::Vector3f extent = bounds.centers.max - bounds.centers.min;
+    extent.maxCoeff(&axis);
+    mid = begin + count / 2;
+    std::nth_element(data.refs.begin() + begin, data.refs.begin() + mid,
+                     data.refs.begin() + end, [&](int32_t a, int32_t b) {
+                       return data.centers[a][axis] < data.centers[b][axis];
+                     });
+  }
+  return mid;
+}
+
+/// Build the subtree of a range depth-first into nodes, serially.
+/// @return Index of its root in nodes.
+int32_t BuildNode(BuildData& data, size_t begin, size_t end, size_t depth,
+                  std::vector<Bvh::Node>& nodes) {
+  const RangeBounds bounds = Bounds(data, begin, end, false);
+  const int32_t i = static_cast<int32_t>(nodes.size());
+  nodes.emplace_back();
+  SetBox(nodes[i], bounds.box);
+  int axis = 0;
+  const size_t mid = Partition(data, begin, end, depth, bounds, false, axis);
+  if (mid == begin) {
+    nodes[i].offset = static_cast<int32_t>(begin);
+    nodes[i].count = static_cast<uint16_t>(end - begin);
+    nodes[i].axis = 0;
+    return i;
+  }
+  nodes[i].count = 0;
+  nodes[i].axis = static_cast<uint16_t>(axis);
+  BuildNode(data, begin, mid, depth + 1, nodes);
+  const int32_t second = BuildNode(data, mid, end, depth + 1, nodes);
+  nodes[i].offset = second;
+  return i;
+}
+
+/// Subtree built by one thread.
+struct BuildTask {
+  size_t begin, end, depth;
+  std::vector<Bvh::Node> nodes;
+};
+
+/// Split the large ranges with parallel passes, down to ranges small
+/// enough to become parallel tasks.
+int32_t BuildTop(BuildData& data, size_t begin, size_t end, size_t depth,
+                 size_t task_size, std::vector<Bvh::Node>& top,
+                 std::vector<BuildTask>& tasks) {
+  const int32_t i = static_cast<int32_t>(top.size());
+  top.emplace_back();
+  int axis = 0;
+  size_t mid = begin;
+  if (end - begin > task_size) {
+    const RangeBounds bounds = Bounds(data, begin, end, true);
+    SetBox(top[i], bounds.box);
+    mid = Partition(data, begin, end, depth, bounds, true, axis);
+  }
+  if (mid == begin) {
+    top[i].axis = kTaskAxis;
+    top[i].offset = static_cast<int32_t>(tasks.size());
+    tasks.push_back({begin, end, depth, {}});
+    return i;
+  }
+  top[i].count = 0;
+  top[i].axis = static_cast<uint16_t>(axis);
+  BuildTop(data, begin, mid, depth + 1, task_size, top, tasks);
+  const int32_t second =
+      BuildTop(data, mid, end, depth + 1, task_size, top, tasks);
+  top[i].offset = second;
+  return i;
+}
+
+/// Append the top tree depth-first with the subtrees of the tasks.
+/// @return Index of the node in nodes.
+int32_t Flatten(const std::vector<Bvh::Node>& top,
+                const std::vector<BuildTask>& tasks, int32_t t,
+                std::vector<Bvh::Node>& nodes) {
+  const int32_t i = static_cast<int32_t>(nodes.size());
+  if (top[t].axis == kTaskAxis) {
+    for (Bvh::Node node : tasks[top[t].offset].nodes) {
+      if (node.count == 0)
+        node.offset += i;
+      nodes.push_back(node);
+    }
+    return i;
+  }
+  nodes.push_back(top[t]);
+  Flatten(top, tasks, t + 1, nodes);
+  const int32_t second = Flatten(top, tasks, top[t].offset, nodes);
+  nodes[i].offset = second;
+  return i;
+}
+
+// ========== Ray tests ==========
+// A kernel knows a ray and tests it against a node box or the packets
+// of a leaf. The traversal is shared by the scalar and SSE kernels.
+
+struct ScalarKernel {
+  explicit ScalarKernel(const Bvh::Ray& ray) : ray(ray) {
+    for (int a = 0; a < 3; ++a)
+      inv[a] = 1.0f / ray.direction[a];
+  }
+  bool Box(const Bvh::Node& node, float t_max, float& t_near) const {
+    float t0 = ray.t_min, t1 = t_max;
+    for (int a = 0; a < 3; ++a) {
+      float ta = (node.min[a] - ray.origin[a]) * inv[a];
+      float tb = (node.max[a] - ray.origin[a]) * inv[a];
+      if (ta > tb)
+        std::swap(ta, tb);
+      t0 = std::max(t0, ta);
+      t1 = std::min(t1, tb);
+    }
+    t_near = t0;
+    return t0 <= t1;
+  }
+  // Moller-Trumbore on every lane
+  void Packets(const Bvh::Packet* packets, size_t n, Bvh::Hit& hit) const {
+    const Eigen::Vector3f& o = ray.origin;
+    const Eigen::Vector3f& d = ray.direction;
+    for (size_t k = 0; k < n; ++k) {
+      const Bvh::Packet& p = packets[k];
+      for (int l = 0; l < 4; ++l) {
+        const Eigen::Vector3f v0(p.v0[0][l], p.v0[1][l], p.v0[2][l]);
+        const Eigen::Vector3f e1(p.e1[0][l], p.e1[1][l], p.e1[2][l]);
+        const Eigen::Vector3f e2(p.e2[0][l], p.e2[1][l], p.e2[2][l]);
+        const Eigen::Vector3f pvec = d.cross(e2);
+        const float det = e1.dot(pvec);
+        if (det == 0.0f)
+          continue;
+        const float inv_det = 1.0f / det;
+        const Eigen::Vector3f tvec = o - v0;
+        const float u = tvec.dot(pvec) * inv_det;
+        const Eigen::Vector3f qvec = tvec.cross(e1);
+        const float v = d.dot(qvec) * inv_det;
+        const float t = e2.dot(qvec) * inv_det;
+        if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > ray.t_min &&
+            t < hit.t) {
+          hit.t = t;
+          hit.u = u;
+          hit.v = v;
+          hit.face = p.face[l];
+        }
+      }
+    }
+  }
+  const Bvh::Ray& ray;
+  float inv[3];
+};
+
+#ifdef GEOMETRY_LAB_X86
+struct SSEKernel {
+  explicit SSEKernel(const Bvh::Ray& ray) : ray(ray) {
+    const Eigen::Vector3f& o = ray.origin;
+    const Eigen::Vector3f& d = ray.direction;
+    origin = _mm_setr_ps(o.x(), o.y(), o.z(), 0.0f);
+    inv = _mm_div_ps(_mm_set1_ps(1.0f),
+                     _mm_setr_ps(d.x(), d.y(), d.z(), 1.0f));
+    keep_xyz = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    for (int a = 0; a < 3; ++a) {
+      o4[a] = _mm_set1_ps(o[a]);
+      d4[a] = _mm_set1_ps(d[a]);
+    }
+  }
+  // Slab test of the 3 axes at once. Lane 3 holds the offset and the
+  // count of the node, which would be slow denormals, it is cleared
+  // before any arithmetic and replaced by the range of the ray
+  bool Box(const Bvh::Node& node, float t_max, float& t_near) const {
+    const __m128 min = _mm_and_ps(_mm_loadu_ps(node.min), keep_xyz);
+    const __m128 max = _mm_and_ps(_mm_loadu_ps(node.max), keep_xyz);
+    const __m128 lo = _mm_mul_ps(_mm_sub_ps(min, origin), inv);
+    const __m128 hi = _mm_mul_ps(_mm_sub_ps(max, origin), inv);
+    __m128 t0 = _mm_and_ps(_mm_min_ps(lo, hi), keep_xyz);
+    __m128 t1 = _mm_and_ps(_mm_max_ps(lo, hi), keep_xyz);
+    t0 = _mm_or_ps(t0, _mm_setr_ps(0.0f, 0.0f, 0.0f, ray.t_min));
+    t1 = _mm_or_ps(t1, _mm_setr_ps(0.0f, 0.0f, 0.0f, t_max));
+    t0 = _mm_max_ps(t0, _mm_shuffle_ps(t0, t0, _MM_SHUFFLE(1, 0, 3, 2)));
+    t0 = _mm_max_ps(t0, _mm_shuffle_ps(t0, t0, _MM_SHUFFLE(2, 3, 0, 1)));
+    t1 = _mm_min_ps(t1, _mm_shuffle_ps(t1, t1, _MM_SHUFFLE(1, 0, 3, 2)));
+    t1 = _mm_min_ps(t1, _mm_shuffle_ps(t1, t1, _MM_SHUFFLE(2, 3, 0, 1)));
+    t_near = _mm_cvtss_f32(t0);
+    return t_near <= _mm_cvtss_f32(t1);
+  }
+  // Moller-Trumbore on the 4 lanes at once
+  void Packets(const Bvh::Packet* packets, size_t n, Bvh::Hit& hit) const {
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 t_min = _mm_set1_ps(ray.t_min);
+    for (size_t k = 0; k < n; ++k) {
+      const Bvh::Packet& p = packets[k];
+      __m128 e1[3], e2[3], tvec[3];
+      for (int a = 0; a < 3; ++a) {
+        e1[a] = _mm_load_ps(p.e1[a]);
+        e2[a] = _mm_load_ps(p.e2[a]);
+        tvec[a] = _mm_sub_ps(o4[a], _mm_load_ps(p.v0[a]));
+      }
+      auto cross = [](const __m128* a, const __m128* b, __m128* c) {
+        c[0] = _mm_sub_ps(_mm_mul_ps(a[1], b[2]), _mm_mul_ps(a[2], b[1]));
+        c[1] = _mm_sub_ps(_mm_mul_ps(a[2], b[0]), _mm_mul_ps(a[0], b[2]));
+        c[2] = _mm_sub_ps(_mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0]));
+      };
+      auto dot = [](const __m128* a, const __m128* b) {
+        return _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])),
+            _mm_mul_ps(a[2], b[2]));
+      };
+      __m128 pvec[3], qvec[3];
+      cross(d4, e2, pvec);
+      const __m128 det = dot(e1, pvec);
+      const __m128 inv_det = _mm_div_ps(one, det);
+      const __m128 u = _mm_mul_ps(dot(tvec, pvec), inv_det);
+      cross(tvec, e1, qvec);
+      const __m128 v = _mm_mul_ps(dot(d4, qvec), inv_det);
+      const __m128 t = _mm_mul_ps(dot(e2, qvec), inv_det);
+      __m128 mask = _mm_cmpneq_ps(det, zero);
+      mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+      mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+      mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+      mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, t_min));
+      mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(hit.t)));
+      int bits = _mm_movemask_ps(mask);
+      if (bits == 0)
+        continue;
+      alignas(16) float ts[4], us[4], vs[4];
+      _mm_store_ps(ts, t);
+      _mm_store_ps(us, u);
+      _mm_store_ps(vs, v);
+      for (int l = 0; l < 4; ++l) {
+        if ((bits >> l & 1) && ts[l] < hit.t) {
+          hit.t = ts[l];
+          hit.u = us[l];
+          hit.v = vs[l];
+          hit.face = p.face[l];
+        }
+      }
+    }
+  }
+  const Bvh::Ray& ray;
+  __m128 origin, inv, keep_xyz;
+  __m128 o4[3], d4[3];
+};
+#endif
+
+template <typename Kernel>
+Bvh::Hit Traverse(const Bvh& bvh, const Bvh::Ray& ray) {
+  const Kernel kernel(ray);
+  Bvh::Hit hit;
+  hit.t = ray.t_max;
+  float t_near;
+  if (bvh.empty() || !kernel.Box(bvh.nodes_[0], hit.t, t_near)) {
+    hit.t = kInf;
+    return hit;
+  }
+  // Far children left behind, with their entry distance
+  std::pair<int32_t, float> stack[Bvh::kMaxDepth];
+  size_t top = 0;
+  int32_t i = 0;
+  while (true) {
+    const Bvh::Node& node = bvh.nodes_[i];
+    if (node.count > 0) {
+      kernel.Packets(&bvh.packets_[node.offset], (node.count + 3) / 4, hit);
+    } else {
+      int32_t a = i + 1, b = node.offset;
+      float ta, tb;
+      const bool hit_a = kernel.Box(bvh.nodes_[a], hit.t, ta);
+      const bool hit_b = kernel.Box(bvh.nodes_[b], hit.t, tb);
+      if (hit_a && hit_b) {
+        if (tb < ta) {
+          std::swap(a, b);
+          std::swap(ta, tb);
+        }
+        stack[top++] = {b, tb};
+        i = a;
+        continue;
+      }
+      if (hit_a || hit_b) {
+        i = hit_a ? a : b;
+        continue;
+      }
+    }
+    // Skip the nodes behind the nearest hit
+    while (top > 0 && stack[top - 1].second > hit.t)
+      --top;
+    if (top == 0)
+      break;
+    i = stack[--top].first;
+  }
+  if (hit.face < 0)
+    hit.t = kInf;
+  return hit;
+}
+
+}  // namespace
+
+void Bvh::Build(const TriMeshSoA& mesh, size_t leaf_size) {
+  GEOMETRY_LAB_TRACE_SCOPE("Bvh::Build");
+  const size_t n_f = mesh.n_faces();
+  nodes_.clear();
+  packets_.clear();
+  depth_ = 0;
+  if (n_f == 0)
+    return;
+  // 1. Boxes and centers of the faces
+  BuildData data;
+  data.leaf_size = std::min(std::max<size_t>(leaf_size, 1), kMaxLeafSize);
+  data.boxes.resize(n_f);
+  data.centers.resize(n_f);
+  data.refs.resize(n_f);
+  ParallelFor(0, n_f, [&](size_t f) {
+    Box box;
+    for (int k = 0; k < 3; ++k) {
+      const int32_t v = mesh.faces_[3 * f + k];
+      box.Grow(Eigen::Vector3f(mesh.x_[v], mesh.y_[v], mesh.z_[v]));
+    }
+    data.boxes[f] = box;
+    data.centers[f] = 0.5f * (box.min + box.max);
+    data.refs[f] = static_cast<int32_t>(f);
+  });
+  // 2. Top levels with parallel passes, then the subtrees in parallel
+  const size_t task_size =
+      std::max<size_t>(n_f / (8 * ParallelThreadCount()), 4096);
+  std::vector<Node> top;
+  std::vector<BuildTask> tasks;
+  BuildTop(data, 0, n_f, 0, task_size, top, tasks);
+  ParallelFor(
+      0, tasks.size(),
+      [&](size_t t) {
+        BuildTask& task = tasks[t];
+        BuildNode(data, task.begin, task.end, task.depth, task.nodes);
+      },
+      1);
+  Flatten(top, tasks, 0, nodes_);
+  // 3. One packet per 4 faces of a leaf
+  std::vector<int32_t> leaves;
+  size_t n_packets = 0;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    if (nodes_[i].count == 0)
+      continue;
+    leaves.push_back(static_cast<int32_t>(i));
+    n_packets += (nodes_[i].count + 3) / 4;
+  }
+  packets_.resize(n_packets);
+  std::vector<int32_t> first(leaves.size());
+  for (size_t k = 0, p = 0; k < leaves.size(); ++k) {
+    first[k] = static_cast<int32_t>(p);
+    p += (nodes_[leaves[k]].count + 3) / 4;
+  }
+  ParallelFor(0, leaves.size(), [&](size_t k) {
+    Node& leaf = nodes_[leaves[k]];
+    const int32_t begin = leaf.offset;
+    leaf.offset = first[k];
+    const size_t n = 4 * ((leaf.count + 3) / 4);
+    for (size_t j = 0; j < n; ++j) {
+      packets_[first[k] + j / 4].face[j % 4] =
+          j < leaf.count ? data.refs[begin + j] : -1;
+    }
+  });
+  FillPackets(mesh);
+  // 4. Depth of the tree, the children follow their parent
+  std::vector<uint8_t> level(nodes_.size());
+  level[0] = 1;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    depth_ = std::max<size_t>(depth_, level[i]);
+    if (nodes_[i].count == 0) {
+      level[i + 1] = level[i] + 1;
+      level[nodes_[i].offset] = level[i] + 1;
+    }
+  }
+}
+
+void Bvh::FillPackets(const TriMeshSoA& mesh) {
+  ParallelFor(0, packets_.size(), [&](size_t k) {
+    Packet& p = packets_[k];
+    for (int l = 0; l < 4; ++l) {
+      const int32_t f = p.face[l];
+      if (f < 0) {
+        for (int a = 0; a < 3; ++a)
+          p.v0[a][l] = p.e1[a][l] = p.e2[a][l] = 0.0f;
+        continue;
+      }
+      const int32_t* v = &mesh.faces_[3 * f];
+      const float* xyz[3] = {mesh.x_.data(), mesh.y_.data(), mesh.z_.data()};
+      for (int a = 0; a < 3; ++a) {
+        p.v0[a][l] = xyz[a][v[0]];
+        p.e1[a][l] = xyz[a][v[1]] - xyz[a][v[0]];
+        p.e2[a][l] = xyz[a][v[2]] - xyz[a][v[0]];
+      }
+    }
+  });
+}
+
+void Bvh::Refit(const TriMeshSoA& mesh) {
+  GEOMETRY_LAB_TRACE_SCOPE("Bvh::Refit");
+  if (nodes_.empty())
+    return;
+  FillPackets(mesh);
+  auto refit = [&](int32_t i) {
+    Node& node = nodes_[i];
+    Box box;
+    if (node.count > 0) {
+      for (size_t j = 0; j < node.count; ++j) {
+        const int32_t f = packets_[node.offset + j / 4].face[j % 4];
+        for (int k = 0; k < 3; ++k) {
+          const int32_t v = mesh.faces_[3 * f + k];
+          box.Grow(Eigen::Vector3f(mesh.x_[v], mesh.y_[v], mesh.z_[v]));
+        }
+      }
+    } else {
+      box = NodeBox(nodes_[i + 1]);
+      box.Grow(NodeBox(nodes_[node.offset]));
+    }
+    SetBox(node, box);
+  };
+  // Split the tree into subtrees, each one is a contiguous range of
+  // nodes refitted backwards by one thread, then the nodes above them
+  const size_t n_roots = 8 * ParallelThreadCount();
+  std::vector<int32_t> roots = {0}, above;
+  for (size_t k = 0; k < roots.size() && roots.size() < n_roots;) {
+    const Node& node = nodes_[roots[k]];
+    if (node.count > 0) {
+      ++k;
+      continue;
+    }
+    above.push_back(roots[k]);
+    roots[k] = roots[k] + 1;
+    roots.push_back(node.offset);
+  }
+  ParallelFor(
+      0, roots.size(),
+      [&](size_t k) {
+        // The last node of a subtree is on the path of second children
+        int32_t last = roots[k];
+        while (nodes_[last].count == 0)
+          last = nodes_[last].offset;
+        for (int32_t i = last; i >= roots[k]; --i)
+          refit(i);
+      },
+      1);
+  std::sort(above.begin(), above.end());
+  for (auto i = above.rbegin(); i != above.rend(); ++i)
+    refit(*i);
+}
+
+Bvh::Hit Bvh::Intersect(const Ray& ray) const {
+#ifdef GEOMETRY_LAB_X86
+  if (DispatchSimdLevel(simd_level_) >= SimdLevel::kSSE)
+    return Traverse<SSEKernel>(*this, ray);
+#endif
+  return Traverse<ScalarKernel>(*this, ray);
+}
+
+void Bvh::Intersect(const Ray* rays, size_t n, Hit* hits) const {
+  GEOMETRY_LAB_TRACE_SCOPE("Bvh::Intersect");
+#ifdef GEOMETRY_LAB_X86
+  if (DispatchSimdLevel(simd_level_) >= SimdLevel::kSSE) {
+    ParallelFor(
+        0, n,
+        [&](size_t i) { hits[i] = Traverse<SSEKernel>(*this, rays[i]); },
+        256);
+    return;
+  }
+#endif
+  ParallelFor(
+      0, n,
+      [&](size_t i) { hits[i] = Traverse<ScalarKernel>(*this, rays[i]); },
+      256);
+}
+
+}  // namespace geometry_lab
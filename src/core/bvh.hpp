@@ -0,0 +1,134 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_BVH_HPP_
+#define GEOMETRY_LAB_CORE_BVH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "core/simd.hpp"
+
+namespace geometry_lab {
+
+class TriMeshSoA;
+
+/**
+ * @brief Bounding volume hierarchy over the faces of a triangle mesh,
+ *  for ray casting and picking.
+ *
+ *  The tree is built top-down with a binned surface area heuristic.
+ *  The binning of the large nodes runs in parallel over the faces,
+ *  then the subtrees are built in parallel. The nodes are 32 bytes
+ *  and flattened depth-first: the first child of an inner node
+ *  follows it, so a subtree is a contiguous range of nodes.
+ *
+ *  The triangles of each leaf are stored as packets of 4 (vertex 0
+ *  and the two edges in SoA form), so a ray is tested against 4
+ *  triangles at once. Only the packets and the boxes depend on the
+ *  positions: @c Refit() updates them in parallel without touching
+ *  the tree, which is much faster than a new build while the mesh
+ *  deforms moderately.
+*/
+class Bvh {
+ public:
+  /**
+   * @brief Node of the flattened tree, 32 bytes.
+  */
+  struct Node {
+    /// Box of the subtree.
+    float min[3];
+    /// Leaf: first packet. Inner node: the second child, the first
+    /// one is the next node.
+    int32_t offset;
+    float max[3];
+    /// Number of triangles of a leaf, 0 for an inner node.
+    uint16_t count;
+    /// Split axis of an inner node.
+    uint16_t axis;
+  };
+  /**
+   * @brief 4 triangles in SoA form, padded with empty triangles.
+  */
+  struct alignas(16) Packet {
+    /// First vertex and the edges v1 - v0 and v2 - v0, [axis][lane].
+    float v0[3][4], e1[3][4], e2[3][4];
+    /// Faces of the lanes, -1 for the padding.
+    int32_t face[4];
+  };
+  /**
+   * @brief Ray origin + t * direction for t in (t_min, t_max).
+  */
+  struct Ray {
+    Eigen::Vector3f origin = Eigen::Vector3f::Zero();
+    Eigen::Vector3f direction = Eigen::Vector3f::UnitZ();
+    float t_min = 0.0f;
+    float t_max = std::numeric_limits<float>::infinity();
+  };
+  /**
+   * @brief Nearest intersection of a ray.
+  */
+  struct Hit {
+    /// Ray parameter of the hit point.
+    float t = std::numeric_limits<float>::infinity();
+    /// Barycentric coordinates of vertices 1 and 2 of the face.
+    float u = 0.0f, v = 0.0f;
+    /// Hit face, -1 for a miss.
+    int32_t face = -1;
+  };
+  /**
+   * @brief Build the tree over all the faces.
+   * @param mesh[in] - Flat snapshot of the mesh.
+   * @param leaf_size[in] - Leaves with at most this many faces are
+   *                        not split.
+  */
+  void Build(const TriMeshSoA& mesh, size_t leaf_size = 4);
+  /**
+   * @brief Update the packets and the boxes after the positions
+   *  changed, the connectivity must be the same as in @c Build().
+   * @param mesh[in] - Flat snapshot of the mesh.
+  */
+  void Refit(const TriMeshSoA& mesh);
+  /**
+   * @brief Find the nearest intersection of a ray, both sides of the
+   *  faces are hit.
+   * @param ray[in] - The ray.
+   * @return The hit, @c Hit::face is -1 for a miss.
+  */
+  Hit Intersect(const Ray& ray) const;
+  /**
+   * @brief Intersect a batch of rays in parallel.
+   * @param rays[in] - The rays.
+   * @param n[in] - Number of rays.
+   * @param hits[out] - The hits, n of them.
+  */
+  void Intersect(const Ray* rays, size_t n, Hit* hits) const;
+
+  Bvh() {}
+  /// Is there no face in the tree?
+  bool empty() const { return nodes_.empty(); }
+  /// Depth of the deepest leaf, the root is at depth 1.
+  size_t depth() const { return depth_; }
+
+  /// Nodes, the root first.
+  std::vector<Node> nodes_;
+  /// Triangles of the leaves.
+  AlignedVector<Packet> packets_;
+  /// The best instruction set of the ray tests.
+  SimdLevel simd_level_ = SimdLevel::kSSE;
+  /// Size of the traversal stack, deeper trees are not built.
+  static constexpr size_t kMaxDepth = 64;
+
+ private:
+  /// Fill the packets from the positions of their faces.
+  void FillPackets(const TriMeshSoA& mesh);
+
+  size_t depth_ = 0;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_BVH_HPP_
@@ -0,0 +1,444 @@
+#include "core/closest_point.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include <Eigen/Geometry>
+
+#ifdef GEOMETRY_LAB_X86
+#include <immintrin.h>
+#endif
+
+#include "core/bvh.hpp"
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh.hpp"
+
+namespace geometry_lab {
+
+namespace {
+
+constexpr float kInf = std::numeric_limits<float>::infinity();
+/// Barycentric coordinates below this are on an edge for the sign.
+constexpr float kFeatureTolerance = 1e-5f;
+
+/// Closest point found so far for one query.
+struct Closest {
+  float d2 = kInf;
+  float u = 0.0f, v = 0.0f;
+  int32_t face = -1;
+};
+
+// The closest point of a triangle v0, v0 + e1, v0 + e2 is either the
+// projection on its plane when it falls inside, or the closest point
+// of one of the edges. All four candidates are computed, so the SIMD
+// version has no branch, and the nearest one is kept.
+
+/// Squared distance from p to the triangle, (u, v) are the
+/// barycentric coordinates of v0 + e1 and v0 + e2.
+float PointTriangle(const Eigen::Vector3f& p, const Eigen::Vector3f& v0,
+                    const Eigen::Vector3f& e1, const Eigen::Vector3f& e2,
+                    float& u, float& v) {
+  const Eigen::Vector3f w = p - v0;
+  const float d00 = e1.dot(e1), d01 = e1.dot(e2), d11 = e2.dot(e2);
+  const float d20 = w.dot(e1), d21 = w.dot(e2);
+  auto clamp01 = [](float t) { return std::min(std::max(t, 0.0f), 1.0f); };
+  // Edges v0-v1, v0-v2 and v1-v2
+  const float t01 = clamp01(d20 / std::max(d00, 1e-30f));
+  const float t02 = clamp01(d21 / std::max(d11, 1e-30f));
+  const Eigen::Vector3f e12 = e2 - e1;
+  const float t12 =
+      clamp01((w - e1).dot(e12) / std::max(e12.dot(e12), 1e-30f));
+  float rst = (w - t01 * e1).squaredNorm();
+  u = t01;
+  v = 0.0f;
+  const float d02 = (w - t02 * e2).squaredNorm();
+  if (d02 < rst) {
+    rst = d02;
+    u = 0.0f;
+    v = t02;
+  }
+  const float d12 = (w - e1 - t12 * e12).squaredNorm();
+  if (d12 < rst) {
+    rst = d12;
+    u = 1.0f - t12;
+    v = t12;
+  }
+  // Projection inside the face
+  const float denom = d00 * d11 - d01 * d01;
+  if (denom > 0.0f) {
+    const float bu = (d11 * d20 - d01 * d21) / denom;
+    const float bv = (d00 * d21 - d01 * d20) / denom;
+    if (bu >= 0.0f && bv >= 0.0f && bu + bv <= 1.0f) {
+      const float d = (w - bu * e1 - bv * e2).squaredNorm();
+      if (d < rst) {
+        rst = d;
+        u = bu;
+        v = bv;
+      }
+    }
+  }
+  return rst;
+}
+
+// A kernel knows a query point and measures its distance to a node box
+// or to the packets of a leaf. The traversal is shared by the scalar
+// and SSE kernels.
+
+struct ScalarKernel {
+  explicit ScalarKernel(const Eigen::Vector3f& p) : p(p) {}
+  float Box(const Bvh::Node& node) const {
+    float rst = 0.0f;
+    for (int a = 0; a < 3; ++a) {
+      const float d =
+          std::max({node.min[a] - p[a], p[a] - node.max[a], 0.0f});
+      rst += d * d;
+    }
+    return rst;
+  }
+  void Packets(const Bvh::Packet* packets, size_t n, Closest& best) const {
+    for (size_t k = 0; k < n; ++k) {
+      const Bvh::Packet& q = packets[k];
+      for (int l = 0; l < 4; ++l) {
+        if (q.face[l] < 0)
+          continue;
+        float u, v;
+        const float d2 = PointTriangle(
+            p, Eigen::Vector3f(q.v0[0][l], q.v0[1][l], q.v0[2][l]),
+            Eigen::Vector3f(q.e1[0][l], q.e1[1][l], q.e1[2][l]),
+            Eigen::Vector3f(q.e2[0][l], q.e2[1][l], q.e2[2][l]), u, v);
+        if (d2 < best.d2)
+          best = {d2, u, v, q.face[l]};
+      }
+    }
+  }
+  Eigen::Vector3f p;
+};
+
+#ifdef GEOMETRY_LAB_X86
+struct SSEKernel {
+  explicit SSEKernel(const Eigen::Vector3f& point) {
+    p = _mm_setr_ps(point.x(), point.y(), point.z(), 0.0f);
+    keep_xyz = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    for (int a = 0; a < 3; ++a)
+      p4[a] = _mm_set1_ps(point[a]);
+  }
+  // Lane 3 of the node holds its offset and count, cleared before any
+  // arithmetic since they would be slow denormals
+  float Box(const Bvh::Node& node) const {
+    const __m128 min = _mm_and_ps(_mm_loadu_ps(node.min), keep_xyz);
+    const __m128 max = _mm_and_ps(_mm_loadu_ps(node.max), keep_xyz);
+    const __m128 d = _mm_max_ps(
+        _mm_max_ps(_mm_sub_ps(min, p), _mm_sub_ps(p, max)), _mm_setzero_ps());
+    __m128 d2 = _mm_mul_ps(d, d);
+    d2 = _mm_add_ps(d2, _mm_shuffle_ps(d2, d2, _MM_SHUFFLE(1, 0, 3, 2)));
+    d2 = _mm_add_ps(d2, _mm_shuffle_ps(d2, d2, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(d2);
+  }
+  void Packets(const Bvh::Packet* packets, size_t n, Closest& best) const {
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 tiny = _mm_set1_ps(1e-30f), inf = _mm_set1_ps(kInf);
+    auto dot = [](const __m128* a, const __m128* b) {
+      return _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])),
+          _mm_mul_ps(a[2], b[2]));
+    };
+    auto clamp01 = [&](__m128 t) {
+      return _mm_min_ps(_mm_max_ps(t, zero), one);
+    };
+    // |w - s * a - t * b|^2
+    auto dist2 = [&](const __m128* w, __m128 s, const __m128* a, __m128 t,
+                     const __m128* b) {
+      __m128 d[3];
+      for (int k = 0; k < 3; ++k) {
+        d[k] = _mm_sub_ps(
+            w[k], _mm_add_ps(_mm_mul_ps(s, a[k]), _mm_mul_ps(t, b[k])));
+      }
+      return dot(d, d);
+    };
+    // Keep the candidate where it is nearer
+    auto select = [](__m128 mask, __m128 a, __m128 b) {
+      return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    };
+    for (size_t k = 0; k < n; ++k) {
+      const Bvh::Packet& q = packets[k];
+      __m128 w[3], e1[3], e2[3], e12[3];
+      for (int a = 0; a < 3; ++a) {
+        w[a] = _mm_sub_ps(p4[a], _mm_load_ps(q.v0[a]));
+        e1[a] = _mm_load_ps(q.e1[a]);
+        e2[a] = _mm_load_ps(q.e2[a]);
+        e12[a] = _mm_sub_ps(e2[a], e1[a]);
+      }
+      const __m128 d00 = dot(e1, e1), d01 = dot(e1, e2), d11 = dot(e2, e2);
+      const __m128 d20 = dot(w, e1), d21 = dot(w, e2);
+      // Edges v0-v1, v0-v2 and v1-v2
+      const __m128 t01 = clamp01(_mm_div_ps(d20, _mm_max_ps(d00, tiny)));
+      const __m128 t02 = clamp01(_mm_div_ps(d21, _mm_max_ps(d11, tiny)));
+      __m128 w1[3];
+      for (int a = 0; a < 3; ++a)
+        w1[a] = _mm_sub_ps(w[a], e1[a]);
+      const __m128 t12 = clamp01(
+          _mm_div_ps(dot(w1, e12), _mm_max_ps(dot(e12, e12), tiny)));
+      __m128 d2 = dist2(w, t01, e1, zero, e2);
+      __m128 u = t01, v = zero;
+      const __m128 c02 = dist2(w, zero, e1, t02, e2);
+      __m128 nearer = _mm_cmplt_ps(c02, d2);
+      d2 = _mm_min_ps(c02, d2);
+      u = select(nearer, zero, u);
+      v = select(nearer, t02, v);
+      const __m128 c12 = dist2(w1, zero, e1, t12, e12);
+      nearer = _mm_cmplt_ps(c12, d2);
+      d2 = _mm_min_ps(c12, d2);
+      u = select(nearer, _mm_sub_ps(one, t12), u);
+      v = select(nearer, t12, v);
+      // Projection inside the face
+      const __m128 denom =
+          _mm_sub_ps(_mm_mul_ps(d00, d11), _mm_mul_ps(d01, d01));
+      const __m128 bu = _mm_div_ps(
+          _mm_sub_ps(_mm_mul_ps(d11, d20), _mm_mul_ps(d01, d21)), denom);
+      const __m128 bv = _mm_div_ps(
+          _mm_sub_ps(_mm_mul_ps(d00, d21), _mm_mul_ps(d01, d20)), denom);
+      __m128 inside = _mm_cmpgt_ps(denom, zero);
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(bu, zero));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(bv, zero));
+      inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_add_ps(bu, bv), one));
+      const __m128 cf = select(inside, dist2(w, bu, e1, bv, e2), inf);
+      nearer = _mm_cmplt_ps(cf, d2);
+      d2 = _mm_min_ps(cf, d2);
+      u = select(nearer, bu, u);
+      v = select(nearer, bv, v);
+      // Padding lanes are never the closest
+      const __m128 padding = _mm_castsi128_ps(_mm_cmplt_epi32(
+          _mm_load_si128(reinterpret_cast<const __m128i*>(q.face)),
+          _mm_setzero_si128()));
+      d2 = select(padding, inf, d2);
+      const int bits =
+          _mm_movemask_ps(_mm_cmplt_ps(d2, _mm_set1_ps(best.d2)));
+      if (bits == 0)
+        continue;
+      alignas(16) float ds[4], us[4], vs[4];
+      _mm_store_ps(ds, d2);
+      _mm_store_ps(us, u);
+      _mm_store_ps(vs, v);
+      for (int l = 0; l < 4; ++l) {
+        if ((bits >> l & 1) && ds[l] < best.d2)
+          best = {ds[l], us[l], vs[l], q.face[l]};
+      }
+    }
+  }
+  __m128 p, keep_xyz;
+  __m128 p4[3];
+};
+#endif
+
+/// Improve best with the faces of the tree closer than it.
+template <typename Kernel>
+void Traverse(const Bvh& bvh, const Eigen::Vector3f& p, Closest& best) {
+  const Kernel kernel(p);
+  const float root = kernel.Box(bvh.nodes_[0]);
+  if (root >= best.d2)
+    return;
+  // Far children left behind, with their squared distance
+  std::pair<int32_t, float> stack[Bvh::kMaxDepth];
+  size_t top = 0;
+  int32_t i = 0;
+  while (true) {
+    const Bvh::Node& node = bvh.nodes_[i];
+    if (node.count > 0) {
+      kernel.Packets(&bvh.packets_[node.offset], (node.count + 3) / 4, best);
+    } else {
+      int32_t a = i + 1, b = node.offset;
+      float da = kernel.Box(bvh.nodes_[a]);
+      float db = kernel.Box(bvh.nodes_[b]);
+      if (db < da) {
+        std::swap(a, b);
+        std::swap(da, db);
+      }
+      if (da < best.d2) {
+        if (db < best.d2)
+          stack[top++] = {b, db};
+        i = a;
+        continue;
+      }
+    }
+    while (top > 0 && stack[top - 1].second >= best.d2)
+      --top;
+    if (top == 0)
+      break;
+    i = stack[--top].first;
+  }
+}
+
+template <typename Kernel>
+void QueryBlock(const Bvh& bvh, const TriMeshSoA& mesh, const float* x,
+                const float* y, const float* z, size_t begin, size_t end,
+                float* distance, int32_t* face, float* u, float* v) {
+  int32_t last = -1;
+  for (size_t i = begin; i < end; ++i) {
+    const Eigen::Vector3f p(x[i], y[i], z[i]);
+    Closest best;
+    // The face of the previous point bounds the search
+    if (last >= 0) {
+      const int32_t* f = &mesh.faces_[3 * last];
+      const Eigen::Vector3f v0(mesh.x_[f[0]], mesh.y_[f[0]], mesh.z_[f[0]]);
+      const Eigen::Vector3f e1 =
+          Eigen::Vector3f(mesh.x_[f[1]], mesh.y_[f[1]], mesh.z_[f[1]]) - v0;
+      const Eigen::Vector3f e2 =
+          Eigen::Vector3f(mesh.x_[f[2]], mesh.y_[f[2]], mesh.z_[f[2]]) - v0;
+      best.d2 = PointTriangle(p, v0, e1, e2, best.u, best.v);
+      best.face = last;
+    }
+    Traverse<Kernel>(bvh, p, best);
+    distance[i] = std::sqrt(best.d2);
+    face[i] = best.face;
+    u[i] = best.u;
+    v[i] = best.v;
+    last = best.face;
+  }
+}
+
+}  // namespace
+
+void ClosestPointQuery::Compute(TriMesh& mesh, const float* x,
+                                const float* y, const float* z, size_t n,
+                                bool sign) {
+  GEOMETRY_LAB_TRACE_SCOPE("ClosestPointQuery::Compute");
+  distance_.resize(n);
+  face_.resize(n);
+  u_.resize(n);
+  v_.resize(n);
+  const Bvh& bvh = mesh.ComputeBvh();
+  const TriMeshSoA& soa = mesh.soa();
+  if (bvh.empty()) {
+    std::fill(distance_.begin(), distance_.end(), kInf);
+    std::fill(face_.begin(), face_.end(), -1);
+    std::fill(u_.begin(), u_.end(), 0.0f);
+    std::fill(v_.begin(), v_.end(), 0.0f);
+    return;
+  }
+  const SimdLevel run = DispatchSimdLevel(simd_level_);
+  ParallelBlocks(
+      n,
+      [&](size_t, size_t begin, size_t end) {
+#ifdef GEOMETRY_LAB_X86
+        if (run >= SimdLevel::kSSE) {
+          QueryBlock<SSEKernel>(bvh, soa, x, y, z, begin, end,
+                                distance_.data(), face_.data(), u_.data(),
+                                v_.data());
+          return;
+        }
+#endif
+        QueryBlock<ScalarKernel>(bvh, soa, x, y, z, begin, end,
+                                 distance_.data(), face_.data(), u_.data(),
+                                 v_.data());
+      },
+      256);
+  if (!sign)
+    return;
+  if (mesh_ != &mesh || topology_ != mesh.topology_generation() ||
+      geometry_ != mesh.geometry_generation()) {
+    ComputePseudoNormals(soa);
+    mesh_ = &mesh;
+    topology_ = mesh.topology_generation();
+    geometry_ = mesh.geometry_generation();
+  }
+  ParallelFor(0, n, [&](size_t i) {
+    const int32_t f = face_[i];
+    const int32_t* v = &soa.faces_[3 * f];
+    const float w0 = 1.0f - u_[i] - v_[i];
+    const Eigen::Vector3f q =
+        w0 * Eigen::Vector3f(soa.x_[v[0]], soa.y_[v[0]], soa.z_[v[0]]) +
+        u_[i] * Eigen::Vector3f(soa.x_[v[1]], soa.y_[v[1]], soa.z_[v[1]]) +
+        v_[i] * Eigen::Vector3f(soa.x_[v[2]], soa.y_[v[2]], soa.z_[v[2]]);
+    const Eigen::Vector3f d = Eigen::Vector3f(x[i], y[i], z[i]) - q;
+    if (d.dot(PseudoNormal(soa, f, u_[i], v_[i])) < 0.0f)
+      distance_[i] = -distance_[i];
+  });
+}
+
+ClosestPointQuery::Summary ClosestPointQuery::Summarize() const {
+  Summary rst;
+  const size_t n = distance_.size();
+  if (n == 0)
+    return rst;
+  double sum = 0.0, sum2 = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    const float d = std::abs(distance_[i]);
+    sum += d;
+    sum2 += static_cast<double>(d) * d;
+    if (rst.argmax < 0 || d > rst.max) {
+      rst.max = d;
+      rst.argmax = static_cast<int64_t>(i);
+    }
+  }
+  rst.mean = static_cast<float>(sum / n);
+  rst.rms = static_cast<float>(std::sqrt(sum2 / n));
+  return rst;
+}
+
+void ClosestPointQuery::ComputePseudoNormals(const TriMeshSoA& mesh) {
+  GEOMETRY_LAB_TRACE_SCOPE("ClosestPointQuery::ComputePseudoNormals");
+  auto pos = [&](int32_t v) {
+    return Eigen::Vector3f(mesh.x_[v], mesh.y_[v], mesh.z_[v]);
+  };
+  face_normals_.resize(mesh.n_faces());
+  ParallelFor(0, mesh.n_faces(), [&](size_t f) {
+    const int32_t* v = &mesh.faces_[3 * f];
+    face_normals_[f] =
+        (pos(v[1]) - pos(v[0])).cross(pos(v[2]) - pos(v[0])).normalized();
+  });
+  // Incident face normals weighted by their angle at the vertex
+  vertex_normals_.resize(mesh.n_vertices());
+  ParallelFor(0, mesh.n_vertices(), [&](size_t v) {
+    Eigen::Vector3f n = Eigen::Vector3f::Zero();
+    const int32_t h0 = mesh.vertex_halfedge_[v];
+    if (h0 >= 0) {
+      int32_t h = h0;
+      do {
+        const int32_t f = mesh.face_[h];
+        if (f >= 0) {
+          const int32_t prev = mesh.next_[mesh.next_[h]];
+          const Eigen::Vector3f a =
+              pos(mesh.to_vertex_[h]) - pos(static_cast<int32_t>(v));
+          const Eigen::Vector3f b =
+              pos(mesh.from_vertex(prev)) - pos(static_cast<int32_t>(v));
+          n += std::atan2(a.cross(b).norm(), a.dot(b)) * face_normals_[f];
+        }
+        h = mesh.next_[TriMeshSoA::opposite(h)];
+      } while (h != h0);
+    }
+    vertex_normals_[v] = n;
+  });
+}
+
+Eigen::Vector3f ClosestPointQuery::PseudoNormal(const TriMeshSoA& mesh,
+                                                int32_t f, float u,
+                                                float v) const {
+  const float w[3] = {1.0f - u - v, u, v};
+  int n_zero = 0, nonzero = 0, zero = 0;
+  for (int k = 0; k < 3; ++k) {
+    if (w[k] <= kFeatureTolerance) {
+      ++n_zero;
+      zero = k;
+    } else {
+      nonzero = k;
+    }
+  }
+  // At a vertex
+  if (n_zero == 2)
+    return vertex_normals_[mesh.faces_[3 * f + nonzero]];
+  // On the edge opposite the zero coordinate, halfedge k goes from
+  // vertex k to vertex k + 1
+  if (n_zero == 1) {
+    int32_t h = mesh.face_halfedge_[f];
+    for (int k = 0; k < (zero + 1) % 3; ++k)
+      h = mesh.next_[h];
+    const int32_t g = mesh.face_[TriMeshSoA::opposite(h)];
+    return g >= 0 ? face_normals_[f] + face_normals_[g] : face_normals_[f];
+  }
+  return face_normals_[f];
+}
+
+}  // namespace geometry_lab
@@ -0,0 +1,90 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_CLOSEST_POINT_HPP_
+#define GEOMETRY_LAB_CORE_CLOSEST_POINT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "core/simd.hpp"
+
+namespace geometry_lab {
+
+class TriMesh;
+class TriMeshSoA;
+
+/**
+ * @brief Closest points and (signed) distances from batches of points
+ *  to the surface of a mesh.
+ *
+ *  The points are split into blocks processed in parallel. Each query
+ *  walks the BVH of the mesh (see @c TriMesh::ComputeBvh()) nearest
+ *  box first and prunes every box farther than the best distance so
+ *  far, which starts at the face found for the previous point: points
+ *  given in a coherent order (e.g. the vertices of another mesh) find
+ *  a close bound at once. The distances to the 4 triangles of a leaf
+ *  packet are computed together with SSE.
+ *
+ *  The sign comes from the angle-weighted pseudo-normal of the
+ *  closest feature (face, edge or vertex), which is exact for closed
+ *  and consistently oriented meshes.
+*/
+class ClosestPointQuery {
+ public:
+  /**
+   * @brief Summary of the absolute distances of a batch.
+  */
+  struct Summary {
+    float max = 0.0f, mean = 0.0f, rms = 0.0f;
+    /// Point at the largest distance, -1 for an empty batch.
+    int64_t argmax = -1;
+  };
+  /**
+   * @brief Find the closest point of the surface to each point.
+   * @param mesh[in] - The mesh, its BVH is built or refitted if needed.
+   * @param x[in] - x coordinates of the points.
+   * @param y[in] - y coordinates of the points.
+   * @param z[in] - z coordinates of the points.
+   * @param n[in] - Number of points.
+   * @param sign[in] - Negative distances inside the mesh?
+  */
+  void Compute(TriMesh& mesh, const float* x, const float* y, const float* z,
+               size_t n, bool sign = false);
+  /**
+   * @return Maximum, mean and RMS of the absolute distances of the
+   *  last batch. The maximum from the vertices of a mesh A to a mesh B
+   *  is the one-sided Hausdorff distance from A to B.
+  */
+  Summary Summarize() const;
+
+  ClosestPointQuery() {}
+
+  /// Distance of each point, negative inside when signed.
+  AlignedVector<float> distance_;
+  /// Face of the closest point, -1 for an empty mesh.
+  std::vector<int32_t> face_;
+  /// Barycentric coordinates of the closest point for vertices 1 and
+  /// 2 of the face (@c TriMeshSoA::faces_ order).
+  AlignedVector<float> u_, v_;
+  /// The best instruction set of the distance tests.
+  SimdLevel simd_level_ = SimdLevel::kSSE;
+
+ private:
+  /// Face normals and angle-weighted vertex normals for the signs.
+  void ComputePseudoNormals(const TriMeshSoA& mesh);
+  /// Pseudo-normal of the feature of a face a closest point is on.
+  Eigen::Vector3f PseudoNormal(const TriMeshSoA& mesh, int32_t f, float u,
+                               float v) const;
+
+  std::vector<Eigen::Vector3f> face_normals_, vertex_normals_;
+  /// Mesh and generations of the pseudo-normals.
+  const TriMesh* mesh_ = nullptr;
+  uint64_t topology_ = UINT64_MAX, geometry_ = UINT64_MAX;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_CLOSEST_POINT_HPP_
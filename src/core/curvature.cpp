@@ -0,0 +1,210 @@
+#include "core/curvature.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include <Eigen/Cholesky>
+#include <Eigen/Geometry>
+
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh.hpp"
+
+namespace geometry_lab {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+Eigen::Vector3d Position(const TriMeshSoA& mesh, int32_t v) {
+  return Eigen::Vector3d(mesh.x_[v], mesh.y_[v], mesh.z_[v]);
+}
+
+/// Vector i of a flat array of 3D vectors.
+Eigen::Map<const Eigen::Vector3d> Vec3(const std::vector<double>& a,
+                                       size_t i) {
+  return Eigen::Map<const Eigen::Vector3d>(&a[3 * i]);
+}
+Eigen::Map<Eigen::Vector3d> Vec3(std::vector<double>& a, size_t i) {
+  return Eigen::Map<Eigen::Vector3d>(&a[3 * i]);
+}
+
+}  // namespace
+
+void CurvatureEngine::Compute(TriMesh& mesh) {
+  GEOMETRY_LAB_TRACE_SCOPE("CurvatureEngine::Compute");
+  const TriMeshSoA& soa = mesh.soa();
+  const size_t n_v = soa.n_vertices(), n_f = soa.n_faces();
+  assert(soa.faces_.size() == 3 * n_f);
+  auto halfedge_diff = mesh.prop_halfedge_diff();
+  auto face_area = mesh.prop_face_area();
+  // 1. Angles, cotangents and mixed areas of the corners, the
+  //    boundary halfedges have none
+  angle_.assign(soa.n_halfedges(), 0.0);
+  corner_area_.assign(soa.n_halfedges(), 0.0);
+  cot_.assign(soa.n_halfedges(), 0.0);
+  face_normals_.resize(3 * n_f);
+  face_axes_.resize(3 * n_f);
+  ParallelFor(0, n_f, [&](size_t f) {
+    const int32_t* v = &soa.faces_[3 * f];
+    int32_t h[3];
+    h[0] = soa.face_halfedge_[f];
+    h[1] = soa.next_[h[0]];
+    h[2] = soa.next_[h[1]];
+    const Eigen::Vector3d p0 = Position(soa, v[0]);
+    const Eigen::Vector3d e01 = Position(soa, v[1]) - p0;
+    const Eigen::Vector3d e02 = Position(soa, v[2]) - p0;
+    Vec3(face_normals_, f) = e01.cross(e02).normalized();
+    Vec3(face_axes_, f) = e01.normalized();
+    Eigen::Vector2d d[3];
+    for (int k = 0; k < 3; ++k)
+      d[k] = halfedge_diff[OpenMesh::HalfedgeHandle(h[k])];
+    const double a = face_area[OpenMesh::FaceHandle(static_cast<int>(f))];
+    if (a <= 0.0)
+      return;
+    const double inv = 0.5 / a;
+    bool obtuse = false;
+    for (int k = 0; k < 3; ++k) {
+      // The corner at the from-vertex of h_k is between h_k and the
+      // reverse of h_(k+2), the norm of their cross product is 2a
+      const double dot = -d[k].dot(d[(k + 2) % 3]);
+      angle_[h[k]] = std::atan2(2.0 * a, dot);
+      cot_[h[k]] = -d[(k + 1) % 3].dot(d[(k + 2) % 3]) * inv;
+      obtuse = obtuse || dot < 0.0;
+    }
+    for (int k = 0; k < 3; ++k) {
+      const int j = (k + 2) % 3;
+      if (!obtuse) {
+        // Voronoi area of the corner
+        corner_area_[h[k]] = (d[k].squaredNorm() * cot_[h[k]] +
+                              d[j].squaredNorm() * cot_[h[j]]) /
+                             8.0;
+      } else {
+        corner_area_[h[k]] = angle_[h[k]] > 0.5 * kPi ? 0.5 * a : 0.25 * a;
+      }
+    }
+  });
+  // 2. Angle defect, mean curvature normal and angle-weighted normal
+  //    of the vertices
+  gaussian_.resize(n_v);
+  mean_.resize(n_v);
+  principal_.resize(2 * n_v);
+  areas_.resize(n_v);
+  normals_.resize(3 * n_v);
+  ParallelFor(0, n_v, [&](size_t v) {
+    const Eigen::Vector3d p = Position(soa, static_cast<int32_t>(v));
+    double angle = 0.0, area = 0.0;
+    bool boundary = false;
+    Eigen::Vector3d laplacian = Eigen::Vector3d::Zero();
+    Eigen::Vector3d normal = Eigen::Vector3d::Zero();
+    const int32_t h0 = soa.vertex_halfedge_[v];
+    if (h0 >= 0) {
+      int32_t h = h0;
+      do {
+        const int32_t o = TriMeshSoA::opposite(h);
+        const double w = 0.5 * (cot_[h] + cot_[o]);
+        laplacian += w * (p - Position(soa, soa.to_vertex_[h]));
+        angle += angle_[h];
+        area += corner_area_[h];
+        if (soa.face_[h] >= 0)
+          normal += angle_[h] * Vec3(face_normals_, soa.face_[h]);
+        else
+          boundary = true;
+        h = soa.next_[o];
+      } while (h != h0);
+    }
+    if (normal.squaredNorm() > 0.0)
+      normal.normalize();
+    Vec3(normals_, v) = normal;
+    areas_[v] = area;
+    double gaussian = 0.0, mean = 0.0;
+    if (area > 0.0) {
+      gaussian = ((boundary ? kPi : 2.0 * kPi) - angle) / area;
+      // The cotangent Laplacian of the positions is 2 H A n
+      mean = normal.dot(laplacian) / (2.0 * area);
+    }
+    gaussian_[v] = gaussian;
+    mean_[v] = mean;
+    const double r = std::sqrt(std::max(mean * mean - gaussian, 0.0));
+    principal_[2 * v] = mean + r;
+    principal_[2 * v + 1] = mean - r;
+  });
+  // 3. Shape operator of each face in its frame, least squares fit of
+  //    S e = dn on its three edges, S = [a b; b c]
+  shape_.resize(6 * n_f);
+  ParallelFor(0, n_f, [&](size_t f) {
+    const int32_t* v = &soa.faces_[3 * f];
+    double* s = &shape_[6 * f];
+    std::fill(s, s + 6, 0.0);
+    if (face_area[OpenMesh::FaceHandle(static_cast<int>(f))] <= 0.0)
+      return;
+    const Eigen::Vector3d x = Vec3(face_axes_, f);
+    const Eigen::Vector3d y = Vec3(face_normals_, f).cross(x);
+    Eigen::Matrix3d ata = Eigen::Matrix3d::Zero();
+    Eigen::Vector3d atb = Eigen::Vector3d::Zero();
+    int32_t h = soa.face_halfedge_[f];
+    for (int k = 0; k < 3; ++k) {
+      const Eigen::Vector2d& e = halfedge_diff[OpenMesh::HalfedgeHandle(h)];
+      const Eigen::Vector3d dn =
+          Vec3(normals_, v[(k + 1) % 3]) - Vec3(normals_, v[k]);
+      const double dx = dn.dot(x), dy = dn.dot(y);
+      ata(0, 0) += e.x() * e.x();
+      ata(0, 1) += e.x() * e.y();
+      ata(1, 1) += e.x() * e.x() + e.y() * e.y();
+      ata(1, 2) += e.x() * e.y();
+      ata(2, 2) += e.y() * e.y();
+      atb += Eigen::Vector3d(e.x() * dx, e.y() * dx + e.x() * dy, e.y() * dy);
+      h = soa.next_[h];
+    }
+    ata(1, 0) = ata(0, 1);
+    ata(2, 1) = ata(1, 2);
+    const Eigen::Vector3d abc = ata.ldlt().solve(atb);
+    const Eigen::Matrix3d shape = abc[0] * x * x.transpose() +
+                                  abc[1] * (x * y.transpose() +
+                                            y * x.transpose()) +
+                                  abc[2] * y * y.transpose();
+    s[0] = shape(0, 0);
+    s[1] = shape(0, 1);
+    s[2] = shape(0, 2);
+    s[3] = shape(1, 1);
+    s[4] = shape(1, 2);
+    s[5] = shape(2, 2);
+  });
+  // 4. Principal directions, the operators of the faces weighted by
+  //    the corner areas and restricted to the tangent plane
+  directions_.assign(3 * n_v, 0.0);
+  ParallelFor(0, n_v, [&](size_t v) {
+    const Eigen::Vector3d n = Vec3(normals_, v);
+    const int32_t h0 = soa.vertex_halfedge_[v];
+    if (h0 < 0 || n.squaredNorm() == 0.0)
+      return;
+    Eigen::Matrix3d shape = Eigen::Matrix3d::Zero();
+    int32_t h = h0;
+    do {
+      const int32_t f = soa.face_[h];
+      if (f >= 0) {
+        const double* s = &shape_[6 * f];
+        const double w = corner_area_[h];
+        shape(0, 0) += w * s[0];
+        shape(0, 1) += w * s[1];
+        shape(0, 2) += w * s[2];
+        shape(1, 1) += w * s[3];
+        shape(1, 2) += w * s[4];
+        shape(2, 2) += w * s[5];
+      }
+      h = soa.next_[TriMeshSoA::opposite(h)];
+    } while (h != h0);
+    const Eigen::Vector3d u = n.unitOrthogonal();
+    const Eigen::Vector3d w = n.cross(u);
+    const Eigen::Matrix3d sym = shape.selfadjointView<Eigen::Upper>();
+    const double s00 = u.dot(sym * u);
+    const double s01 = u.dot(sym * w);
+    const double s11 = w.dot(sym * w);
+    // Eigenvector of the largest eigenvalue of [s00 s01; s01 s11]
+    const double phi = 0.5 * std::atan2(2.0 * s01, s00 - s11);
+    Vec3(directions_, v) = std::cos(phi) * u + std::sin(phi) * w;
+  });
+}
+
+}  // namespace geometry_lab
@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_CURVATURE_HPP_
+#define GEOMETRY_LAB_CORE_CURVATURE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace geometry_lab {
+
+class TriMesh;
+
+/**
+ * @brief Parallel discrete curvatures of the vertices of a triangle
+ *  mesh.
+ *
+ *  A first pass over the faces gets the corner angles, the cotangents
+ *  and the mixed Voronoi areas (Meyer et al.) from the 2D frames of
+ *  the @c HalfedgeDiff property. Every vertex then gathers its own
+ *  corners: the Gaussian curvature is the angle defect, the mean
+ *  curvature comes from the cotangent Laplacian of the positions, both
+ *  divided by the mixed area. A second pass fits the shape operator of
+ *  each face in its frame to the differences of the vertex normals
+ *  (Rusinkiewicz), and every vertex averages the operators of its
+ *  faces in its tangent plane to find the principal directions.
+ *
+ *  As for @c NormalEngine, the vertices only read the per-face
+ *  buffers, so no thread writes to a shared vertex.
+*/
+class CurvatureEngine {
+ public:
+  /**
+   * @brief Compute the curvatures of all the vertices.
+   * @param mesh[in] - The mesh, its properties @c HalfedgeDiff and
+   *                   @c FaceArea must be up to date.
+  */
+  void Compute(TriMesh& mesh);
+
+  CurvatureEngine() {}
+  /// Unit direction of the largest curvature at vertex v, (x,y,z).
+  const double* direction(size_t v) const { return &directions_[3 * v]; }
+
+  /// Gaussian curvature of each vertex, the angle defect over the
+  /// mixed area. The defect is measured from pi on the boundary.
+  std::vector<double> gaussian_;
+  /// Mean curvature of each vertex, positive where the surface bends
+  /// away from the normal (e.g. 1 / r on a sphere).
+  std::vector<double> mean_;
+  /// Largest and smallest principal curvatures, H +- sqrt(H^2 - K),
+  /// (k1,k2) in a row.
+  std::vector<double> principal_;
+  /// Unit direction of k1 in the tangent plane, (x,y,z) in a row.
+  std::vector<double> directions_;
+  /// Mixed Voronoi area of each vertex.
+  std::vector<double> areas_;
+  /// Unit angle-weighted normal of each vertex, (x,y,z) in a row.
+  std::vector<double> normals_;
+
+ private:
+  /// Angle and mixed area of the corner at the from-vertex of each
+  /// halfedge, cotangent of the angle opposite it, 0 on the boundary.
+  std::vector<double> angle_, corner_area_, cot_;
+  /// Unit normal and first axis of the frame of each face, (x,y,z) in
+  /// a row.
+  std::vector<double> face_normals_, face_axes_;
+  /// Shape operator of each face in 3D, (xx,xy,xz,yy,yz,zz) in a row.
+  std::vector<double> shape_;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_CURVATURE_HPP_
@@ -0,0 +1,523 @@
+#include "core/decimation.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include "core/boundary_loops.hpp"
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh.hpp"
+
+namespace geometry_lab {
+
+namespace {
+
+constexpr double kInfinity = std::numeric_limits<double>::infinity();
+/// Weight of the planes holding a boundary allowed to move.
+constexpr double kBoundaryWeight = 100.0;
+
+/**
+ * @brief Quadric v^T A v + 2 b^T v + c, A is symmetric.
+*/
+struct Quadric {
+  /// Plane n.v + d = 0 with a unit normal, scaled by w.
+  static Quadric Plane(const Eigen::Vector3d& n, double d, double w) {
+    Quadric q;
+    q.a = {w * n.x() * n.x(), w * n.x() * n.y(), w * n.x() * n.z(),
+           w * n.y() * n.y(), w * n.y() * n.z(), w * n.z() * n.z(),
+           w * d * n.x(),     w * d * n.y(),     w * d * n.z(),
+           w * d * d};
+    return q;
+  }
+  Quadric& operator+=(const Quadric& q) {
+    for (int k = 0; k < 10; ++k)
+      a[k] += q.a[k];
+    return *this;
+  }
+  Quadric operator+(const Quadric& q) const {
+    Quadric rst = *this;
+    return rst += q;
+  }
+  double Evaluate(const Eigen::Vector3d& v) const {
+    const double x = v.x(), y = v.y(), z = v.z();
+    return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z +
+           a[3] * y * y + 2 * a[4] * y * z + a[5] * z * z +
+           2 * (a[6] * x + a[7] * y + a[8] * z) + a[9];
+  }
+  /// Solve A v = -b, fails when A is close to singular (flat or
+  /// straight neighborhoods).
+  bool Minimize(Eigen::Vector3d& v) const {
+    Eigen::Matrix3d m;
+    m << a[0], a[1], a[2], a[1], a[3], a[4], a[2], a[4], a[5];
+    const double det = m.determinant();
+    const double scale = m.cwiseAbs().maxCoeff();
+    if (!(std::abs(det) > 1e-10 * scale * scale * scale))
+      return false;
+    v = -(m.inverse() * Eigen::Vector3d(a[6], a[7], a[8]));
+    return true;
+  }
+  std::array<double, 10> a = {};
+};
+
+/**
+ * @brief Entry of the heap, stale when one of its vertices was
+ *  collapsed since.
+*/
+struct Candidate {
+  double cost;
+  int32_t a, b;
+  uint32_t a_version, b_version;
+  bool operator>(const Candidate& c) const { return cost > c.cost; }
+};
+
+/**
+ * @brief Edge collapse planned for the current state of the mesh.
+*/
+struct Collapse {
+  int32_t keep, remove;
+  Eigen::Vector3d position;
+  double cost;
+};
+
+/**
+ * @brief Working state of one decimation on an indexed face set.
+*/
+class Collapser {
+ public:
+  Collapser(const TriMeshSoA& mesh, const BoundaryLoops& loops,
+            bool preserve_boundary, double max_normal_angle,
+            bool keep_vertices)
+      : mesh_(mesh),
+        loops_(loops),
+        preserve_boundary_(preserve_boundary),
+        keep_vertices_(keep_vertices),
+        min_cos_(std::cos(max_normal_angle * 3.14159265358979323846 / 180)) {
+  }
+  /// Quadrics of the vertices and costs of all the edges.
+  void Setup();
+  /// Collapse until target_faces or max_error is reached.
+  /// @return The largest error collapsed.
+  double Run(size_t target_faces, double max_error, size_t& collapses);
+  /// Dense positions and triangles of the surviving mesh.
+  void Compact(std::vector<float>& positions, std::vector<int>& indices);
+  /// Surviving triangles over the vertices of the mesh.
+  void Triangles(std::vector<int32_t>& indices) const;
+
+ private:
+  /// Plan the collapse of edge (a, b).
+  bool Plan(int32_t a, int32_t b, Collapse& c) const;
+  /// Does the collapse keep the mesh manifold and the faces unflipped?
+  bool IsLegal(const Collapse& c);
+  void Apply(const Collapse& c);
+  /// Push the edges around vertex v.
+  void PushEdges(int32_t v);
+  bool Contains(int32_t f, int32_t v) const {
+    return faces_[f][0] == v || faces_[f][1] == v || faces_[f][2] == v;
+  }
+  void RemoveFace(int32_t v, int32_t f) {
+    auto& list = vertex_faces_[v];
+    auto it = std::find(list.begin(), list.end(), f);
+    *it = list.back();
+    list.pop_back();
+  }
+  /// Start a new marking of vertices in @c mark_.
+  uint32_t NewEpoch() {
+    if (epoch_ >= UINT32_MAX - 2) {
+      std::fill(mark_.begin(), mark_.end(), 0);
+      epoch_ = 0;
+    }
+    epoch_ += 2;
+    return epoch_;
+  }
+
+  const TriMeshSoA& mesh_;
+  const BoundaryLoops& loops_;
+  const bool preserve_boundary_;
+  /// Only halfedge collapses, the vertices never move.
+  const bool keep_vertices_;
+  const double min_cos_;
+  std::vector<Eigen::Vector3d> positions_;
+  std::vector<Quadric> quadrics_;
+  std::vector<std::array<int32_t, 3>> faces_;
+  std::vector<std::vector<int32_t>> vertex_faces_;
+  std::vector<uint8_t> boundary_, face_alive_;
+  /// Bumped at each collapse kept in the vertex, 0 for a removed one.
+  std::vector<uint32_t> version_;
+  std::vector<uint32_t> mark_;
+  uint32_t epoch_ = 0;
+  std::vector<Candidate> heap_;
+  size_t n_faces_ = 0;
+};
+
+void Collapser::Setup() {
+  const size_t n_v = mesh_.n_vertices(), n_f = mesh_.n_faces();
+  positions_.resize(n_v);
+  ParallelFor(0, n_v, [&](size_t v) {
+    positions_[v] = Eigen::Vector3d(mesh_.x_[v], mesh_.y_[v], mesh_.z_[v]);
+  });
+  faces_.resize(n_f);
+  face_alive_.assign(n_f, 1);
+  n_faces_ = n_f;
+  // Faces around the vertices, sized before filling
+  std::vector<int32_t> valence(n_v, 0);
+  for (size_t f = 0; f < n_f; ++f) {
+    for (int k = 0; k < 3; ++k) {
+      faces_[f][k] = mesh_.faces_[3 * f + k];
+      ++valence[faces_[f][k]];
+    }
+  }
+  vertex_faces_.resize(n_v);
+  ParallelFor(0, n_v, [&](size_t v) {
+    vertex_faces_[v].clear();
+    vertex_faces_[v].reserve(valence[v]);
+  });
+  for (size_t f = 0; f < n_f; ++f) {
+    for (int k = 0; k < 3; ++k)
+      vertex_faces_[faces_[f][k]].push_back(static_cast<int32_t>(f));
+  }
+  boundary_.assign(n_v, 0);
+  for (int32_t h : loops_.halfedges_)
+    boundary_[mesh_.to_vertex_[h]] = 1;
+  version_.assign(n_v, 1);
+  mark_.assign(n_v, 0);
+  epoch_ = 0;
+  // Plane of each face, then the sum around each vertex
+  std::vector<Quadric> planes(n_f);
+  ParallelFor(0, n_f, [&](size_t f) {
+    const Eigen::Vector3d& p0 = positions_[faces_[f][0]];
+    const Eigen::Vector3d n = (positions_[faces_[f][1]] - p0)
+                                  .cross(positions_[faces_[f][2]] - p0);
+    const double length = n.norm();
+    if (length > 0.0)
+      planes[f] = Quadric::Plane(n / length, -n.dot(p0) / length, 1.0);
+  });
+  quadrics_.resize(n_v);
+  ParallelFor(0, n_v, [&](size_t v) {
+    Quadric q;
+    for (int32_t f : vertex_faces_[v])
+      q += planes[f];
+    quadrics_[v] = q;
+  });
+  // A moving boundary is held by the planes through its edges
+  // orthogonal to their face
+  if (!preserve_boundary_) {
+    for (int32_t h : loops_.halfedges_) {
+      const int32_t u = mesh_.from_vertex(h), w = mesh_.to_vertex_[h];
+      const int32_t f = mesh_.face_[TriMeshSoA::opposite(h)];
+      const Eigen::Vector3d& p0 = positions_[faces_[f][0]];
+      const Eigen::Vector3d normal = (positions_[faces_[f][1]] - p0)
+                                         .cross(positions_[faces_[f][2]] - p0);
+      const Eigen::Vector3d edge = positions_[w] - positions_[u];
+      const Eigen::Vector3d n = edge.cross(normal).normalized();
+      if (!n.allFinite())
+        continue;
+      const Quadric q = Quadric::Plane(n, -n.dot(positions_[u]),
+                                       kBoundaryWeight * edge.squaredNorm());
+      quadrics_[u] += q;
+      quadrics_[w] += q;
+    }
+  }
+  // One candidate per edge, the heap is built in linear time
+  const size_t n_e = mesh_.n_halfedges() / 2;
+  heap_.resize(n_e);
+  ParallelFor(0, n_e, [&](size_t e) {
+    const int32_t h = static_cast<int32_t>(2 * e);
+    const int32_t a = mesh_.from_vertex(h), b = mesh_.to_vertex_[h];
+    Collapse c;
+    heap_[e] = {Plan(a, b, c) ? c.cost : kInfinity, a, b, 1, 1};
+  });
+  heap_.erase(std::remove_if(heap_.begin(), heap_.end(),
+                             [](const Candidate& c) {
+                               return c.cost == kInfinity;
+                             }),
+              heap_.end());
+  std::make_heap(heap_.begin(), heap_.end(), std::greater<Candidate>());
+}
+
+bool Collapser::Plan(int32_t a, int32_t b, Collapse& c) const {
+  const Quadric q = quadrics_[a] + quadrics_[b];
+  if (preserve_boundary_ && (boundary_[a] || boundary_[b])) {
+    // An interior vertex merges into the boundary one
+    if (boundary_[a] && boundary_[b])
+      return false;
+    c.keep = boundary_[a] ? a : b;
+    c.remove = boundary_[a] ? b : a;
+    c.position = positions_[c.keep];
+  } else if (keep_vertices_) {
+    const bool keep_a = q.Evaluate(positions_[a]) <= q.Evaluate(positions_[b]);
+    c.keep = keep_a ? a : b;
+    c.remove = keep_a ? b : a;
+    c.position = positions_[c.keep];
+  } else {
+    // The vertex with more faces stays, fewer faces to move
+    const bool keep_a = vertex_faces_[a].size() >= vertex_faces_[b].size();
+    c.keep = keep_a ? a : b;
+    c.remove = keep_a ? b : a;
+    if (!q.Minimize(c.position)) {
+      const Eigen::Vector3d options[3] = {
+          positions_[a], positions_[b], 0.5 * (positions_[a] + positions_[b])};
+      c.position = options[0];
+      for (int k = 1; k < 3; ++k) {
+        if (q.Evaluate(options[k]) < q.Evaluate(c.position))
+          c.position = options[k];
+      }
+    }
+  }
+  // Rounding makes tiny errors negative
+  c.cost = std::max(q.Evaluate(c.position), 0.0);
+  return true;
+}
+
+bool Collapser::IsLegal(const Collapse& c) {
+  // Link condition: the common neighbors of the two vertices are the
+  // opposite vertices of their common faces
+  const uint32_t epoch = NewEpoch();
+  for (int32_t f : vertex_faces_[c.keep]) {
+    for (int32_t v : faces_[f])
+      mark_[v] = epoch;
+  }
+  int shared = 0, common = 0;
+  for (int32_t f : vertex_faces_[c.remove]) {
+    if (Contains(f, c.keep)) {
+      ++shared;
+      // The opposite vertex would be left with two faces
+      for (int32_t v : faces_[f]) {
+        if (v != c.keep && v != c.remove && !boundary_[v] &&
+            vertex_faces_[v].size() <= 3)
+          return false;
+      }
+    }
+    for (int32_t v : faces_[f]) {
+      if (v != c.keep && v != c.remove && mark_[v] == epoch) {
+        mark_[v] = epoch + 1;
+        ++common;
+      }
+    }
+  }
+  if (shared == 0 || common != shared)
+    return false;
+  // Two boundary vertices only merge along a boundary edge
+  if (boundary_[c.keep] && boundary_[c.remove] && shared != 1)
+    return false;
+  // Normals of the faces that stay, before and after the move
+  for (int32_t v : {c.keep, c.remove}) {
+    for (int32_t f : vertex_faces_[v]) {
+      if (Contains(f, c.keep) && Contains(f, c.remove))
+        continue;
+      Eigen::Vector3d p[3];
+      for (int k = 0; k < 3; ++k)
+        p[k] = positions_[faces_[f][k]];
+      const Eigen::Vector3d before = (p[1] - p[0]).cross(p[2] - p[0]);
+      for (int k = 0; k < 3; ++k) {
+        if (faces_[f][k] == v)
+          p[k] = c.position;
+      }
+      const Eigen::Vector3d after = (p[1] - p[0]).cross(p[2] - p[0]);
+      const double length = before.norm() * after.norm();
+      if (after.squaredNorm() == 0.0 ||
+          (length > 0.0 && before.dot(after) < min_cos_ * length))
+        return false;
+    }
+  }
+  return true;
+}
+
+void Collapser::Apply(const Collapse& c) {
+  positions_[c.keep] = c.position;
+  quadrics_[c.keep] += quadrics_[c.remove];
+  boundary_[c.keep] |= boundary_[c.remove];
+  // The common faces vanish, the others move to the kept vertex
+  for (int32_t f : vertex_faces_[c.remove]) {
+    if (Contains(f, c.keep)) {
+      face_alive_[f] = 0;
+      --n_faces_;
+      for (int32_t v : faces_[f]) {
+        if (v != c.remove)
+          RemoveFace(v, f);
+      }
+    } else {
+      for (int32_t& v : faces_[f]) {
+        if (v == c.remove)
+          v = c.keep;
+      }
+      vertex_faces_[c.keep].push_back(f);
+    }
+  }
+  vertex_faces_[c.remove].clear();
+  vertex_faces_[c.remove].shrink_to_fit();
+  version_[c.remove] = 0;
+  ++version_[c.keep];
+}
+
+void Collapser::PushEdges(int32_t v) {
+  const uint32_t epoch = NewEpoch();
+  mark_[v] = epoch;
+  for (int32_t f : vertex_faces_[v]) {
+    for (int32_t w : faces_[f]) {
+      if (mark_[w] == epoch)
+        continue;
+      mark_[w] = epoch;
+      Collapse c;
+      if (!Plan(v, w, c))
+        continue;
+      heap_.push_back({c.cost, v, w, version_[v], version_[w]});
+      std::push_heap(heap_.begin(), heap_.end(), std::greater<Candidate>());
+    }
+  }
+}
+
+double Collapser::Run(size_t target_faces, double max_error,
+                      size_t& collapses) {
+  double error = 0.0;
+  collapses = 0;
+  while (n_faces_ > target_faces && !heap_.empty()) {
+    std::pop_heap(heap_.begin(), heap_.end(), std::greater<Candidate>());
+    const Candidate top = heap_.back();
+    heap_.pop_back();
+    if (version_[top.a] != top.a_version || version_[top.b] != top.b_version)
+      continue;
+    if (top.cost > max_error)
+      break;
+    Collapse c;
+    if (!Plan(top.a, top.b, c) || !IsLegal(c))
+      continue;
+    Apply(c);
+    error = std::max(error, c.cost);
+    ++collapses;
+    PushEdges(c.keep);
+  }
+  return error;
+}
+
+void Collapser::Compact(std::vector<float>& positions,
+                        std::vector<int>& indices) {
+  // Vertices keep their order, the isolated ones are dropped
+  const size_t n_v = positions_.size();
+  std::vector<int32_t> index(n_v, -1);
+  int32_t n = 0;
+  for (size_t v = 0; v < n_v; ++v) {
+    if (!vertex_faces_[v].empty())
+      index[v] = n++;
+  }
+  positions.resize(3 * static_cast<size_t>(n));
+  ParallelFor(0, n_v, [&](size_t v) {
+    if (index[v] < 0)
+      return;
+    for (int k = 0; k < 3; ++k)
+      positions[3 * index[v] + k] = static_cast<float>(positions_[v][k]);
+  });
+  indices.clear();
+  indices.reserve(3 * n_faces_);
+  for (size_t f = 0; f < faces_.size(); ++f) {
+    if (!face_alive_[f])
+      continue;
+    for (int32_t v : faces_[f])
+      indices.push_back(index[v]);
+  }
+}
+
+void Collapser::Triangles(std::vector<int32_t>& indices) const {
+  indices.clear();
+  indices.reserve(3 * n_faces_);
+  for (size_t f = 0; f < faces_.size(); ++f) {
+    if (face_alive_[f])
+      indices.insert(indices.end(), faces_[f].begin(), faces_[f].end());
+  }
+}
+
+/// Can the mesh be decimated? Prints the error.
+bool IsTriangleMesh(const TriMesh& mesh) {
+  if (mesh.n_faces() == 0) {
+    printf("Error::QuadricDecimater::The mesh has no face.\n\n");
+    return false;
+  }
+  for (const auto& f : mesh.faces()) {
+    if (f.valence() != 3) {
+      printf("Error::QuadricDecimater::The mesh is not triangulated.\n\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool QuadricDecimater::Decimate(TriMesh& mesh, size_t target_faces,
+                                double max_error) {
+  GEOMETRY_LAB_TRACE_SCOPE("QuadricDecimater::Decimate");
+  report_ = Report();
+  if (!IsTriangleMesh(mesh))
+    return false;
+  auto start = std::chrono::steady_clock::now();
+  const BoundaryLoops& loops = mesh.ComputeBoundaryLoops();
+  Collapser collapser(mesh.soa(), loops, preserve_boundary_,
+                      max_normal_angle_, false);
+  collapser.Setup();
+  report_.setup_ms = MillisecondsSince(start);
+  start = std::chrono::steady_clock::now();
+  {
+    GEOMETRY_LAB_TRACE_SCOPE("QuadricDecimater::Collapse");
+    report_.error =
+        collapser.Run(target_faces, max_error, report_.collapses);
+  }
+  report_.collapse_ms = MillisecondsSince(start);
+  start = std::chrono::steady_clock::now();
+  std::vector<float> positions;
+  std::vector<int> indices;
+  collapser.Compact(positions, indices);
+  // BuildFromPolygons() marks the topology changed and resets the
+  // transform, the decimated mesh stays in the frame of the source
+  const float normalized_scale = mesh.normalized_scale_;
+  const Eigen::Vector3f source_offset = mesh.source_offset_;
+  const float source_scale = mesh.source_scale_;
+  if (!mesh.BuildFromPolygons(positions, indices)) {
+    printf("Error::QuadricDecimater::Failed to rebuild the mesh.\n\n");
+    return false;
+  }
+  mesh.normalized_scale_ = normalized_scale;
+  mesh.source_offset_ = source_offset;
+  mesh.source_scale_ = source_scale;
+  if (mesh.has_vertex_normals())
+    mesh.ComputeVertexNormalWithFace();
+  report_.compact_ms = MillisecondsSince(start);
+  return true;
+}
+
+bool QuadricDecimater::Simplify(TriMesh& mesh,
+                                const std::vector<size_t>& targets,
+                                std::vector<std::vector<int32_t>>& levels) {
+  GEOMETRY_LAB_TRACE_SCOPE("QuadricDecimater::Simplify");
+  report_ = Report();
+  levels.clear();
+  if (!IsTriangleMesh(mesh))
+    return false;
+  auto start = std::chrono::steady_clock::now();
+  const BoundaryLoops& loops = mesh.ComputeBoundaryLoops();
+  Collapser collapser(mesh.soa(), loops, preserve_boundary_,
+                      max_normal_angle_, true);
+  collapser.Setup();
+  report_.setup_ms = MillisecondsSince(start);
+  levels.resize(targets.size());
+  for (size_t i = 0; i < targets.size(); ++i) {
+    start = std::chrono::steady_clock::now();
+    size_t collapses = 0;
+    report_.error = std::max(
+        report_.error, collapser.Run(targets[i], kInfinity, collapses));
+    report_.collapses += collapses;
+    report_.collapse_ms += MillisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    collapser.Triangles(levels[i]);
+    report_.compact_ms += MillisecondsSince(start);
+  }
+  return true;
+}
+
+}  // namespace geometry_lab
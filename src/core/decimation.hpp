@@ -0,0 +1,97 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_DECIMATION_HPP_
+#define GEOMETRY_LAB_CORE_DECIMATION_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace geometry_lab {
+
+class TriMesh;
+
+/**
+ * @brief Quadric error metric (Garland-Heckbert) decimation of a
+ *  triangle mesh by edge collapses.
+ *
+ *  Every vertex sums the plane quadrics of its faces, computed in
+ *  parallel on the flat snapshot of the mesh, and the initial costs
+ *  of all the edges are evaluated in parallel too. The collapses are
+ *  then taken from a lazy heap: a collapse changes only the edges of
+ *  the kept vertex, whose new costs are pushed while the old entries
+ *  are dropped when popped, since they carry the versions of their
+ *  vertices. The kept vertex moves to the minimum of the summed
+ *  quadric.
+ *
+ *  A collapse is skipped when it would make the mesh non-manifold
+ *  (link condition), when it tilts a face more than
+ *  @c max_normal_angle_ or flips it, and when it moves the boundary
+ *  while @c preserve_boundary_ is set. Finally the surviving vertices
+ *  and faces are compacted into dense arrays and the mesh is rebuilt
+ *  by @c TriMesh::BuildFromPolygons().
+*/
+class QuadricDecimater {
+ public:
+  /**
+   * @brief Statistics of the last @c Decimate() or @c Simplify().
+  */
+  struct Report {
+    size_t collapses = 0;
+    /// Largest quadric error of a collapse.
+    double error = 0.0;
+    /// Quadrics and costs, collapses and compaction (or the output
+    /// of the levels) in milliseconds.
+    double setup_ms = 0.0, collapse_ms = 0.0, compact_ms = 0.0;
+  };
+  /**
+   * @brief Collapse the cheapest edges until the mesh has few enough
+   *  faces or the next collapse is too costly.
+   *
+   *  The vertex normals are recomputed if the mesh has them, the
+   *  other vertex attributes are not kept. The transform back to the
+   *  source frame is kept.
+   *
+   * @param mesh[in] - The triangle mesh, rebuilt in place.
+   * @param target_faces[in] - Stop at this many faces.
+   * @param max_error[in] - Stop before a collapse of a larger quadric
+   *                        error, the sum of the squared distances to
+   *                        the planes of the merged faces.
+   * @return Success?
+  */
+  bool Decimate(TriMesh& mesh, size_t target_faces,
+                double max_error = std::numeric_limits<double>::infinity());
+  /**
+   * @brief Chain of simplified index sets over the vertices of the
+   *  mesh, e.g. levels of detail sharing one vertex buffer.
+   *
+   *  The collapses keep the better of the two vertices in place
+   *  (halfedge collapses), so every level indexes the vertices of the
+   *  mesh, and each level continues the collapses of the previous
+   *  one. The mesh is not changed.
+   *
+   * @param mesh[in] - The triangle mesh.
+   * @param targets[in] - Face counts of the levels, decreasing.
+   * @param levels[out] - Triangles of each level, 3 vertex indices
+   *                      each, a level is larger than its target when
+   *                      no legal collapse is left.
+   * @return Success?
+  */
+  bool Simplify(TriMesh& mesh, const std::vector<size_t>& targets,
+                std::vector<std::vector<int32_t>>& levels);
+
+  QuadricDecimater() {}
+
+  /// Keep the boundary vertices in place? Otherwise the boundary
+  /// edges are only held by heavy planes orthogonal to their faces.
+  bool preserve_boundary_ = true;
+  /// Largest rotation of a face normal by a collapse, in degrees.
+  double max_normal_angle_ = 60.0;
+  /// Statistics of the last @c Decimate() or @c Simplify().
+  Report report_;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_DECIMATION_HPP_
@@ -0,0 +1,186 @@
+#include "core/face_frames.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef GEOMETRY_LAB_X86
+#include <immintrin.h>
+#endif
+
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh.hpp"
+
+namespace geometry_lab {
+
+namespace {
+
+/// Raw pointers shared by the kernels.
+struct FrameData {
+  const float *x, *y, *z;
+  const int32_t* faces;
+  float *x0, *x1, *y1, *area;
+};
+
+// The frame is computed from a = p1 - p0 and b = p2 - p0 as
+//   x0 = |a|, x1 = a.b / |a| - |a|, y1 = |a x b| / |a|, area = |a x b| / 2
+// which avoids the cancellation of sqrt(1 - cos^2) in single precision.
+
+void FramesScalar(const FrameData& d, size_t begin, size_t end) {
+  for (size_t f = begin; f < end; ++f) {
+    const int32_t v0 = d.faces[3 * f];
+    const int32_t v1 = d.faces[3 * f + 1];
+    const int32_t v2 = d.faces[3 * f + 2];
+    const float ax = d.x[v1] - d.x[v0];
+    const float ay = d.y[v1] - d.y[v0];
+    const float az = d.z[v1] - d.z[v0];
+    const float bx = d.x[v2] - d.x[v0];
+    const float by = d.y[v2] - d.y[v0];
+    const float bz = d.z[v2] - d.z[v0];
+    const float cx = ay * bz - az * by;
+    const float cy = az * bx - ax * bz;
+    const float cz = ax * by - ay * bx;
+    const float l01 = std::sqrt(ax * ax + ay * ay + az * az);
+    const float cross = std::sqrt(cx * cx + cy * cy + cz * cz);
+    d.x0[f] = l01;
+    d.x1[f] = (ax * bx + ay * by + az * bz) / l01 - l01;
+    d.y1[f] = cross / l01;
+    d.area[f] = 0.5f * cross;
+  }
+}
+
+#ifdef GEOMETRY_LAB_X86
+inline __m128 Dot3(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by,
+                   __m128 bz) {
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+                    _mm_mul_ps(az, bz));
+}
+
+GEOMETRY_LAB_TARGET_AVX2
+inline __m256 Dot3(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by,
+                   __m256 bz) {
+  const __m256 xy = _mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by));
+  return _mm256_add_ps(xy, _mm256_mul_ps(az, bz));
+}
+
+void FramesSSE(const FrameData& d, size_t begin, size_t end) {
+  size_t f = begin;
+  for (; f + 4 <= end; f += 4) {
+    const int32_t* v = d.faces + 3 * f;
+    auto gather = [&](const float* src, int k) {
+      return _mm_setr_ps(src[v[k]], src[v[3 + k]], src[v[6 + k]],
+                         src[v[9 + k]]);
+    };
+    const __m128 x0 = gather(d.x, 0), y0 = gather(d.y, 0), z0 = gather(d.z, 0);
+    const __m128 ax = _mm_sub_ps(gather(d.x, 1), x0);
+    const __m128 ay = _mm_sub_ps(gather(d.y, 1), y0);
+    const __m128 az = _mm_sub_ps(gather(d.z, 1), z0);
+    const __m128 bx = _mm_sub_ps(gather(d.x, 2), x0);
+    const __m128 by = _mm_sub_ps(gather(d.y, 2), y0);
+    const __m128 bz = _mm_sub_ps(gather(d.z, 2), z0);
+    const __m128 cx = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+    const __m128 cy = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+    const __m128 cz = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+    const __m128 l01 = _mm_sqrt_ps(Dot3(ax, ay, az, ax, ay, az));
+    const __m128 cross = _mm_sqrt_ps(Dot3(cx, cy, cz, cx, cy, cz));
+    const __m128 dot = Dot3(ax, ay, az, bx, by, bz);
+    _mm_storeu_ps(d.x0 + f, l01);
+    _mm_storeu_ps(d.x1 + f, _mm_sub_ps(_mm_div_ps(dot, l01), l01));
+    _mm_storeu_ps(d.y1 + f, _mm_div_ps(cross, l01));
+    _mm_storeu_ps(d.area + f, _mm_mul_ps(_mm_set1_ps(0.5f), cross));
+  }
+  FramesScalar(d, f, end);
+}
+
+GEOMETRY_LAB_TARGET_AVX2
+void FramesAVX2(const FrameData& d, size_t begin, size_t end) {
+  // Offsets of the k-th vertex of 8 consecutive faces
+  const __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+  size_t f = begin;
+  for (; f + 8 <= end; f += 8) {
+    const int* v = reinterpret_cast<const int*>(d.faces + 3 * f);
+    const __m256i v0 = _mm256_i32gather_epi32(v, stride, 4);
+    const __m256i v1 = _mm256_i32gather_epi32(v + 1, stride, 4);
+    const __m256i v2 = _mm256_i32gather_epi32(v + 2, stride, 4);
+    const __m256 x0 = _mm256_i32gather_ps(d.x, v0, 4);
+    const __m256 y0 = _mm256_i32gather_ps(d.y, v0, 4);
+    const __m256 z0 = _mm256_i32gather_ps(d.z, v0, 4);
+    const __m256 ax = _mm256_sub_ps(_mm256_i32gather_ps(d.x, v1, 4), x0);
+    const __m256 ay = _mm256_sub_ps(_mm256_i32gather_ps(d.y, v1, 4), y0);
+    const __m256 az = _mm256_sub_ps(_mm256_i32gather_ps(d.z, v1, 4), z0);
+    const __m256 bx = _mm256_sub_ps(_mm256_i32gather_ps(d.x, v2, 4), x0);
+    const __m256 by = _mm256_sub_ps(_mm256_i32gather_ps(d.y, v2, 4), y0);
+    const __m256 bz = _mm256_sub_ps(_mm256_i32gather_ps(d.z, v2, 4), z0);
+    const __m256 cx =
+        _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+    const __m256 cy =
+        _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz));
+    const __m256 cz =
+        _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx));
+    const __m256 l01 = _mm256_sqrt_ps(Dot3(ax, ay, az, ax, ay, az));
+    const __m256 cross = _mm256_sqrt_ps(Dot3(cx, cy, cz, cx, cy, cz));
+    const __m256 dot = Dot3(ax, ay, az, bx, by, bz);
+    _mm256_storeu_ps(d.x0 + f, l01);
+    _mm256_storeu_ps(d.x1 + f, _mm256_sub_ps(_mm256_div_ps(dot, l01), l01));
+    _mm256_storeu_ps(d.y1 + f, _mm256_div_ps(cross, l01));
+    _mm256_storeu_ps(d.area + f, _mm256_mul_ps(_mm256_set1_ps(0.5f), cross));
+  }
+  FramesScalar(d, f, end);
+}
+#endif
+
+}  // namespace
+
+void FaceFrames::Compute(const TriMeshSoA& mesh, SimdLevel level) {
+  GEOMETRY_LAB_TRACE_SCOPE("FaceFrames::Compute");
+  const size_t n_f = mesh.n_faces();
+  x0_.resize(n_f);
+  x1_.resize(n_f);
+  y1_.resize(n_f);
+  area_.resize(n_f);
+  const FrameData data = {
+      mesh.x_.data(), mesh.y_.data(), mesh.z_.data(), mesh.faces_.data(),
+      x0_.data(),     x1_.data(),     y1_.data(),     area_.data(),
+  };
+  const SimdLevel run = DispatchSimdLevel(level);
+  ParallelBlocks(n_f, [&](size_t, size_t begin, size_t end) {
+    switch (run) {
+#ifdef GEOMETRY_LAB_X86
+      case SimdLevel::kAVX2:
+        FramesAVX2(data, begin, end);
+        break;
+      case SimdLevel::kSSE:
+        FramesSSE(data, begin, end);
+        break;
+#endif
+      default:
+        FramesScalar(data, begin, end);
+    }
+  });
+}
+
+double FaceFrames::Deviation(TriMesh& mesh) const {
+  mesh.ComputeHalfedgeDifferenceAndFaceArea();
+  auto halfedge_diff = mesh.prop_halfedge_diff();
+  auto face_area = mesh.prop_face_area();
+  double rst = 0.0;
+  for (const auto& fh : mesh.faces()) {
+    const size_t f = fh.idx();
+    const OpenMesh::SmartHalfedgeHandle hh[3] = {
+        fh.halfedge(), fh.halfedge().next(), fh.halfedge().next().next()};
+    double length = 0.0, error = 0.0;
+    for (int k = 0; k < 3; ++k) {
+      length = std::max(length, halfedge_diff[hh[k]].norm());
+      error = std::max(error, (halfedge_diff[hh[k]] - diff(f, k)).norm());
+    }
+    if (length <= 0.0)
+      continue;
+    error /= length;
+    error = std::max(error,
+                     std::abs(face_area[fh] - area_[f]) / (length * length));
+    rst = std::max(rst, error);
+  }
+  return rst;
+}
+
+}  // namespace geometry_lab
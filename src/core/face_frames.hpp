@@ -0,0 +1,83 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_FACE_FRAMES_HPP_
+#define GEOMETRY_LAB_CORE_FACE_FRAMES_HPP_
+
+#include <Eigen/Core>
+
+#include "core/simd.hpp"
+
+namespace geometry_lab {
+
+class TriMesh;
+class TriMeshSoA;
+
+/**
+ * @brief Single-precision local 2D frames of all the faces, the
+ *  vectorized counterpart of the @c HalfedgeDiff and @c FaceArea
+ *  properties of TriMesh.
+ *
+ *  Every array holds one value per face. With h0 the first halfedge
+ *  of face f, h1 = next(h0) and h2 = next(h1):
+ *   - diff(h0) = (x0_[f], 0)
+ *   - diff(h1) = (x1_[f], y1_[f])
+ *   - diff(h2) = -diff(h0) - diff(h1)
+ *   - area(f) = area_[f]
+ *  which is the same layout as @c ComputeHalfedgeDifferenceAndFaceArea().
+*/
+class FaceFrames {
+ public:
+  /**
+   * @brief Compute the frames of all the faces in parallel.
+   *
+   *  The faces are processed 8 (AVX2) or 4 (SSE) at a time with a
+   *  scalar tail. The instruction set is chosen at runtime.
+   *
+   * @param mesh[in] - Flat snapshot of the mesh.
+   * @param level[in] - The best instruction set to use, clamped by
+   *                    what the CPU supports.
+  */
+  void Compute(const TriMeshSoA& mesh, SimdLevel level = SimdLevel::kAVX2);
+  /**
+   * @brief Compare the frames with the double-precision properties of
+   *  @c TriMesh::ComputeHalfedgeDifferenceAndFaceArea(), which are
+   *  computed if they do not exist.
+   * @param mesh[in] - The mesh the frames were computed from.
+   * @return The largest error of a face, the differences are divided
+   *  by the longest edge and the area by its square. It is expected
+   *  to be below @c kTolerance.
+  */
+  double Deviation(TriMesh& mesh) const;
+
+  FaceFrames() {}
+  /// Number of faces.
+  size_t size() const { return area_.size(); }
+  /**
+   * @param f[in] - Face index
+   * @param k[in] - Halfedge of the face, 0 for the first halfedge
+   * @return Difference vector of the halfedge in the face frame.
+  */
+  Eigen::Vector2d diff(size_t f, int k) const {
+    switch (k) {
+      case 0:
+        return {x0_[f], 0.0};
+      case 1:
+        return {x1_[f], y1_[f]};
+      default:
+        return {-x0_[f] - x1_[f], -y1_[f]};
+    }
+  }
+
+  /// Expected bound of @c Deviation().
+  static constexpr double kTolerance = 1e-5;
+  /// Length of the first halfedge.
+  AlignedVector<float> x0_;
+  /// Difference vector of the second halfedge.
+  AlignedVector<float> x1_, y1_;
+  /// Face area.
+  AlignedVector<float> area_;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_FACE_FRAMES_HPP_
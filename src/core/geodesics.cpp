@@ -0,0 +1,243 @@
+#include "core/geodesics.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh.hpp"
+
+namespace geometry_lab {
+
+bool HeatGeodesics::Initialize(TriMesh& mesh) {
+  if (mesh_ == &mesh && topology_ == mesh.topology_generation() &&
+      geometry_ == mesh.geometry_generation() && factor_ == time_factor_)
+    return true;
+  GEOMETRY_LAB_TRACE_SCOPE("HeatGeodesics::Initialize");
+  const auto start = std::chrono::steady_clock::now();
+  mesh_ = nullptr;
+  const TriMeshSoA& soa = mesh.soa();
+  const size_t n_v = soa.n_vertices(), n_f = soa.n_faces();
+  if (n_f == 0) {
+    printf("Error::HeatGeodesics::The mesh has no face.\n\n");
+    return false;
+  }
+  for (size_t f = 0; f < n_f; ++f) {
+    const int32_t h = soa.face_halfedge_[f];
+    if (soa.next_[soa.next_[soa.next_[h]]] != h) {
+      printf("Error::HeatGeodesics::The mesh is not triangulated.\n\n");
+      return false;
+    }
+  }
+  // The Laplacian brings the HalfedgeDiff and FaceArea properties up
+  // to date
+  const LaplacianOperator& laplacian = mesh.ComputeLaplacian();
+  auto halfedge_diff = mesh.prop_halfedge_diff();
+  auto face_area = mesh.prop_face_area();
+  // 1. Flat per-face data for the gradients and the divergence
+  face_halfedges_.resize(3 * n_f);
+  face_vertices_.resize(3 * n_f);
+  edge_.assign(2 * soa.n_halfedges(), 0.0);
+  half_cot_.assign(soa.n_halfedges(), 0.0);
+  inv_double_area_.resize(n_f);
+  source_heat_.resize(n_v);
+  const double* mass = laplacian.M_.valuePtr();
+  ParallelFor(0, n_v, [&](size_t v) {
+    source_heat_[v] = mass[laplacian.diagonal(v)];
+  });
+  std::vector<double> edge_sum(ParallelBlockCount(n_f), 0.0);
+  ParallelBlocks(n_f, [&](size_t block, size_t b, size_t e) {
+    double sum = 0.0;
+    for (size_t f = b; f < e; ++f) {
+      int32_t* h = &face_halfedges_[3 * f];
+      h[0] = soa.face_halfedge_[f];
+      h[1] = soa.next_[h[0]];
+      h[2] = soa.next_[h[1]];
+      Eigen::Vector2d d[3];
+      for (int k = 0; k < 3; ++k) {
+        d[k] = halfedge_diff[OpenMesh::HalfedgeHandle(h[k])];
+        face_vertices_[3 * f + k] = soa.from_vertex(h[k]);
+        edge_[2 * h[k]] = d[k].x();
+        edge_[2 * h[k] + 1] = d[k].y();
+        sum += d[k].norm();
+      }
+      const double a = face_area[OpenMesh::FaceHandle(static_cast<int>(f))];
+      const double inv = a > 0.0 ? 0.5 / a : 0.0;
+      inv_double_area_[f] = inv;
+      // Same cotangents as the Laplacian
+      for (int k = 0; k < 3; ++k)
+        half_cot_[h[k]] = -0.5 * d[(k + 1) % 3].dot(d[(k + 2) % 3]) * inv;
+    }
+    edge_sum[block] = sum;
+  });
+  // Every interior edge is counted twice, close enough for a time
+  // step
+  double mean_edge = 0.0;
+  for (const double s : edge_sum)
+    mean_edge += s;
+  mean_edge /= static_cast<double>(3 * n_f);
+  time_ = time_factor_ * mean_edge * mean_edge;
+  // 2. Connected components, one vertex of each is pinned in the
+  //    Poisson equation
+  component_.assign(n_v, -1);
+  pinned_.clear();
+  std::vector<int32_t> stack;
+  for (size_t s = 0; s < n_v; ++s) {
+    if (component_[s] >= 0)
+      continue;
+    const int32_t c = static_cast<int32_t>(pinned_.size());
+    component_[s] = c;
+    pinned_.push_back(static_cast<int32_t>(s));
+    stack.push_back(static_cast<int32_t>(s));
+    while (!stack.empty()) {
+      const int32_t v = stack.back();
+      stack.pop_back();
+      const int32_t h0 = soa.vertex_halfedge_[v];
+      if (h0 < 0)
+        continue;
+      int32_t h = h0;
+      do {
+        const int32_t t = soa.to_vertex_[h];
+        if (component_[t] < 0) {
+          component_[t] = c;
+          stack.push_back(t);
+        }
+        h = soa.next_[TriMeshSoA::opposite(h)];
+      } while (h != h0);
+    }
+  }
+  // 3. Both matrices only depend on the mesh
+  if (!heat_solver_.Factorize(laplacian, 1.0, time_) ||
+      !poisson_solver_.Factorize(laplacian, 0.0, 1.0, pinned_))
+    return false;
+  report_.setup_ms = MillisecondsSince(start);
+  mesh_ = &mesh;
+  topology_ = mesh.topology_generation();
+  geometry_ = mesh.geometry_generation();
+  factor_ = time_factor_;
+  return true;
+}
+
+bool HeatGeodesics::Compute(
+    TriMesh& mesh, const std::vector<std::vector<int32_t>>& sources) {
+  GEOMETRY_LAB_TRACE_SCOPE("HeatGeodesics::Compute");
+  if (!Initialize(mesh))
+    return false;
+  const TriMeshSoA& soa = mesh.soa();
+  const size_t n_v = soa.n_vertices(), n_f = soa.n_faces();
+  const Eigen::Index n_c = static_cast<Eigen::Index>(sources.size());
+  for (const auto& column : sources) {
+    for (const int32_t v : column) {
+      if (v < 0 || static_cast<size_t>(v) >= n_v) {
+        printf("Error::HeatGeodesics::Source vertex %d out of range.\n\n", v);
+        return false;
+      }
+    }
+  }
+  report_.columns = sources.size();
+  // 1. Heat flow, (M + t L) u = M delta. Only the direction of the
+  //    gradient is used, so each column is scaled to a largest source
+  //    of 1 before the solve and to a largest heat of 1 after it,
+  //    whatever the size of the mesh
+  auto start = std::chrono::steady_clock::now();
+  divergence_.setZero(n_v, n_c);
+  for (Eigen::Index c = 0; c < n_c; ++c) {
+    double largest = 0.0;
+    for (const int32_t v : sources[c])
+      largest = std::max(largest, source_heat_[v]);
+    for (const int32_t v : sources[c])
+      divergence_(v, c) = largest > 0.0 ? source_heat_[v] / largest : 1.0;
+  }
+  if (!heat_solver_.Solve(divergence_, heat_))
+    return false;
+  ParallelFor(0, static_cast<size_t>(n_c), [&](size_t c) {
+    const double largest = heat_.col(c).cwiseAbs().maxCoeff();
+    if (largest > 0.0)
+      heat_.col(c) /= largest;
+  }, 1);
+  report_.heat_ms = MillisecondsSince(start);
+  // 2. Normalized gradient of the faces, grad u = sum_k u_k J e_k /
+  //    (2 A) with e_k the edge opposite to vertex k and J the rotation
+  //    by 90 degrees
+  start = std::chrono::steady_clock::now();
+  field_.resize(n_f, 2 * n_c);
+  ParallelFor(0, n_f, [&](size_t f) {
+    const int32_t* h = &face_halfedges_[3 * f];
+    const int32_t* v = &face_vertices_[3 * f];
+    const double inv = inv_double_area_[f];
+    for (Eigen::Index c = 0; c < n_c; ++c) {
+      double gx = 0.0, gy = 0.0;
+      for (int k = 0; k < 3; ++k) {
+        const int32_t o = h[(k + 1) % 3];
+        const double u = heat_(v[k], c);
+        gx -= u * edge_[2 * o + 1];
+        gy += u * edge_[2 * o];
+      }
+      // Scaled before squaring, the heat is tiny far from the sources
+      const double scale = std::max(std::abs(gx), std::abs(gy));
+      if (scale == 0.0 || inv == 0.0) {
+        field_(f, 2 * c) = field_(f, 2 * c + 1) = 0.0;
+        continue;
+      }
+      gx /= scale;
+      gy /= scale;
+      const double s = -1.0 / std::sqrt(gx * gx + gy * gy);
+      field_(f, 2 * c) = s * gx;
+      field_(f, 2 * c + 1) = s * gy;
+    }
+  });
+  // Integrated divergence, every halfedge h of a face gives
+  // w = cot(h) / 2 <e(h), X> to its from-vertex and -w to its
+  // to-vertex, gathered over the outgoing halfedges of each vertex so
+  // every row is written by one thread. The sign is flipped for the
+  // positive semi-definite L.
+  auto flux = [&](int32_t h, Eigen::Index c) {
+    const int32_t f = soa.face_[h];
+    if (f < 0)
+      return 0.0;
+    return half_cot_[h] * (edge_[2 * h] * field_(f, 2 * c) +
+                           edge_[2 * h + 1] * field_(f, 2 * c + 1));
+  };
+  ParallelFor(0, n_v, [&](size_t v) {
+    const int32_t h0 = soa.vertex_halfedge_[v];
+    for (Eigen::Index c = 0; c < n_c; ++c) {
+      double div = 0.0;
+      if (h0 >= 0) {
+        int32_t h = h0;
+        do {
+          const int32_t o = TriMeshSoA::opposite(h);
+          div += flux(h, c) - flux(o, c);
+          h = soa.next_[o];
+        } while (h != h0);
+      }
+      divergence_(v, c) = -div;
+    }
+  });
+  report_.field_ms = MillisecondsSince(start);
+  // 3. Poisson equation L phi = -div X, then shift every component
+  //    so that its closest source is at 0
+  start = std::chrono::steady_clock::now();
+  distance_.setZero(n_v, n_c);
+  if (!poisson_solver_.Solve(divergence_, distance_))
+    return false;
+  constexpr double kInfinity = std::numeric_limits<double>::infinity();
+  const size_t n_components = pinned_.size();
+  ParallelFor(0, static_cast<size_t>(n_c), [&](size_t c) {
+    std::vector<double> shift(n_components, kInfinity);
+    for (const int32_t v : sources[c]) {
+      double& s = shift[component_[v]];
+      s = std::min(s, distance_(v, c));
+    }
+    for (size_t v = 0; v < n_v; ++v) {
+      const double s = shift[component_[v]];
+      distance_(v, c) = s < kInfinity ? distance_(v, c) - s : kInfinity;
+    }
+  }, 1);
+  report_.poisson_ms = MillisecondsSince(start);
+  return true;
+}
+
+}  // namespace geometry_lab
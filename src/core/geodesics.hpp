@@ -0,0 +1,130 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_GEODESICS_HPP_
+#define GEOMETRY_LAB_CORE_GEODESICS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "core/laplacian.hpp"
+
+namespace geometry_lab {
+
+class TriMesh;
+
+/**
+ * @brief Geodesic distances to sets of source vertices by the heat
+ *  method (Crane, Weischedel and Wardetzky).
+ *
+ *  The heat of the sources is diffused for a short time t,
+ *  (M + t L) u = M delta, the normalized gradient
+ *  X = -grad u / |grad u| of each face is kept and the distance is
+ *  recovered from its divergence by the Poisson equation
+ *  L phi = -div X, with the lumped mass M and the cotangent Laplacian
+ *  L of @c TriMesh::ComputeLaplacian().
+ *
+ *  Both matrices only depend on the mesh, they are factorized once in
+ *  @c Initialize() so a new set of sources only costs two
+ *  back-substitutions and two parallel passes over the faces and the
+ *  vertices. Several sets of sources are solved in one batch, one
+ *  column each, and the columns are back-substituted in parallel.
+*/
+class HeatGeodesics {
+ public:
+  /**
+   * @brief Timings of the last @c Initialize() and @c Compute().
+  */
+  struct Report {
+    /// Factorizations in milliseconds.
+    double setup_ms = 0.0;
+    /// Heat flow, gradient field and divergence, Poisson equation of
+    /// the last batch in milliseconds.
+    double heat_ms = 0.0, field_ms = 0.0, poisson_ms = 0.0;
+    /// Number of sets of sources in the last batch.
+    size_t columns = 0;
+  };
+  /**
+   * @brief Prepare the per-face data and factorize both systems, only
+   *  done again when the mesh, its connectivity, its positions or
+   *  @c time_factor_ changed.
+   * @param mesh[in] - The triangle mesh.
+   * @return Success?
+  */
+  bool Initialize(TriMesh& mesh);
+  /**
+   * @brief Distances to several sets of sources in one batch, the
+   *  result is in @c distance_.
+   * @param mesh[in] - The triangle mesh, see @c Initialize().
+   * @param sources[in] - Source vertices of each column.
+   * @return Success?
+  */
+  bool Compute(TriMesh& mesh,
+               const std::vector<std::vector<int32_t>>& sources);
+  /**
+   * @brief Distances to one set of sources, the result is the first
+   *  column of @c distance_.
+   * @param mesh[in] - The triangle mesh, see @c Initialize().
+   * @param sources[in] - Source vertices.
+   * @return Success?
+  */
+  bool Compute(TriMesh& mesh, const std::vector<int32_t>& sources) {
+    return Compute(mesh, std::vector<std::vector<int32_t>>{sources});
+  }
+
+  HeatGeodesics() {}
+  /// Diffusion time used by the factorization.
+  double time() const { return time_; }
+
+  /// Distance of each vertex (row) to each set of sources (column),
+  /// 0 at the closest source and infinity on the connected components
+  /// without a source.
+  Eigen::MatrixXd distance_;
+  /// Diffusion time in units of the squared mean edge length, larger
+  /// values give smoother distances. The heat decays by about
+  /// exp(-1 / sqrt(time_factor_)) per edge and underflows some
+  /// 700 * sqrt(time_factor_) edges away from the sources, where the
+  /// distances are lost.
+  double time_factor_ = 1.0;
+  /// Timings of the last @c Initialize() and @c Compute().
+  Report report_;
+
+ private:
+  /// Halfedges of each face, the k-th of face f at 3 * f + k.
+  std::vector<int32_t> face_halfedges_;
+  /// Vertices of each face, from-vertex of the halfedges above.
+  std::vector<int32_t> face_vertices_;
+  /// 2D edge vector of each halfedge in the frame of its face, see
+  /// the @c HalfedgeDiff property, (x, y) at 2 * h.
+  std::vector<double> edge_;
+  /// Half the cotangent of the angle opposite each halfedge, 0 on the
+  /// boundary.
+  std::vector<double> half_cot_;
+  /// 1 / (2 * area) of each face, 0 for degenerate faces.
+  std::vector<double> inv_double_area_;
+  /// Right-hand side of the heat flow at a source vertex.
+  std::vector<double> source_heat_;
+  /// Connected component of each vertex, and one vertex of each
+  /// component pinned to 0 in the Poisson equation.
+  std::vector<int32_t> component_;
+  std::vector<int32_t> pinned_;
+  /// Heat of each vertex, and the right-hand sides of the heat flow
+  /// then of the Poisson equation.
+  Eigen::MatrixXd heat_, divergence_;
+  /// Normalized gradient of each face, (x, y) of column c at
+  /// (f, 2 * c) and (f, 2 * c + 1).
+  Eigen::MatrixXd field_;
+  /// Factorizations of M + t L and of L with the pinned vertices.
+  LaplacianSolver heat_solver_, poisson_solver_;
+  double time_ = 0.0;
+  /// Mesh and time factor the solvers were initialized for.
+  TriMesh* mesh_ = nullptr;
+  uint64_t topology_ = UINT64_MAX, geometry_ = UINT64_MAX;
+  double factor_ = 0.0;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_GEODESICS_HPP_
@@ -0,0 +1,224 @@
+#include "core/laplacian.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <cstdio>
+#include <utility>
+
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh.hpp"
+
+namespace geometry_lab {
+
+void LaplacianOperator::BuildPattern(const TriMeshSoA& mesh) {
+  GEOMETRY_LAB_TRACE_SCOPE("LaplacianOperator::BuildPattern");
+  static std::atomic<uint64_t> n_patterns{0};
+  const size_t n_v = mesh.n_vertices();
+  slot_.assign(mesh.n_halfedges(), -1);
+  diagonal_.resize(n_v);
+  L_.resize(n_v, n_v);
+  // 1. Column v holds v and its neighbors
+  int* outer = L_.outerIndexPtr();
+  outer[0] = 0;
+  ParallelFor(0, n_v, [&](size_t v) {
+    int count = 1;
+    const int32_t h0 = mesh.vertex_halfedge_[v];
+    if (h0 >= 0) {
+      int32_t h = h0;
+      do {
+        ++count;
+        h = mesh.next_[TriMeshSoA::opposite(h)];
+      } while (h != h0);
+    }
+    outer[v + 1] = count;
+  });
+  for (size_t v = 0; v < n_v; ++v)
+    outer[v + 1] += outer[v];
+  L_.resizeNonZeros(outer[n_v]);
+  // 2. Sorted rows of each column, the outgoing halfedges of v give
+  //    the entries (to(h), v)
+  int* inner = L_.innerIndexPtr();
+  ParallelBlocks(n_v, [&](size_t, size_t b, size_t e) {
+    std::vector<std::pair<int32_t, int32_t>> column;
+    for (size_t v = b; v < e; ++v) {
+      column.clear();
+      column.emplace_back(static_cast<int32_t>(v), -1);
+      const int32_t h0 = mesh.vertex_halfedge_[v];
+      if (h0 >= 0) {
+        int32_t h = h0;
+        do {
+          column.emplace_back(mesh.to_vertex_[h], h);
+          h = mesh.next_[TriMeshSoA::opposite(h)];
+        } while (h != h0);
+      }
+      std::sort(column.begin(), column.end());
+      for (size_t k = 0; k < column.size(); ++k) {
+        const int32_t p = outer[v] + static_cast<int32_t>(k);
+        inner[p] = column[k].first;
+        if (column[k].second < 0)
+          diagonal_[v] = p;
+        else
+          slot_[column[k].second] = p;
+      }
+    }
+  });
+  std::fill(L_.valuePtr(), L_.valuePtr() + L_.nonZeros(), 0.0);
+  M_ = L_;
+  pattern_version_ = ++n_patterns;
+}
+
+void LaplacianOperator::Assemble(TriMesh& mesh, Mass mass) {
+  GEOMETRY_LAB_TRACE_SCOPE("LaplacianOperator::Assemble");
+  const TriMeshSoA& soa = mesh.soa();
+  const size_t n_v = soa.n_vertices();
+  const size_t n_f = soa.n_faces();
+  assert(size() == n_v && slot_.size() == soa.n_halfedges());
+  mass_ = mass;
+  auto halfedge_diff = mesh.prop_halfedge_diff();
+  auto face_area = mesh.prop_face_area();
+  // 1. Cotangents of the faces, the boundary halfedges have none
+  cot_.resize(soa.n_halfedges());
+  area_.resize(n_f);
+  ParallelFor(0, cot_.size(), [&](size_t h) {
+    if (soa.face_[h] < 0)
+      cot_[h] = 0.0;
+  });
+  ParallelFor(0, n_f, [&](size_t f) {
+    const int32_t h0 = soa.face_halfedge_[f];
+    const int32_t h1 = soa.next_[h0];
+    const int32_t h2 = soa.next_[h1];
+    const Eigen::Vector2d& d0 = halfedge_diff[OpenMesh::HalfedgeHandle(h0)];
+    const Eigen::Vector2d& d1 = halfedge_diff[OpenMesh::HalfedgeHandle(h1)];
+    const Eigen::Vector2d& d2 = halfedge_diff[OpenMesh::HalfedgeHandle(h2)];
+    const double a = face_area[OpenMesh::FaceHandle(static_cast<int>(f))];
+    area_[f] = a;
+    // The angle opposite a halfedge is between the two others, the
+    // norm of their cross product is twice the area
+    const double inv = a > 0.0 ? 0.5 / a : 0.0;
+    cot_[h0] = -d1.dot(d2) * inv;
+    cot_[h1] = -d2.dot(d0) * inv;
+    cot_[h2] = -d0.dot(d1) * inv;
+  });
+  // 2. Gather the columns, each one is written by a single thread
+  const int* outer = L_.outerIndexPtr();
+  double* l = L_.valuePtr();
+  double* m = M_.valuePtr();
+  ParallelFor(0, n_v, [&](size_t v) {
+    std::fill(l + outer[v], l + outer[v + 1], 0.0);
+    std::fill(m + outer[v], m + outer[v + 1], 0.0);
+    double l_vv = 0.0, area = 0.0;
+    const int32_t h0 = soa.vertex_halfedge_[v];
+    if (h0 >= 0) {
+      int32_t h = h0;
+      do {
+        const int32_t o = TriMeshSoA::opposite(h);
+        const double w = 0.5 * (cot_[h] + cot_[o]);
+        l[slot_[h]] = -w;
+        l_vv += w;
+        const double a = soa.face_[h] >= 0 ? area_[soa.face_[h]] : 0.0;
+        const double b = soa.face_[o] >= 0 ? area_[soa.face_[o]] : 0.0;
+        if (mass == Mass::kFull)
+          m[slot_[h]] = (a + b) / 12.0;
+        area += a;
+        h = soa.next_[o];
+      } while (h != h0);
+    }
+    l[diagonal_[v]] = l_vv;
+    m[diagonal_[v]] = area / (mass == Mass::kFull ? 6.0 : 3.0);
+  });
+}
+
+bool LaplacianSolver::Factorize(const LaplacianOperator& op, double a,
+                                double b, const std::vector<int32_t>& fixed) {
+  GEOMETRY_LAB_TRACE_SCOPE("LaplacianSolver::Factorize");
+  const size_t n = op.size();
+  factorized_ = false;
+  if (n == 0)
+    return false;
+  fixed_ = fixed;
+  is_fixed_.assign(n, 0);
+  for (const int32_t v : fixed_) {
+    if (v < 0 || static_cast<size_t>(v) >= n) {
+      printf("Error::LaplacianSolver::Fixed vertex %d out of range.\n\n", v);
+      return false;
+    }
+    is_fixed_[v] = 1;
+  }
+  // Copy the pattern only when it changed
+  const bool analyze = pattern_version_ != op.pattern_version();
+  if (analyze)
+    A_ = op.L_;
+  values_.resize(A_.nonZeros());
+  const int* outer = A_.outerIndexPtr();
+  const int* inner = A_.innerIndexPtr();
+  const double* l = op.L_.valuePtr();
+  const double* m = op.M_.valuePtr();
+  double* values = A_.valuePtr();
+  ParallelFor(0, n, [&](size_t j) {
+    for (int p = outer[j]; p < outer[j + 1]; ++p) {
+      const size_t i = inner[p];
+      values_[p] = a * m[p] + b * l[p];
+      if (is_fixed_[i] || is_fixed_[j])
+        values[p] = i == j ? 1.0 : 0.0;
+      else if (outer[j + 1] - outer[j] == 1 && values_[p] == 0.0)
+        values[p] = 1.0;  // Isolated vertex, its row is empty
+      else
+        values[p] = values_[p];
+    }
+  });
+  if (analyze) {
+    ldlt_.analyzePattern(A_);
+    pattern_version_ = op.pattern_version();
+    ++n_analyses_;
+  }
+  ldlt_.factorize(A_);
+  if (ldlt_.info() != Eigen::Success) {
+    printf("Error::LaplacianSolver::Failed to factorize the matrix.\n\n");
+    return false;
+  }
+  factorized_ = true;
+  return true;
+}
+
+bool LaplacianSolver::Solve(const Eigen::MatrixXd& rhs,
+                            Eigen::MatrixXd& x) const {
+  GEOMETRY_LAB_TRACE_SCOPE("LaplacianSolver::Solve");
+  const Eigen::Index n = A_.rows();
+  if (!factorized_ || rhs.rows() != n) {
+    printf("Error::LaplacianSolver::No factorization for the system.\n\n");
+    return false;
+  }
+  if (x.rows() != n || x.cols() != rhs.cols()) {
+    if (!fixed_.empty()) {
+      printf("Error::LaplacianSolver::Missing the fixed values.\n\n");
+      return false;
+    }
+    x.setZero(n, rhs.cols());
+  }
+  // Move the known values to the right-hand side, the matrix is
+  // symmetric so column f holds row f
+  Eigen::MatrixXd b = rhs;
+  const int* outer = A_.outerIndexPtr();
+  const int* inner = A_.innerIndexPtr();
+  for (const int32_t f : fixed_) {
+    for (int p = outer[f]; p < outer[f + 1]; ++p) {
+      if (!is_fixed_[inner[p]])
+        b.row(inner[p]) -= values_[p] * x.row(f);
+    }
+  }
+  for (const int32_t f : fixed_)
+    b.row(f) = x.row(f);
+  // The back-substitutions of the columns are independent
+  if (b.cols() == 1) {
+    x = ldlt_.solve(b);
+  } else {
+    ParallelFor(0, static_cast<size_t>(b.cols()), [&](size_t c) {
+      x.col(c) = ldlt_.solve(b.col(c));
+    }, 1);
+  }
+  return ldlt_.info() == Eigen::Success;
+}
+
+}  // namespace geometry_lab
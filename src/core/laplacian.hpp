@@ -0,0 +1,151 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_LAPLACIAN_HPP_
+#define GEOMETRY_LAB_CORE_LAPLACIAN_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/SparseCholesky>
+#include <Eigen/SparseCore>
+
+namespace geometry_lab {
+
+class TriMesh;
+class TriMeshSoA;
+
+/**
+ * @brief Cotangent Laplacian and mass matrices of a triangle mesh.
+ *
+ *  Both matrices share one symmetric sparsity pattern, the vertex
+ *  adjacency plus the diagonal, so any combination a * M + b * L can
+ *  be formed on the value arrays and factorized without a new
+ *  symbolic analysis. L is the positive semi-definite stiffness
+ *  matrix: L(i,j) = -(cot(alpha_ij) + cot(beta_ij)) / 2 for an edge
+ *  (i,j) and L(i,i) = -sum_j L(i,j).
+ *
+ *  The pattern only depends on the connectivity, @c TriMesh keeps it
+ *  (see @c TriMesh::ComputeLaplacian()) and only refills the values
+ *  when the positions change.
+*/
+class LaplacianOperator {
+ public:
+  /**
+   * @brief Kind of mass matrix.
+  */
+  enum class Mass {
+    /// Diagonal, a third of the adjacent face areas.
+    kLumped = 0,
+    /// Linear finite elements, area / 6 on the diagonal and area / 12
+    /// on the edges of each face.
+    kFull
+  };
+  /**
+   * @brief Build the sparsity pattern from the connectivity, the
+   *  columns are filled in parallel.
+   * @param mesh[in] - Flat snapshot of the mesh.
+  */
+  void BuildPattern(const TriMeshSoA& mesh);
+  /**
+   * @brief Fill the values of L and M, straight into the compressed
+   *  storage of the pattern.
+   *
+   *  The cotangents are computed in parallel over the faces from the
+   *  @c HalfedgeDiff and @c FaceArea properties, then every column is
+   *  gathered by one thread, so there is no triplet list and no
+   *  atomics.
+   *
+   * @param mesh[in] - The mesh, its properties @c HalfedgeDiff and
+   *                   @c FaceArea must be up to date.
+   * @param mass[in] - Kind of mass matrix.
+  */
+  void Assemble(TriMesh& mesh, Mass mass);
+
+  LaplacianOperator() {}
+  /// Number of rows and columns.
+  size_t size() const { return diagonal_.size(); }
+  /// Kind of mass matrix of the last @c Assemble().
+  Mass mass() const { return mass_; }
+  /// Unique number of the pattern, changed by every @c BuildPattern()
+  /// of any operator, see @c LaplacianSolver.
+  uint64_t pattern_version() const { return pattern_version_; }
+  /// Index of the diagonal entry of a column in the value arrays.
+  int32_t diagonal(size_t v) const { return diagonal_[v]; }
+
+  /// Cotangent Laplacian, column-major with a symmetric pattern.
+  Eigen::SparseMatrix<double> L_;
+  /// Mass matrix, same pattern as @c L_.
+  Eigen::SparseMatrix<double> M_;
+
+ private:
+  /// Entry (to(h), from(h)) of halfedge h in the value arrays.
+  std::vector<int32_t> slot_;
+  /// Entry (v, v) in the value arrays.
+  std::vector<int32_t> diagonal_;
+  /// Cotangent of the angle opposite each halfedge, 0 on the
+  /// boundary.
+  std::vector<double> cot_;
+  /// Area of each face.
+  std::vector<double> area_;
+  Mass mass_ = Mass::kLumped;
+  uint64_t pattern_version_ = 0;
+};
+
+/**
+ * @brief Sparse LDLT factorization of a * M + b * L with Dirichlet
+ *  conditions, the symbolic analysis is kept as long as the pattern
+ *  of the operator does not change.
+ *
+ *  The rows and columns of the fixed vertices are replaced by the
+ *  identity, which keeps the matrix symmetric and the pattern
+ *  unchanged. Their known values are moved to the right-hand side in
+ *  @c Solve(). An isolated vertex has an empty row, it gets a unit
+ *  diagonal so its value is its right-hand side.
+*/
+class LaplacianSolver {
+ public:
+  /**
+   * @brief Factorize a * M + b * L.
+   * @param op[in] - The operator.
+   * @param a[in] - Weight of the mass matrix.
+   * @param b[in] - Weight of the Laplacian.
+   * @param fixed[in] - Indices of the fixed vertices.
+   * @return Success? It fails when the matrix is not positive definite,
+   *  e.g. L alone without fixed vertices.
+  */
+  bool Factorize(const LaplacianOperator& op, double a, double b,
+                 const std::vector<int32_t>& fixed = {});
+  /**
+   * @brief Solve the system for several right-hand sides at once, the
+   *  columns are back-substituted in parallel.
+   * @param rhs[in] - One right-hand side per column, the rows of the
+   *                  fixed vertices are ignored.
+   * @param x[in,out] - Values of the fixed vertices in, solution out.
+   * @return Success?
+  */
+  bool Solve(const Eigen::MatrixXd& rhs, Eigen::MatrixXd& x) const;
+
+  LaplacianSolver() {}
+  /// Number of symbolic analyses since construction.
+  size_t n_analyses() const { return n_analyses_; }
+
+ private:
+  /// The system matrix with the fixed rows and columns replaced.
+  Eigen::SparseMatrix<double> A_;
+  /// Values of a * M + b * L before applying the fixed vertices.
+  std::vector<double> values_;
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldlt_;
+  /// Fixed vertices and their marks.
+  std::vector<int32_t> fixed_;
+  std::vector<uint8_t> is_fixed_;
+  /// Pattern of the last analysis.
+  uint64_t pattern_version_ = 0;
+  size_t n_analyses_ = 0;
+  bool factorized_ = false;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_LAPLACIAN_HPP_
@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_MAPPED_FILE_HPP_
+#define GEOMETRY_LAB_CORE_MAPPED_FILE_HPP_
+
+#include <cstddef>
+#include <string>
+
+namespace geometry_lab {
+
+/**
+ * @brief Read-only memory mapping of a whole file, the pages are
+ *  loaded by the OS on demand and released when closing.
+*/
+class MappedFile {
+ public:
+  /**
+   * @brief Map the file into memory.
+   * @param path[in] - File path
+   * @retval FALSE - when the file cannot be opened or is empty
+   * @retval TRUE - when the file is mapped successfully
+  */
+  bool Open(const std::string& path);
+  /**
+   * @brief Unmap the file, does nothing if no file is mapped.
+  */
+  void Close();
+
+  MappedFile() {}
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() { Close(); }
+  /// First byte of the file.
+  const char* data() const { return data_; }
+  /// Number of bytes in the file.
+  size_t size() const { return size_; }
+  /// Is there a mapped file?
+  bool is_open() const { return data_ != nullptr; }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#endif
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_MAPPED_FILE_HPP_
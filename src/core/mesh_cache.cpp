@@ -0,0 +1,313 @@
+#include "core/mesh_cache.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "core/mapped_file.hpp"
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh.hpp"
+
+namespace geometry_lab {
+
+namespace {
+
+constexpr char kMagic[8] = {'G', 'L', 'M', 'E', 'S', 'H', '\0', '\0'};
+constexpr uint32_t kEndian = 0x01020304;
+
+uint64_t AlignUp(uint64_t offset) {
+  return (offset + MeshCache::kAlignment - 1) / MeshCache::kAlignment *
+         MeshCache::kAlignment;
+}
+bool SourceStamp(const std::string& source, uint64_t& size, int64_t& time) {
+  std::error_code ec;
+  size = std::filesystem::file_size(source, ec);
+  if (ec)
+    return false;
+  auto t = std::filesystem::last_write_time(source, ec);
+  if (ec)
+    return false;
+  time = static_cast<int64_t>(t.time_since_epoch().count());
+  return true;
+}
+bool ReadHeader(const char* data, size_t size, MeshCache::Header& header) {
+  if (size < sizeof(MeshCache::Header))
+    return false;
+  memcpy(&header, data, sizeof(MeshCache::Header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != MeshCache::kVersion || header.endian != kEndian)
+    return false;
+  for (const auto& section : header.sections) {
+    if (section.size > 0 && (section.offset % MeshCache::kAlignment != 0 ||
+                             section.offset + section.size > size))
+      return false;
+  }
+  return true;
+}
+void ParallelCopy(void* dst, const void* src, size_t bytes) {
+  ParallelBlocks(
+      bytes,
+      [&](size_t, size_t b, size_t e) {
+        memcpy(static_cast<char*>(dst) + b, static_cast<const char*>(src) + b,
+               e - b);
+      },
+      size_t(1) << 22);
+}
+
+}  // namespace
+
+bool MeshCache::Write(const TriMesh& mesh, const std::string& path,
+                      const std::string& source) {
+  GEOMETRY_LAB_TRACE_SCOPE("MeshCache::Write");
+  static_assert(sizeof(TriMesh::Point) == 3 * sizeof(float),
+                "Positions are stored as float[3]");
+  static_assert(sizeof(TriMesh::Normal) == 3 * sizeof(float),
+                "Normals are stored as float[3]");
+  static_assert(sizeof(Eigen::Vector2d) == 2 * sizeof(double),
+                "Halfedge differences are stored as double[2]");
+  const size_t n_v = mesh.n_vertices();
+  const size_t n_h = mesh.n_halfedges();
+  const size_t n_f = mesh.n_faces();
+  if (n_v == 0 || !mesh.has_vertex_normals())
+    return false;
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.endian = kEndian;
+  header.n_vertices = n_v;
+  header.n_edges = mesh.n_edges();
+  header.n_faces = n_f;
+  if (!source.empty() &&
+      !SourceStamp(source, header.source_size, header.source_time)) {
+    header.source_size = 0;
+    header.source_time = 0;
+  }
+  header.normalized_scale = mesh.normalized_scale_;
+  for (int k = 0; k < 3; ++k)
+    header.source_offset[k] = mesh.source_offset_[k];
+  header.source_scale = mesh.source_scale_;
+  // Normals computed by the mesh and stale since then are stored but
+  // recomputed after loading, the ones set by the user are kept
+  if (mesh.normals_stamp_.topology != mesh.topology_generation_ ||
+      mesh.is_current(mesh.normals_stamp_))
+    header.flags |= kCurrentNormals;
+  // 1. Flatten the connectivity
+  std::vector<int32_t> he_vertex(n_h), he_next(n_h), he_face(n_h);
+  std::vector<int32_t> v_he(n_v), f_he(n_f);
+  ParallelFor(0, n_h, [&](size_t i) {
+    const OpenMesh::HalfedgeHandle hh(static_cast<int>(i));
+    he_vertex[i] = mesh.to_vertex_handle(hh).idx();
+    he_next[i] = mesh.next_halfedge_handle(hh).idx();
+    he_face[i] = mesh.face_handle(hh).idx();
+  });
+  ParallelFor(0, n_v, [&](size_t i) {
+    v_he[i] =
+        mesh.halfedge_handle(OpenMesh::VertexHandle(static_cast<int>(i))).idx();
+  });
+  ParallelFor(0, n_f, [&](size_t i) {
+    f_he[i] = mesh.halfedge_handle(OpenMesh::FaceHandle(int(i))).idx();
+  });
+  // 2. Optional properties, written straight from the mesh when they
+  //    are up to date
+  const void* halfedge_diff = nullptr;
+  const void* face_area = nullptr;
+  OpenMesh::HPropHandleT<Eigen::Vector2d> diff_handle;
+  OpenMesh::FPropHandleT<double> area_handle;
+  if (mesh.is_current(mesh.halfedge_diff_stamp_) &&
+      mesh.get_property_handle(diff_handle,
+                               TriMesh::kPropHalfedgeDiff.data()) &&
+      mesh.get_property_handle(area_handle, TriMesh::kPropFaceArea.data())) {
+    halfedge_diff = mesh.property(diff_handle).data_vector().data();
+    face_area = mesh.property(area_handle).data_vector().data();
+  }
+  // 3. Lay out the sections
+  const void* data[kSectionCount] = {
+      mesh.points(),   mesh.vertex_normals(), he_vertex.data(),
+      he_next.data(),  he_face.data(),        v_he.data(),
+      f_he.data(),     halfedge_diff,         face_area,
+  };
+  const uint64_t sizes[kSectionCount] = {
+      n_v * sizeof(TriMesh::Point),
+      n_v * sizeof(TriMesh::Normal),
+      n_h * sizeof(int32_t),
+      n_h * sizeof(int32_t),
+      n_h * sizeof(int32_t),
+      n_v * sizeof(int32_t),
+      n_f * sizeof(int32_t),
+      halfedge_diff ? 2 * n_h * sizeof(double) : 0,
+      face_area ? n_f * sizeof(double) : 0,
+  };
+  uint64_t offset = AlignUp(sizeof(Header));
+  for (uint32_t s = 0; s < kSectionCount; ++s) {
+    header.sections[s].offset = sizes[s] > 0 ? offset : 0;
+    header.sections[s].size = sizes[s];
+    offset = AlignUp(offset + sizes[s]);
+  }
+  // 4. Write to a temporary file and replace the old cache at last
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out)
+      return false;
+    const char zeros[kAlignment] = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t written = sizeof(header);
+    for (uint32_t s = 0; s < kSectionCount; ++s) {
+      if (sizes[s] == 0)
+        continue;
+      out.write(zeros, header.sections[s].offset - written);
+      out.write(static_cast<const char*>(data[s]), sizes[s]);
+      written = header.sections[s].offset + sizes[s];
+    }
+    if (!out.good())
+      return false;
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, path, ec);
+  return !ec;
+}
+
+bool MeshCache::Read(const std::string& path, TriMesh& mesh) {
+  GEOMETRY_LAB_TRACE_SCOPE("MeshCache::Read");
+  MappedFile file;
+  Header header;
+  if (!file.Open(path) || !ReadHeader(file.data(), file.size(), header))
+    return false;
+  const size_t n_v = header.n_vertices;
+  const size_t n_e = header.n_edges;
+  const size_t n_h = 2 * n_e;
+  const size_t n_f = header.n_faces;
+  // Check the section sizes, the optional sections may be empty
+  auto expect = [&](Section s, uint64_t size, bool optional) {
+    const uint64_t actual = header.sections[s].size;
+    return actual == size || (optional && actual == 0);
+  };
+  if (n_v == 0 || n_h >= static_cast<size_t>(INT32_MAX) ||
+      !expect(kPositions, n_v * sizeof(TriMesh::Point), false) ||
+      !expect(kNormals, n_v * sizeof(TriMesh::Normal), false) ||
+      !expect(kHalfedgeVertex, n_h * sizeof(int32_t), false) ||
+      !expect(kHalfedgeNext, n_h * sizeof(int32_t), false) ||
+      !expect(kHalfedgeFace, n_h * sizeof(int32_t), false) ||
+      !expect(kVertexHalfedge, n_v * sizeof(int32_t), false) ||
+      !expect(kFaceHalfedge, n_f * sizeof(int32_t), false) ||
+      !expect(kHalfedgeDiff, 2 * n_h * sizeof(double), true) ||
+      !expect(kFaceArea, n_f * sizeof(double), true))
+    return false;
+  auto section = [&](Section s) {
+    return file.data() + header.sections[s].offset;
+  };
+  const int32_t* he_vertex =
+      reinterpret_cast<const int32_t*>(section(kHalfedgeVertex));
+  const int32_t* he_next =
+      reinterpret_cast<const int32_t*>(section(kHalfedgeNext));
+  const int32_t* he_face =
+      reinterpret_cast<const int32_t*>(section(kHalfedgeFace));
+  const int32_t* v_he =
+      reinterpret_cast<const int32_t*>(section(kVertexHalfedge));
+  const int32_t* f_he =
+      reinterpret_cast<const int32_t*>(section(kFaceHalfedge));
+  // Reject corrupted handles before touching the mesh
+  std::atomic<bool> valid{true};
+  const int32_t iv = static_cast<int32_t>(n_v);
+  const int32_t ih = static_cast<int32_t>(n_h);
+  const int32_t iff = static_cast<int32_t>(n_f);
+  ParallelFor(0, n_h, [&](size_t i) {
+    if (he_vertex[i] < 0 || he_vertex[i] >= iv || he_next[i] < 0 ||
+        he_next[i] >= ih || he_face[i] < -1 || he_face[i] >= iff)
+      valid = false;
+  });
+  ParallelFor(0, n_v, [&](size_t i) {
+    if (v_he[i] < -1 || v_he[i] >= ih)
+      valid = false;
+  });
+  ParallelFor(0, n_f, [&](size_t i) {
+    if (f_he[i] < 0 || f_he[i] >= ih)
+      valid = false;
+  });
+  if (!valid)
+    return false;
+  // Fill the kernel
+  mesh.clear();
+  mesh.resize(n_v, n_e, n_f);
+  mesh.MarkTopologyChanged();
+  mesh.request_vertex_normals();
+  ParallelCopy(mesh.property(mesh.points_pph()).data_vector().data(),
+               section(kPositions), header.sections[kPositions].size);
+  ParallelCopy(mesh.property(mesh.vertex_normals_pph()).data_vector().data(),
+               section(kNormals), header.sections[kNormals].size);
+  ParallelFor(0, n_h, [&](size_t i) {
+    const OpenMesh::HalfedgeHandle hh(static_cast<int>(i));
+    mesh.set_vertex_handle(hh, OpenMesh::VertexHandle(he_vertex[i]));
+    mesh.set_next_halfedge_handle(hh, OpenMesh::HalfedgeHandle(he_next[i]));
+    mesh.set_face_handle(hh, OpenMesh::FaceHandle(he_face[i]));
+  });
+  ParallelFor(0, n_v, [&](size_t i) {
+    mesh.set_halfedge_handle(OpenMesh::VertexHandle(static_cast<int>(i)),
+                             OpenMesh::HalfedgeHandle(v_he[i]));
+  });
+  ParallelFor(0, n_f, [&](size_t i) {
+    mesh.set_halfedge_handle(OpenMesh::FaceHandle(static_cast<int>(i)),
+                             OpenMesh::HalfedgeHandle(f_he[i]));
+  });
+  // Optional properties, drop the stale ones left in the mesh
+  OpenMesh::HPropHandleT<Eigen::Vector2d> diff_handle;
+  if (mesh.get_property_handle(diff_handle, TriMesh::kPropHalfedgeDiff.data()))
+    mesh.remove_property(diff_handle);
+  OpenMesh::FPropHandleT<double> area_handle;
+  if (mesh.get_property_handle(area_handle, TriMesh::kPropFaceArea.data()))
+    mesh.remove_property(area_handle);
+  if (header.sections[kHalfedgeDiff].size > 0) {
+    const double* src = reinterpret_cast<const double*>(section(kHalfedgeDiff));
+    auto halfedge_diff = OpenMesh::HProp<Eigen::Vector2d>(
+        mesh, TriMesh::kPropHalfedgeDiff.data());
+    ParallelFor(0, n_h, [&](size_t i) {
+      halfedge_diff[OpenMesh::HalfedgeHandle(static_cast<int>(i))] =
+          Eigen::Vector2d(src[2 * i], src[2 * i + 1]);
+    });
+  }
+  if (header.sections[kFaceArea].size > 0) {
+    const double* src = reinterpret_cast<const double*>(section(kFaceArea));
+    auto face_area =
+        OpenMesh::FProp<double>(mesh, TriMesh::kPropFaceArea.data());
+    ParallelFor(0, n_f, [&](size_t i) {
+      face_area[OpenMesh::FaceHandle(static_cast<int>(i))] = src[i];
+    });
+  }
+  mesh.normalized_scale_ = header.normalized_scale;
+  mesh.source_offset_ = Eigen::Vector3f(header.source_offset[0],
+                                        header.source_offset[1],
+                                        header.source_offset[2]);
+  mesh.source_scale_ = header.source_scale;
+  // The stored properties match the positions, and the normals when
+  // they were current
+  if (header.flags & kCurrentNormals)
+    mesh.normals_stamp_ = mesh.stamp();
+  if (header.sections[kHalfedgeDiff].size > 0 &&
+      header.sections[kFaceArea].size > 0)
+    mesh.halfedge_diff_stamp_ = mesh.stamp();
+  return true;
+}
+
+bool MeshCache::IsFresh(const std::string& path, const std::string& source,
+                        float normalized_scale) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return false;
+  char data[sizeof(Header)];
+  in.read(data, sizeof(Header));
+  Header header;
+  std::error_code ec;
+  uint64_t size = 0;
+  int64_t time = 0;
+  return in.gcount() == sizeof(Header) &&
+         ReadHeader(data, std::filesystem::file_size(path, ec), header) &&
+         !ec && SourceStamp(source, size, time) && header.source_size != 0 &&
+         header.source_size == size && header.source_time == time &&
+         header.normalized_scale == normalized_scale;
+}
+
+}  // namespace geometry_lab
@@ -0,0 +1,123 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_MESH_CACHE_HPP_
+#define GEOMETRY_LAB_CORE_MESH_CACHE_HPP_
+
+#include <cstdint>
+#include <string>
+
+namespace geometry_lab {
+
+class TriMesh;
+
+/**
+ * @brief Versioned binary container of a TriMesh (.glmesh).
+ *
+ *  The file starts with a @c Header followed by sections aligned to
+ *  @c kAlignment bytes. Every section is a plain little-endian array
+ *  which is copied into the mesh kernel without any parsing:
+ *   - kPositions, kNormals : float[3] per vertex
+ *   - kHalfedgeVertex, kHalfedgeNext, kHalfedgeFace : int32 per halfedge
+ *   - kVertexHalfedge : int32 per vertex
+ *   - kFaceHalfedge : int32 per face
+ *   - kHalfedgeDiff : double[2] per halfedge (optional)
+ *   - kFaceArea : double per face (optional)
+ *  A section with zero size is absent. The optional properties are
+ *  only written when they are up to date.
+*/
+class MeshCache {
+ public:
+  /// Sections of the file, in the order they are written.
+  enum Section : uint32_t {
+    kPositions = 0,
+    kNormals,
+    kHalfedgeVertex,
+    kHalfedgeNext,
+    kHalfedgeFace,
+    kVertexHalfedge,
+    kFaceHalfedge,
+    kHalfedgeDiff,
+    kFaceArea,
+    kSectionCount,
+  };
+  /// Bits of @c Header::flags.
+  enum Flag : uint32_t {
+    /// The normals match the positions, otherwise they are recomputed
+    /// by the next @c TriMesh::UpdateVertexNormals().
+    kCurrentNormals = 1,
+  };
+  /// Location of a section in the file, in bytes.
+  struct SectionInfo {
+    uint64_t offset;
+    uint64_t size;
+  };
+  /// Fixed-size header at the beginning of the file.
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    /// Written as 0x01020304 to detect byte order mismatch.
+    uint32_t endian;
+    uint64_t n_vertices;
+    uint64_t n_edges;
+    uint64_t n_faces;
+    /// Size and modification time of the source file, 0 if unknown.
+    uint64_t source_size;
+    int64_t source_time;
+    /// Scale of the last normalization, 0 if the positions are raw.
+    float normalized_scale;
+    /// Bits of @c Flag.
+    uint32_t flags;
+    /// Transform back to the source frame, see
+    /// @c TriMesh::source_offset_.
+    float source_offset[3];
+    float source_scale;
+    SectionInfo sections[kSectionCount];
+  };
+
+  /**
+   * @brief Write the mesh into a cache file.
+   * @param mesh[in] - Source mesh, it must have vertex normals. It is
+   *                   not modified, stale derived data is not written.
+   * @param path[in] - Cache file path
+   * @param source[in] - The file the mesh was loaded from, used to
+   *                     check the freshness later, can be empty.
+   * @return Success?
+  */
+  static bool Write(const TriMesh& mesh, const std::string& path,
+                    const std::string& source);
+  /**
+   * @brief Map a cache file and fill the mesh with its sections.
+   * @param path[in] - Cache file path
+   * @param mesh[out] - Target mesh, cleared before filling.
+   * @return Success?
+  */
+  static bool Read(const std::string& path, TriMesh& mesh);
+  /**
+   * @brief Check whether a cache file matches its source.
+   * @param path[in] - Cache file path
+   * @param source[in] - Source file path
+   * @param normalized_scale[in] - Expected normalization scale, 0 for
+   *                               raw positions.
+   * @return Does the cache record the current size and modification
+   *  time of the source with the same normalization?
+  */
+  static bool IsFresh(const std::string& path, const std::string& source,
+                      float normalized_scale);
+  /**
+   * @return The default cache path next to the source file.
+  */
+  static std::string PathFor(const std::string& source) {
+    return source + kExtension;
+  }
+
+  /// Current version, files with other versions are rejected.
+  static constexpr uint32_t kVersion = 3;
+  /// Alignment of the sections in bytes.
+  static constexpr uint64_t kAlignment = 64;
+  /// File extension of the cache.
+  static constexpr const char* kExtension = ".glmesh";
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_MESH_CACHE_HPP_
@@ -0,0 +1,134 @@
+#include "core/normal_engine.hpp"
+
+#include <cmath>
+#include <numeric>
+
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh_soa.hpp"
+
+namespace geometry_lab {
+
+void NormalEngine::Compute(const TriMeshSoA& mesh, Weighting weighting) {
+  GEOMETRY_LAB_TRACE_SCOPE("NormalEngine::Compute");
+  const size_t n_v = mesh.n_vertices();
+  const size_t n_f = mesh.n_faces();
+  weighting_ = weighting;
+  // The buffers only grow when the mesh does
+  normals_.resize(3 * n_v);
+  face_normals_.resize(3 * n_f);
+  face_areas_.resize(n_f);
+  ParallelFor(0, n_f, [&](size_t f) { ComputeFace(mesh, f); });
+  ParallelFor(0, n_v, [&](size_t v) { GatherVertex(mesh, v); });
+}
+
+const std::vector<int32_t>& NormalEngine::Update(
+    const TriMeshSoA& mesh, const std::vector<int32_t>& vertices) {
+  GEOMETRY_LAB_TRACE_SCOPE("NormalEngine::Update");
+  const size_t n_v = mesh.n_vertices();
+  const size_t n_f = mesh.n_faces();
+  if (normals_.size() != 3 * n_v || face_areas_.size() != n_f) {
+    Compute(mesh, weighting_);
+    touched_.resize(n_v);
+    std::iota(touched_.begin(), touched_.end(), 0);
+    return touched_;
+  }
+  if (face_stamp_.size() != n_f || vertex_stamp_.size() != n_v ||
+      ++stamp_ == 0) {
+    face_stamp_.assign(n_f, 0);
+    vertex_stamp_.assign(n_v, 0);
+    stamp_ = 1;
+  }
+  // 1. Faces around the moved vertices
+  dirty_faces_.clear();
+  for (const int32_t v : vertices) {
+    const int32_t h0 = mesh.vertex_halfedge_[v];
+    if (h0 < 0)
+      continue;
+    int32_t h = h0;
+    do {
+      const int32_t f = mesh.face_[h];
+      if (f >= 0 && face_stamp_[f] != stamp_) {
+        face_stamp_[f] = stamp_;
+        dirty_faces_.push_back(f);
+      }
+      h = mesh.next_[TriMeshSoA::opposite(h)];
+    } while (h != h0);
+  }
+  // 2. Vertices of these faces, their normals depend on the faces
+  touched_.clear();
+  for (const int32_t f : dirty_faces_) {
+    for (int k = 0; k < 3; ++k) {
+      const int32_t v = mesh.faces_[3 * f + k];
+      if (vertex_stamp_[v] != stamp_) {
+        vertex_stamp_[v] = stamp_;
+        touched_.push_back(v);
+      }
+    }
+  }
+  ParallelFor(0, dirty_faces_.size(),
+              [&](size_t i) { ComputeFace(mesh, dirty_faces_[i]); });
+  ParallelFor(0, touched_.size(),
+              [&](size_t i) { GatherVertex(mesh, touched_[i]); });
+  return touched_;
+}
+
+void NormalEngine::ComputeFace(const TriMeshSoA& mesh, size_t f) {
+  const int32_t* v = &mesh.faces_[3 * f];
+  const float ax = mesh.x_[v[1]] - mesh.x_[v[0]];
+  const float ay = mesh.y_[v[1]] - mesh.y_[v[0]];
+  const float az = mesh.z_[v[1]] - mesh.z_[v[0]];
+  const float bx = mesh.x_[v[2]] - mesh.x_[v[0]];
+  const float by = mesh.y_[v[2]] - mesh.y_[v[0]];
+  const float bz = mesh.z_[v[2]] - mesh.z_[v[0]];
+  const float nx = ay * bz - az * by;
+  const float ny = az * bx - ax * bz;
+  const float nz = ax * by - ay * bx;
+  const float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+  // Degenerated faces have no normal
+  const float inv = length > 0.0f ? 1.0f / length : 0.0f;
+  face_normals_[3 * f + 0] = nx * inv;
+  face_normals_[3 * f + 1] = ny * inv;
+  face_normals_[3 * f + 2] = nz * inv;
+  face_areas_[f] = 0.5f * length;
+}
+
+void NormalEngine::GatherVertex(const TriMeshSoA& mesh, size_t v) {
+  float n[3] = {0.0f, 0.0f, 0.0f};
+  const int32_t h0 = mesh.vertex_halfedge_[v];
+  if (h0 >= 0) {
+    int32_t h = h0;
+    do {
+      const int32_t f = mesh.face_[h];
+      if (f >= 0) {
+        float weight = 1.0f;
+        if (weighting_ == Weighting::kArea) {
+          weight = face_areas_[f];
+        } else if (weighting_ == Weighting::kAngle) {
+          // The corner at v is spanned by h and the edge v->to(next(h))
+          const int32_t a = mesh.to_vertex_[h];
+          const int32_t b = mesh.to_vertex_[mesh.next_[h]];
+          const float ax = mesh.x_[a] - mesh.x_[v];
+          const float ay = mesh.y_[a] - mesh.y_[v];
+          const float az = mesh.z_[a] - mesh.z_[v];
+          const float bx = mesh.x_[b] - mesh.x_[v];
+          const float by = mesh.y_[b] - mesh.y_[v];
+          const float bz = mesh.z_[b] - mesh.z_[v];
+          const float dot = ax * bx + ay * by + az * bz;
+          weight = std::atan2(2.0f * face_areas_[f], dot);
+        }
+        n[0] += weight * face_normals_[3 * f + 0];
+        n[1] += weight * face_normals_[3 * f + 1];
+        n[2] += weight * face_normals_[3 * f + 2];
+      }
+      h = mesh.next_[TriMeshSoA::opposite(h)];
+    } while (h != h0);
+  }
+  const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+  const float inv = length > 0.0f ? 1.0f / length : 0.0f;
+  normals_[3 * v + 0] = n[0] * inv;
+  normals_[3 * v + 1] = n[1] * inv;
+  normals_[3 * v + 2] = n[2] * inv;
+}
+
+}  // namespace geometry_lab
@@ -0,0 +1,93 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_NORMAL_ENGINE_HPP_
+#define GEOMETRY_LAB_CORE_NORMAL_ENGINE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace geometry_lab {
+
+class TriMeshSoA;
+
+/**
+ * @brief Parallel vertex normals on the flat snapshot of a mesh.
+ *
+ *  The face normals are computed into a buffer that is reused between
+ *  calls, then every vertex gathers the normals of its own faces, so
+ *  no thread writes to a shared vertex and no atomics are needed.
+ *  Degenerate faces have a zero normal and area, so they add nothing
+ *  to their vertices whatever the weighting, a vertex with only such
+ *  faces gets a zero normal.
+*/
+class NormalEngine {
+ public:
+  /**
+   * @brief How the normals of the faces around a vertex are weighted.
+  */
+  enum class Weighting {
+    /// Every face counts the same, as OpenMesh update_normals().
+    kUniform = 0,
+    /// Weighted by the face area.
+    kArea,
+    /// Weighted by the corner angle at the vertex.
+    kAngle,
+  };
+  /**
+   * @brief Compute the normals of all the faces and vertices.
+   * @param mesh[in] - Flat snapshot of a triangle mesh.
+   * @param weighting[in] - Weighting of the face normals.
+  */
+  void Compute(const TriMeshSoA& mesh, Weighting weighting);
+  /**
+   * @brief Recompute only the faces around some moved vertices and
+   *  the vertices of these faces.
+   *
+   *  Falls back to @c Compute(), with the weighting of the last call,
+   *  when the mesh size differs from the last call.
+   *
+   * @param mesh[in] - Flat snapshot with the new positions.
+   * @param vertices[in] - Indices of the moved vertices.
+   * @return Indices of the vertices whose normal was recomputed,
+   *  valid until the next call.
+  */
+  const std::vector<int32_t>& Update(const TriMeshSoA& mesh,
+                                     const std::vector<int32_t>& vertices);
+
+  NormalEngine() {}
+  /// Weighting of the last @c Compute().
+  Weighting weighting() const { return weighting_; }
+  /// Normal of vertex v, (x,y,z).
+  const float* normal(size_t v) const { return &normals_[3 * v]; }
+
+  /// Unit vertex normals, (x,y,z) in a row.
+  std::vector<float> normals_;
+  /// Unit face normals, (x,y,z) in a row.
+  std::vector<float> face_normals_;
+  /// Face areas.
+  std::vector<float> face_areas_;
+
+ private:
+  /**
+   * @brief Compute the normal and area of face f.
+  */
+  void ComputeFace(const TriMeshSoA& mesh, size_t f);
+  /**
+   * @brief Sum the weighted normals of the faces around vertex v.
+  */
+  void GatherVertex(const TriMeshSoA& mesh, size_t v);
+
+  /// Weighting of the current normals.
+  Weighting weighting_ = Weighting::kUniform;
+  /// Marks of the visited faces and vertices in @c Update(), an
+  /// element is visited when it equals @c stamp_.
+  std::vector<uint32_t> face_stamp_, vertex_stamp_;
+  uint32_t stamp_ = 0;
+  /// Faces and vertices found by @c Update().
+  std::vector<int32_t> dirty_faces_, touched_;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_NORMAL_ENGINE_HPP_
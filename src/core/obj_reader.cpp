@@ -0,0 +1,176 @@
+#include "core/obj_reader.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstring>
+
+#include "core/mapped_file.hpp"
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+
+namespace geometry_lab {
+
+namespace {
+
+/// Result of parsing one line-aligned piece of the file.
+struct ObjChunk {
+  std::vector<float> positions;
+  std::vector<int> indices;
+  std::vector<int> sizes;
+  /// Places in @c indices holding negative (relative) references,
+  /// they are counted from the first vertex of the chunk.
+  std::vector<size_t> relative;
+  bool ok = true;
+};
+
+inline bool IsBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+inline const char* SkipBlank(const char* p, const char* end) {
+  while (p < end && (*p == ' ' || *p == '\t'))
+    ++p;
+  return p;
+}
+inline bool ParseFloat(const char*& p, const char* end, float& value) {
+  p = SkipBlank(p, end);
+  if (p < end && *p == '+')
+    ++p;
+  auto rst = std::from_chars(p, end, value);
+  if (rst.ec != std::errc())
+    return false;
+  p = rst.ptr;
+  return true;
+}
+void ParseChunk(const char* p, const char* end, ObjChunk& chunk) {
+  while (p < end) {
+    const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (!eol)
+      eol = end;
+    p = SkipBlank(p, eol);
+    if (eol - p > 1 && IsBlank(p[1])) {
+      if (p[0] == 'v') {
+        // v x y z [w]
+        const char* q = p + 1;
+        float x, y, z;
+        if (!ParseFloat(q, eol, x) || !ParseFloat(q, eol, y) ||
+            !ParseFloat(q, eol, z)) {
+          chunk.ok = false;
+          return;
+        }
+        chunk.positions.push_back(x);
+        chunk.positions.push_back(y);
+        chunk.positions.push_back(z);
+      } else if (p[0] == 'f') {
+        // f v0[/vt0[/vn0]] v1[/vt1[/vn1]] ...
+        const int n_local = static_cast<int>(chunk.positions.size() / 3);
+        const char* q = p + 1;
+        int size = 0;
+        while (true) {
+          q = SkipBlank(q, eol);
+          if (q >= eol || *q == '\r' || *q == '#')
+            break;
+          int id = 0;
+          auto rst = std::from_chars(q, eol, id);
+          if (rst.ec != std::errc() || id == 0) {
+            chunk.ok = false;
+            return;
+          }
+          if (id > 0) {
+            chunk.indices.push_back(id - 1);
+          } else {
+            chunk.relative.push_back(chunk.indices.size());
+            chunk.indices.push_back(n_local + id);
+          }
+          ++size;
+          // Skip the texture coordinate and normal references
+          q = rst.ptr;
+          while (q < eol && !IsBlank(*q))
+            ++q;
+        }
+        if (size < 3) {
+          chunk.ok = false;
+          return;
+        }
+        chunk.sizes.push_back(size);
+      }
+    }
+    if (eol == end)
+      break;
+    p = eol + 1;
+  }
+}
+
+}  // namespace
+
+bool ObjReader::Read(const std::string& path) {
+  GEOMETRY_LAB_TRACE_SCOPE("ObjReader::Read");
+  positions_.clear();
+  face_indices_.clear();
+  face_offsets_.clear();
+  MappedFile file;
+  if (!file.Open(path))
+    return false;
+  const char* data = file.data();
+  const size_t size = file.size();
+  n_bytes_ = size;
+  // The first character of the line containing or following i
+  auto line_start = [&](size_t i) -> size_t {
+    if (i == 0 || i >= size)
+      return std::min(i, size);
+    const void* nl = memchr(data + i - 1, '\n', size - i + 1);
+    return nl ? static_cast<const char*>(nl) - data + 1 : size;
+  };
+  // 1. Parse the chunks independently
+  constexpr size_t kGrain = size_t(1) << 20;
+  std::vector<ObjChunk> chunks(ParallelBlockCount(size, kGrain));
+  ParallelBlocks(
+      size,
+      [&](size_t c, size_t begin, size_t end) {
+        ParseChunk(data + line_start(begin), data + line_start(end),
+                   chunks[c]);
+      },
+      kGrain);
+  // 2. Locate every chunk in the merged arrays
+  const size_t n_chunks = chunks.size();
+  std::vector<size_t> v_off(n_chunks), i_off(n_chunks), f_off(n_chunks);
+  size_t n_v = 0, n_i = 0, n_f = 0;
+  for (size_t c = 0; c < n_chunks; ++c) {
+    if (!chunks[c].ok)
+      return false;
+    v_off[c] = n_v;
+    i_off[c] = n_i;
+    f_off[c] = n_f;
+    n_v += chunks[c].positions.size() / 3;
+    n_i += chunks[c].indices.size();
+    n_f += chunks[c].sizes.size();
+  }
+  if (n_v == 0 || n_f == 0 || n_i >= static_cast<size_t>(INT_MAX))
+    return false;
+  // 3. Merge, relative references become absolute here
+  positions_.resize(3 * n_v);
+  face_indices_.resize(n_i);
+  face_offsets_.resize(n_f + 1);
+  ParallelFor(
+      0, n_chunks,
+      [&](size_t c) {
+        auto& chunk = chunks[c];
+        std::copy(chunk.positions.begin(), chunk.positions.end(),
+                  positions_.begin() + 3 * v_off[c]);
+        std::copy(chunk.indices.begin(), chunk.indices.end(),
+                  face_indices_.begin() + i_off[c]);
+        for (size_t r : chunk.relative)
+          face_indices_[i_off[c] + r] += static_cast<int>(v_off[c]);
+        int offset = static_cast<int>(i_off[c]);
+        for (size_t k = 0; k < chunk.sizes.size(); ++k) {
+          face_offsets_[f_off[c] + k] = offset;
+          offset += chunk.sizes[k];
+        }
+        chunk = ObjChunk();
+      },
+      1);
+  face_offsets_[n_f] = static_cast<int>(n_i);
+  return true;
+}
+
+}  // namespace geometry_lab
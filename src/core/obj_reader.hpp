@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_OBJ_READER_HPP_
+#define GEOMETRY_LAB_CORE_OBJ_READER_HPP_
+
+#include <string>
+#include <vector>
+
+namespace geometry_lab {
+
+/**
+ * @brief Fast reader of Wavefront .obj files.
+ *
+ *  The file is memory mapped and split into line-aligned chunks
+ *  which are parsed on different threads. Only the vertex positions
+ *  ('v') and the polygons ('f') are read, other records (normals,
+ *  texture coordinates, groups, ...) are skipped.
+*/
+class ObjReader {
+ public:
+  /**
+   * @brief Parse the file into @c positions_, @c face_indices_ and
+   *  @c face_offsets_.
+   * @param path[in] - File path
+   * @retval FALSE - when the file cannot be mapped or is malformed
+   * @retval TRUE - when the file is parsed successfully
+  */
+  bool Read(const std::string& path);
+
+  ObjReader() {}
+  /// Vertex positions, (x,y,z) in a row.
+  std::vector<float> positions_;
+  /// Zero-based vertex indices of all the polygons in a row.
+  std::vector<int> face_indices_;
+  /// Polygon k uses face_indices_[face_offsets_[k], face_offsets_[k+1]).
+  std::vector<int> face_offsets_;
+  /// Size of the parsed file in bytes.
+  size_t n_bytes_ = 0;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_OBJ_READER_HPP_
@@ -0,0 +1,110 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_PARALLEL_HPP_
+#define GEOMETRY_LAB_CORE_PARALLEL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "core/trace.hpp"
+
+namespace geometry_lab {
+
+namespace internal {
+/// Storage of the worker count shared by all the parallel kernels.
+inline std::atomic<size_t>& parallel_thread_count() {
+  static std::atomic<size_t> count{
+      std::max<size_t>(1, std::thread::hardware_concurrency())};
+  return count;
+}
+}  // namespace internal
+
+/**
+ * @return Number of threads used by the parallel kernels.
+*/
+inline size_t ParallelThreadCount() {
+  return internal::parallel_thread_count();
+}
+/**
+ * @brief Set the number of threads used by the parallel kernels.
+ * @param n[in] - Number of threads, 0 means all the hardware threads.
+*/
+inline void SetParallelThreadCount(size_t n) {
+  if (n == 0)
+    n = std::max<size_t>(1, std::thread::hardware_concurrency());
+  internal::parallel_thread_count() = n;
+}
+/**
+ * @brief Number of blocks @c ParallelBlocks() would split a range
+ *  into, callers use it to allocate per-block partial results.
+ * @param n[in] - Size of the range.
+ * @param grain[in] - Minimal number of elements in a block.
+*/
+inline size_t ParallelBlockCount(size_t n, size_t grain = 4096) {
+  size_t n_blocks = (n + grain - 1) / std::max<size_t>(grain, 1);
+  return std::max<size_t>(1, std::min(ParallelThreadCount(), n_blocks));
+}
+/**
+ * @brief Split [0, n) into contiguous blocks and process them on
+ *  different threads. The calling thread takes the first block.
+ * @param n[in] - Size of the range.
+ * @param fun[in] - Called as fun(block, begin, end).
+ * @param grain[in] - Minimal number of elements in a block, small
+ *                    ranges run on the calling thread only.
+ * @return Number of blocks, same as @c ParallelBlockCount().
+*/
+template <typename F>
+size_t ParallelBlocks(size_t n, F&& fun, size_t grain = 4096) {
+  const size_t n_blocks = ParallelBlockCount(n, grain);
+  if (n_blocks == 1) {
+    if (n > 0)
+      fun(size_t(0), size_t(0), n);
+    return n_blocks;
+  }
+  std::vector<std::thread> workers;
+  workers.reserve(n_blocks - 1);
+  for (size_t b = 1; b < n_blocks; ++b) {
+    workers.emplace_back([&fun, b, n, n_blocks]() {
+      GEOMETRY_LAB_TRACE_SCOPE("ParallelBlocks::Worker");
+      fun(b, n * b / n_blocks, n * (b + 1) / n_blocks);
+    });
+  }
+  fun(size_t(0), size_t(0), n / n_blocks);
+  for (auto& w : workers)
+    w.join();
+  return n_blocks;
+}
+/**
+ * @brief Parallel loop over [begin, end).
+ * @param fun[in] - Called as fun(i) for each index.
+ * @param grain[in] - Minimal number of elements handled by a thread.
+*/
+template <typename F>
+void ParallelFor(size_t begin, size_t end, F&& fun, size_t grain = 4096) {
+  if (end <= begin)
+    return;
+  ParallelBlocks(
+      end - begin,
+      [&](size_t, size_t b, size_t e) {
+        for (size_t i = begin + b; i < begin + e; ++i)
+          fun(i);
+      },
+      grain);
+}
+/**
+ * @brief Wall time of a kernel, for the reports of the solvers.
+ * @param start[in] - Time point taken when the kernel started.
+ * @return Milliseconds elapsed since @p start.
+*/
+inline double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_PARALLEL_HPP_
@@ -0,0 +1,316 @@
+#include "core/parameterization.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+
+#include <Eigen/Geometry>
+
+#include "core/boundary_loops.hpp"
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh.hpp"
+
+namespace geometry_lab {
+
+bool HarmonicParameterization::Compute(TriMesh& mesh, Weighting weighting,
+                                       Boundary boundary) {
+  GEOMETRY_LAB_TRACE_SCOPE("HarmonicParameterization::Compute");
+  const TriMeshSoA& soa = mesh.soa();
+  const BoundaryLoops& loops = mesh.ComputeBoundaryLoops();
+  if (loops.size() == 0) {
+    printf("Error::HarmonicParameterization::The mesh has no boundary.\n\n");
+    return false;
+  }
+  const bool new_topology =
+      mesh_ != &mesh || topology_ != mesh.topology_generation();
+  if (new_topology) {
+    BuildPattern(soa, loops);
+    ldlt_analyzed_ = false;
+    lu_analyzed_ = false;
+  }
+  // The uniform weights do not depend on the positions
+  const bool new_geometry = geometry_ != mesh.geometry_generation() &&
+                            weighting != Weighting::kUniform;
+  if (new_topology || new_geometry || weighting_ != weighting) {
+    weighting_ = weighting;
+    topology_ = UINT64_MAX;
+    FillWeights(soa, weighting);
+    if (!Factorize())
+      return false;
+    mesh_ = &mesh;
+    topology_ = mesh.topology_generation();
+    geometry_ = mesh.geometry_generation();
+  }
+  // Solve u and v together
+  PlaceBoundary(soa, boundary);
+  const Eigen::MatrixXd rhs = coupling_ * pinned_uv_;
+  const Eigen::MatrixXd x = weighting_ == Weighting::kMeanValue
+                                ? Eigen::MatrixXd(lu_.solve(rhs))
+                                : Eigen::MatrixXd(ldlt_.solve(rhs));
+  const size_t n_v = soa.n_vertices();
+  uv_.resize(n_v, 2);
+  if (!mesh.has_vertex_texcoords2D())
+    mesh.request_vertex_texcoords2D();
+  ParallelFor(0, n_v, [&](size_t v) {
+    const int32_t k = index_[v];
+    if (k >= 0)
+      uv_.row(v) = x.row(k);
+    else
+      uv_.row(v) = pinned_uv_.row(-1 - k);
+    mesh.set_texcoord2D(OpenMesh::VertexHandle(static_cast<int>(v)),
+                        TriMesh::TexCoord2D(static_cast<float>(uv_(v, 0)),
+                                            static_cast<float>(uv_(v, 1))));
+  });
+  return true;
+}
+
+void HarmonicParameterization::BuildPattern(const TriMeshSoA& mesh,
+                                            const BoundaryLoops& loops) {
+  GEOMETRY_LAB_TRACE_SCOPE("HarmonicParameterization::BuildPattern");
+  const size_t n_v = mesh.n_vertices();
+  // 1. Pin the longest loop, the other holes are free
+  index_.assign(n_v, 0);
+  pinned_.clear();
+  loops.Visit(0, [&](int32_t h) { pinned_.push_back(mesh.from_vertex(h)); });
+  for (size_t k = 0; k < pinned_.size(); ++k)
+    index_[pinned_[k]] = -1 - static_cast<int32_t>(k);
+  free_.clear();
+  for (size_t v = 0; v < n_v; ++v) {
+    if (index_[v] >= 0) {
+      index_[v] = static_cast<int32_t>(free_.size());
+      free_.push_back(static_cast<int32_t>(v));
+    }
+  }
+  // 2. Entries per row, a free vertex and its free neighbors in
+  //    rows_, its pinned neighbors in coupling_
+  const size_t n_i = free_.size();
+  slot_.assign(mesh.n_halfedges(), 0);
+  diagonal_.resize(n_i);
+  rows_.resize(n_i, n_i);
+  coupling_.resize(n_i, pinned_.size());
+  int* rows_outer = rows_.outerIndexPtr();
+  int* coupling_outer = coupling_.outerIndexPtr();
+  rows_outer[0] = 0;
+  coupling_outer[0] = 0;
+  ParallelFor(0, n_i, [&](size_t i) {
+    int n_free = 1, n_pinned = 0;
+    const int32_t h0 = mesh.vertex_halfedge_[free_[i]];
+    if (h0 >= 0) {
+      int32_t h = h0;
+      do {
+        if (index_[mesh.to_vertex_[h]] >= 0)
+          ++n_free;
+        else
+          ++n_pinned;
+        h = mesh.next_[TriMeshSoA::opposite(h)];
+      } while (h != h0);
+    }
+    rows_outer[i + 1] = n_free;
+    coupling_outer[i + 1] = n_pinned;
+  });
+  for (size_t i = 0; i < n_i; ++i) {
+    rows_outer[i + 1] += rows_outer[i];
+    coupling_outer[i + 1] += coupling_outer[i];
+  }
+  rows_.resizeNonZeros(rows_outer[n_i]);
+  coupling_.resizeNonZeros(coupling_outer[n_i]);
+  // 3. Sorted columns of each row
+  int* rows_inner = rows_.innerIndexPtr();
+  int* coupling_inner = coupling_.innerIndexPtr();
+  ParallelBlocks(n_i, [&](size_t, size_t b, size_t e) {
+    std::vector<std::pair<int32_t, int32_t>> free_cols, pinned_cols;
+    for (size_t i = b; i < e; ++i) {
+      free_cols.clear();
+      pinned_cols.clear();
+      free_cols.emplace_back(static_cast<int32_t>(i), -1);
+      const int32_t h0 = mesh.vertex_halfedge_[free_[i]];
+      if (h0 >= 0) {
+        int32_t h = h0;
+        do {
+          const int32_t k = index_[mesh.to_vertex_[h]];
+          if (k >= 0)
+            free_cols.emplace_back(k, h);
+          else
+            pinned_cols.emplace_back(-1 - k, h);
+          h = mesh.next_[TriMeshSoA::opposite(h)];
+        } while (h != h0);
+      }
+      std::sort(free_cols.begin(), free_cols.end());
+      std::sort(pinned_cols.begin(), pinned_cols.end());
+      for (size_t k = 0; k < free_cols.size(); ++k) {
+        const int32_t p = rows_outer[i] + static_cast<int32_t>(k);
+        rows_inner[p] = free_cols[k].first;
+        if (free_cols[k].second < 0)
+          diagonal_[i] = p;
+        else
+          slot_[free_cols[k].second] = p;
+      }
+      for (size_t k = 0; k < pinned_cols.size(); ++k) {
+        const int32_t p = coupling_outer[i] + static_cast<int32_t>(k);
+        coupling_inner[p] = pinned_cols[k].first;
+        slot_[pinned_cols[k].second] = -1 - p;
+      }
+    }
+  });
+}
+
+void HarmonicParameterization::FillWeights(const TriMeshSoA& mesh,
+                                           Weighting weighting) {
+  GEOMETRY_LAB_TRACE_SCOPE("HarmonicParameterization::FillWeights");
+  auto pos = [&](int32_t v) {
+    return Eigen::Vector3d(mesh.x_[v], mesh.y_[v], mesh.z_[v]);
+  };
+  // Cotangent of the angle opposite a halfedge in its face
+  auto cot = [&](int32_t h) {
+    if (mesh.face_[h] < 0)
+      return 0.0;
+    const Eigen::Vector3d k = pos(mesh.to_vertex_[mesh.next_[h]]);
+    const Eigen::Vector3d a = pos(mesh.from_vertex(h)) - k;
+    const Eigen::Vector3d b = pos(mesh.to_vertex_[h]) - k;
+    const double s = a.cross(b).norm();
+    return s > 0.0 ? a.dot(b) / s : 0.0;
+  };
+  // Tangent of half the angle between two edges
+  auto tan_half = [](const Eigen::Vector3d& a, const Eigen::Vector3d& b) {
+    const double s = a.cross(b).norm();
+    return s > 0.0 ? (a.norm() * b.norm() - a.dot(b)) / s : 0.0;
+  };
+  // Weight of the edge from(h) -> to(h) in the row of from(h)
+  auto weight = [&](int32_t h) {
+    const int32_t o = TriMeshSoA::opposite(h);
+    switch (weighting) {
+      case Weighting::kUniform:
+        return 1.0;
+      case Weighting::kCotan:
+        return 0.5 * (cot(h) + cot(o));
+      case Weighting::kMeanValue: {
+        // The two angles at from(h) next to the edge
+        const Eigen::Vector3d p = pos(mesh.from_vertex(h));
+        const Eigen::Vector3d e = pos(mesh.to_vertex_[h]) - p;
+        double t = 0.0;
+        if (mesh.face_[h] >= 0)
+          t += tan_half(e, pos(mesh.to_vertex_[mesh.next_[h]]) - p);
+        if (mesh.face_[o] >= 0)
+          t += tan_half(e, pos(mesh.to_vertex_[mesh.next_[o]]) - p);
+        const double l = e.norm();
+        return l > 0.0 ? t / l : 0.0;
+      }
+    }
+    return 0.0;
+  };
+  double* rows = rows_.valuePtr();
+  double* coupling = coupling_.valuePtr();
+  ParallelFor(0, free_.size(), [&](size_t i) {
+    double sum = 0.0;
+    const int32_t h0 = mesh.vertex_halfedge_[free_[i]];
+    if (h0 >= 0) {
+      int32_t h = h0;
+      do {
+        const double w = weight(h);
+        sum += w;
+        if (slot_[h] >= 0)
+          rows[slot_[h]] = -w;
+        else
+          coupling[-1 - slot_[h]] = w;
+        h = mesh.next_[TriMeshSoA::opposite(h)];
+      } while (h != h0);
+    }
+    // Isolated vertices stay at the origin
+    rows[diagonal_[i]] = sum != 0.0 ? sum : 1.0;
+  });
+}
+
+bool HarmonicParameterization::Factorize() {
+  GEOMETRY_LAB_TRACE_SCOPE("HarmonicParameterization::Factorize");
+  A_ = rows_;
+  bool ok = false;
+  if (weighting_ == Weighting::kMeanValue) {
+    if (!lu_analyzed_) {
+      lu_.analyzePattern(A_);
+      lu_analyzed_ = true;
+    }
+    lu_.factorize(A_);
+    ok = lu_.info() == Eigen::Success;
+  } else {
+    if (!ldlt_analyzed_) {
+      ldlt_.analyzePattern(A_);
+      ldlt_analyzed_ = true;
+    }
+    ldlt_.factorize(A_);
+    ok = ldlt_.info() == Eigen::Success;
+  }
+  ++n_factorizations_;
+  if (!ok)
+    printf("Error::HarmonicParameterization::Failed to factorize.\n\n");
+  return ok;
+}
+
+void HarmonicParameterization::PlaceBoundary(const TriMeshSoA& mesh,
+                                             Boundary boundary) {
+  const size_t n_b = pinned_.size();
+  auto pos = [&](size_t k) {
+    const int32_t v = pinned_[k % n_b];
+    return Eigen::Vector3d(mesh.x_[v], mesh.y_[v], mesh.z_[v]);
+  };
+  // The square starts at the sharpest turn of the loop, so the corners
+  // of a rectangular mesh map to the corners of the square
+  size_t start = 0;
+  if (boundary == Boundary::kSquare) {
+    double best = -2.0;
+    for (size_t k = 0; k < n_b; ++k) {
+      const Eigen::Vector3d a = (pos(k) - pos(k + n_b - 1)).normalized();
+      const Eigen::Vector3d b = (pos(k + 1) - pos(k)).normalized();
+      const double turn = 1.0 - a.dot(b);
+      if (turn > best) {
+        best = turn;
+        start = k;
+      }
+    }
+  }
+  std::vector<double> length(n_b + 1, 0.0);
+  for (size_t k = 0; k < n_b; ++k)
+    length[k + 1] = length[k] + (pos(start + k + 1) - pos(start + k)).norm();
+  auto arc = [&](size_t k) {
+    return length[n_b] > 0.0 ? length[k] / length[n_b]
+                             : static_cast<double>(k) / n_b;
+  };
+  // The loop walks clockwise around the faces, so does the boundary
+  // to keep the orientation of the faces
+  pinned_uv_.resize(n_b, 2);
+  if (boundary == Boundary::kCircle) {
+    for (size_t k = 0; k < n_b; ++k) {
+      const double angle = -2.0 * M_PI * arc(k);
+      pinned_uv_(k, 0) = 0.5 + 0.5 * std::cos(angle);
+      pinned_uv_(k, 1) = 0.5 + 0.5 * std::sin(angle);
+    }
+    return;
+  }
+  // Corners at the vertices closest to the quarters of the length, a
+  // face with its three vertices on one side would be flat
+  const double corners[5][2] = {{0, 0}, {0, 1}, {1, 1}, {1, 0}, {0, 0}};
+  size_t first[5] = {0, 0, 0, 0, n_b};
+  for (size_t side = 1; side < 4; ++side) {
+    size_t k = first[side - 1] + 1;
+    while (k + 1 < n_b && std::abs(arc(k + 1) - 0.25 * side) <
+                              std::abs(arc(k) - 0.25 * side))
+      ++k;
+    first[side] = std::min(k, n_b);
+  }
+  for (size_t side = 0; side < 4; ++side) {
+    const size_t b = first[side], e = std::max(first[side + 1], b);
+    for (size_t k = b; k < e; ++k) {
+      const double span = length[e] - length[b];
+      const double r = span > 0.0 ? (length[k] - length[b]) / span
+                                  : static_cast<double>(k - b) / (e - b);
+      const size_t p = (start + k) % n_b;
+      pinned_uv_(p, 0) =
+          (1.0 - r) * corners[side][0] + r * corners[side + 1][0];
+      pinned_uv_(p, 1) =
+          (1.0 - r) * corners[side][1] + r * corners[side + 1][1];
+    }
+  }
+}
+
+}  // namespace geometry_lab
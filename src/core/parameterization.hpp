@@ -0,0 +1,107 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_PARAMETERIZATION_HPP_
+#define GEOMETRY_LAB_CORE_PARAMETERIZATION_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/SparseCholesky>
+#include <Eigen/SparseCore>
+#include <Eigen/SparseLU>
+
+namespace geometry_lab {
+
+class BoundaryLoops;
+class TriMesh;
+class TriMeshSoA;
+
+/**
+ * @brief Tutte / harmonic parameterization of a disk-like mesh.
+ *
+ *  The longest boundary loop is pinned to a circle or a square by arc
+ *  length and the other vertices solve L_II * uv_I = -L_IB * uv_B,
+ *  where L is the Laplacian of the chosen weights. The rows of the
+ *  interior vertices are filled in parallel into a fixed pattern,
+ *  and the factorization is kept until the positions or the weights
+ *  change: a new boundary shape only costs a solve. The u and v
+ *  right-hand sides are solved together.
+*/
+class HarmonicParameterization {
+ public:
+  /**
+   * @brief Weights of the edges.
+  */
+  enum class Weighting {
+    /// Tutte's barycentric embedding.
+    kUniform = 0,
+    /// Floater's mean value coordinates, not symmetric.
+    kMeanValue,
+    /// Cotangent weights, harmonic maps.
+    kCotan
+  };
+  /**
+   * @brief Shape of the pinned boundary.
+  */
+  enum class Boundary { kCircle = 0, kSquare };
+  /**
+   * @brief Parameterize the mesh into the unit square [0,1]^2.
+   *
+   *  The result is kept in @c uv_ and written into the vertex
+   *  texcoords2D of the mesh, which are requested if needed.
+   *
+   * @param mesh[in] - The mesh, with at least one boundary loop.
+   * @param weighting[in] - Weights of the edges.
+   * @param boundary[in] - Shape of the longest boundary loop.
+   * @return Success?
+  */
+  bool Compute(TriMesh& mesh, Weighting weighting = Weighting::kCotan,
+               Boundary boundary = Boundary::kCircle);
+
+  HarmonicParameterization() {}
+  /// Number of factorizations since construction.
+  size_t n_factorizations() const { return n_factorizations_; }
+
+  /// (u, v) of each vertex.
+  Eigen::MatrixXd uv_;
+
+ private:
+  /// Split the vertices into pinned and free ones and build the
+  /// patterns of the rows.
+  void BuildPattern(const TriMeshSoA& mesh, const BoundaryLoops& loops);
+  /// Fill the weights of the free rows.
+  void FillWeights(const TriMeshSoA& mesh, Weighting weighting);
+  /// Factorize the free block, analyzing its pattern once.
+  bool Factorize();
+  /// Positions of the pinned vertices by arc length.
+  void PlaceBoundary(const TriMeshSoA& mesh, Boundary boundary);
+
+  /// Index of each vertex in its block, pinned vertex k is -1 - k.
+  std::vector<int32_t> index_;
+  /// Free and pinned vertices, the pinned ones in walking order.
+  std::vector<int32_t> free_, pinned_;
+  /// Entry of each outgoing halfedge of a free vertex, in @c rows_ if
+  /// positive and in @c coupling_ at -1 - entry otherwise.
+  std::vector<int32_t> slot_;
+  /// Diagonal entry of each free row.
+  std::vector<int32_t> diagonal_;
+  /// Free block L_II and coupling -L_IB of the Laplacian.
+  Eigen::SparseMatrix<double, Eigen::RowMajor> rows_, coupling_;
+  /// Column-major copy of @c rows_ for the factorizations.
+  Eigen::SparseMatrix<double> A_;
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldlt_;
+  Eigen::SparseLU<Eigen::SparseMatrix<double>> lu_;
+  /// Positions of the pinned vertices.
+  Eigen::MatrixXd pinned_uv_;
+  /// State of the cached factorization.
+  const TriMesh* mesh_ = nullptr;
+  uint64_t topology_ = UINT64_MAX, geometry_ = UINT64_MAX;
+  Weighting weighting_ = Weighting::kUniform;
+  bool ldlt_analyzed_ = false, lu_analyzed_ = false;
+  size_t n_factorizations_ = 0;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_PARAMETERIZATION_HPP_
@@ -0,0 +1,40 @@
+#include "core/simd.hpp"
+
+#if defined(GEOMETRY_LAB_X86) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace geometry_lab {
+
+SimdLevel DetectSimdLevel() {
+#if defined(GEOMETRY_LAB_X86) && (defined(__GNUC__) || defined(__clang__))
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return SimdLevel::kAVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return SimdLevel::kSSE;
+  return SimdLevel::kScalar;
+#elif defined(GEOMETRY_LAB_X86) && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  const int max_leaf = info[0];
+  __cpuid(info, 1);
+  const bool sse2 = (info[3] & (1 << 26)) != 0;
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  bool avx2 = false;
+  // AVX2 also needs the OS to save the YMM registers
+  if (max_leaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+  if (avx2)
+    return SimdLevel::kAVX2;
+  return sse2 ? SimdLevel::kSSE : SimdLevel::kScalar;
+#else
+  return SimdLevel::kScalar;
+#endif
+}
+
+}  // namespace geometry_lab
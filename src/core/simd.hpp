@@ -0,0 +1,97 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_SIMD_HPP_
+#define GEOMETRY_LAB_CORE_SIMD_HPP_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// The SSE kernels are compiled without a target attribute, so 32-bit
+// x86 only gets them when the whole build targets SSE2.
+#if defined(__x86_64__) || defined(_M_X64) ||           \
+    (defined(__i386__) && defined(__SSE2__)) ||         \
+    (defined(_M_IX86) && defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GEOMETRY_LAB_X86 1
+#endif
+
+// Functions using AVX2 intrinsics are compiled for AVX2 one by one,
+// so the rest of the library still runs on any x86 CPU. MSVC accepts
+// the intrinsics without any flag.
+#if defined(GEOMETRY_LAB_X86) && (defined(__GNUC__) || defined(__clang__))
+#define GEOMETRY_LAB_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define GEOMETRY_LAB_TARGET_AVX2
+#endif
+
+namespace geometry_lab {
+
+/**
+ * @brief Instruction sets the vectorized kernels are written for.
+*/
+enum class SimdLevel {
+  /// Plain C++.
+  kScalar = 0,
+  /// 4 floats per instruction, always available on x86-64.
+  kSSE,
+  /// 8 floats per instruction with gathers.
+  kAVX2,
+};
+/**
+ * @brief Query the CPU (and OS) for the supported instruction sets.
+ * @return The best supported level.
+*/
+SimdLevel DetectSimdLevel();
+/**
+ * @return The best supported level, detected once.
+*/
+inline SimdLevel SupportedSimdLevel() {
+  static const SimdLevel level = DetectSimdLevel();
+  return level;
+}
+/**
+ * @return The level a kernel should run with, i.e. the requested one
+ *  clamped by what the CPU supports.
+*/
+inline SimdLevel DispatchSimdLevel(SimdLevel requested) {
+  return requested < SupportedSimdLevel() ? requested : SupportedSimdLevel();
+}
+
+/**
+ * @brief Allocator returning memory aligned to @c Alignment bytes,
+ *  so SIMD loads of a std::vector never split a cache line.
+*/
+template <typename T, size_t Alignment = 64>
+class AlignedAllocator {
+ public:
+  using value_type = T;
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+  AlignedAllocator() noexcept {}
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+  T* allocate(size_t n) {
+    return static_cast<T*>(
+        ::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+  }
+  void deallocate(T* p, size_t) noexcept {
+    ::operator delete(p, std::align_val_t(Alignment));
+  }
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept {
+    return false;
+  }
+};
+/// std::vector with 64-byte aligned storage.
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_SIMD_HPP_
@@ -0,0 +1,369 @@
+#include "core/subdivision.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh.hpp"
+
+namespace geometry_lab {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+/// Corners of triangle lists, corner c of face c / 3 starts the edge
+/// to the next corner.
+int32_t NextCorner(int32_t c) { return c % 3 == 2 ? c - 2 : c + 1; }
+int32_t PrevCorner(int32_t c) { return c % 3 == 0 ? c + 2 : c - 1; }
+
+/// Loop's weight of each neighbor of an interior vertex of valence n.
+double LoopBeta(size_t n) {
+  const double c = 0.375 + 0.25 * std::cos(2.0 * kPi / n);
+  return (0.625 - c * c) / n;
+}
+
+/**
+ * @brief Split every triangle in four and build the stencils of the
+ *  refined vertices: the n_v old vertices first, then one vertex per
+ *  edge.
+ * @param n_v[in] - Number of vertices.
+ * @param tris[in] - Triangles, 3 vertex indices each, a manifold.
+ * @param stencils[out] - Stencils of the refined vertices.
+ * @param refined[out] - Triangles of the refined mesh.
+ * @return Success? It fails on non-manifold or inconsistently oriented
+ *  edges.
+*/
+bool RefineLevel(size_t n_v, const std::vector<int32_t>& tris,
+                 LoopSubdivision::Stencils& stencils,
+                 std::vector<int32_t>& refined) {
+  const size_t n_c = tris.size();
+  auto from = [&](int32_t c) { return tris[c]; };
+  auto to = [&](int32_t c) { return tris[NextCorner(c)]; };
+  // 1. Bucket the corners by the smaller vertex of their edge
+  std::vector<int32_t> bucket_offset(n_v + 1, 0), bucket(n_c);
+  for (size_t c = 0; c < n_c; ++c)
+    ++bucket_offset[std::min(from(int32_t(c)), to(int32_t(c)))];
+  for (size_t v = 1; v < n_v; ++v)
+    bucket_offset[v] += bucket_offset[v - 1];
+  bucket_offset[n_v] = static_cast<int32_t>(n_c);
+  for (size_t c = n_c; c-- > 0;)
+    bucket[--bucket_offset[std::min(from(int32_t(c)), to(int32_t(c)))]] =
+        int32_t(c);
+  // 2. Pair the opposite corners
+  std::atomic<bool> valid{true};
+  std::vector<int32_t> mate(n_c, -1);
+  ParallelFor(0, n_v, [&](size_t v) {
+    for (int32_t i = bucket_offset[v]; i < bucket_offset[v + 1]; ++i) {
+      const int32_t a = bucket[i];
+      const int32_t other = from(a) + to(a) - static_cast<int32_t>(v);
+      for (int32_t j = i + 1; j < bucket_offset[v + 1]; ++j) {
+        const int32_t b = bucket[j];
+        if (from(b) + to(b) - static_cast<int32_t>(v) != other)
+          continue;
+        if (mate[a] >= 0 || mate[b] >= 0 || from(a) == from(b)) {
+          valid = false;
+          return;
+        }
+        mate[a] = b;
+        mate[b] = a;
+      }
+    }
+  });
+  if (!valid)
+    return false;
+  // 3. Number the edges by their owner corner, the smaller of a pair
+  auto is_owner = [&](size_t c) {
+    return mate[c] < 0 || static_cast<int32_t>(c) < mate[c];
+  };
+  std::vector<size_t> block_edges(ParallelBlockCount(n_c) + 1, 0);
+  ParallelBlocks(n_c, [&](size_t block, size_t b, size_t e) {
+    for (size_t c = b; c < e; ++c)
+      block_edges[block + 1] += is_owner(c);
+  });
+  for (size_t i = 1; i < block_edges.size(); ++i)
+    block_edges[i] += block_edges[i - 1];
+  const size_t n_e = block_edges.back();
+  std::vector<int32_t> corner_edge(n_c), edge_corner(n_e);
+  ParallelBlocks(n_c, [&](size_t block, size_t b, size_t e) {
+    int32_t edge = static_cast<int32_t>(block_edges[block]);
+    for (size_t c = b; c < e; ++c) {
+      if (!is_owner(c))
+        continue;
+      corner_edge[c] = edge;
+      if (mate[c] >= 0)
+        corner_edge[mate[c]] = edge;
+      edge_corner[edge] = static_cast<int32_t>(c);
+      ++edge;
+    }
+  });
+  // 4. Edges around each vertex
+  std::vector<int32_t> vertex_offset(n_v + 1, 0), vertex_edges(2 * n_e);
+  for (size_t e = 0; e < n_e; ++e) {
+    ++vertex_offset[from(edge_corner[e]) + 1];
+    ++vertex_offset[to(edge_corner[e]) + 1];
+  }
+  for (size_t v = 0; v < n_v; ++v)
+    vertex_offset[v + 1] += vertex_offset[v];
+  {
+    std::vector<int32_t> fill(vertex_offset.begin(), vertex_offset.end() - 1);
+    for (size_t e = 0; e < n_e; ++e) {
+      vertex_edges[fill[from(edge_corner[e])]++] = static_cast<int32_t>(e);
+      vertex_edges[fill[to(edge_corner[e])]++] = static_cast<int32_t>(e);
+    }
+  }
+  auto is_boundary = [&](int32_t e) { return mate[edge_corner[e]] < 0; };
+  auto other_end = [&](int32_t e, int32_t v) {
+    const int32_t c = edge_corner[e];
+    return from(c) + to(c) - v;
+  };
+  auto n_boundary = [&](size_t v) {
+    int32_t n = 0;
+    for (int32_t i = vertex_offset[v]; i < vertex_offset[v + 1]; ++i)
+      n += is_boundary(vertex_edges[i]);
+    return n;
+  };
+  // 5. Sizes of the rows: the old vertices keep their 1-ring (interior),
+  //    their two boundary neighbors (boundary) or only themselves
+  //    (corners of non-manifold vertices), the new ones take the 4
+  //    vertices of the two faces of their edge or its 2 ends
+  const size_t n_rows = n_v + n_e;
+  auto& offsets = stencils.offsets_;
+  offsets.assign(n_rows + 1, 0);
+  ParallelFor(0, n_rows, [&](size_t r) {
+    int32_t size = 0;
+    if (r < n_v) {
+      const int32_t valence = vertex_offset[r + 1] - vertex_offset[r];
+      const int32_t boundary = n_boundary(r);
+      size = valence == 0 ? 1
+             : boundary == 0 ? valence + 1
+             : boundary == 2 ? 3
+                             : 1;
+    } else {
+      size = is_boundary(static_cast<int32_t>(r - n_v)) ? 2 : 4;
+    }
+    offsets[r + 1] = size;
+  });
+  for (size_t r = 0; r < n_rows; ++r)
+    offsets[r + 1] += offsets[r];
+  stencils.indices_.resize(offsets[n_rows]);
+  stencils.weights_.resize(offsets[n_rows]);
+  ParallelFor(0, n_rows, [&](size_t r) {
+    int32_t* index = &stencils.indices_[offsets[r]];
+    float* weight = &stencils.weights_[offsets[r]];
+    const int32_t size = offsets[r + 1] - offsets[r];
+    if (r >= n_v) {
+      const int32_t c = edge_corner[r - n_v];
+      index[0] = from(c);
+      index[1] = to(c);
+      if (size == 2) {
+        weight[0] = weight[1] = 0.5f;
+      } else {
+        index[2] = tris[PrevCorner(c)];
+        index[3] = tris[PrevCorner(mate[c])];
+        weight[0] = weight[1] = 0.375f;
+        weight[2] = weight[3] = 0.125f;
+      }
+      return;
+    }
+    const int32_t v = static_cast<int32_t>(r);
+    index[0] = v;
+    weight[0] = 1.0f;
+    if (size == 1)
+      return;
+    if (size == 3) {
+      // Cubic B-spline along the boundary
+      weight[0] = 0.75f;
+      int32_t k = 1;
+      for (int32_t i = vertex_offset[v]; i < vertex_offset[v + 1]; ++i) {
+        const int32_t e = vertex_edges[i];
+        if (is_boundary(e)) {
+          index[k] = other_end(e, v);
+          weight[k++] = 0.125f;
+        }
+      }
+      return;
+    }
+    const double beta = LoopBeta(size - 1);
+    weight[0] = static_cast<float>(1.0 - (size - 1) * beta);
+    int32_t k = 1;
+    for (int32_t i = vertex_offset[v]; i < vertex_offset[v + 1]; ++i) {
+      index[k] = other_end(vertex_edges[i], v);
+      weight[k++] = static_cast<float>(beta);
+    }
+  });
+  // 6. Four triangles per face, the corner triangles first
+  refined.resize(4 * n_c);
+  ParallelFor(0, n_c / 3, [&](size_t f) {
+    const int32_t* v = &tris[3 * f];
+    int32_t m[3];
+    for (int k = 0; k < 3; ++k)
+      m[k] = static_cast<int32_t>(n_v) + corner_edge[3 * f + k];
+    int32_t* t = &refined[12 * f];
+    const int32_t faces[12] = {v[0], m[0], m[2], m[0], v[1], m[1],
+                               m[2], m[1], v[2], m[0], m[1], m[2]};
+    std::copy(faces, faces + 12, t);
+  });
+  return true;
+}
+
+/// Apply a stencil table to positions, (x,y,z) in a row.
+void ApplyStencils(const LoopSubdivision::Stencils& stencils,
+                   const float* in, float* out) {
+  ParallelFor(0, stencils.rows(), [&](size_t r) {
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    for (int32_t k = stencils.offsets_[r]; k < stencils.offsets_[r + 1];
+         ++k) {
+      const float* p = in + 3 * stencils.indices_[k];
+      const float w = stencils.weights_[k];
+      x += w * p[0];
+      y += w * p[1];
+      z += w * p[2];
+    }
+    out[3 * r] = x;
+    out[3 * r + 1] = y;
+    out[3 * r + 2] = z;
+  });
+}
+
+}  // namespace
+
+bool LoopSubdivision::Build(TriMesh& mesh, size_t levels) {
+  rebuilt_ = false;
+  if (mesh_ == &mesh && topology_ == mesh.topology_generation() &&
+      levels == stencils_.size())
+    return true;
+  GEOMETRY_LAB_TRACE_SCOPE("LoopSubdivision::Build");
+  mesh_ = nullptr;
+  rebuilt_ = true;
+  const TriMeshSoA& soa = mesh.soa();
+  const size_t n_f = soa.n_faces();
+  if (n_f == 0) {
+    printf("Error::LoopSubdivision::The mesh has no face.\n\n");
+    return false;
+  }
+  for (size_t f = 0; f < n_f; ++f) {
+    const int32_t h = soa.face_halfedge_[f];
+    if (soa.next_[soa.next_[soa.next_[h]]] != h) {
+      printf("Error::LoopSubdivision::The mesh is not triangulated.\n\n");
+      return false;
+    }
+  }
+  // 1. Refine the connectivity level by level
+  stencils_.resize(levels);
+  indices_ = soa.faces_;
+  size_t n_v = soa.n_vertices();
+  std::vector<int32_t> refined;
+  for (size_t l = 0; l < levels; ++l) {
+    if (!RefineLevel(n_v, indices_, stencils_[l], refined)) {
+      printf("Error::LoopSubdivision::Non-manifold edge at level %zu.\n\n",
+             l);
+      stencils_.clear();
+      return false;
+    }
+    indices_.swap(refined);
+    n_v = stencils_[l].rows();
+  }
+  // 2. Faces around the refined vertices for the normals
+  vertex_face_offsets_.assign(n_v + 1, 0);
+  for (const int32_t v : indices_)
+    ++vertex_face_offsets_[v + 1];
+  for (size_t v = 0; v < n_v; ++v)
+    vertex_face_offsets_[v + 1] += vertex_face_offsets_[v];
+  vertex_faces_.resize(indices_.size());
+  std::vector<int32_t> fill(vertex_face_offsets_.begin(),
+                            vertex_face_offsets_.end() - 1);
+  for (size_t c = 0; c < indices_.size(); ++c)
+    vertex_faces_[fill[indices_[c]]++] = static_cast<int32_t>(c / 3);
+  positions_.resize(3 * n_v);
+  normals_.resize(3 * n_v);
+  face_normals_.resize(indices_.size());
+  mesh_ = &mesh;
+  topology_ = mesh.topology_generation();
+  return true;
+}
+
+bool LoopSubdivision::Evaluate(TriMesh& mesh) {
+  GEOMETRY_LAB_TRACE_SCOPE("LoopSubdivision::Evaluate");
+  if (mesh_ != &mesh || topology_ != mesh.topology_generation()) {
+    printf("Error::LoopSubdivision::Not built for the mesh.\n\n");
+    return false;
+  }
+  const TriMeshSoA& soa = mesh.soa();
+  std::vector<float>& cage = buffer_[0];
+  cage.resize(3 * soa.n_vertices());
+  ParallelFor(0, soa.n_vertices(), [&](size_t v) {
+    cage[3 * v] = soa.x_[v];
+    cage[3 * v + 1] = soa.y_[v];
+    cage[3 * v + 2] = soa.z_[v];
+  });
+  EvaluateLevels(cage.data());
+  return true;
+}
+
+bool LoopSubdivision::Evaluate(TriMesh& mesh,
+                               const std::vector<float>& positions) {
+  GEOMETRY_LAB_TRACE_SCOPE("LoopSubdivision::Evaluate");
+  if (mesh_ != &mesh || topology_ != mesh.topology_generation()) {
+    printf("Error::LoopSubdivision::Not built for the mesh.\n\n");
+    return false;
+  }
+  if (positions.size() != 3 * mesh.soa().n_vertices()) {
+    printf("Error::LoopSubdivision::Expected %zu cage positions.\n\n",
+           mesh.soa().n_vertices());
+    return false;
+  }
+  EvaluateLevels(positions.data());
+  return true;
+}
+
+void LoopSubdivision::EvaluateLevels(const float* cage) {
+  // 1. The levels one after another, the last one into positions_.
+  //    Level l writes buffer_[(l + 1) % 2], which is not its input
+  const size_t n_v = mesh_->soa().n_vertices();
+  const float* in = cage;
+  for (size_t l = 0; l < stencils_.size(); ++l) {
+    std::vector<float>* out = &buffer_[(l + 1) % 2];
+    if (l + 1 == stencils_.size())
+      out = &positions_;
+    else
+      out->resize(3 * stencils_[l].rows());
+    ApplyStencils(stencils_[l], in, out->data());
+    in = out->data();
+  }
+  if (stencils_.empty())
+    positions_.assign(cage, cage + 3 * n_v);
+  // 2. Area-weighted normals, every vertex gathers its faces
+  const float* p = positions_.data();
+  ParallelFor(0, n_faces(), [&](size_t f) {
+    const float* a = p + 3 * indices_[3 * f];
+    const float* b = p + 3 * indices_[3 * f + 1];
+    const float* c = p + 3 * indices_[3 * f + 2];
+    const float u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    const float v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    float* n = &face_normals_[3 * f];
+    n[0] = u[1] * v[2] - u[2] * v[1];
+    n[1] = u[2] * v[0] - u[0] * v[2];
+    n[2] = u[0] * v[1] - u[1] * v[0];
+  });
+  ParallelFor(0, this->n_vertices(), [&](size_t v) {
+    float n[3] = {0.0f, 0.0f, 0.0f};
+    for (int32_t i = vertex_face_offsets_[v]; i < vertex_face_offsets_[v + 1];
+         ++i) {
+      const float* m = &face_normals_[3 * vertex_faces_[i]];
+      n[0] += m[0];
+      n[1] += m[1];
+      n[2] += m[2];
+    }
+    const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    const float inv = length > 0.0f ? 1.0f / length : 0.0f;
+    normals_[3 * v] = n[0] * inv;
+    normals_[3 * v + 1] = n[1] * inv;
+    normals_[3 * v + 2] = n[2] * inv;
+  });
+}
+
+}  // namespace geometry_lab
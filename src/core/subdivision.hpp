@@ -0,0 +1,118 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_SUBDIVISION_HPP_
+#define GEOMETRY_LAB_CORE_SUBDIVISION_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace geometry_lab {
+
+class TriMesh;
+
+/**
+ * @brief Loop subdivision of a triangle mesh (the control cage), with
+ *  the refinement of the topology split from the evaluation of the
+ *  positions.
+ *
+ *  @c Build() refines the connectivity once per topology and number
+ *  of levels: every face is split in four and each level gets a sparse
+ *  stencil table, one row per refined vertex holding the weights of
+ *  the vertices of the previous level (Loop's masks, the boundary is
+ *  a cubic B-spline crease). @c Evaluate() then only applies the
+ *  tables, one parallel sparse matrix-vector pass per level, and
+ *  recomputes the normals of the refined mesh, so a moving cage never
+ *  rebuilds @c indices_.
+ *
+ *  The levels are applied one after another rather than through a
+ *  single composed table: the rows of a composed table grow with the
+ *  level, while the level tables do fewer than 7 multiply-adds per
+ *  refined vertex in total.
+*/
+class LoopSubdivision {
+ public:
+  /**
+   * @brief Sparse rows of weights, row r is
+   *  (indices_[k], weights_[k]) for k in [offsets_[r], offsets_[r+1]).
+  */
+  struct Stencils {
+    std::vector<int32_t> offsets_, indices_;
+    std::vector<float> weights_;
+    /// Number of rows.
+    size_t rows() const { return offsets_.empty() ? 0 : offsets_.size() - 1; }
+  };
+  /**
+   * @brief Refine the connectivity and build the stencil tables, only
+   *  done again when the mesh, its connectivity or the number of
+   *  levels changed.
+   * @param mesh[in] - The control cage, a triangle mesh.
+   * @param levels[in] - Number of subdivision steps.
+   * @return Success?
+  */
+  bool Build(TriMesh& mesh, size_t levels);
+  /**
+   * @brief Positions and normals of the refined mesh from the current
+   *  positions of the cage, into @c positions_ and @c normals_.
+   * @param mesh[in] - The cage of the last @c Build(), with the same
+   *                   connectivity.
+   * @return Success?
+  */
+  bool Evaluate(TriMesh& mesh);
+  /**
+   * @brief Positions and normals of the refined mesh from other
+   *  positions of the cage, e.g. a deformed copy, the cage itself and
+   *  its caches are left untouched.
+   * @param mesh[in] - The cage of the last @c Build().
+   * @param positions[in] - Positions of the cage vertices, (x,y,z) in
+   *                        a row.
+   * @return Success?
+  */
+  bool Evaluate(TriMesh& mesh, const std::vector<float>& positions);
+
+  LoopSubdivision() {}
+  /// Number of levels of the tables.
+  size_t levels() const { return stencils_.size(); }
+  /// Did the last @c Build() refine the connectivity again? Otherwise
+  /// @c indices_ did not change.
+  bool rebuilt() const { return rebuilt_; }
+  /// Size of the refined mesh.
+  size_t n_vertices() const { return positions_.size() / 3; }
+  size_t n_faces() const { return indices_.size() / 3; }
+  /// Stencil table of a level, from the vertices of the previous one.
+  const Stencils& stencils(size_t level) const { return stencils_[level]; }
+
+  /// Refined positions, (x,y,z) in a row.
+  std::vector<float> positions_;
+  /// Unit area-weighted normals of the refined vertices, (x,y,z) in a
+  /// row.
+  std::vector<float> normals_;
+  /// Triangles of the refined mesh, 3 vertex indices each, the
+  /// vertices of the cage keep their indices.
+  std::vector<int32_t> indices_;
+
+ private:
+  /**
+   * @brief Apply the levels to the cage positions, then recompute the
+   *  normals.
+   * @param cage[in] - Positions of the cage vertices, not in
+   *                   @c buffer_[1].
+  */
+  void EvaluateLevels(const float* cage);
+
+  /// Tables of the levels, the first one applies to the cage.
+  std::vector<Stencils> stencils_;
+  /// Faces around each refined vertex, vertex v has
+  /// vertex_faces_[vertex_face_offsets_[v], vertex_face_offsets_[v+1]).
+  std::vector<int32_t> vertex_face_offsets_, vertex_faces_;
+  /// Positions of the intermediate levels and normals of the faces.
+  std::vector<float> buffer_[2], face_normals_;
+  /// Cage of the tables.
+  TriMesh* mesh_ = nullptr;
+  uint64_t topology_ = UINT64_MAX;
+  bool rebuilt_ = false;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_SUBDIVISION_HPP_
@@ -0,0 +1,192 @@
+#include "core/trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <thread>
+
+namespace geometry_lab {
+
+/// Ring buffer of the current thread, given back when it exits.
+struct TraceThreadSlot {
+  Tracer::Buffer* buffer = nullptr;
+  ~TraceThreadSlot() {
+    if (buffer)
+      Tracer::instance()->Release(buffer);
+  }
+};
+
+namespace {
+thread_local TraceThreadSlot trace_slot;
+
+/// Hold the spin lock of a ring buffer for the scope.
+class SpinLock {
+ public:
+  explicit SpinLock(std::atomic_flag& flag) : flag_(flag) {
+    while (flag_.test_and_set(std::memory_order_acquire))
+      std::this_thread::yield();
+  }
+  ~SpinLock() { flag_.clear(std::memory_order_release); }
+  SpinLock(const SpinLock&) = delete;
+  SpinLock& operator=(const SpinLock&) = delete;
+
+ private:
+  std::atomic_flag& flag_;
+};
+
+void WriteEscaped(FILE* file, const char* text) {
+  for (const char* c = text; *c; ++c) {
+    if (*c == '"' || *c == '\\')
+      fputc('\\', file);
+    fputc(*c, file);
+  }
+}
+}  // namespace
+
+Tracer::Buffer* Tracer::local() {
+  if (!trace_slot.buffer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_buffers_.empty()) {
+      trace_slot.buffer = free_buffers_.back();
+      free_buffers_.pop_back();
+    } else {
+      buffers_.push_back(std::make_unique<Buffer>());
+      buffers_.back()->lane = static_cast<uint32_t>(buffers_.size() - 1);
+      trace_slot.buffer = buffers_.back().get();
+    }
+  }
+  return trace_slot.buffer;
+}
+
+void Tracer::Release(Buffer* buffer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_buffers_.push_back(buffer);
+}
+
+void Tracer::Push(const Event& event) {
+  Buffer* buffer = local();
+  SpinLock lock(buffer->busy);
+  Event& slot = buffer->events[buffer->head++ % kCapacity];
+  slot = event;
+  slot.lane = buffer->lane;
+}
+
+void Tracer::Counter(const char* name, double value) {
+  if (!enabled_)
+    return;
+  Push({name, now(), 0, value, true, 0});
+}
+
+void Tracer::Zone(const char* name, uint64_t begin, uint64_t end) {
+  Push({name, begin, end - begin, 0.0, false, 0});
+}
+
+void Tracer::Frame() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  frames_[n_frames_ % kFrameCapacity] = now();
+  ++n_frames_;
+}
+
+void Tracer::Gather(std::vector<Event>& events) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& buffer : buffers_) {
+    SpinLock buffer_lock(buffer->busy);
+    const uint64_t head = buffer->head;
+    const uint64_t n = std::min<uint64_t>(head, kCapacity);
+    for (uint64_t i = head - n; i < head; ++i)
+      events.push_back(buffer->events[i % kCapacity]);
+  }
+}
+
+std::vector<Tracer::Event> Tracer::Collect() const {
+  std::vector<Event> rst;
+  Gather(rst);
+  std::sort(rst.begin(), rst.end(), [](const Event& a, const Event& b) {
+    return a.begin < b.begin;
+  });
+  return rst;
+}
+
+std::vector<Tracer::ZoneStats> Tracer::FrameStats(size_t n_frames) const {
+  // Start of the frames, the last one is still running
+  std::vector<uint64_t> starts;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t n = std::min<uint64_t>(
+        {n_frames_, kFrameCapacity, static_cast<uint64_t>(n_frames) + 1});
+    for (uint64_t k = n_frames_ - n; k < n_frames_; ++k)
+      starts.push_back(frames_[k % kFrameCapacity]);
+  }
+  std::vector<ZoneStats> rst;
+  if (starts.size() < 2)
+    return rst;
+  const size_t n_complete = starts.size() - 1;
+  std::vector<Event> events;
+  Gather(events);
+  std::map<std::string, ZoneStats> zones;
+  for (const Event& e : events) {
+    if (e.counter || e.begin < starts.front() || e.begin >= starts.back())
+      continue;
+    const size_t frame =
+        std::upper_bound(starts.begin(), starts.end(), e.begin) -
+        starts.begin() - 1;
+    auto& stats = zones[e.name];
+    if (stats.ms.empty()) {
+      stats.name = e.name;
+      stats.ms.resize(n_complete, 0.0f);
+    }
+    stats.ms[frame] += static_cast<float>(e.duration * 1e-6);
+  }
+  for (auto& zone : zones) {
+    ZoneStats& stats = zone.second;
+    for (const float ms : stats.ms) {
+      stats.mean += ms / n_complete;
+      stats.max = std::max(stats.max, ms);
+    }
+    rst.push_back(std::move(stats));
+  }
+  return rst;
+}
+
+bool Tracer::WriteChromeTrace(const std::string& path) const {
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) {
+    printf("Error::Tracer::Failed to write trace: %s\n\n", path.c_str());
+    return false;
+  }
+  fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+  bool first = true;
+  for (const Event& e : Collect()) {
+    fprintf(file, "%s\n{\"name\": \"", first ? "" : ",");
+    WriteEscaped(file, e.name);
+    if (e.counter) {
+      fprintf(file,
+              "\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": 1, \"tid\": %u, "
+              "\"args\": {\"value\": %.17g}}",
+              e.begin * 1e-3, e.lane, e.value);
+    } else {
+      fprintf(file,
+              "\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, "
+              "\"tid\": %u}",
+              e.begin * 1e-3, e.duration * 1e-3, e.lane);
+    }
+    first = false;
+  }
+  fprintf(file, "\n]}\n");
+  const bool ok = !ferror(file);
+  fclose(file);
+  if (ok)
+    printf("Tracer::Successfully wrote trace: %s\n\n", path.c_str());
+  return ok;
+}
+
+void Tracer::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& buffer : buffers_) {
+    SpinLock buffer_lock(buffer->busy);
+    buffer->head = 0;
+  }
+  n_frames_ = 0;
+}
+
+}  // namespace geometry_lab
@@ -0,0 +1,181 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_TRACE_HPP_
+#define GEOMETRY_LAB_CORE_TRACE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The macros below are the only instrumentation interface, they
+// compile to nothing unless GEOMETRY_LAB_ENABLE_TRACE is defined
+// (cmake -DGEOMETRY_LAB_ENABLE_TRACE=ON). Names must be string
+// literals, only their address is recorded.
+#ifdef GEOMETRY_LAB_ENABLE_TRACE
+#define GEOMETRY_LAB_TRACE_CONCAT_(a, b) a##b
+#define GEOMETRY_LAB_TRACE_CONCAT(a, b) GEOMETRY_LAB_TRACE_CONCAT_(a, b)
+/// Record the time until the end of the enclosing scope.
+#define GEOMETRY_LAB_TRACE_SCOPE(name)                   \
+  ::geometry_lab::TraceZone GEOMETRY_LAB_TRACE_CONCAT( \
+      geometry_lab_trace_zone_, __LINE__)(name)
+/// Record the value of a counter.
+#define GEOMETRY_LAB_TRACE_COUNTER(name, value) \
+  ::geometry_lab::Tracer::instance()->Counter(name, static_cast<double>(value))
+/// Mark the start of a frame, for the per-frame statistics.
+#define GEOMETRY_LAB_TRACE_FRAME() ::geometry_lab::Tracer::instance()->Frame()
+#else
+#define GEOMETRY_LAB_TRACE_SCOPE(name) ((void)0)
+#define GEOMETRY_LAB_TRACE_COUNTER(name, value) ((void)0)
+#define GEOMETRY_LAB_TRACE_FRAME() ((void)0)
+#endif
+
+namespace geometry_lab {
+
+/**
+ * @brief Collect timed zones and counters of all the threads.
+ *
+ *  Every thread writes into its own ring buffer, the oldest events are
+ *  overwritten. Buffers of finished threads are recycled by new threads
+ *  (e.g. the workers of @c ParallelBlocks()), so the memory stays
+ *  bounded. Each buffer has a spin lock, which only contends while
+ *  @c Collect(), @c FrameStats() or @c Clear() copy or reset that buffer,
+ *  so events can be read while other threads record.
+*/
+class Tracer {
+ public:
+  /**
+   * @brief One recorded event.
+  */
+  struct Event {
+    /// Zone or counter name, a string literal.
+    const char* name;
+    /// Start time in ns since the tracer was created.
+    uint64_t begin;
+    /// Duration in ns, 0 for counters.
+    uint64_t duration;
+    /// Counter value.
+    double value;
+    /// Is it a counter?
+    bool counter;
+    /// Ring buffer of the recording thread.
+    uint32_t lane;
+  };
+  /**
+   * @brief Time spent in one zone in the last frames.
+  */
+  struct ZoneStats {
+    const char* name;
+    /// Milliseconds per frame, oldest first.
+    std::vector<float> ms;
+    float mean = 0.0f, max = 0.0f;
+  };
+  /**
+   * @brief Record a counter value now.
+  */
+  void Counter(const char* name, double value);
+  /**
+   * @brief Record a finished zone.
+  */
+  void Zone(const char* name, uint64_t begin, uint64_t end);
+  /**
+   * @brief Mark the start of a new frame.
+  */
+  void Frame();
+  /**
+   * @return All the events in the ring buffers, sorted by time.
+  */
+  std::vector<Event> Collect() const;
+  /**
+   * @brief Per-zone time of the last complete frames.
+   * @param n_frames[in] - Number of frames.
+   * @return The zones sorted by name.
+  */
+  std::vector<ZoneStats> FrameStats(size_t n_frames) const;
+  /**
+   * @brief Write the events in the Chrome trace format, which can be
+   *  opened in chrome://tracing or ui.perfetto.dev.
+   * @param path[in] - File path
+   * @return Success?
+  */
+  bool WriteChromeTrace(const std::string& path) const;
+  /**
+   * @brief Drop all the recorded events and frames.
+  */
+  void Clear();
+
+  Tracer() : epoch_(std::chrono::steady_clock::now()) {}
+  /// Static instance of the single tracer.
+  static Tracer* instance() {
+    static Tracer tracer;
+    return &tracer;
+  }
+  /// Nanoseconds since the tracer was created.
+  uint64_t now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - epoch_)
+        .count();
+  }
+  /// Recording can be paused at runtime.
+  std::atomic<bool> enabled_{true};
+  /// Events kept per thread.
+  static constexpr size_t kCapacity = 1 << 16;
+  /// Frames kept for @c FrameStats().
+  static constexpr size_t kFrameCapacity = 1024;
+
+ private:
+  /// Ring buffer owned by one thread at a time.
+  struct Buffer {
+    std::vector<Event> events = std::vector<Event>(kCapacity);
+    /// Number of events ever written, guarded by @c busy.
+    uint64_t head = 0;
+    uint32_t lane = 0;
+    /// Held by the owner while it appends, by readers while they copy.
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;
+  };
+  /// Append one event to the buffer of the calling thread.
+  void Push(const Event& event);
+  /// Buffer of the calling thread, acquired on its first event.
+  Buffer* local();
+  friend struct TraceThreadSlot;
+  /// Give the buffer of a finished thread back.
+  void Release(Buffer* buffer);
+  /// Append the events of all the buffers, unsorted.
+  void Gather(std::vector<Event>& events) const;
+
+  std::chrono::steady_clock::time_point epoch_;
+  /// Guards the buffer lists and the frames.
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+  std::vector<Buffer*> free_buffers_;
+  /// Start time of the last frames, a ring of @c kFrameCapacity.
+  std::vector<uint64_t> frames_ = std::vector<uint64_t>(kFrameCapacity);
+  uint64_t n_frames_ = 0;
+};
+
+/**
+ * @brief Time the enclosing scope, see @c GEOMETRY_LAB_TRACE_SCOPE.
+*/
+class TraceZone {
+ public:
+  explicit TraceZone(const char* name)
+      : name_(name),
+        begin_(Tracer::instance()->enabled_ ? Tracer::instance()->now() : 0) {}
+  ~TraceZone() {
+    if (begin_ > 0)
+      Tracer::instance()->Zone(name_, begin_, Tracer::instance()->now());
+  }
+  TraceZone(const TraceZone&) = delete;
+  TraceZone& operator=(const TraceZone&) = delete;
+
+ private:
+  const char* name_;
+  uint64_t begin_;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_TRACE_HPP_
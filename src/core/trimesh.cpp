@@ -1,103 +1,596 @@
 #include "core/trimesh.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <filesystem>
+#include <numeric>
+
 #include <OpenMesh/Core/IO/MeshIO.hh>
 
+#include "core/mesh_cache.hpp"
+#include "core/obj_reader.hpp"
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+
 namespace geometry_lab {
 
-bool TriMesh::LoadFromFile(const std::string& path, bool normalize) {
-  OpenMesh::IO::Options opt;
-  // Read the file
-  if (!OpenMesh::IO::read_mesh(*this, path, opt)) {
-    printf("Error::TriMesh::Failed to load mesh: %s\n\n", path.c_str());
+namespace {
+bool HasObjExtension(const std::string& path) {
+  if (path.size() < 4)
     return false;
+  std::string ext = path.substr(path.size() - 4);
+  for (auto& c : ext)
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  return ext == ".obj";
+}
+/// Fan the polygons of (indices, offsets) around their first corner into
+/// triangles, fails on a polygon with less than 3 corners.
+bool FanTriangles(const std::vector<int>& indices,
+                  const std::vector<int>& offsets, std::vector<int>& triangles) {
+  const size_t n_f = offsets.size() - 1;
+  size_t n_t = 0;
+  for (size_t f = 0; f < n_f; ++f) {
+    const int b = offsets[f], e = offsets[f + 1];
+    if (b < 0 || e < b + 3 || static_cast<size_t>(e) > indices.size())
+      return false;
+    n_t += e - b - 2;
+  }
+  triangles.resize(3 * n_t);
+  size_t t = 0;
+  for (size_t f = 0; f < n_f; ++f) {
+    for (int c = offsets[f] + 1; c + 1 < offsets[f + 1]; ++c, t += 3) {
+      triangles[t + 0] = indices[offsets[f]];
+      triangles[t + 1] = indices[c];
+      triangles[t + 2] = indices[c + 1];
+    }
+  }
+  return true;
+}
+}  // namespace
+
+bool TriMesh::LoadFromFile(const std::string& path, bool normalize,
+                           bool fast_obj) {
+  GEOMETRY_LAB_TRACE_SCOPE("TriMesh::LoadFromFile");
+  // Pick up a fresh binary cache next to the file
+  const std::string cache = MeshCache::PathFor(path);
+  if (MeshCache::IsFresh(cache, path, normalize ? 1.0f : 0.0f) &&
+      LoadFromCache(cache)) {
+    source_path_ = path;
+    // Caches written before the meshes were triangulated on load
+    Triangulate();
+    // Stale normals are stored but recomputed after loading
+    if (!is_current(normals_stamp_))
+      ComputeVertexNormalWithFace();
+    source_stamp_ = stamp();
+    return true;
+  }
+  auto start = std::chrono::steady_clock::now();
+  bool loaded = false;
+  // Parse .obj files in parallel and build the connectivity in bulk
+  if (fast_obj && HasObjExtension(path)) {
+    ObjReader reader;
+    loaded = reader.Read(path) &&
+             BuildFromPolygons(reader.positions_, reader.face_indices_,
+                               reader.face_offsets_);
   }
-  printf("TriMesh::Successfully loaded: %s\n\n", path.c_str());
+  // Read the file with OpenMesh otherwise
+  if (!loaded) {
+    OpenMesh::IO::Options opt;
+    if (!OpenMesh::IO::read_mesh(*this, path, opt)) {
+      printf("Error::TriMesh::Failed to load mesh: %s\n\n", path.c_str());
+      return false;
+    }
+  }
+  std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+  std::error_code ec;
+  double megabytes = std::filesystem::file_size(path, ec) / 1048576.0;
+  printf("TriMesh::Successfully loaded: %s (%.1f MB/s)\n\n", path.c_str(),
+         ec ? 0.0 : megabytes / std::max(seconds.count(), 1e-9));
+  source_path_ = path;
+  normalized_scale_ = 0.0f;
+  source_offset_.setZero();
+  source_scale_ = 1.0f;
+  MarkTopologyChanged();
+  // OpenMesh keeps the polygons of the file
+  Triangulate();
+  // Nomalize positions, before the normals which depend on the scale
+  // of the face areas
+  if (normalize)
+    NormalizePositions(1.0f);
   // Generate default vertex normal
   request_vertex_normals();
   ComputeVertexNormalWithFace();
-  // Nomalize positions
-  if (normalize)
-    NormalizePositions(1.0f);
+  source_stamp_ = stamp();
+  return true;
+}
+bool TriMesh::Triangulate() {
+  bool triangulated = true;
+  for (const auto& f : faces()) {
+    if (f.valence() != 3) {
+      triangulated = false;
+      break;
+    }
+  }
+  if (triangulated)
+    return false;
+  GEOMETRY_LAB_TRACE_SCOPE("TriMesh::Triangulate");
+  OpenMesh::PolyMesh_ArrayKernelT<>::triangulate();
+  MarkTopologyChanged();
+  return true;
+}
+bool TriMesh::SaveCache(const std::string& path) const {
+  // An edited mesh is not the cache of its source file any more, it
+  // is only written without the source stamp to an explicit path
+  const bool edited = !is_current(source_stamp_);
+  if (path.empty() && (source_path_.empty() || edited)) {
+    printf("Error::TriMesh::The mesh was edited since it was loaded from: "
+           "%s\n\n", source_path_.c_str());
+    return false;
+  }
+  const std::string target = path.empty() ? MeshCache::PathFor(source_path_)
+                                          : path;
+  if (!MeshCache::Write(*this, target, edited ? "" : source_path_)) {
+    printf("Error::TriMesh::Failed to save cache: %s\n\n", target.c_str());
+    return false;
+  }
+  printf("TriMesh::Successfully saved cache: %s\n\n", target.c_str());
+  return true;
+}
+bool TriMesh::LoadFromCache(const std::string& path) {
+  GEOMETRY_LAB_TRACE_SCOPE("TriMesh::LoadFromCache");
+  auto start = std::chrono::steady_clock::now();
+  if (!MeshCache::Read(path, *this)) {
+    printf("Error::TriMesh::Failed to load cache: %s\n\n", path.c_str());
+    return false;
+  }
+  std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+  std::error_code ec;
+  double megabytes = std::filesystem::file_size(path, ec) / 1048576.0;
+  printf("TriMesh::Successfully loaded cache: %s (%.1f MB/s)\n\n",
+         path.c_str(), ec ? 0.0 : megabytes / std::max(seconds.count(), 1e-9));
+  return true;
+}
+bool TriMesh::BuildFromPolygons(const std::vector<float>& positions,
+                                const std::vector<int>& indices,
+                                const std::vector<int>& offsets) {
+  GEOMETRY_LAB_TRACE_SCOPE("TriMesh::BuildFromPolygons");
+  clear();
+  MarkTopologyChanged();
+  normalized_scale_ = 0.0f;
+  source_offset_.setZero();
+  source_scale_ = 1.0f;
+  // Fan the polygons into triangles first
+  if (!offsets.empty()) {
+    std::vector<int> triangles;
+    if (!FanTriangles(indices, offsets, triangles))
+      return false;
+    if (triangles.size() != indices.size())
+      return BuildFromPolygons(positions, triangles);
+  }
+  // Every corner of a polygon starts an interior halfedge
+  const size_t n_v = positions.size() / 3;
+  const size_t n_c = indices.size();
+  const size_t n_f = offsets.empty() ? n_c / 3 : offsets.size() - 1;
+  if (n_v == 0 || n_f == 0 || (offsets.empty() && n_c % 3 != 0) ||
+      n_v >= static_cast<size_t>(INT_MAX) || n_c >= (size_t(1) << 30))
+    return false;
+  auto face_begin = [&](size_t f) -> size_t {
+    return offsets.empty() ? 3 * f : static_cast<size_t>(offsets[f]);
+  };
+  std::atomic<bool> valid{true};
+  // 1. Link each corner to the next one in its polygon
+  std::vector<int> corner_next(n_c);
+  ParallelFor(0, n_f, [&](size_t f) {
+    const size_t b = face_begin(f), e = face_begin(f + 1);
+    if (e < b + 3 || e > n_c) {
+      valid = false;
+      return;
+    }
+    for (size_t c = b; c < e; ++c) {
+      const size_t next = (c + 1 == e) ? b : c + 1;
+      if (indices[c] < 0 || static_cast<size_t>(indices[c]) >= n_v ||
+          indices[c] == indices[next])
+        valid = false;
+      corner_next[c] = static_cast<int>(next);
+    }
+  });
+  if (!valid)
+    return false;
+  // 2. Bucket the halfedges by their smaller vertex, after filling
+  //    bucket v is bucket[bucket_offset[v], bucket_offset[v+1])
+  auto from = [&](int c) { return indices[c]; };
+  auto to = [&](int c) { return indices[corner_next[c]]; };
+  std::vector<int> bucket_offset(n_v + 1, 0), bucket(n_c);
+  for (size_t c = 0; c < n_c; ++c)
+    ++bucket_offset[std::min(from(int(c)), to(int(c)))];
+  for (size_t v = 1; v < n_v; ++v)
+    bucket_offset[v] += bucket_offset[v - 1];
+  bucket_offset[n_v] = static_cast<int>(n_c);
+  for (size_t c = n_c; c-- > 0;)
+    bucket[--bucket_offset[std::min(from(int(c)), to(int(c)))]] = int(c);
+  // 3. Pair the opposite halfedges, an edge shared by more than two
+  //    polygons or by two polygons with the same direction is rejected
+  std::vector<int> mate(n_c, -1);
+  ParallelFor(0, n_v, [&](size_t v) {
+    for (int i = bucket_offset[v]; i < bucket_offset[v + 1]; ++i) {
+      const int a = bucket[i];
+      const int a_other = from(a) + to(a) - static_cast<int>(v);
+      for (int j = i + 1; j < bucket_offset[v + 1]; ++j) {
+        const int b = bucket[j];
+        if (from(b) + to(b) - static_cast<int>(v) != a_other)
+          continue;
+        if (from(a) == from(b) || mate[a] >= 0 || mate[b] >= 0) {
+          valid = false;
+          return;
+        }
+        mate[a] = b;
+        mate[b] = a;
+      }
+    }
+  });
+  if (!valid)
+    return false;
+  // 4. Number the edges, the first halfedge of edge e is the corner
+  //    owning it and the second one is its mate or a boundary halfedge
+  std::vector<int> corner_heh(n_c);
+  auto is_owner = [&](size_t c) { return mate[c] < 0 || int(c) < mate[c]; };
+  std::vector<size_t> block_edges(ParallelBlockCount(n_c) + 1, 0);
+  ParallelBlocks(n_c, [&](size_t block, size_t b, size_t e) {
+    for (size_t c = b; c < e; ++c)
+      block_edges[block + 1] += is_owner(c);
+  });
+  for (size_t i = 1; i < block_edges.size(); ++i)
+    block_edges[i] += block_edges[i - 1];
+  ParallelBlocks(n_c, [&](size_t block, size_t b, size_t e) {
+    int edge = static_cast<int>(block_edges[block]);
+    for (size_t c = b; c < e; ++c) {
+      if (!is_owner(c))
+        continue;
+      corner_heh[c] = 2 * edge;
+      if (mate[c] >= 0)
+        corner_heh[mate[c]] = 2 * edge + 1;
+      ++edge;
+    }
+  });
+  const size_t n_e = block_edges.back();
+  // 5. Fill the kernel
+  resize(n_v, n_e, n_f);
+  ParallelFor(0, n_v, [&](size_t v) {
+    const float* p = &positions[3 * v];
+    OpenMesh::PolyMesh_ArrayKernelT<>::set_point(VertexHandle(int(v)),
+                                                 Point(p[0], p[1], p[2]));
+  });
+  ParallelFor(0, n_f, [&](size_t f) {
+    const FaceHandle fh(static_cast<int>(f));
+    const size_t b = face_begin(f), e = face_begin(f + 1);
+    set_halfedge_handle(fh, HalfedgeHandle(corner_heh[b]));
+    for (size_t c = b; c < e; ++c) {
+      const HalfedgeHandle hh(corner_heh[c]);
+      set_vertex_handle(hh, VertexHandle(to(int(c))));
+      set_face_handle(hh, fh);
+      set_next_halfedge_handle(hh, HalfedgeHandle(corner_heh[corner_next[c]]));
+    }
+  });
+  // 6. Outgoing halfedges of the vertices, which must be the boundary
+  //    one on the boundary. Reuse the bucket offsets to count corners,
+  //    not the buckets as there can be more vertices than corners
+  std::vector<int> vertex_heh(n_v, -1);
+  std::vector<int>& n_corners = bucket_offset;
+  std::fill(n_corners.begin(), n_corners.end(), 0);
+  std::vector<int> boundary;
+  for (size_t c = 0; c < n_c; ++c) {
+    vertex_heh[from(int(c))] = corner_heh[c];
+    ++n_corners[from(int(c))];
+    if (mate[c] < 0)
+      boundary.push_back(int(c));
+  }
+  std::vector<char> on_boundary(n_v, 0);
+  for (int c : boundary) {
+    const HalfedgeHandle hb(corner_heh[c] ^ 1);
+    set_vertex_handle(hb, VertexHandle(from(c)));
+    if (on_boundary[to(c)]) {
+      clear();
+      return false;
+    }
+    on_boundary[to(c)] = 1;
+    vertex_heh[to(c)] = hb.idx();
+  }
+  for (int c : boundary) {
+    set_next_halfedge_handle(HalfedgeHandle(corner_heh[c] ^ 1),
+                             HalfedgeHandle(vertex_heh[from(c)]));
+  }
+  ParallelFor(0, n_v, [&](size_t v) {
+    if (vertex_heh[v] >= 0)
+      set_halfedge_handle(VertexHandle(int(v)), HalfedgeHandle(vertex_heh[v]));
+  });
+  // 7. A single fan around each vertex must reach all of its corners,
+  //    otherwise the vertex is non-manifold
+  ParallelFor(0, n_v, [&](size_t v) {
+    if (vertex_heh[v] < 0)
+      return;
+    const HalfedgeHandle start(vertex_heh[v]);
+    HalfedgeHandle it = start;
+    int count = 0;
+    do {
+      if (face_handle(it).is_valid())
+        ++count;
+      it = next_halfedge_handle(opposite_halfedge_handle(it));
+    } while (it != start && count <= n_corners[v]);
+    if (count != n_corners[v])
+      valid = false;
+  });
+  if (!valid) {
+    clear();
+    return false;
+  }
   return true;
 }
-void TriMesh::ComputeVertexNormalWithFace() {
+const TriMeshSoA& TriMesh::soa() const {
+  // Connectivity changed through the OpenMesh interface without
+  // MarkTopologyChanged()
+  if (soa_stamp_.topology == topology_generation_ &&
+      (soa_.n_vertices() != n_vertices() ||
+       soa_.n_halfedges() != n_halfedges() || soa_.n_faces() != n_faces()))
+    BumpGeneration(true);
+  if (is_current(soa_stamp_))
+    return soa_;
+  if (soa_stamp_.topology != topology_generation_) {
+    soa_.Build(*this);
+  } else if (is_patchable(soa_stamp_)) {
+    VisitMoved(soa_stamp_, [&](int32_t v) {
+      const Point& p = point(VertexHandle(v));
+      soa_.x_[v] = p[0];
+      soa_.y_[v] = p[1];
+      soa_.z_[v] = p[2];
+    });
+  } else {
+    ParallelFor(0, n_vertices(), [&](size_t v) {
+      const Point& p = point(VertexHandle(static_cast<int>(v)));
+      soa_.x_[v] = p[0];
+      soa_.y_[v] = p[1];
+      soa_.z_[v] = p[2];
+    });
+  }
+  soa_stamp_ = stamp();
+  return soa_;
+}
+void TriMesh::MarkVertexMoved(int32_t v) {
+  // A long journal costs more than recomputing everything
+  if (moved_.size() >= std::max<size_t>(n_vertices(), 1024)) {
+    BumpGeneration(false);
+    return;
+  }
+  geometry_generation_ = NextGeneration();
+  moved_.push_back(v);
+  moved_generation_.push_back(geometry_generation_);
+}
+void TriMesh::BumpGeneration(bool topology) const {
+  if (topology)
+    topology_generation_ = NextGeneration();
+  geometry_generation_ = NextGeneration();
+  moved_.clear();
+  moved_generation_.clear();
+  moved_base_ = geometry_generation_;
+}
+uint64_t TriMesh::NextGeneration() {
+  static std::atomic<uint64_t> counter{0};
+  return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+void TriMesh::ComputeVertexNormalWithFace(NormalEngine::Weighting weighting) {
+  GEOMETRY_LAB_TRACE_SCOPE("TriMesh::ComputeVertexNormalWithFace");
   if (!has_vertex_normals())
     request_vertex_normals();
-  request_face_normals();
-  update_normals();
-  release_face_normals();
+  normal_engine_.Compute(soa(), weighting);
+  ParallelFor(0, n_vertices(), [&](size_t i) {
+    const float* n = normal_engine_.normal(i);
+    set_normal(VertexHandle(static_cast<int>(i)), Normal(n[0], n[1], n[2]));
+  });
+  normals_stamp_ = stamp();
 }
-void TriMesh::NormalizePositions(float a) {
-  using vecf3 = OpenMesh::VectorT<float, 3>;
-  // Find current bounding box
-  vecf3 max, min;
-  max = min = point(*vertices_begin());
-  for (const auto& v : vertices()) {
-    const auto& p = point(v);
-    for (int i = 0; i < 3; ++i) {
-      if (p[i] > max[i])
-        max[i] = p[i];
-      if (p[i] < min[i])
-        min[i] = p[i];
-    }
+const std::vector<int32_t>& TriMesh::UpdateVertexNormals() {
+  const TriMeshSoA& mesh = soa();
+  if (!has_vertex_normals() || !is_patchable(normals_stamp_)) {
+    ComputeVertexNormalWithFace(normal_engine_.weighting());
+    normal_vertices_.resize(n_vertices());
+    std::iota(normal_vertices_.begin(), normal_vertices_.end(), 0);
+    return normal_vertices_;
   }
+  normal_vertices_.clear();
+  VisitMoved(normals_stamp_, [&](int32_t v) { normal_vertices_.push_back(v); });
+  // The engine recomputes everything when it has no normals yet
+  const std::vector<int32_t>& touched =
+      normal_engine_.Update(mesh, normal_vertices_);
+  ParallelFor(0, touched.size(), [&](size_t i) {
+    const float* n = normal_engine_.normal(touched[i]);
+    set_normal(VertexHandle(touched[i]), Normal(n[0], n[1], n[2]));
+  });
+  normals_stamp_ = stamp();
+  return touched;
+}
+const std::vector<int32_t>& TriMesh::UpdateVertexNormals(
+    const std::vector<int32_t>& vertices) {
+  for (const int32_t v : vertices)
+    MarkVertexMoved(v);
+  return UpdateVertexNormals();
+}
+void TriMesh::NormalizePositions(float a) {
+  GEOMETRY_LAB_TRACE_SCOPE("TriMesh::NormalizePositions");
+  const TriMeshSoA& mesh = soa();
+  const size_t n_v = mesh.n_vertices();
+  if (n_v == 0)
+    return;
+  // Find current bounding box with a parallel reduction
+  const BoundingBox& box = ComputeBoundingBox();
   // Find contre and scale
-  vecf3 translate = -(max + min) / 2.0f;
-  vecf3 scale_vec = (max - min) / 2.0f;
-  float scale = std::max<float>({scale_vec[0], scale_vec[1], scale_vec[2]});
-  // Transform
-  for (const auto& v : vertices()) {
-    const vecf3& p = point(v);
-    set_point(v, (p + translate) / scale);
+  const Eigen::Vector3f translate = -box.center();
+  const float scale = box.half_extent().maxCoeff() / a;
+  if (scale <= 0.0f)
+    return;
+  // Transform in one pass, the snapshot is updated together with
+  // the mesh
+  const float inv_scale = 1.0f / scale;
+  ParallelFor(0, n_v, [&](size_t i) {
+    const float x = (soa_.x_[i] + translate[0]) * inv_scale;
+    const float y = (soa_.y_[i] + translate[1]) * inv_scale;
+    const float z = (soa_.z_[i] + translate[2]) * inv_scale;
+    soa_.x_[i] = x;
+    soa_.y_[i] = y;
+    soa_.z_[i] = z;
+    OpenMesh::PolyMesh_ArrayKernelT<>::set_point(
+        VertexHandle(static_cast<int>(i)), Point(x, y, z));
+  });
+  BumpGeneration(false);
+  soa_stamp_ = stamp();
+  normalized_scale_ = a;
+  // p = p' * scale - translate in the frame before
+  source_offset_ -= source_scale_ * translate;
+  source_scale_ *= scale;
+}
+const BoundingBox& TriMesh::ComputeBoundingBox() const {
+  const TriMeshSoA& mesh = soa();
+  if (!is_current(bounding_box_stamp_)) {
+    bounding_box_.Compute(mesh);
+    bounding_box_stamp_ = stamp();
+  }
+  return bounding_box_;
+}
+const OrientedBox& TriMesh::ComputeOrientedBox() const {
+  const BoundingBox& box = ComputeBoundingBox();
+  if (!is_current(oriented_box_stamp_)) {
+    oriented_box_.Compute(soa_, box);
+    oriented_box_stamp_ = stamp();
   }
+  return oriented_box_;
 }
 
 std::priority_queue<TriMesh::Boundary> TriMesh::ComputeBoundaries() {
   std::priority_queue<TriMesh::Boundary> rst;
-  auto visited = OpenMesh::HProp<bool>(false, *this);
-  for (const auto& hh : halfedges()) {
-    // Visit the boundary loop
-    if (hh.is_boundary() && !visited[hh]) {
-      Boundary bdr(hh);
-      bdr.Visit([&](const OpenMesh::SmartHalfedgeHandle& it) {
-        visited[it] = true;
-        bdr.length_ += 1;
-      });
-      rst.push(bdr);
-    }
+  const BoundaryLoops& loops = ComputeBoundaryLoops();
+  for (size_t i = 0; i < loops.size(); ++i) {
+    Boundary bdr(OpenMesh::SmartHalfedgeHandle(loops.start(i), this));
+    bdr.length_ = loops.length(i);
+    rst.push(bdr);
   }
   return rst;
 }
-
+const BoundaryLoops& TriMesh::ComputeBoundaryLoops() {
+  const TriMeshSoA& mesh = soa();
+  // The loops only depend on the connectivity
+  if (boundary_loops_stamp_.topology != topology_generation_) {
+    boundary_loops_.Compute(mesh);
+    boundary_loops_stamp_ = stamp();
+  }
+  return boundary_loops_;
+}
 void TriMesh::ComputeHalfedgeDifferenceAndFaceArea() {
-  if (has_halfedge_difference() && has_face_area())
+  GEOMETRY_LAB_TRACE_SCOPE("TriMesh::ComputeHalfedgeDifferenceAndFaceArea");
+  const TriMeshSoA& mesh = soa();
+  const bool exist = has_halfedge_difference() && has_face_area();
+  if (exist && is_current(halfedge_diff_stamp_))
     return;
-  using vecf3 = OpenMesh::VectorT<float, 3>;
   auto halfedge_diff =
       OpenMesh::HProp<Eigen::Vector2d>(*this, kPropHalfedgeDiff.data());
   auto face_area = OpenMesh::FProp<double>(*this, kPropFaceArea.data());
-  vecf3 dx01, dx02;
-  double l01, l02, cos0, sin0;
-  for (const auto& fh : faces()) {
+  auto compute = [&](size_t f) {
     // On each face, the three edges are in the order of
     //   fh.halfedge(), fh.halfedge().next(), fh.halfedge.to()
-    const auto& hh01 = fh.halfedge();
-    const auto& hh20 = hh01.next().next();
-    dx01 = point(hh01.to()) - point(hh01.from());
-    dx02 = point(hh20.from()) - point(hh20.to());
-    l01 = dx01.norm();
-    l02 = dx02.norm();
-    cos0 = dx01.dot(dx02) / (l01 * l02);
-    sin0 = sqrt(1.0 - cos0 * cos0);
+    const int32_t* v = &mesh.faces_[3 * f];
+    const int32_t h01 = mesh.face_halfedge_[f];
+    const int32_t h12 = mesh.next_[h01];
+    const int32_t h20 = mesh.next_[h12];
+    const Eigen::Vector3d p0(mesh.x_[v[0]], mesh.y_[v[0]], mesh.z_[v[0]]);
+    const Eigen::Vector3d dx01 =
+        Eigen::Vector3d(mesh.x_[v[1]], mesh.y_[v[1]], mesh.z_[v[1]]) - p0;
+    const Eigen::Vector3d dx02 =
+        Eigen::Vector3d(mesh.x_[v[2]], mesh.y_[v[2]], mesh.z_[v[2]]) - p0;
+    const double l01 = dx01.norm();
+    const double l02 = dx02.norm();
+    const double cos0 = dx01.dot(dx02) / (l01 * l02);
+    const double sin0 = sqrt(1.0 - cos0 * cos0);
     // Set the start point of fh.halfedge() to (0, 0)
     // and set the end point of fh.halfedge() to (l, 0)
     // Then we can locate the 2D flattenned point of other vertices in order
-    halfedge_diff[hh01] << l01, 0;
-    halfedge_diff[hh01.next()] << l02 * cos0 - l01, l02 * sin0;
-    halfedge_diff[hh20] = -halfedge_diff[hh01] - halfedge_diff[hh01.next()];
+    const Eigen::Vector2d d01(l01, 0);
+    const Eigen::Vector2d d12(l02 * cos0 - l01, l02 * sin0);
+    halfedge_diff[HalfedgeHandle(h01)] = d01;
+    halfedge_diff[HalfedgeHandle(h12)] = d12;
+    halfedge_diff[HalfedgeHandle(h20)] = -d01 - d12;
     // The area of the triangle
-    face_area[fh] = 0.5 * l01 * l02 * sin0;
+    face_area[FaceHandle(static_cast<int>(f))] = 0.5 * l01 * l02 * sin0;
+  };
+  if (exist && is_patchable(halfedge_diff_stamp_)) {
+    // Only the faces around the moved vertices
+    dirty_faces_.clear();
+    VisitMoved(halfedge_diff_stamp_, [&](int32_t v) {
+      const int32_t h0 = mesh.vertex_halfedge_[v];
+      if (h0 < 0)
+        return;
+      int32_t h = h0;
+      do {
+        if (mesh.face_[h] >= 0)
+          dirty_faces_.push_back(mesh.face_[h]);
+        h = mesh.next_[TriMeshSoA::opposite(h)];
+      } while (h != h0);
+    });
+    std::sort(dirty_faces_.begin(), dirty_faces_.end());
+    dirty_faces_.erase(std::unique(dirty_faces_.begin(), dirty_faces_.end()),
+                       dirty_faces_.end());
+    ParallelFor(0, dirty_faces_.size(),
+                [&](size_t i) { compute(dirty_faces_[i]); });
+  } else {
+    ParallelFor(0, mesh.n_faces(), compute);
   }
+  halfedge_diff_stamp_ = stamp();
+}
+const LaplacianOperator& TriMesh::ComputeLaplacian(
+    LaplacianOperator::Mass mass) {
+  const TriMeshSoA& mesh = soa();
+  if (laplacian_stamp_.topology != topology_generation_)
+    laplacian_.BuildPattern(mesh);
+  if (!is_current(laplacian_stamp_) || laplacian_.mass() != mass) {
+    ComputeHalfedgeDifferenceAndFaceArea();
+    laplacian_.Assemble(*this, mass);
+  }
+  laplacian_stamp_ = stamp();
+  return laplacian_;
+}
+void TriMesh::ComputeCurvature() {
+  if (has_curvature() && is_current(curvature_stamp_))
+    return;
+  GEOMETRY_LAB_TRACE_SCOPE("TriMesh::ComputeCurvature");
+  ComputeHalfedgeDifferenceAndFaceArea();
+  curvature_engine_.Compute(*this);
+  auto gaussian =
+      OpenMesh::VProp<double>(*this, kPropGaussianCurvature.data());
+  auto mean = OpenMesh::VProp<double>(*this, kPropMeanCurvature.data());
+  auto principal = OpenMesh::VProp<Eigen::Vector2d>(
+      *this, kPropPrincipalCurvatures.data());
+  auto direction = OpenMesh::VProp<Eigen::Vector3d>(
+      *this, kPropPrincipalDirection.data());
+  const CurvatureEngine& engine = curvature_engine_;
+  ParallelFor(0, n_vertices(), [&](size_t i) {
+    const VertexHandle vh(static_cast<int>(i));
+    gaussian[vh] = engine.gaussian_[i];
+    mean[vh] = engine.mean_[i];
+    principal[vh] = {engine.principal_[2 * i], engine.principal_[2 * i + 1]};
+    const double* d = engine.direction(i);
+    direction[vh] = {d[0], d[1], d[2]};
+  });
+  curvature_stamp_ = stamp();
+}
+const Bvh& TriMesh::ComputeBvh() {
+  const TriMeshSoA& mesh = soa();
+  if (bvh_stamp_.topology != topology_generation_)
+    bvh_.Build(mesh);
+  else if (!is_current(bvh_stamp_))
+    bvh_.Refit(mesh);
+  bvh_stamp_ = stamp();
+  return bvh_;
 }
 
-}  // namespace geometry_lab
\ No newline at end of file
+}  // namespace geometry_lab
@@ -3,20 +3,38 @@
 #ifndef GEOMETRY_LAB_CORE_TRIMESH_HPP_
 #define GEOMETRY_LAB_CORE_TRIMESH_HPP_
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <queue>
 #include <string>
+#include <vector>
 
 #include <Eigen/Core>
 #include <OpenMesh/Core/Mesh/PolyMesh_ArrayKernelT.hh>
 #include <OpenMesh/Core/Utils/PropertyManager.hh>
 
+#include "core/boundary_loops.hpp"
+#include "core/bounding_box.hpp"
+#include "core/bvh.hpp"
+#include "core/curvature.hpp"
+#include "core/laplacian.hpp"
+#include "core/normal_engine.hpp"
+#include "core/trimesh_soa.hpp"
+
 namespace geometry_lab {
 
 /**
  * @brief Triangle mesh inherited from OpenMesh, where some
  *  additional operators are implemented.
+ *
+ *  The mesh labels its changes with a geometry and a topology
+ *  generation. Derived data (the snapshot @c soa(), normals,
+ *  halfedge differences, face areas, boxes and boundaries) remember
+ *  the generations they were computed at, so they are only
+ *  recomputed when stale, and only around the moved vertices when
+ *  the positions were changed by @c set_point().
 */
 class TriMesh : public OpenMesh::PolyMesh_ArrayKernelT<> {
  public:
@@ -29,9 +47,10 @@ class TriMesh : public OpenMesh::PolyMesh_ArrayKernelT<> {
     /**
      * @brief Visit one boundary loop and do sth.
      * @param fun[in] - What we want to do, can be an anonymous 
-     *                  function.
+     *                  function taking the SmartHalfedgeHandle.
     */
-    void Visit(std::function<void(const OpenMesh::SmartHalfedgeHandle&)> fun) {
+    template <typename F>
+    void Visit(F&& fun) const {
       OpenMesh::SmartHalfedgeHandle it = start_;
       do {
         fun(it);
@@ -62,6 +81,14 @@ class TriMesh : public OpenMesh::PolyMesh_ArrayKernelT<> {
   static constexpr std::string_view kPropHalfedgeDiff = "HalfedgeDiff";
   /// Face area property label
   static constexpr std::string_view kPropFaceArea = "FaceArea";
+  /// Vertex curvature property labels, see @c ComputeCurvature()
+  static constexpr std::string_view kPropGaussianCurvature =
+      "GaussianCurvature";
+  static constexpr std::string_view kPropMeanCurvature = "MeanCurvature";
+  static constexpr std::string_view kPropPrincipalCurvatures =
+      "PrincipalCurvatures";
+  static constexpr std::string_view kPropPrincipalDirection =
+      "PrincipalDirection";
 
   /**
    * @brief Load the mesh from an .obj file. 
@@ -69,32 +96,196 @@ class TriMesh : public OpenMesh::PolyMesh_ArrayKernelT<> {
    *  Default vertices normals would be computed by faces for  
    *  further requirements.
    * 
+   *  A fresh .glmesh cache next to the file (see @c SaveCache()) is
+   *  loaded instead when it exists. .obj files are parsed by the
+   *  parallel @c ObjReader and built by @c BuildFromPolygons(),
+   *  OpenMesh is used for other formats and when the fast path fails
+   *  (e.g. non-manifold input). The polygons are split into
+   *  triangles, see @c Triangulate().
+   *
    * @param path[in] - File path
    * @param normalize[in] - Should the positions be normalized?
+   * @param fast_obj[in] - Use the fast path for .obj files?
    * @retval FALSE - when some error occur
    * @retval TRUE - when the mesh is load successfully
   */
-  bool LoadFromFile(const std::string& path, bool normalize = true);
+  bool LoadFromFile(const std::string& path, bool normalize = true,
+                    bool fast_obj = true);
+  /**
+   * @brief Replace the mesh by a list of polygons.
+   *
+   *  The polygons are fanned into triangles around their first
+   *  corner, then the halfedge connectivity is built in bulk
+   *  (halfedges are paired by bucketing them on their smaller vertex)
+   *  instead of calling add_face() one by one.
+   *
+   * @param positions[in] - Vertex positions, (x,y,z) in a row.
+   * @param indices[in] - Zero-based vertex indices of the polygons.
+   * @param offsets[in] - Polygon k uses indices[offsets[k], offsets[k+1]),
+   *                      leave it empty if all polygons are triangles.
+   * @retval FALSE - when the polygons are not a manifold surface,
+   *                 the mesh is left empty
+   * @retval TRUE - when the mesh is built successfully
+  */
+  bool BuildFromPolygons(const std::vector<float>& positions,
+                         const std::vector<int>& indices,
+                         const std::vector<int>& offsets = {});
+  /**
+   * @brief Split the faces which are not triangles into fans of
+   *  triangles, as the snapshot @c soa() and the kernels working on
+   *  it expect triangles. Call it after adding polygons through the
+   *  OpenMesh interface.
+   * @retval FALSE - when the mesh was already triangulated
+   * @retval TRUE - when some faces were split
+  */
+  bool Triangulate();
+  /**
+   * @brief Write the mesh into a binary .glmesh cache, including the
+   *  vertex normals and the @c HalfedgeDiff / @c FaceArea properties
+   *  if they are up to date.
+   *
+   *  The cache records the size and modification time of
+   *  @c source_path_ only while the mesh is unchanged since
+   *  @c LoadFromFile(). An edited mesh (e.g. decimated, rebuilt by
+   *  @c BuildFromPolygons() or moved) is written without them, so
+   *  it is never taken for a fresh cache of the file.
+   *
+   * @param path[in] - Cache file path, empty for the default path
+   *                   next to @c source_path_, which is refused for an
+   *                   edited mesh.
+   * @return Success?
+  */
+  bool SaveCache(const std::string& path = "") const;
+  /**
+   * @brief Load the mesh from a binary .glmesh cache. The file is
+   *  memory mapped and copied into the kernel without parsing or
+   *  recomputing the normals.
+   * @param path[in] - Cache file path
+   * @return Success?
+  */
+  bool LoadFromCache(const std::string& path);
+  /**
+   * @brief Update vertices normals with face normals, computed in
+   *  parallel by @c normal_engine() on the flat snapshot @c soa().
+   * @param weighting[in] - Weighting of the face normals.
+  */
+  void ComputeVertexNormalWithFace(
+      NormalEngine::Weighting weighting = NormalEngine::Weighting::kUniform);
+  /**
+   * @brief Bring the vertex normals up to date, with the weighting
+   *  of the last @c ComputeVertexNormalWithFace().
+   *
+   *  Only the normals around the vertices moved by @c set_point()
+   *  since the last update are recomputed, all of them after a
+   *  bigger change. The new normals can be sent to
+   *  @c MeshPainter::UpdateNormals() with @c normal_engine().normals_.
+   *
+   * @return Indices of the vertices whose normal changed, valid until
+   *  the next update.
+  */
+  const std::vector<int32_t>& UpdateVertexNormals();
   /**
-   * @brief Update vertices normals with precomputed face normals.
+   * @brief Same as @c UpdateVertexNormals(), for vertices moved
+   *  through point() instead of @c set_point().
+   * @param vertices[in] - Indices of the moved vertices.
+   * @return Indices of the vertices whose normal changed, valid until
+   *  the next update.
   */
-  void ComputeVertexNormalWithFace();
+  const std::vector<int32_t>& UpdateVertexNormals(
+      const std::vector<int32_t>& vertices);
   /**
    * @brief Normalize the positions of vertices into a bounding cube.
+   *
+   *  The box is found by a parallel reduction on the flat snapshot
+   *  @c soa(), then the positions are transformed in one parallel
+   *  pass. The snapshot stays valid.
+   *
    * @param a[in] - The scale of normalization. i.e. The bounding 
    *                cube would be scaled to (-a,-a,-a)->(a,a,a).
+   *                The transform is kept in @c source_scale_ and
+   *                @c source_offset_.
   */
   void NormalizePositions(float a);
   /**
-   * @brief Find all the boundary loops of the mesh.
+   * @return The axis-aligned box and centroid of the vertices,
+   *  computed in parallel on the flat snapshot @c soa(). It is cached
+   *  until the positions change.
+  */
+  const BoundingBox& ComputeBoundingBox() const;
+  /**
+   * @return The box of the vertices along their principal axes,
+   *  cached until the positions change.
+  */
+  const OrientedBox& ComputeOrientedBox() const;
+  /**
+   * @brief Find all the boundary loops of the mesh, runs on the flat
+   *  snapshot @c soa().
    * @return The boundary loops sorted by number of edges (longest
    *  to shortest)
   */
   std::priority_queue<Boundary> ComputeBoundaries();
   /**
-   * @brief Initialize the property @c HalfedgeDiff and @c FaceArea.
+   * @brief Find all the boundary loops of the mesh in compressed form,
+   *  see @c BoundaryLoops. The loops are cached until the topology
+   *  changes.
+   * @return The loops sorted by number of edges (longest to shortest),
+   *  valid until the next change of the topology.
+  */
+  const BoundaryLoops& ComputeBoundaryLoops();
+  /**
+   * @brief Bring the property @c HalfedgeDiff and @c FaceArea up to
+   *  date, the faces are processed in parallel on the flat snapshot
+   *  @c soa(). Only the faces around the moved vertices are
+   *  recomputed when the properties exist.
   */
   void ComputeHalfedgeDifferenceAndFaceArea();
+  /**
+   * @brief Assemble the cotangent Laplacian and the mass matrix, see
+   *  @c LaplacianOperator. The sparsity pattern is kept until the
+   *  topology changes and the values are refilled when the positions
+   *  change, so a @c LaplacianSolver factorizing it again skips the
+   *  symbolic analysis.
+   * @param mass[in] - Kind of mass matrix.
+   * @return The operator, valid until the next change of the mesh.
+  */
+  const LaplacianOperator& ComputeLaplacian(
+      LaplacianOperator::Mass mass = LaplacianOperator::Mass::kLumped);
+  /**
+   * @brief Bring the curvature properties of the vertices up to date,
+   *  see @c CurvatureEngine: @c GaussianCurvature and
+   *  @c MeanCurvature (double), @c PrincipalCurvatures (k1 >= k2 in an
+   *  Eigen::Vector2d) and @c PrincipalDirection (direction of k1 in
+   *  an Eigen::Vector3d). They are recomputed in parallel when the
+   *  mesh changed, the flat results stay in @c curvature_engine().
+  */
+  void ComputeCurvature();
+  /**
+   * @brief Bring the BVH of the faces up to date, see @c Bvh. It is
+   *  built again when the topology changes and only refitted when
+   *  the positions change.
+   * @return The tree, valid until the next change of the mesh.
+  */
+  const Bvh& ComputeBvh();
+  /**
+   * @brief Move a vertex, hides the OpenMesh version to record the
+   *  vertex for the derived data. Not thread-safe.
+   * @param vh[in] - The vertex
+   * @param p[in] - New position
+  */
+  void set_point(VertexHandle vh, const Point& p) {
+    OpenMesh::PolyMesh_ArrayKernelT<>::set_point(vh, p);
+    MarkVertexMoved(vh.idx());
+  }
+  /**
+   * @brief Mark all the positions changed, e.g. after editing them
+   *  through point() or the property of the points.
+  */
+  void MarkGeometryChanged() { BumpGeneration(false); }
+  /**
+   * @brief Mark the connectivity changed, e.g. after add_face() or
+   *  garbage_collection(). The positions are considered changed too.
+  */
+  void MarkTopologyChanged() { BumpGeneration(true); }
 
   TriMesh() {}
   /**
@@ -124,6 +315,35 @@ class TriMesh : public OpenMesh::PolyMesh_ArrayKernelT<> {
     return OpenMesh::getProperty<OpenMesh::FaceHandle, double>(
         *this, kPropFaceArea.data());
   }
+  /**
+   * @brief Get a scalar curvature property, one should first call
+   *  @c ComputeCurvature().
+   * @param label[in] - @c kPropGaussianCurvature or
+   *                    @c kPropMeanCurvature.
+   * @return A Vertex property manager.
+  */
+  const OpenMesh::VProp<double> prop_curvature(std::string_view label) {
+    return OpenMesh::getProperty<OpenMesh::VertexHandle, double>(
+        *this, label.data());
+  }
+  /**
+   * @brief Get the principal curvatures property, (k1, k2) with
+   *  k1 >= k2. One should first call @c ComputeCurvature().
+   * @return A Vertex property manager.
+  */
+  const OpenMesh::VProp<Eigen::Vector2d> prop_principal_curvatures() {
+    return OpenMesh::getProperty<OpenMesh::VertexHandle, Eigen::Vector2d>(
+        *this, kPropPrincipalCurvatures.data());
+  }
+  /**
+   * @brief Get the principal direction property, the unit direction
+   *  of k1. One should first call @c ComputeCurvature().
+   * @return A Vertex property manager.
+  */
+  const OpenMesh::VProp<Eigen::Vector3d> prop_principal_direction() {
+    return OpenMesh::getProperty<OpenMesh::VertexHandle, Eigen::Vector3d>(
+        *this, kPropPrincipalDirection.data());
+  }
   /**
    * @brief Get the 3d position from index
    * @param id[in] - index of the vertex 
@@ -154,6 +374,136 @@ class TriMesh : public OpenMesh::PolyMesh_ArrayKernelT<> {
     return OpenMesh::hasProperty<OpenMesh::FaceHandle, double>(
         *this, kPropFaceArea.data());
   }
+  /**
+   * @return Do the curvature properties exist?
+  */
+  bool has_curvature() const {
+    return OpenMesh::hasProperty<OpenMesh::VertexHandle, Eigen::Vector3d>(
+        *this, kPropPrincipalDirection.data());
+  }
+  /**
+   * @brief Get the flat structure-of-arrays snapshot of the mesh for
+   *  hot kernels, it is brought up to date when it is stale.
+   *
+   *  The positions of the vertices moved by @c set_point() are
+   *  patched, the snapshot is rebuilt after a topology change. Call
+   *  @c MarkGeometryChanged() or @c MarkTopologyChanged() after
+   *  editing the mesh through the rest of the OpenMesh interface,
+   *  and @c Triangulate() after adding polygons.
+   *
+   * @return The snapshot, valid until the next change of the mesh.
+  */
+  const TriMeshSoA& soa() const;
+  /**
+   * @return Generation of the positions. Generations are drawn from
+   *  one counter of the process, so (mesh address, generation) never
+   *  repeats, even for a mesh allocated where a freed one was.
+  */
+  uint64_t geometry_generation() const { return geometry_generation_; }
+  /**
+   * @return Generation of the connectivity, unique in the process like
+   *  @c geometry_generation().
+  */
+  uint64_t topology_generation() const { return topology_generation_; }
+  /**
+   * @return The engine of the last vertex normals computation.
+  */
+  const NormalEngine& normal_engine() const { return normal_engine_; }
+  /**
+   * @return The engine of the last curvature computation.
+  */
+  const CurvatureEngine& curvature_engine() const {
+    return curvature_engine_;
+  }
+  /// The file the mesh was loaded from.
+  std::string source_path_;
+  /// Scale of the last @c NormalizePositions() since loading, 0 if
+  /// the positions are raw.
+  float normalized_scale_ = 0.0f;
+  /// Transform of the positions back to the frame of the source file,
+  /// source = point * source_scale_ + source_offset_. It accumulates
+  /// the @c NormalizePositions() since loading, so meshes normalized
+  /// apart can be compared in their common source frame.
+  Eigen::Vector3f source_offset_ = Eigen::Vector3f::Zero();
+  float source_scale_ = 1.0f;
+
+ private:
+  /// Generations a cached quantity was computed at.
+  struct Stamp {
+    uint64_t geometry = UINT64_MAX;
+    uint64_t topology = UINT64_MAX;
+  };
+  /// Current generations.
+  Stamp stamp() const { return {geometry_generation_, topology_generation_}; }
+  /// Was the quantity computed at the current generations?
+  bool is_current(const Stamp& s) const {
+    return s.geometry == geometry_generation_ &&
+           s.topology == topology_generation_;
+  }
+  /// Can the quantity be patched with the vertices in @c moved_?
+  bool is_patchable(const Stamp& s) const {
+    return s.topology == topology_generation_ && s.geometry >= moved_base_;
+  }
+  /// Visit the vertices moved since the quantity was computed.
+  template <typename F>
+  void VisitMoved(const Stamp& s, F&& fun) const {
+    const size_t first =
+        std::upper_bound(moved_generation_.begin(), moved_generation_.end(),
+                         s.geometry) -
+        moved_generation_.begin();
+    for (size_t i = first; i < moved_.size(); ++i)
+      fun(moved_[i]);
+  }
+  /// Record a moved vertex in @c moved_.
+  void MarkVertexMoved(int32_t v);
+  /// Start a new generation where all the positions changed.
+  void BumpGeneration(bool topology) const;
+  /// Draw a new generation from the counter shared by all the meshes.
+  static uint64_t NextGeneration();
+  /// The cache restores the derived data it stores.
+  friend class MeshCache;
+
+  /// Generations of the mesh, bumped by @c soa() too when it finds the
+  /// connectivity changed behind its back.
+  mutable uint64_t geometry_generation_ = NextGeneration();
+  mutable uint64_t topology_generation_ = NextGeneration();
+  /// Vertices moved since the geometry generation @c moved_base_, the
+  /// i-th one started the generation moved_generation_[i].
+  mutable std::vector<int32_t> moved_;
+  mutable std::vector<uint64_t> moved_generation_;
+  mutable uint64_t moved_base_ = geometry_generation_;
+  /// Generations at the end of @c LoadFromFile(), the mesh is edited
+  /// when they are not current.
+  Stamp source_stamp_;
+  /// Cached flat snapshot of the mesh.
+  mutable TriMeshSoA soa_;
+  mutable Stamp soa_stamp_;
+  /// Cached boxes of the vertices.
+  mutable BoundingBox bounding_box_;
+  mutable Stamp bounding_box_stamp_;
+  mutable OrientedBox oriented_box_;
+  mutable Stamp oriented_box_stamp_;
+  /// Buffers of the boundary loops, reused between calls.
+  BoundaryLoops boundary_loops_;
+  Stamp boundary_loops_stamp_;
+  /// Buffers of the vertex normals, reused between updates.
+  NormalEngine normal_engine_;
+  Stamp normals_stamp_;
+  /// Moved vertices passed to the normal engine, or all of them.
+  std::vector<int32_t> normal_vertices_;
+  /// Stamp of the properties @c HalfedgeDiff and @c FaceArea.
+  Stamp halfedge_diff_stamp_;
+  /// Faces around the moved vertices.
+  std::vector<int32_t> dirty_faces_;
+  /// Cached cotangent Laplacian.
+  LaplacianOperator laplacian_;
+  Stamp laplacian_stamp_;
+  /// Buffers of the curvatures, reused between updates.
+  CurvatureEngine curvature_engine_;
+  Stamp curvature_stamp_;
+  /// Cached BVH of the faces.
+  Bvh bvh_;
+  Stamp bvh_stamp_;
 };
 
 }  // namespace geometry_lab
@@ -0,0 +1,66 @@
+#include "core/trimesh_soa.hpp"
+
+#include <atomic>
+#include <cstdio>
+
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+#include "core/trimesh.hpp"
+
+namespace geometry_lab {
+
+bool TriMeshSoA::Build(const TriMesh& mesh) {
+  GEOMETRY_LAB_TRACE_SCOPE("TriMeshSoA::Build");
+  const size_t n_v = mesh.n_vertices();
+  const size_t n_h = mesh.n_halfedges();
+  const size_t n_f = mesh.n_faces();
+  x_.resize(n_v);
+  y_.resize(n_v);
+  z_.resize(n_v);
+  vertex_halfedge_.resize(n_v);
+  next_.resize(n_h);
+  to_vertex_.resize(n_h);
+  face_.resize(n_h);
+  face_halfedge_.resize(n_f);
+  faces_.resize(3 * n_f);
+  ParallelFor(0, n_v, [&](size_t i) {
+    const OpenMesh::VertexHandle vh(static_cast<int>(i));
+    const auto& p = mesh.point(vh);
+    x_[i] = p[0];
+    y_[i] = p[1];
+    z_[i] = p[2];
+    vertex_halfedge_[i] = mesh.halfedge_handle(vh).idx();
+  });
+  ParallelFor(0, n_h, [&](size_t i) {
+    const OpenMesh::HalfedgeHandle hh(static_cast<int>(i));
+    next_[i] = mesh.next_halfedge_handle(hh).idx();
+    to_vertex_[i] = mesh.to_vertex_handle(hh).idx();
+    face_[i] = mesh.face_handle(hh).idx();
+  });
+  // The face vertices need the halfedge arrays, a polygon left by an
+  // edit without TriMesh::Triangulate() keeps its first fan triangle
+  std::atomic<bool> triangulated{true};
+  ParallelFor(0, n_f, [&](size_t i) {
+    const int32_t h0 = mesh.halfedge_handle(OpenMesh::FaceHandle(int(i))).idx();
+    const int32_t h1 = next_[h0];
+    if (next_[next_[h1]] != h0)
+      triangulated = false;
+    face_halfedge_[i] = h0;
+    faces_[3 * i + 0] = from_vertex(h0);
+    faces_[3 * i + 1] = to_vertex_[h0];
+    faces_[3 * i + 2] = to_vertex_[h1];
+  });
+  triangulated_ = triangulated;
+  if (!triangulated_) {
+    printf("Error::TriMeshSoA::The mesh is not triangulated, call "
+           "TriMesh::Triangulate().\n\n");
+    return false;
+  }
+  return true;
+}
+
+void TriMeshSoA::Clear() {
+  *this = TriMeshSoA();
+}
+
+}  // namespace geometry_lab
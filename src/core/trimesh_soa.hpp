@@ -0,0 +1,72 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_CORE_TRIMESH_SOA_HPP_
+#define GEOMETRY_LAB_CORE_TRIMESH_SOA_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace geometry_lab {
+
+class TriMesh;
+
+/**
+ * @brief Read-only structure-of-arrays snapshot of a TriMesh.
+ *
+ *  The positions and the halfedge connectivity are copied into flat
+ *  arrays indexed by the OpenMesh handle indices, so hot kernels can
+ *  stream through them instead of chasing smart handles. The faces
+ *  are expected to be triangles, see @c TriMesh::Triangulate(). The
+ *  opposite halfedge is not stored since the array kernel always
+ *  pairs halfedge h with h^1.
+*/
+class TriMeshSoA {
+ public:
+  /**
+   * @brief Copy the positions and connectivity of the mesh.
+   * @param mesh[in] - Source mesh.
+   * @retval FALSE - when a face is not a triangle, the snapshot is
+   *                 still complete but @c faces_ only holds the first
+   *                 fan triangle of such a face
+   * @retval TRUE - when the snapshot is built successfully
+  */
+  bool Build(const TriMesh& mesh);
+  /**
+   * @brief Release all the arrays.
+  */
+  void Clear();
+
+  TriMeshSoA() {}
+  size_t n_vertices() const { return x_.size(); }
+  size_t n_halfedges() const { return to_vertex_.size(); }
+  size_t n_faces() const { return face_halfedge_.size(); }
+  /// Opposite halfedge of h.
+  static int32_t opposite(int32_t h) { return h ^ 1; }
+  /// Start vertex of halfedge h.
+  int32_t from_vertex(int32_t h) const { return to_vertex_[h ^ 1]; }
+  /// Is halfedge h on the boundary (without face)?
+  bool is_boundary(int32_t h) const { return face_[h] < 0; }
+
+  /// Vertex positions.
+  std::vector<float> x_, y_, z_;
+  /// Vertex indices of the faces, 3 per face starting at the start
+  /// vertex of @c face_halfedge_.
+  std::vector<int32_t> faces_;
+  /// Next halfedge in the face (or boundary loop).
+  std::vector<int32_t> next_;
+  /// Vertex the halfedge points to.
+  std::vector<int32_t> to_vertex_;
+  /// Face of the halfedge, -1 on the boundary.
+  std::vector<int32_t> face_;
+  /// Outgoing halfedge of each vertex, -1 for isolated vertices.
+  std::vector<int32_t> vertex_halfedge_;
+  /// First halfedge of each face.
+  std::vector<int32_t> face_halfedge_;
+  /// Were all the faces triangles in the last @c Build()?
+  bool triangulated_ = true;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_CORE_TRIMESH_SOA_HPP_
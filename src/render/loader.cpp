@@ -1,8 +1,15 @@
 #include "loader.hpp"
 
+#include <utility>
+#include <vector>
+
+#include "core/decimation.hpp"
+#include "core/trace.hpp"
+
 namespace geometry_lab {
 
 void TriMeshLoader::GeneratePainter() {
+  GEOMETRY_LAB_TRACE_SCOPE("TriMeshLoader::GeneratePainter");
   size_t n_v = mesh_->n_vertices();
   size_t n_f = mesh_->n_faces();
   painter_->vertices_.resize(n_v);
@@ -22,6 +29,29 @@ void TriMeshLoader::GeneratePainter() {
     tar[1] = fh0.next().from().idx();
     tar[2] = fh0.next().next().from().idx();
   }
+  // The levels of detail index the old vertices
+  painter_->UpdateLevels({});
+}
+bool TriMeshLoader::GenerateLevels() {
+  GEOMETRY_LAB_TRACE_SCOPE("TriMeshLoader::GenerateLevels");
+  std::vector<size_t> targets;
+  for (size_t n = mesh_->n_faces() / 4; n >= kMinLevelFaces; n /= 4)
+    targets.push_back(n);
+  std::vector<std::vector<int32_t>> levels;
+  QuadricDecimater decimater;
+  if (!targets.empty() && !decimater.Simplify(*mesh_, targets, levels))
+    return false;
+  // Drop the levels where the collapses got stuck
+  size_t n_faces = mesh_->n_faces();
+  std::vector<std::vector<int32_t>> kept;
+  for (auto& level : levels) {
+    if (level.size() / 3 * 4 > n_faces * 3)
+      continue;
+    n_faces = level.size() / 3;
+    kept.push_back(std::move(level));
+  }
+  painter_->UpdateLevels(kept);
+  return true;
 }
 
 }  // namespace geometry_lab
\ No newline at end of file
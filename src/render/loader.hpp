@@ -22,6 +22,15 @@ class TriMeshLoader {
    * @brief Send the mesh to GL and generate the @c painter_.
   */
   void GeneratePainter();
+  /**
+   * @brief Simplify the mesh into levels of detail of the painter,
+   *  index sets over the same vertices made by
+   *  @c QuadricDecimater::Simplify(). Each level has a quarter of the
+   *  faces of the previous one, down to about @c kMinLevelFaces. Call
+   *  @c LoadBuffers() to send them to GL.
+   * @return Success?
+  */
+  bool GenerateLevels();
   /**
    * @brief InitGlBuffers()
   */
@@ -43,6 +52,8 @@ class TriMeshLoader {
     painter_ =
         std::make_shared<MeshPainter>(mesh_->n_vertices(), mesh_->n_faces());
   }
+  /// Faces of the coarsest level of detail.
+  static constexpr size_t kMinLevelFaces = 1000;
   /// The name of the mesh in the renderer.
   std::string label_;
   /// Source mesh for computing.
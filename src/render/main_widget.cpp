@@ -4,6 +4,11 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+#include <cfloat>
+
+#include "core/trace.hpp"
+#include "painter.hpp"
+
 namespace geometry_lab {
 
 bool MainWidget::Init() {
@@ -51,8 +56,10 @@ bool MainWidget::Init() {
     exit(-1);
   }
   // gl status
-  glViewport(0, 0, GEOMETRY_LAB_DEFAULT_WINDOW_WIDTH,
-             GEOMETRY_LAB_DEFAULT_WINDOW_HEIGHT);
+  int width, height;
+  glfwGetFramebufferSize(main_window_, &width, &height);
+  viewport_callback(main_window_, width, height);
+  glfwSetFramebufferSizeCallback(main_window_, viewport_callback);
   // - Default clear color is white
   glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
   glEnable(GL_DEPTH_TEST);
@@ -63,8 +70,9 @@ bool MainWidget::Init() {
 }
 
 void MainWidget::StartNewFrame() {
+  GEOMETRY_LAB_TRACE_FRAME();
+  GEOMETRY_LAB_TRACE_SCOPE("MainWidget::StartNewFrame");
   glfwPollEvents();
-  viewport_callback();
   io_callback();
   ImGui_ImplOpenGL3_NewFrame();
   ImGui_ImplGlfw_NewFrame();
@@ -72,12 +80,18 @@ void MainWidget::StartNewFrame() {
 }
 
 void MainWidget::Render() {
+  GEOMETRY_LAB_TRACE_SCOPE("MainWidget::Render");
   ImGui::Render();
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 void MainWidget::EndFrame() {
-  ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+  {
+    GEOMETRY_LAB_TRACE_SCOPE("MainWidget::EndFrame");
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+  }
+  // Mostly waiting for the vertical sync
+  GEOMETRY_LAB_TRACE_SCOPE("MainWidget::SwapBuffers");
   glfwSwapBuffers(main_window_);
 }
 
@@ -89,4 +103,48 @@ void MainWidget::Close() {
   glfwTerminate();
 }
 
+void MainWidget::viewport_callback(GLFWwindow* window, int w, int h) {
+  glViewport(0, 0, w, h);
+  Painter::set_framebuffer_size(w, h);
+}
+
+void MainWidget::ShowTracePanel(bool* open) {
+  if (!ImGui::Begin("Trace", open)) {
+    ImGui::End();
+    return;
+  }
+#ifdef GEOMETRY_LAB_ENABLE_TRACE
+  auto tracer = Tracer::instance();
+  bool enabled = tracer->enabled_;
+  if (ImGui::Checkbox("Record", &enabled))
+    tracer->enabled_ = enabled;
+  ImGui::SameLine();
+  if (ImGui::Button("Clear"))
+    tracer->Clear();
+  ImGui::SameLine();
+  if (ImGui::Button("Save Chrome Trace"))
+    tracer->WriteChromeTrace(trace_path_);
+  ImGui::SliderInt("Frames", &trace_frames_, 10,
+                   static_cast<int>(Tracer::kFrameCapacity) - 1);
+  ImGui::Separator();
+  // Milliseconds per frame of each zone, nested zones are included in
+  // their parents
+  for (const auto& zone : tracer->FrameStats(trace_frames_)) {
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "mean %.3f ms, max %.3f ms", zone.mean,
+             zone.max);
+    ImGui::Text("%s", zone.name);
+    ImGui::PushID(zone.name);
+    ImGui::PlotLines("##ms", zone.ms.data(), static_cast<int>(zone.ms.size()),
+                     0, overlay, 0.0f, FLT_MAX, ImVec2(-1.0f, 40.0f));
+    ImGui::PopID();
+  }
+#else
+  ImGui::TextWrapped(
+      "Tracing is compiled out, configure with "
+      "-DGEOMETRY_LAB_ENABLE_TRACE=ON to record the zones.");
+#endif
+  ImGui::End();
+}
+
 }  // namespace geometry_lab
\ No newline at end of file
@@ -4,6 +4,7 @@
 #define GEOMETRY_LAB_RENDER_MAIN_WIDGET_HPP_
 
 #include <memory>
+#include <string>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -41,6 +42,12 @@ class MainWidget {
    * @brief Close the window and end the context.
   */
   void Close();
+  /**
+   * @brief Show the time spent in each traced zone over the last
+   *  frames, see @c GEOMETRY_LAB_TRACE_SCOPE().
+   * @param open[in] - Close button of the window, can be NULL.
+  */
+  void ShowTracePanel(bool* open = NULL);
 
   MainWidget() {}
   /**
@@ -54,14 +61,15 @@ class MainWidget {
   }
   /// main window
   GLFWwindow* main_window_ = nullptr;
+  /// Number of frames shown in the trace panel.
+  int trace_frames_ = 120;
+  /// Output of the Chrome trace saved from the trace panel.
+  std::string trace_path_ = "geometry_lab_trace.json";
 
  private:
-  /// Change the size of viewpot when the window size changes.
-  void viewport_callback() {
-    static int w, h;
-    glfwGetFramebufferSize(main_window_, &w, &h);
-    glViewport(0, 0, w, h);
-  }
+  /// Change the size of viewpot when the window size changes, GLFW
+  /// calls it from glfwPollEvents().
+  static void viewport_callback(GLFWwindow* window, int w, int h);
   /// Process IO inputs
   void io_callback() {
     // Esc to exit
@@ -1,53 +1,132 @@
 #include "mesh_painter.hpp"
 #include "shader.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#include "core/parallel.hpp"
+#include "core/trace.hpp"
+
 namespace geometry_lab {
+
+namespace {
+
+/// Entries of a colormap table.
+constexpr size_t kColormapSize = 256;
+using ColormapTable = std::array<glm::vec3, kColormapSize>;
+
+/// Unsigned normalized values of 8 and 16 bits, t in [0, 1].
+uint8_t PackUnorm8(float t) {
+  return static_cast<uint8_t>(std::clamp(t, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+uint16_t PackUnorm16(float t) {
+  return static_cast<uint16_t>(std::clamp(t, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+/// Signed normalized 10 bits of GL_INT_2_10_10_10_REV, GL 3.3 decodes
+/// c as (2c + 1) / 1023.
+uint32_t PackSnorm10(float v) {
+  const float c = std::round(0.5f * (std::clamp(v, -1.0f, 1.0f) * 1023.0f -
+                                     1.0f));
+  return static_cast<uint32_t>(static_cast<int32_t>(c)) & 0x3ffu;
+}
+/// Interpolate evenly spaced control colors into a table.
+template <size_t N>
+ColormapTable MakeColormap(const glm::vec3 (&stops)[N]) {
+  ColormapTable table;
+  for (size_t i = 0; i < kColormapSize; ++i) {
+    const float t = static_cast<float>(i * (N - 1)) / (kColormapSize - 1);
+    const size_t k = std::min(static_cast<size_t>(t), N - 2);
+    table[i] = glm::mix(stops[k], stops[k + 1], t - static_cast<float>(k));
+  }
+  return table;
+}
+
+const ColormapTable& LookupColormap(MeshPainter::Colormap map) {
+  static const glm::vec3 kViridis[] = {{0.267f, 0.005f, 0.329f},
+                                       {0.231f, 0.322f, 0.545f},
+                                       {0.129f, 0.569f, 0.549f},
+                                       {0.369f, 0.788f, 0.384f},
+                                       {0.992f, 0.906f, 0.145f}};
+  static const glm::vec3 kCoolWarm[] = {{0.230f, 0.299f, 0.754f},
+                                        {0.865f, 0.865f, 0.865f},
+                                        {0.706f, 0.016f, 0.150f}};
+  static const ColormapTable viridis = MakeColormap(kViridis);
+  static const ColormapTable cool_warm = MakeColormap(kCoolWarm);
+  return map == MeshPainter::Colormap::kCoolWarm ? cool_warm : viridis;
+}
+
+}  // namespace
+
 void MeshPainter::Draw() const {
+  GEOMETRY_LAB_TRACE_SCOPE("MeshPainter::Draw");
+  level_ = SelectLevel();
+  GEOMETRY_LAB_TRACE_COUNTER("Triangles", n_level_faces(level_));
+  // Every pass draws the triangles of the level
+  const GLsizei count = 3 * static_cast<GLsizei>(n_level_faces(level_));
+  const size_t first =
+      level_ == 0 ? 0 : indices_.size() + levels_[level_ - 1].first;
+  const void* offset =
+      reinterpret_cast<const void*>(first * sizeof(glm::ivec3));
+  // The camera and the light go to the frame uniform buffer, only
+  // uploaded when they changed since the last painter
+  FrameUniformBuffer::instance()->Update(
+      camera_.GetView(), camera_.GetProjection(), camera_.position_,
+      point_light_.position_, point_light_.color_, framebuffer_size());
   const glm::mat4 M = model_.GetModel();
-  const glm::mat4 V = camera_.GetView();
-  const glm::mat4 P = camera_.GetProjection();
+  // Quantized positions are relative to their box
+  glm::vec3 decode_offset(0.0f), decode_scale(1.0f);
+  if (vbo_layout_.quantize_positions) {
+    decode_offset = quantization_lo_;
+    decode_scale = quantization_hi_ - quantization_lo_;
+  }
   glBindVertexArray(vao_);
   switch (fill_mode_) {
     case FillMode::kLineAndFill: {
       // Firstly, draw faces
       glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-      MeshFillShader::instance()->Use();
-      MeshFillShader::instance()->set_parameters(M, V, P, camera_.position_,
-                                                 point_light_.position_,
-                                                 point_light_.color_);
-      glDrawElements(GL_TRIANGLES, 3 * static_cast<GLsizei>(indices_.size()),
-                     GL_UNSIGNED_INT, 0);
+      const auto& fill = *MeshFillShader::instance();
+      fill.Use();
+      fill.set_parameters(M, decode_offset, decode_scale);
+      glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, offset);
       // The, draw lines on the two sides
       glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-      MeshLineShader::instance()->Use();
-      MeshLineShader::instance()->set_parameters(M, V, P, camera_.position_,
-                                                 offset_);
-      glDrawElements(GL_TRIANGLES, 3 * static_cast<GLsizei>(indices_.size()),
-                     GL_UNSIGNED_INT, 0);
-      MeshLineShader::instance()->set_parameters(M, V, P, camera_.position_,
-                                                 -offset_);
-      glDrawElements(GL_TRIANGLES, 3 * static_cast<GLsizei>(indices_.size()),
-                     GL_UNSIGNED_INT, 0);
+      const auto& line = *MeshLineShader::instance();
+      line.Use();
+      line.set_parameters(M, decode_offset, decode_scale);
+      line.set_bias(offset_);
+      glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, offset);
+      line.set_bias(-offset_);
+      glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, offset);
 
       break;
     }
     case FillMode::kLine: {
       glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-      MeshLineShader::instance()->Use();
-      MeshLineShader::instance()->set_parameters(M, V, P, camera_.position_,
-                                                 0.0f);
-      glDrawElements(GL_TRIANGLES, 3 * static_cast<GLsizei>(indices_.size()),
-                     GL_UNSIGNED_INT, 0);
+      const auto& line = *MeshLineShader::instance();
+      line.Use();
+      line.set_parameters(M, decode_offset, decode_scale);
+      line.set_bias(0.0f);
+      glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, offset);
       break;
     }
     case FillMode::kFill: {
       glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-      MeshFillShader::instance()->Use();
-      MeshFillShader::instance()->set_parameters(M, V, P, camera_.position_,
-                                                 point_light_.position_,
-                                                 point_light_.color_);
-      glDrawElements(GL_TRIANGLES, 3 * static_cast<GLsizei>(indices_.size()),
-                     GL_UNSIGNED_INT, 0);
+      const auto& fill = *MeshFillShader::instance();
+      fill.Use();
+      fill.set_parameters(M, decode_offset, decode_scale);
+      glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, offset);
+      break;
+    }
+    case FillMode::kFillAndWire: {
+      // Distances to the edges from the geometry shader, one draw
+      glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+      const auto& wire = *MeshWireShader::instance();
+      wire.Use();
+      wire.set_parameters(M, decode_offset, decode_scale);
+      wire.set_wire(wire_width_, wire_color_);
+      glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, offset);
       break;
     }
     default:
@@ -55,41 +134,405 @@ void MeshPainter::Draw() const {
   }
   glBindVertexArray(0);
 }
+void MeshPainter::MapColors(const double* values, size_t stride, double lo,
+                            double hi, Colormap map) {
+  GEOMETRY_LAB_TRACE_SCOPE("MeshPainter::MapColors");
+  const ColormapTable& table = LookupColormap(map);
+  const double scale = hi > lo ? (kColormapSize - 1) / (hi - lo) : 0.0;
+  ParallelFor(0, vertices_.size(), [&](size_t i) {
+    const double value = values[i * stride];
+    if (!std::isfinite(value)) {
+      vertices_[i].color = glm::vec3(0.5f);
+      return;
+    }
+    const double t = std::clamp((value - lo) * scale, 0.0,
+                                static_cast<double>(kColormapSize - 1));
+    vertices_[i].color = table[static_cast<size_t>(t + 0.5)];
+  });
+  MarkVerticesDirty(0, vertices_.size(), kColorBit);
+}
+void MeshPainter::UpdatePositions(const float* positions, size_t first,
+                                  size_t count) {
+  assert(first + count <= vertices_.size());
+  ParallelFor(0, count, [&](size_t i) {
+    const float* p = positions + 3 * i;
+    vertices_[first + i].pos = {p[0], p[1], p[2]};
+  });
+  MarkVerticesDirty(first, count, kPositionBit);
+}
+void MeshPainter::UpdateNormals(const float* normals, size_t first,
+                                size_t count) {
+  assert(first + count <= vertices_.size());
+  ParallelFor(0, count, [&](size_t i) {
+    const float* n = normals + 3 * i;
+    vertices_[first + i].normal = {n[0], n[1], n[2]};
+  });
+  MarkVerticesDirty(first, count, kNormalBit);
+}
+void MeshPainter::UpdateNormals(const std::vector<int32_t>& ids,
+                                const std::vector<float>& normals) {
+  assert(normals.size() == 3 * vertices_.size());
+  if (ids.empty())
+    return;
+  int32_t lo = ids[0], hi = ids[0];
+  for (const int32_t i : ids) {
+    vertices_[i].normal = {normals[3 * i], normals[3 * i + 1],
+                           normals[3 * i + 2]};
+    lo = std::min(lo, i);
+    hi = std::max(hi, i);
+  }
+  MarkVerticesDirty(lo, hi - lo + 1, kNormalBit);
+}
+void MeshPainter::UpdateColors(const float* colors, size_t first,
+                               size_t count) {
+  assert(first + count <= vertices_.size());
+  ParallelFor(0, count, [&](size_t i) {
+    const float* c = colors + 3 * i;
+    vertices_[first + i].color = {c[0], c[1], c[2]};
+  });
+  MarkVerticesDirty(first, count, kColorBit);
+}
+void MeshPainter::MarkVerticesDirty(size_t first, size_t count,
+                                    uint32_t attributes) {
+  if (count == 0)
+    return;
+  ++vertex_generation_;
+  for (int a = 0; a < kAttributeCount; ++a) {
+    if (!(attributes & (1u << a)))
+      continue;
+    auto& dirty = dirty_[a];
+    dirty.push_back({first, first + count});
+    if (dirty.size() > kMaxDirtyRanges) {
+      // Too many small edits, send their span at once
+      Range all = dirty[0];
+      for (const Range& r : dirty) {
+        all.begin = std::min(all.begin, r.begin);
+        all.end = std::max(all.end, r.end);
+      }
+      dirty.assign(1, all);
+    }
+  }
+}
+void MeshPainter::UpdateLevels(
+    const std::vector<std::vector<int32_t>>& levels) {
+  levels_.clear();
+  level_indices_.clear();
+  for (const auto& level : levels) {
+    levels_.push_back({level_indices_.size(), level.size() / 3});
+    for (size_t i = 0; i + 2 < level.size(); i += 3)
+      level_indices_.emplace_back(level[i], level[i + 1], level[i + 2]);
+  }
+  level_ = 0;
+  ++index_generation_;
+}
+size_t MeshPainter::SelectLevel(const Camera& camera, const glm::mat4& model,
+                                size_t last) const {
+  if (!lod_enabled_ || levels_.empty())
+    return 0;
+  // Pixels covered by the bounding sphere, all of the screen when the
+  // camera is inside
+  const glm::ivec2 size = framebuffer_size();
+  const int w = size[0], h = size[1];
+  const float screen = static_cast<float>(w) * static_cast<float>(h);
+  float pixels = screen;
+  if (camera.type_ == Camera::ProjectionType::kOrthogonal) {
+    pixels = 3.14159265f * bounding_radius_ * bounding_radius_;
+  } else {
+    const glm::vec4 center =
+        camera.GetView() * model *
+        glm::vec4(bounding_center_.x, bounding_center_.y,
+                  bounding_center_.z, 1.0f);
+    const float depth = -center.z;
+    if (depth > bounding_radius_) {
+      const float radius =
+          0.5f * static_cast<float>(h) * bounding_radius_ /
+          (depth * std::tan(0.5f * glm::radians(camera.zoom_)));
+      pixels = 3.14159265f * radius * radius;
+    }
+  }
+  const float wanted = lod_density_ * std::min(pixels, screen);
+  // Coarsest level with enough triangles
+  size_t best = 0;
+  for (size_t i = 1; i < n_levels(); ++i) {
+    if (n_level_faces(i) >= wanted)
+      best = i;
+  }
+  // Leave the last level only when it is off by the margin
+  const float margin = 1.0f + lod_hysteresis_;
+  size_t level = std::min(last, n_levels() - 1);
+  if (best < level) {
+    if (n_level_faces(level) * margin < wanted)
+      level = best;
+  } else {
+    while (level < best && n_level_faces(level + 1) >= wanted * margin)
+      ++level;
+  }
+  return level;
+}
 void MeshPainter::InitGlBuffers() {
   glGenVertexArrays(1, &vao_);
   glBindVertexArray(vao_);
-  glGenBuffers(1, &vbo_);
+  glGenBuffers(kAttributeCount, vbos_);
   glGenBuffers(1, &ebo_);
   glBindVertexArray(0);
 }
+size_t MeshPainter::attribute_bytes(Attribute attribute,
+                                    const VertexLayout& layout) {
+  switch (attribute) {
+    case kPosition:
+      return layout.quantize_positions ? 4 * sizeof(uint16_t)
+                                       : 3 * sizeof(float);
+    case kNormal:
+      return layout.pack_normals ? sizeof(uint32_t) : 3 * sizeof(float);
+    case kColor:
+      return layout.pack_colors ? 4 * sizeof(uint8_t) : 3 * sizeof(float);
+    default:
+      assert(false);
+      return 0;
+  }
+}
+size_t MeshPainter::vertex_bytes() const {
+  return attribute_bytes(kPosition) + attribute_bytes(kNormal) +
+         attribute_bytes(kColor);
+}
+void MeshPainter::PackVertices(Attribute attribute, const VertexLayout& layout,
+                               const glm::vec3& lo, const glm::vec3& hi,
+                               size_t first, size_t count,
+                               uint8_t* out) const {
+  assert(first + count <= vertices_.size());
+  const size_t bytes = attribute_bytes(attribute, layout);
+  const glm::vec3 extent = hi - lo;
+  glm::vec3 scale(0.0f);
+  for (int k = 0; k < 3; ++k)
+    scale[k] = extent[k] > 0.0f ? 1.0f / extent[k] : 0.0f;
+  ParallelFor(first, first + count, [&](size_t i) {
+    uint8_t* dst = out + (i - first) * bytes;
+    const VertInfo& v = vertices_[i];
+    switch (attribute) {
+      case kPosition:
+        if (layout.quantize_positions) {
+          const glm::vec3 t = (v.pos - lo) * scale;
+          const uint16_t q[4] = {PackUnorm16(t.x), PackUnorm16(t.y),
+                                 PackUnorm16(t.z), 0};
+          std::memcpy(dst, q, sizeof(q));
+        } else {
+          std::memcpy(dst, &v.pos[0], 3 * sizeof(float));
+        }
+        break;
+      case kNormal:
+        if (layout.pack_normals) {
+          const uint32_t q = PackSnorm10(v.normal.x) |
+                             PackSnorm10(v.normal.y) << 10 |
+                             PackSnorm10(v.normal.z) << 20;
+          std::memcpy(dst, &q, sizeof(q));
+        } else {
+          std::memcpy(dst, &v.normal[0], 3 * sizeof(float));
+        }
+        break;
+      case kColor:
+        if (layout.pack_colors) {
+          const uint8_t q[4] = {PackUnorm8(v.color[0]), PackUnorm8(v.color[1]),
+                                PackUnorm8(v.color[2]), 255};
+          std::memcpy(dst, q, sizeof(q));
+        } else {
+          std::memcpy(dst, &v.color[0], 3 * sizeof(float));
+        }
+        break;
+      default:
+        assert(false);
+    }
+  });
+}
+void MeshPainter::MergeRanges(std::vector<Range>& ranges) {
+  if (ranges.empty())
+    return;
+  std::sort(ranges.begin(), ranges.end(),
+            [](const Range& a, const Range& b) { return a.begin < b.begin; });
+  size_t merged = 0;
+  for (size_t i = 1; i < ranges.size(); ++i) {
+    if (ranges[i].begin <= ranges[merged].end + kMergeGap)
+      ranges[merged].end = std::max(ranges[merged].end, ranges[i].end);
+    else
+      ranges[++merged] = ranges[i];
+  }
+  ranges.resize(merged + 1);
+}
+void MeshPainter::ComputeBoundingSphere() {
+  // Around the center of the box, blocks reduce their own extents
+  const size_t n_blocks = ParallelBlockCount(vertices_.size());
+  std::vector<glm::vec3> lo(n_blocks, vertices_[0].pos);
+  std::vector<glm::vec3> hi(n_blocks, vertices_[0].pos);
+  ParallelBlocks(vertices_.size(), [&](size_t block, size_t b, size_t e) {
+    for (size_t i = b; i < e; ++i) {
+      lo[block] = glm::min(lo[block], vertices_[i].pos);
+      hi[block] = glm::max(hi[block], vertices_[i].pos);
+    }
+  });
+  for (size_t k = 1; k < n_blocks; ++k) {
+    lo[0] = glm::min(lo[0], lo[k]);
+    hi[0] = glm::max(hi[0], hi[k]);
+  }
+  box_lo_ = lo[0];
+  box_hi_ = hi[0];
+  bounding_center_ = 0.5f * (box_lo_ + box_hi_);
+  std::vector<float> radius2(n_blocks, 0.0f);
+  ParallelBlocks(vertices_.size(), [&](size_t block, size_t b, size_t e) {
+    for (size_t i = b; i < e; ++i) {
+      const glm::vec3 d = vertices_[i].pos - bounding_center_;
+      radius2[block] = std::max(radius2[block], glm::dot(d, d));
+    }
+  });
+  bounding_radius_ =
+      std::sqrt(*std::max_element(radius2.begin(), radius2.end()));
+}
+void MeshPainter::GrowBoundingSphere(const std::vector<Range>& ranges) {
+  for (const Range& r : ranges) {
+    const size_t n_blocks = ParallelBlockCount(r.end - r.begin);
+    std::vector<glm::vec3> lo(n_blocks, box_lo_), hi(n_blocks, box_hi_);
+    std::vector<float> radius2(n_blocks, bounding_radius_ * bounding_radius_);
+    ParallelBlocks(r.end - r.begin, [&](size_t block, size_t b, size_t e) {
+      for (size_t i = r.begin + b; i < r.begin + e; ++i) {
+        const glm::vec3& p = vertices_[i].pos;
+        lo[block] = glm::min(lo[block], p);
+        hi[block] = glm::max(hi[block], p);
+        const glm::vec3 d = p - bounding_center_;
+        radius2[block] = std::max(radius2[block], glm::dot(d, d));
+      }
+    });
+    for (size_t k = 0; k < n_blocks; ++k) {
+      box_lo_ = glm::min(box_lo_, lo[k]);
+      box_hi_ = glm::max(box_hi_, hi[k]);
+    }
+    bounding_radius_ =
+        std::sqrt(*std::max_element(radius2.begin(), radius2.end()));
+  }
+}
+void MeshPainter::SetAttributePointer(Attribute attribute,
+                                      const VertexLayout& layout) {
+  const GLuint a = attribute;
+  switch (attribute) {
+    case kPosition:
+      if (layout.quantize_positions)
+        glVertexAttribPointer(a, 4, GL_UNSIGNED_SHORT, GL_TRUE, 0, 0);
+      else
+        glVertexAttribPointer(a, 3, GL_FLOAT, GL_FALSE, 0, 0);
+      break;
+    case kNormal:
+      if (layout.pack_normals)
+        glVertexAttribPointer(a, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 0, 0);
+      else
+        glVertexAttribPointer(a, 3, GL_FLOAT, GL_FALSE, 0, 0);
+      break;
+    default:
+      if (layout.pack_colors)
+        glVertexAttribPointer(a, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, 0);
+      else
+        glVertexAttribPointer(a, 3, GL_FLOAT, GL_FALSE, 0, 0);
+  }
+  glEnableVertexAttribArray(a);
+}
 void MeshPainter::LoadVertexBuffer() {
+  GEOMETRY_LAB_TRACE_SCOPE("MeshPainter::LoadVertexBuffer");
   assert(vertices_.size() > 0);
+  ++vertex_generation_;
+  ComputeBoundingSphere();
+  quantization_lo_ = box_lo_;
+  quantization_hi_ = box_hi_;
+  // Same size and formats, overwrite the storage instead of
+  // allocating it again
+  const bool allocate =
+      vbo_vertices_ != vertices_.size() || vbo_layout_ != layout_;
   glBindVertexArray(vao_);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-  glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(vertices_[0]),
-               vertices_.data(), GL_STATIC_DRAW);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertices_[0]),
-                        (void*)0);
-  glEnableVertexAttribArray(0);  // Vertex Position
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertices_[0]),
-                        (void*)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);  // Vertex Normal
-  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertices_[0]),
-                        (void*)(6 * sizeof(float)));
-  glEnableVertexAttribArray(2);  // Vertex Color
+  for (int a = 0; a < kAttributeCount; ++a) {
+    const Attribute attribute = static_cast<Attribute>(a);
+    const size_t size = vertices_.size() * attribute_bytes(attribute);
+    staging_.resize(size);
+    PackAttribute(attribute, {0, vertices_.size()}, staging_.data());
+    glBindBuffer(GL_ARRAY_BUFFER, vbos_[a]);
+    if (!allocate) {
+      glBufferSubData(GL_ARRAY_BUFFER, 0, size, staging_.data());
+      continue;
+    }
+    // Dynamic, animated meshes stream into it every frame
+    glBufferData(GL_ARRAY_BUFFER, size, staging_.data(), GL_DYNAMIC_DRAW);
+    SetAttributePointer(attribute, layout_);
+  }
   glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  vbo_vertices_ = vertices_.size();
+  vbo_layout_ = layout_;
+  for (auto& dirty : dirty_)
+    dirty.clear();
+}
+void MeshPainter::UpdateVertexBuffer() {
+  if (vbo_vertices_ != vertices_.size() || vbo_layout_ != layout_) {
+    LoadVertexBuffer();
+    return;
+  }
+  GEOMETRY_LAB_TRACE_SCOPE("MeshPainter::UpdateVertexBuffer");
+  if (!dirty_[kPosition].empty()) {
+    GrowBoundingSphere(dirty_[kPosition]);
+    // Quantized positions out of their box, quantize all of them in a
+    // larger one so that small motions do not do it again. The grown
+    // bounds are loose, they are computed again for the new box
+    bool inside = true;
+    for (int k = 0; k < 3; ++k) {
+      inside = inside && box_lo_[k] >= quantization_lo_[k] &&
+               box_hi_[k] <= quantization_hi_[k];
+    }
+    if (layout_.quantize_positions && !inside) {
+      ComputeBoundingSphere();
+      const glm::vec3 margin = 0.125f * (box_hi_ - box_lo_);
+      quantization_lo_ = box_lo_ - margin;
+      quantization_hi_ = box_hi_ + margin;
+      dirty_[kPosition].assign(1, {0, vertices_.size()});
+    }
+  }
+  size_t uploaded = 0;
+  for (int a = 0; a < kAttributeCount; ++a) {
+    auto& dirty = dirty_[a];
+    if (dirty.empty())
+      continue;
+    const Attribute attribute = static_cast<Attribute>(a);
+    const size_t bytes = attribute_bytes(attribute);
+    MergeRanges(dirty);
+    glBindBuffer(GL_ARRAY_BUFFER, vbos_[a]);
+    for (const Range& r : dirty) {
+      staging_.resize((r.end - r.begin) * bytes);
+      PackAttribute(attribute, r, staging_.data());
+      glBufferSubData(GL_ARRAY_BUFFER, r.begin * bytes, staging_.size(),
+                      staging_.data());
+      uploaded += staging_.size();
+    }
+    dirty.clear();
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  GEOMETRY_LAB_TRACE_COUNTER("Uploaded bytes", uploaded);
 }
 void MeshPainter::LoadElementBuffer() {
+  GEOMETRY_LAB_TRACE_SCOPE("MeshPainter::LoadElementBuffer");
   assert(indices_.size() > 0);
+  ++index_generation_;
   glBindVertexArray(vao_);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(indices_[0]),
-               indices_.data(), GL_STATIC_DRAW);
+  // One buffer, the levels of detail after the full mesh
+  const size_t size = indices_.size() * sizeof(indices_[0]);
+  const size_t level_size = level_indices_.size() * sizeof(glm::ivec3);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, size + level_size, nullptr,
+               GL_STATIC_DRAW);
+  glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, size, indices_.data());
+  if (level_size > 0) {
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, size, level_size,
+                    level_indices_.data());
+  }
   glBindVertexArray(0);
 }
 MeshPainter::~MeshPainter() {
+  // Nothing was sent to GL, e.g. a painter generated without context
+  if (vao_ == 0)
+    return;
   glDeleteBuffers(1, &ebo_);
-  glDeleteBuffers(1, &vbo_);
+  glDeleteBuffers(kAttributeCount, vbos_);
   glDeleteVertexArrays(1, &vao_);
 }
 }  // namespace geometry_lab
\ No newline at end of file
@@ -4,6 +4,7 @@
 #define GEOMETRY_LAB_RENDER_MESH_PAINTER
 
 #include <cassert>
+#include <cstdint>
 #include <vector>
 
 #include "painter.hpp"
@@ -14,16 +15,61 @@ namespace geometry_lab {
  * @brief Load mesh info to the GL buffer for rendering, we
  *  seperate the rendering object and computing object in the 
  *  engine, and bind them in loader.hpp.
+ *
+ *  Coarser index sets over the same vertices can be added as levels
+ *  of detail, they follow @c indices_ in the element buffer. @c Draw()
+ *  estimates the pixels covered by the bounding sphere of the mesh
+ *  and draws the coarsest level with about @c lod_density_ triangles
+ *  per pixel, so the cost of a frame follows the screen size rather
+ *  than the size of the mesh.
+ *
+ *  @c vertices_ is the editable copy of the vertices. Each attribute
+ *  goes to the GPU in its own buffer in the format of @c layout_, so
+ *  recoloring does not send the positions again and a vertex takes
+ *  16 to 20 bytes instead of 36 by default.
 */
 class MeshPainter : public Painter {
  public:
   /**
-   * @brief Package the properties of a vertex and send
-   *  them to the buffer together.
+   * @brief Package the properties of a vertex, packed by
+   *  attribute when sent to the buffers.
   */
   struct VertInfo {
     glm::vec3 pos, normal, color;
   };
+  /**
+   * @brief Vertex attributes, the location and buffer index of each.
+  */
+  enum Attribute {
+    kPosition = 0,
+    kNormal,
+    kColor,
+    kAttributeCount,
+  };
+  /// Bits of the attributes in the masks of @c MarkVerticesDirty().
+  static constexpr uint32_t kPositionBit = 1u << kPosition;
+  static constexpr uint32_t kNormalBit = 1u << kNormal;
+  static constexpr uint32_t kColorBit = 1u << kColor;
+  static constexpr uint32_t kAllBits = kPositionBit | kNormalBit | kColorBit;
+  /**
+   * @brief Formats of the vertex buffers, changes are sent by the next
+   *  @c LoadVertexBuffer() or @c UpdateVertexBuffer().
+  */
+  struct VertexLayout {
+    /// Positions as 16-bit normalized values in the bounding box
+    /// (8 bytes), or floats (12 bytes).
+    bool quantize_positions = false;
+    /// Normals as GL_INT_2_10_10_10_REV (4 bytes), or floats.
+    bool pack_normals = true;
+    /// Colors as normalized RGBA8 (4 bytes), or floats.
+    bool pack_colors = true;
+
+    bool operator==(const VertexLayout& o) const {
+      return quantize_positions == o.quantize_positions &&
+             pack_normals == o.pack_normals && pack_colors == o.pack_colors;
+    }
+    bool operator!=(const VertexLayout& o) const { return !(*this == o); }
+  };
   /**
    * @brief Fill the triangles or draw the line sketch.
   */
@@ -34,59 +80,239 @@ class MeshPainter : public Painter {
     kLine,
     /// Only fill the faces.
     kFill,
+    /// Fill the faces with the wires blended in the same pass, see
+    /// @c wire_width_.
+    kFillAndWire,
+  };
+  /**
+   * @brief Colormaps of @c MapColors().
+  */
+  enum class Colormap {
+    /// Sequential, dark purple to yellow.
+    kViridis = 0,
+    /// Diverging, blue to gray to red, for signed values.
+    kCoolWarm,
+  };
+  /**
+   * @brief Range of triangles of a level of detail in the element
+   *  buffer.
+  */
+  struct Level {
+    size_t first = 0, count = 0;
   };
   /**
    * @brief Call this function to draw!
   */
   void Draw() const;
+  /**
+   * @brief Update the positions of a range of @c vertices_, marked
+   *  dirty for @c UpdateVertexBuffer().
+   * @param positions[in] - New positions of the range, (x,y,z) in a row.
+   * @param first[in] - First vertex of the range.
+   * @param count[in] - Number of vertices of the range.
+  */
+  void UpdatePositions(const float* positions, size_t first, size_t count);
+  /**
+   * @brief Update the normals of a range of @c vertices_, see
+   *  @c UpdatePositions().
+  */
+  void UpdateNormals(const float* normals, size_t first, size_t count);
+  /**
+   * @brief Update the colors of a range of @c vertices_, see
+   *  @c UpdatePositions().
+  */
+  void UpdateColors(const float* colors, size_t first, size_t count);
   /**
    * @brief Update the position infomation in @c vertices_.
    * @param positions[in] - New positions for updating. 
   */
   void UpdatePositions(const std::vector<glm::vec3>& positions) {
     assert(positions.size() == vertices_.size());
-    for (size_t i = 0; i < positions.size(); ++i) {
-      vertices_[i].pos = positions[i];
-    }
+    UpdatePositions(reinterpret_cast<const float*>(positions.data()), 0,
+                    positions.size());
+  }
+  /**
+   * @brief Update the position infomation in @c vertices_ from a flat
+   *  array, e.g. @c LoopSubdivision::positions_.
+   * @param positions[in] - New positions, (x,y,z) in a row.
+  */
+  void UpdatePositions(const std::vector<float>& positions) {
+    assert(positions.size() == 3 * vertices_.size());
+    UpdatePositions(positions.data(), 0, vertices_.size());
   }
   /**
    * @brief Update the normal infomation in @c vertices_.
-   * @param normals[in] - New normals for updating. 
+   * @param normals[in] - New normals for updating.
   */
   void UpdateNormals(const std::vector<glm::vec3>& normals) {
     assert(normals.size() == vertices_.size());
-    for (size_t i = 0; i < normals.size(); ++i) {
-      vertices_[i].normal = normals[i];
-    }
+    UpdateNormals(reinterpret_cast<const float*>(normals.data()), 0,
+                  normals.size());
+  }
+  /**
+   * @brief Update the normal infomation in @c vertices_ from a flat
+   *  array, e.g. @c LoopSubdivision::normals_.
+   * @param normals[in] - New normals, (x,y,z) in a row.
+  */
+  void UpdateNormals(const std::vector<float>& normals) {
+    assert(normals.size() == 3 * vertices_.size());
+    UpdateNormals(normals.data(), 0, vertices_.size());
   }
+  /**
+   * @brief Update the normals of some vertices in @c vertices_, e.g.
+   *  the output of @c TriMesh::UpdateVertexNormals(). The range from
+   *  the smallest to the largest index is marked dirty.
+   * @param ids[in] - Indices of the vertices for updating.
+   * @param normals[in] - Normals of all the vertices, (x,y,z) in a row.
+  */
+  void UpdateNormals(const std::vector<int32_t>& ids,
+                     const std::vector<float>& normals);
   /**
    * @brief Update the color infomation in @c vertices_.
    * @param colors[in] - New colors for updating. 
   */
   void UpdateColors(const std::vector<glm::vec3>& colors) {
     assert(colors.size() == vertices_.size());
-    for (size_t i = 0; i < colors.size(); ++i) {
-      vertices_[i].color = colors[i];
-    }
+    UpdateColors(reinterpret_cast<const float*>(colors.data()), 0,
+                 colors.size());
   }
+  /**
+   * @brief Mark a range of @c vertices_ edited in place, e.g. a few
+   *  colors, to be sent by the next @c UpdateVertexBuffer().
+   * @param first[in] - First vertex of the range.
+   * @param count[in] - Number of vertices of the range.
+   * @param attributes[in] - Bits of the attributes that changed, the
+   *                         bounding sphere is updated with the
+   *                         positions.
+  */
+  void MarkVerticesDirty(size_t first, size_t count,
+                         uint32_t attributes = kAllBits);
+  /**
+   * @brief Color the vertices by a scalar field through a colormap,
+   *  written straight into @c vertices_ in parallel without building
+   *  a color array.
+   * @param values[in] - Value of vertex i at values[i * stride], e.g.
+   *                     a flat array of @c CurvatureEngine.
+   * @param stride[in] - Distance between the values of two vertices.
+   * @param lo[in] - Value at the start of the colormap.
+   * @param hi[in] - Value at the end of the colormap, the values out
+   *                 of the range are clamped and the non-finite ones
+   *                 are gray.
+   * @param map[in] - The colormap.
+  */
+  void MapColors(const double* values, size_t stride, double lo, double hi,
+                 Colormap map = Colormap::kViridis);
   /**
    * @brief Update the indices of faces, using std::move().
    * @param indices[in] - New indices for updating. 
   */
   void UpdateIndices(std::vector<glm::ivec3>& indices) {
     indices_ = std::move(indices);
+    ++index_generation_;
   }
+  /**
+   * @brief Replace the levels of detail, sent to the GPU by
+   *  @c LoadElementBuffer().
+   * @param levels[in] - Triangles of each level over the vertices of
+   *                     @c vertices_, 3 indices each, from the finest
+   *                     to the coarsest. Empty to draw @c indices_
+   *                     only.
+  */
+  void UpdateLevels(const std::vector<std::vector<int32_t>>& levels);
+  /**
+   * @brief Level @c Draw() would pick for the current view, level 0
+   *  is @c indices_. It keeps the last level unless the number of
+   *  triangles wanted leaves it by more than @c lod_hysteresis_.
+   * @return The level.
+  */
+  size_t SelectLevel() const {
+    return SelectLevel(camera_, model_.GetModel(), level_);
+  }
+  /**
+   * @brief Level for any view of the mesh, see @c SelectLevel().
+   * @param camera[in] - The camera.
+   * @param model[in] - Model matrix of the mesh, rigid or shrinking.
+   * @param last[in] - Level of the last frame.
+   * @return The level.
+  */
+  size_t SelectLevel(const Camera& camera, const glm::mat4& model,
+                     size_t last) const;
+  /**
+   * @return Number of triangles of a level, level 0 is @c indices_.
+  */
+  size_t n_level_faces(size_t level) const {
+    return level == 0 ? indices_.size() : levels_[level - 1].count;
+  }
+  /**
+   * @return Number of levels, including @c indices_.
+  */
+  size_t n_levels() const { return levels_.size() + 1; }
   /**
    * @brief Initialize the buffers, including VAO,VBO,and VEO.
   */
   void InitGlBuffers();
   /**
    * @brief Load vertex buffer. Send all the vertices information
-   *  to the GPU.
+   *  to the GPU, the storage is only allocated again when the number
+   *  of vertices changed.
   */
   void LoadVertexBuffer();
   /**
-   * @brief Load element buffer. Send all the indices to the GPU.
+   * @brief Send the dirty ranges of @c vertices_ to the GPU with
+   *  glBufferSubData(), only in the buffers of the attributes that
+   *  changed. Everything goes through @c LoadVertexBuffer() when the
+   *  number of vertices or @c layout_ changed. Nearby ranges are
+   *  merged into one upload. The bounds only grow to the edited
+   *  positions, see @c GrowBoundingSphere().
+  */
+  void UpdateVertexBuffer();
+  /**
+   * @return Bytes of a vertex in the buffers with @c layout_.
+  */
+  size_t vertex_bytes() const;
+  /**
+   * @brief Write an attribute of a range of @c vertices_ in the format
+   *  of a layout, e.g. into the shared buffers of @c SceneRenderer.
+   * @param attribute[in] - The attribute.
+   * @param layout[in] - Formats of the buffers.
+   * @param lo[in] - Box of the quantized positions, from lo
+   * @param hi[in] - to hi.
+   * @param first[in] - First vertex of the range.
+   * @param count[in] - Number of vertices of the range.
+   * @param out[out] - Packed values, the bytes of the range.
+  */
+  void PackVertices(Attribute attribute, const VertexLayout& layout,
+                    const glm::vec3& lo, const glm::vec3& hi, size_t first,
+                    size_t count, uint8_t* out) const;
+  /**
+   * @brief Bytes of a vertex in the buffer of an attribute.
+  */
+  static size_t attribute_bytes(Attribute attribute,
+                                const VertexLayout& layout);
+  /**
+   * @brief Point an attribute of the bound vertex array at the bound
+   *  GL_ARRAY_BUFFER in the format of a layout, and enable it.
+  */
+  static void SetAttributePointer(Attribute attribute,
+                                  const VertexLayout& layout);
+  /**
+   * @brief Bounding box and sphere of @c vertices_, in parallel, done
+   *  by @c LoadVertexBuffer() and when the positions are quantized in
+   *  a new box.
+  */
+  void ComputeBoundingSphere();
+  /// Bounding box of the positions of the last
+  /// @c ComputeBoundingSphere().
+  const glm::vec3& box_lo() const { return box_lo_; }
+  const glm::vec3& box_hi() const { return box_hi_; }
+  /// Counters bumped when @c vertices_ or the triangles change, from
+  /// the dirty marks and the loads of the buffers, e.g. for
+  /// @c SceneRenderer to send the mesh again.
+  uint64_t vertex_generation() const { return vertex_generation_; }
+  uint64_t index_generation() const { return index_generation_; }
+  /**
+   * @brief Load element buffer. Send all the indices to the GPU,
+   *  @c indices_ then the levels of detail.
   */
   void LoadElementBuffer();
   /**
@@ -103,8 +329,11 @@ class MeshPainter : public Painter {
    * @brief Release the buffers when deconstruct.
   */
   ~MeshPainter();
-  /// GL Buffers
-  GLuint vao_ = 0, vbo_ = 0, ebo_ = 0;
+  /// GL Buffers, one vertex buffer per attribute
+  GLuint vao_ = 0, ebo_ = 0;
+  GLuint vbos_[kAttributeCount] = {0, 0, 0};
+  /// Formats of the vertex buffers.
+  VertexLayout layout_;
   /// Draw the sketch or fill the faces?
   FillMode fill_mode_ = FillMode::kLineAndFill;
   /// Properties of vertices
@@ -114,6 +343,84 @@ class MeshPainter : public Painter {
   /// When draw the lines at the same time of faces, we need to
   /// draw twice with a offset on both sides.
   float offset_ = 1e-4f;
+  /// Width in pixels and color of the wires of
+  /// @c FillMode::kFillAndWire.
+  float wire_width_ = 1.0f;
+  glm::vec3 wire_color_ = {0.0f, 0.0f, 0.0f};
+  /// Triangles of the levels of detail, after @c indices_ in the
+  /// element buffer.
+  std::vector<glm::ivec3> level_indices_;
+  /// Levels of detail coarser than @c indices_, the first triangle
+  /// counts from the start of @c level_indices_.
+  std::vector<Level> levels_;
+  /// Pick a level of detail in @c Draw()? Otherwise draw @c indices_.
+  bool lod_enabled_ = true;
+  /// Triangles wanted per covered pixel.
+  float lod_density_ = 0.5f;
+  /// Relative margin of the triangles wanted before changing level.
+  float lod_hysteresis_ = 0.3f;
+  /// Bounding sphere of the vertices in the model frame, computed by
+  /// @c LoadVertexBuffer() and grown by @c UpdateVertexBuffer().
+  glm::vec3 bounding_center_ = {0.0f, 0.0f, 0.0f};
+  float bounding_radius_ = 0.0f;
+  /// Level drawn by the last @c Draw().
+  mutable size_t level_ = 0;
+
+ private:
+  /**
+   * @brief Range [begin, end) of vertices.
+  */
+  struct Range {
+    size_t begin = 0, end = 0;
+  };
+  /**
+   * @brief Write an attribute of a range of vertices in its buffer
+   *  format.
+   * @param attribute[in] - The attribute.
+   * @param range[in] - The vertices.
+   * @param out[out] - Packed values, the bytes of the range.
+  */
+  void PackAttribute(Attribute attribute, const Range& range,
+                     uint8_t* out) const {
+    PackVertices(attribute, layout_, quantization_lo_, quantization_hi_,
+                 range.begin, range.end - range.begin, out);
+  }
+  /**
+   * @brief Bytes of a vertex in the buffer of an attribute with
+   *  @c layout_.
+  */
+  size_t attribute_bytes(Attribute attribute) const {
+    return attribute_bytes(attribute, layout_);
+  }
+  /**
+   * @brief Sort the ranges and merge the ones closer than @c kMergeGap.
+  */
+  static void MergeRanges(std::vector<Range>& ranges);
+  /**
+   * @brief Grow the bounding box and sphere to the vertices of some
+   *  ranges, the others are not read. The sphere keeps its center, so
+   *  it still holds the vertices outside the ranges, and neither
+   *  bound ever shrinks.
+   * @param ranges[in] - The vertices whose positions changed.
+  */
+  void GrowBoundingSphere(const std::vector<Range>& ranges);
+  /// More dirty ranges than this are merged into one.
+  static constexpr size_t kMaxDirtyRanges = 64;
+  /// Ranges closer than this, in vertices, are uploaded together.
+  static constexpr size_t kMergeGap = 1024;
+  /// Vertices edited since the last upload, for each attribute.
+  std::vector<Range> dirty_[kAttributeCount];
+  /// Bounding box of the positions, and the box the quantized
+  /// positions of the buffer are relative to.
+  glm::vec3 box_lo_ = glm::vec3(0.0f), box_hi_ = glm::vec3(0.0f);
+  glm::vec3 quantization_lo_ = glm::vec3(0.0f);
+  glm::vec3 quantization_hi_ = glm::vec3(0.0f);
+  /// Packed values of the uploads.
+  std::vector<uint8_t> staging_;
+  /// Number of vertices and formats of the storage of @c vbos_.
+  size_t vbo_vertices_ = 0;
+  VertexLayout vbo_layout_;
+  uint64_t vertex_generation_ = 0, index_generation_ = 0;
 };
 
 }  // namespace geometry_lab
@@ -57,9 +57,8 @@ class Painter {
      * @return The projection matrix.
     */
     glm::mat4 GetProjection() const {
-      static int w, h;
-      const auto& current_window = glfwGetCurrentContext();
-      glfwGetFramebufferSize(current_window, &w, &h);
+      const glm::ivec2 size = framebuffer_size();
+      const int w = size[0], h = size[1];
       float aspect = (h == 0) ? 1.0f : (float)w / (float)h;
       switch (type_) {
         case ProjectionType::kPerspective:
@@ -135,12 +134,44 @@ class Painter {
       }
     }
   }
+  /**
+   * @brief Ray through the mouse cursor in the frame of the model,
+   *  e.g. for picking, the near plane is at t = 0 and the far plane
+   *  at t = 1.
+   * @param origin[out] - Point under the cursor on the near plane.
+   * @param direction[out] - From the near plane to the far plane.
+  */
+  void MouseRay(glm::vec3& origin, glm::vec3& direction) const {
+    const auto& io = ImGui::GetIO();
+    const float x = 2.0f * io.MousePos.x / io.DisplaySize.x - 1.0f;
+    const float y = 1.0f - 2.0f * io.MousePos.y / io.DisplaySize.y;
+    const glm::mat4 inv = glm::inverse(
+        camera_.GetProjection() * camera_.GetView() * model_.GetModel());
+    const glm::vec4 front = inv * glm::vec4(x, y, -1.0f, 1.0f);
+    const glm::vec4 back = inv * glm::vec4(x, y, 1.0f, 1.0f);
+    origin = glm::vec3(front) / front.w;
+    direction = glm::vec3(back) / back.w - origin;
+  }
   Painter() {}
+  /**
+   * @brief Size of the framebuffer in pixels shared by all painters,
+   *  kept by the main widget so that drawing never asks GLFW for it.
+  */
+  static glm::ivec2 framebuffer_size() { return framebuffer(); }
+  static void set_framebuffer_size(int width, int height) {
+    framebuffer() = glm::ivec2(width, height);
+  }
   /// Parameter for converting mouse movement to position.
   float move_sensitivity_ = 0.001f;
   Model model_;
   Camera camera_;
   PointLight point_light_;
+
+ private:
+  static glm::ivec2& framebuffer() {
+    static glm::ivec2 size(0, 0);
+    return size;
+  }
 };
 
 }  // namespace geometry_lab
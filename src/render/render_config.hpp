@@ -10,5 +10,6 @@
 
 #define GEOMETRY_LAB_MESH_FILL_VERT "E:/fitting-driven-para/code/fitting-driven-para/extend/geometry-lab/src/render/shader/mesh_fill.vert"
 #define GEOMETRY_LAB_MESH_FILL_FRAG "E:/fitting-driven-para/code/fitting-driven-para/extend/geometry-lab/src/render/shader/mesh_fill.frag"
+#define GEOMETRY_LAB_MESH_WIRE_GEOM "E:/fitting-driven-para/code/fitting-driven-para/extend/geometry-lab/src/render/shader/mesh_wire.geom"
 #define GEOMETRY_LAB_MESH_LINE_VERT "E:/fitting-driven-para/code/fitting-driven-para/extend/geometry-lab/src/render/shader/mesh_line.vert"
 #define GEOMETRY_LAB_MESH_LINE_FRAG "E:/fitting-driven-para/code/fitting-driven-para/extend/geometry-lab/src/render/shader/mesh_line.frag"
@@ -0,0 +1,430 @@
+#include "scene_renderer.hpp"
+#include "shader.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "core/trace.hpp"
+
+namespace geometry_lab {
+
+namespace {
+
+/// Floats of a mesh and of an instance in the buffer textures.
+constexpr size_t kMeshFloats = 8;
+constexpr size_t kInstanceFloats = 16;
+
+/**
+ * @brief Storage of a buffer grown to a number of bytes, the bytes in
+ *  use are copied on the GPU.
+ * @return The new buffer, the old one is deleted.
+*/
+GLuint GrowBuffer(GLuint buffer, size_t used, size_t bytes) {
+  GLuint grown = 0;
+  glGenBuffers(1, &grown);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+  glBufferData(GL_COPY_WRITE_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW);
+  if (used > 0) {
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                        used);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  if (buffer != 0)
+    glDeleteBuffers(1, &buffer);
+  return grown;
+}
+/**
+ * @brief Send the content of a buffer texture when it changed.
+ * @param buffer[in] - The buffer.
+ * @param data[in] - New content.
+ * @param last[in,out] - Content of the last upload.
+*/
+void UploadTexels(GLuint buffer, const std::vector<float>& data,
+                  std::vector<float>& last) {
+  if (data == last)
+    return;
+  glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+  if (data.size() != last.size()) {
+    glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(float), data.data(),
+                 GL_DYNAMIC_DRAW);
+  } else {
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, data.size() * sizeof(float),
+                    data.data());
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  last = data;
+}
+
+}  // namespace
+
+void SceneRenderer::Draw() const {
+  GEOMETRY_LAB_TRACE_SCOPE("SceneRenderer::Draw");
+  n_draw_calls_ = 0;
+  if (meshes_.empty())
+    return;
+  // The model of the scene goes into the view, the camera and the
+  // light are moved into the scene instead, the same for a rigid model
+  const glm::mat4 M = model_.GetModel();
+  const glm::mat4 inverse = glm::inverse(M);
+  const glm::vec3 view_pos(inverse * glm::vec4(camera_.position_, 1.0f));
+  const glm::vec3 light_pos(inverse *
+                            glm::vec4(point_light_.position_, 1.0f));
+  FrameUniformBuffer::instance()->Update(
+      camera_.GetView() * M, camera_.GetProjection(), view_pos, light_pos,
+      point_light_.color_, framebuffer_size());
+  // 1. Draws of the meshes by pass, at the finest level any instance
+  //    needs
+  for (auto& batch : batches_)
+    batch.clear();
+  size_t n_triangles = 0;
+  for (const Mesh& mesh : meshes_) {
+    const MeshPainter& painter = *mesh.painter;
+    size_t level = mesh.levels.size();
+    for (size_t i = 0; i < mesh.n_instances && level > 0; ++i) {
+      const glm::mat4& model = models_[mesh.first_instance + i];
+      level = std::min(level, painter.SelectLevel(camera_, M * model,
+                                                  mesh.level));
+    }
+    mesh.level = level;
+    const size_t faces =
+        level == 0 ? mesh.n_faces : mesh.levels[level - 1].count;
+    const size_t first =
+        level == 0 ? 0 : mesh.n_faces + mesh.levels[level - 1].first;
+    const GLsizei count = 3 * static_cast<GLsizei>(faces);
+    const void* offset = reinterpret_cast<const void*>(
+        (mesh.first_index + 3 * first) * sizeof(uint32_t));
+    const GLint base_vertex = static_cast<GLint>(mesh.base_vertex);
+    n_triangles += faces * mesh.n_instances;
+    auto add = [&](Pass pass) {
+      Batch& batch = batches_[pass];
+      if (mesh.n_instances == 1) {
+        batch.counts.push_back(count);
+        batch.offsets.push_back(offset);
+        batch.base_vertices.push_back(base_vertex);
+      } else {
+        batch.instanced.push_back(
+            {count, offset, base_vertex,
+             static_cast<GLsizei>(mesh.n_instances)});
+      }
+    };
+    switch (painter.fill_mode_) {
+      case MeshPainter::FillMode::kLineAndFill:
+        add(kFillPass);
+        add(kLineFrontPass);
+        add(kLineBackPass);
+        break;
+      case MeshPainter::FillMode::kLine:
+        add(kLinePass);
+        break;
+      case MeshPainter::FillMode::kFill:
+        add(kFillPass);
+        break;
+      case MeshPainter::FillMode::kFillAndWire:
+        add(kWirePass);
+        break;
+      default:
+        assert(false);
+    }
+  }
+  GEOMETRY_LAB_TRACE_COUNTER("Triangles", n_triangles);
+  // 2. One program per shader, the passes of the lines only change
+  //    the side
+  glBindVertexArray(vao_);
+  glActiveTexture(GL_TEXTURE0 + MeshShader::kMeshUnit);
+  glBindTexture(GL_TEXTURE_BUFFER, mesh_texture_);
+  glActiveTexture(GL_TEXTURE0 + MeshShader::kInstanceUnit);
+  glBindTexture(GL_TEXTURE_BUFFER, instance_texture_);
+  glActiveTexture(GL_TEXTURE0);
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  if (!batches_[kFillPass].empty()) {
+    MeshFillShader::scene_instance()->Use();
+    Submit(batches_[kFillPass]);
+  }
+  if (!batches_[kWirePass].empty()) {
+    const auto& wire = *MeshWireShader::scene_instance();
+    wire.Use();
+    wire.set_wire(wire_width_, wire_color_);
+    Submit(batches_[kWirePass]);
+  }
+  if (!batches_[kLinePass].empty() || !batches_[kLineFrontPass].empty()) {
+    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    const auto& line = *MeshLineShader::scene_instance();
+    line.Use();
+    const float sides[3] = {0.0f, 1.0f, -1.0f};
+    for (int k = 0; k < 3; ++k) {
+      const Batch& batch = batches_[kLinePass + k];
+      if (batch.empty())
+        continue;
+      line.set_bias(sides[k]);
+      Submit(batch);
+    }
+  }
+  glBindVertexArray(0);
+  GEOMETRY_LAB_TRACE_COUNTER("Draw calls", n_draw_calls_);
+}
+void SceneRenderer::Submit(const Batch& batch) const {
+  if (!batch.counts.empty()) {
+    glMultiDrawElementsBaseVertex(
+        GL_TRIANGLES, batch.counts.data(), GL_UNSIGNED_INT,
+        batch.offsets.data(), static_cast<GLsizei>(batch.counts.size()),
+        batch.base_vertices.data());
+    ++n_draw_calls_;
+  }
+  for (const auto& draw : batch.instanced) {
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, draw.count,
+                                      GL_UNSIGNED_INT, draw.offset,
+                                      draw.instances, draw.base_vertex);
+    ++n_draw_calls_;
+  }
+}
+bool SceneRenderer::UpdateBuffers() {
+  GEOMETRY_LAB_TRACE_SCOPE("SceneRenderer::UpdateBuffers");
+  // 1. Painters of the instances, the packed ones keep their place
+  std::unordered_set<const MeshPainter*> used;
+  for (const auto& instance : instances_) {
+    const MeshPainter* painter = instance.painter.get();
+    if (painter && !painter->vertices_.empty() && !painter->indices_.empty())
+      used.insert(painter);
+  }
+  if (used.size() > kMaxMeshes) {
+    printf("Error::SceneRenderer::More than %zu meshes.\n\n", kMaxMeshes);
+    return false;
+  }
+  if (vao_ == 0) {
+    glGenVertexArrays(1, &vao_);
+    // The buffers exist once bound, before the textures use them
+    glGenBuffers(1, &mesh_buffer_);
+    glGenBuffers(1, &instance_buffer_);
+    for (const GLuint buffer : {mesh_buffer_, instance_buffer_}) {
+      glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+      glBufferData(GL_TEXTURE_BUFFER, kInstanceFloats * sizeof(float), NULL,
+                   GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glGenTextures(1, &mesh_texture_);
+    glGenTextures(1, &instance_texture_);
+    glBindTexture(GL_TEXTURE_BUFFER, mesh_texture_);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mesh_buffer_);
+    glBindTexture(GL_TEXTURE_BUFFER, instance_texture_);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instance_buffer_);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+  }
+  bool repack = vbo_layout_ != layout_;
+  std::unordered_map<const MeshPainter*, size_t> slots;
+  std::vector<Mesh> meshes;
+  meshes.reserve(used.size());
+  for (auto& mesh : meshes_) {
+    const MeshPainter& painter = *mesh.painter;
+    if (!used.count(&painter)) {
+      repack = true;
+      continue;
+    }
+    const size_t n_faces =
+        painter.indices_.size() + painter.level_indices_.size();
+    repack = repack || painter.vertices_.size() != mesh.n_vertices ||
+             3 * n_faces != mesh.n_indices;
+    slots[&painter] = meshes.size();
+    meshes.push_back(std::move(mesh));
+  }
+  const size_t n_kept = repack ? 0 : meshes.size();
+  for (const auto& instance : instances_) {
+    const MeshPainter* painter = instance.painter.get();
+    if (!used.count(painter) || slots.count(painter))
+      continue;
+    slots[painter] = meshes.size();
+    meshes.emplace_back();
+    meshes.back().painter = instance.painter;
+  }
+  meshes_ = std::move(meshes);
+  // 2. Storage of the new meshes, after the kept ones
+  if (repack)
+    n_vertices_ = n_indices_ = 0;
+  size_t n_vertices = n_vertices_, n_indices = n_indices_;
+  for (size_t i = n_kept; i < meshes_.size(); ++i) {
+    const MeshPainter& painter = *meshes_[i].painter;
+    n_vertices += painter.vertices_.size();
+    n_indices += 3 * (painter.indices_.size() + painter.level_indices_.size());
+  }
+  if (n_vertices > vertex_capacity_ || n_indices > index_capacity_ ||
+      vbo_layout_ != layout_) {
+    // Room for some more meshes before growing again
+    auto grow = [](size_t needed, size_t capacity) {
+      return needed > capacity ? std::max(needed, capacity + capacity / 2)
+                               : capacity;
+    };
+    Reserve(grow(n_vertices, vertex_capacity_),
+            grow(n_indices, index_capacity_));
+  }
+  // 3. Pack the new meshes and the edited ones
+  for (size_t i = 0; i < meshes_.size(); ++i) {
+    Mesh& mesh = meshes_[i];
+    const MeshPainter& painter = *mesh.painter;
+    if (i >= n_kept) {
+      mesh.base_vertex = n_vertices_;
+      mesh.n_vertices = painter.vertices_.size();
+      mesh.first_index = n_indices_;
+      mesh.n_indices =
+          3 * (painter.indices_.size() + painter.level_indices_.size());
+      n_vertices_ += mesh.n_vertices;
+      n_indices_ += mesh.n_indices;
+      PackVertices(mesh, i);
+      PackIndices(mesh);
+      continue;
+    }
+    if (mesh.vertex_generation != painter.vertex_generation())
+      PackVertices(mesh, i);
+    if (mesh.index_generation != painter.index_generation())
+      PackIndices(mesh);
+  }
+  // 4. Instances grouped by mesh
+  for (auto& mesh : meshes_)
+    mesh.n_instances = 0;
+  for (const auto& instance : instances_) {
+    const auto it = slots.find(instance.painter.get());
+    if (it != slots.end())
+      ++meshes_[it->second].n_instances;
+  }
+  size_t n_instances = 0;
+  for (auto& mesh : meshes_) {
+    mesh.first_instance = n_instances;
+    n_instances += mesh.n_instances;
+    mesh.n_instances = 0;
+  }
+  models_.resize(n_instances);
+  for (const auto& instance : instances_) {
+    const auto it = slots.find(instance.painter.get());
+    if (it == slots.end())
+      continue;
+    Mesh& mesh = meshes_[it->second];
+    models_[mesh.first_instance + mesh.n_instances++] = instance.model;
+  }
+  // 5. Buffer textures, only sent when they changed
+  std::vector<float> mesh_data(kMeshFloats * meshes_.size());
+  for (size_t i = 0; i < meshes_.size(); ++i) {
+    const Mesh& mesh = meshes_[i];
+    float* data = &mesh_data[kMeshFloats * i];
+    for (int k = 0; k < 3; ++k) {
+      data[k] = mesh.offset[k];
+      data[4 + k] = mesh.scale[k];
+    }
+    data[3] = static_cast<float>(mesh.first_instance);
+    data[7] = mesh.painter->offset_;
+  }
+  std::vector<float> instance_data(kInstanceFloats * n_instances);
+  for (size_t i = 0; i < n_instances; ++i) {
+    std::memcpy(&instance_data[kInstanceFloats * i], &models_[i][0][0],
+                kInstanceFloats * sizeof(float));
+  }
+  UploadTexels(mesh_buffer_, mesh_data, mesh_data_);
+  UploadTexels(instance_buffer_, instance_data, instance_data_);
+  return true;
+}
+void SceneRenderer::Reserve(size_t n_vertices, size_t n_indices) {
+  GEOMETRY_LAB_TRACE_SCOPE("SceneRenderer::Reserve");
+  if (n_vertices > vertex_capacity_ || vbo_layout_ != layout_) {
+    // A new layout starts from empty buffers
+    const bool keep = vbo_layout_ == layout_;
+    for (int a = 0; a < MeshPainter::kAttributeCount; ++a) {
+      const size_t bytes = MeshPainter::attribute_bytes(
+          static_cast<MeshPainter::Attribute>(a), layout_);
+      vbos_[a] = GrowBuffer(vbos_[a], keep ? n_vertices_ * bytes : 0,
+                            n_vertices * bytes);
+    }
+    mesh_vbo_ = GrowBuffer(mesh_vbo_, keep ? n_vertices_ * sizeof(uint16_t)
+                                           : 0,
+                           n_vertices * sizeof(uint16_t));
+    vertex_capacity_ = n_vertices;
+    vbo_layout_ = layout_;
+  }
+  if (n_indices > index_capacity_) {
+    ebo_ = GrowBuffer(ebo_, n_indices_ * sizeof(uint32_t),
+                      n_indices * sizeof(uint32_t));
+    index_capacity_ = n_indices;
+  }
+  BindAttributes();
+}
+void SceneRenderer::BindAttributes() {
+  glBindVertexArray(vao_);
+  for (int a = 0; a < MeshPainter::kAttributeCount; ++a) {
+    glBindBuffer(GL_ARRAY_BUFFER, vbos_[a]);
+    MeshPainter::SetAttributePointer(static_cast<MeshPainter::Attribute>(a),
+                                     layout_);
+  }
+  // The mesh of each vertex, an integer attribute
+  const GLuint mesh = MeshPainter::kAttributeCount;
+  glBindBuffer(GL_ARRAY_BUFFER, mesh_vbo_);
+  glVertexAttribIPointer(mesh, 1, GL_UNSIGNED_SHORT, 0, 0);
+  glEnableVertexAttribArray(mesh);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+void SceneRenderer::PackVertices(Mesh& mesh, size_t slot) {
+  GEOMETRY_LAB_TRACE_SCOPE("SceneRenderer::PackVertices");
+  MeshPainter& painter = *mesh.painter;
+  // The box is also the bounding sphere of the levels of detail
+  painter.ComputeBoundingSphere();
+  glm::vec3 lo(0.0f), hi(1.0f);
+  if (layout_.quantize_positions) {
+    lo = painter.box_lo();
+    hi = painter.box_hi();
+  }
+  mesh.offset = lo;
+  mesh.scale = hi - lo;
+  for (int a = 0; a < MeshPainter::kAttributeCount; ++a) {
+    const auto attribute = static_cast<MeshPainter::Attribute>(a);
+    const size_t bytes = MeshPainter::attribute_bytes(attribute, layout_);
+    staging_.resize(mesh.n_vertices * bytes);
+    painter.PackVertices(attribute, layout_, lo, hi, 0, mesh.n_vertices,
+                         staging_.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbos_[a]);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.base_vertex * bytes,
+                    staging_.size(), staging_.data());
+  }
+  const std::vector<uint16_t> slots(mesh.n_vertices,
+                                    static_cast<uint16_t>(slot));
+  glBindBuffer(GL_COPY_WRITE_BUFFER, mesh_vbo_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.base_vertex * sizeof(uint16_t),
+                  slots.size() * sizeof(uint16_t), slots.data());
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  mesh.vertex_generation = painter.vertex_generation();
+}
+void SceneRenderer::PackIndices(Mesh& mesh) {
+  const MeshPainter& painter = *mesh.painter;
+  const size_t size = painter.indices_.size() * sizeof(glm::ivec3);
+  const size_t level_size = painter.level_indices_.size() * sizeof(glm::ivec3);
+  assert(size + level_size == mesh.n_indices * sizeof(uint32_t));
+  const size_t offset = mesh.first_index * sizeof(uint32_t);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, ebo_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size,
+                  painter.indices_.data());
+  if (level_size > 0) {
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset + size, level_size,
+                    painter.level_indices_.data());
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  mesh.n_faces = painter.indices_.size();
+  mesh.levels = painter.levels_;
+  mesh.level = std::min(mesh.level, mesh.levels.size());
+  mesh.index_generation = painter.index_generation();
+}
+SceneRenderer::~SceneRenderer() {
+  // Nothing was sent to GL
+  if (vao_ == 0)
+    return;
+  glDeleteBuffers(1, &ebo_);
+  glDeleteBuffers(1, &mesh_vbo_);
+  glDeleteBuffers(MeshPainter::kAttributeCount, vbos_);
+  glDeleteBuffers(1, &mesh_buffer_);
+  glDeleteBuffers(1, &instance_buffer_);
+  glDeleteTextures(1, &mesh_texture_);
+  glDeleteTextures(1, &instance_texture_);
+  glDeleteVertexArrays(1, &vao_);
+}
+
+}  // namespace geometry_lab
@@ -0,0 +1,212 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_RENDER_SCENE_RENDERER_HPP_
+#define GEOMETRY_LAB_RENDER_SCENE_RENDERER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "mesh_painter.hpp"
+
+namespace geometry_lab {
+
+/**
+ * @brief Draw many instances of many painters at once, e.g. all the
+ *  parts of an assembly.
+ *
+ *  The vertices and the triangles of every painter are sub-allocated
+ *  in one set of vertex buffers in the format of @c layout_ and one
+ *  element buffer, the indices stay relative to the first vertex of
+ *  their mesh. The buffers grow on the GPU by copies, adding a mesh
+ *  only packs the new one. The model matrix of each instance and the
+ *  decoding of the positions of each mesh are read by the shaders
+ *  from buffer textures, so a frame binds one vertex array and does
+ *  not set any uniform per mesh.
+ *
+ *  The draws are sorted by shader and fill mode into passes. In each
+ *  pass, the meshes with one instance go in a single
+ *  glMultiDrawElementsBaseVertex() and each repeated mesh in one
+ *  glDrawElementsInstancedBaseVertex(). A vertex attribute holds the
+ *  mesh of each vertex, as GL 3.3 has no draw id nor base instance.
+ *
+ *  Each mesh keeps the @c fill_mode_, the line @c offset_ and the
+ *  levels of detail of its painter, the level is the finest one that
+ *  any of its instances needs. The camera, the light and the model of
+ *  the whole scene are the ones of this painter.
+*/
+class SceneRenderer : public Painter {
+ public:
+  /**
+   * @brief A painter drawn at some place of the scene.
+  */
+  struct Instance {
+    std::shared_ptr<MeshPainter> painter;
+    /// Placement in the scene, before the model of the scene. Rigid,
+    /// or with a uniform scale of at most 1 so the levels stay fine.
+    glm::mat4 model = glm::identity<glm::mat4>();
+  };
+  /**
+   * @brief Passes of a frame in their order, the draws of a pass share
+   *  a program and a fill mode.
+  */
+  enum Pass {
+    kFillPass = 0,
+    kWirePass,
+    /// Lines of @c FillMode::kLine, then the two sides of the lines of
+    /// @c FillMode::kLineAndFill.
+    kLinePass,
+    kLineFrontPass,
+    kLineBackPass,
+    kPassCount,
+  };
+  /**
+   * @brief Call this function to draw all the instances, after
+   *  @c UpdateBuffers().
+  */
+  void Draw() const;
+  /**
+   * @brief Bring the buffers up to date with @c instances_, cheap when
+   *  nothing changed, so it can be called every frame. New painters
+   *  are appended, painters whose @c vertex_generation() or
+   *  @c index_generation() changed are packed again. Everything is
+   *  packed again when a painter was removed or resized, or when
+   *  @c layout_ changed.
+   * @return Success?
+  */
+  bool UpdateBuffers();
+  /**
+   * @brief Add an instance of a painter.
+   * @param painter[in] - The painter, it does not need buffers of its
+   *                      own.
+   * @param model[in] - Its placement in the scene.
+   * @return Index of the instance in @c instances_.
+  */
+  size_t AddInstance(std::shared_ptr<MeshPainter> painter,
+                     const glm::mat4& model = glm::identity<glm::mat4>()) {
+    instances_.push_back({std::move(painter), model});
+    return instances_.size() - 1;
+  }
+
+  SceneRenderer() {}
+  /**
+   * @brief Release the buffers when deconstruct.
+  */
+  ~SceneRenderer();
+  /// Number of distinct painters in the buffers.
+  size_t n_meshes() const { return meshes_.size(); }
+  /// Vertices and indices in use in the buffers.
+  size_t n_vertices() const { return n_vertices_; }
+  size_t n_indices() const { return n_indices_; }
+  /// Draw calls of the last @c Draw().
+  size_t n_draw_calls() const { return n_draw_calls_; }
+
+  /// The painters and their placements, edit then call
+  /// @c UpdateBuffers().
+  std::vector<Instance> instances_;
+  /// Formats of the shared vertex buffers.
+  MeshPainter::VertexLayout layout_;
+  /// Width in pixels and color of the wires of all the meshes in
+  /// @c FillMode::kFillAndWire.
+  float wire_width_ = 1.0f;
+  glm::vec3 wire_color_ = {0.0f, 0.0f, 0.0f};
+  /// More meshes than this do not fit the 16-bit mesh attribute.
+  static constexpr size_t kMaxMeshes = 65536;
+
+ private:
+  /**
+   * @brief A painter sub-allocated in the buffers.
+  */
+  struct Mesh {
+    std::shared_ptr<MeshPainter> painter;
+    /// First vertex and index in the buffers, the triangles of the
+    /// painter then its levels of detail.
+    size_t base_vertex = 0, first_index = 0;
+    size_t n_vertices = 0, n_indices = 0;
+    /// Triangles of the painter and its levels when packed.
+    size_t n_faces = 0;
+    std::vector<MeshPainter::Level> levels;
+    /// Generations of the painter when packed.
+    uint64_t vertex_generation = 0, index_generation = 0;
+    /// Positions are offset + scale * the attribute.
+    glm::vec3 offset = glm::vec3(0.0f), scale = glm::vec3(1.0f);
+    /// Instances of the mesh in @c models_.
+    size_t first_instance = 0, n_instances = 0;
+    /// Level drawn by the last @c Draw().
+    mutable size_t level = 0;
+  };
+  /**
+   * @brief The draws of a pass.
+  */
+  struct Batch {
+    /// Meshes with one instance, arguments of one multi-draw.
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> base_vertices;
+    /// Repeated meshes, one instanced draw each.
+    struct Instanced {
+      GLsizei count;
+      const void* offset;
+      GLint base_vertex;
+      GLsizei instances;
+    };
+    std::vector<Instanced> instanced;
+
+    void clear() {
+      counts.clear();
+      offsets.clear();
+      base_vertices.clear();
+      instanced.clear();
+    }
+    bool empty() const { return counts.empty() && instanced.empty(); }
+  };
+  /**
+   * @brief Grow the storage of the buffers, the vertices and indices
+   *  in use are copied on the GPU.
+  */
+  void Reserve(size_t n_vertices, size_t n_indices);
+  /**
+   * @brief Point the vertex array at the buffers.
+  */
+  void BindAttributes();
+  /**
+   * @brief Send the vertices of a mesh, and its index in
+   *  @c meshes_ as the mesh attribute.
+  */
+  void PackVertices(Mesh& mesh, size_t slot);
+  /**
+   * @brief Send the triangles of a mesh and of its levels.
+  */
+  void PackIndices(Mesh& mesh);
+  /**
+   * @brief Submit the draws of a pass with the program in use.
+  */
+  void Submit(const Batch& batch) const;
+
+  /// GL objects, one vertex buffer per attribute and one for the mesh
+  /// of each vertex, buffer textures of the meshes and the instances.
+  GLuint vao_ = 0, ebo_ = 0, mesh_vbo_ = 0;
+  GLuint vbos_[MeshPainter::kAttributeCount] = {0, 0, 0};
+  GLuint mesh_buffer_ = 0, mesh_texture_ = 0;
+  GLuint instance_buffer_ = 0, instance_texture_ = 0;
+  /// Storage and use of the buffers, in vertices and indices.
+  size_t vertex_capacity_ = 0, index_capacity_ = 0;
+  size_t n_vertices_ = 0, n_indices_ = 0;
+  /// Formats of the storage of @c vbos_.
+  MeshPainter::VertexLayout vbo_layout_;
+  std::vector<Mesh> meshes_;
+  /// Model matrices of the instances, grouped by mesh.
+  std::vector<glm::mat4> models_;
+  /// Contents of the buffer textures.
+  std::vector<float> mesh_data_, instance_data_;
+  /// Packed values of the uploads.
+  std::vector<uint8_t> staging_;
+  /// Draws of each pass, rebuilt by every frame.
+  mutable Batch batches_[kPassCount];
+  mutable size_t n_draw_calls_ = 0;
+};
+
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_RENDER_SCENE_RENDERER_HPP_
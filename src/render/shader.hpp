@@ -3,9 +3,14 @@
 #ifndef GEOMETRY_LAB_RENDER_SHADER_HPP_
 #define GEOMETRY_LAB_RENDER_SHADER_HPP_
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -14,13 +19,105 @@
 
 namespace geometry_lab {
 
+/**
+ * @brief Data of a frame shared by all the programs, in the std140
+ *  layout of the @c Frame block declared by the shaders. Plain floats
+ *  so that the layout does not depend on the alignment of glm.
+*/
+struct FrameUniforms {
+  float view_projection[16];
+  float view_pos[4];
+  float light_pos[4];
+  float light_color[4];
+  /// Size of the framebuffer in pixels, then two unused floats.
+  float viewport[4];
+};
+
+/**
+ * @brief The uniform buffer of @c FrameUniforms, bound to
+ *  @c kBinding where every program finds its @c Frame block.
+ *
+ *  Every painter sends its camera and light before drawing, the data
+ *  is only uploaded when it differs from the last upload, so the
+ *  painters sharing a view cost one upload per frame.
+*/
+class FrameUniformBuffer {
+ public:
+  /// Binding point of the @c Frame blocks.
+  static constexpr GLuint kBinding = 0;
+  /**
+   * @brief Send the view and the light of the frame.
+   * @param view[in] - View matrix.
+   * @param projection[in] - Projection matrix.
+   * @param view_pos[in] - Position of the camera.
+   * @param light_pos[in] - Position of the point light.
+   * @param light_color[in] - Color of the point light.
+   * @param viewport[in] - Size of the framebuffer in pixels.
+   * @return Was the buffer uploaded?
+  */
+  bool Update(const glm::mat4& view, const glm::mat4& projection,
+              const glm::vec3& view_pos, const glm::vec3& light_pos,
+              const glm::vec3& light_color, const glm::ivec2& viewport) {
+    FrameUniforms frame;
+    std::memset(&frame, 0, sizeof(frame));
+    const glm::mat4 view_projection = projection * view;
+    std::memcpy(frame.view_projection, &view_projection[0][0],
+                sizeof(frame.view_projection));
+    for (int k = 0; k < 3; ++k) {
+      frame.view_pos[k] = view_pos[k];
+      frame.light_pos[k] = light_pos[k];
+      frame.light_color[k] = light_color[k];
+    }
+    frame.view_pos[3] = frame.light_pos[3] = 1.0f;
+    frame.viewport[0] = static_cast<float>(viewport[0]);
+    frame.viewport[1] = static_cast<float>(viewport[1]);
+    if (id_ == 0) {
+      glGenBuffers(1, &id_);
+      glBindBuffer(GL_UNIFORM_BUFFER, id_);
+      glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL,
+                   GL_DYNAMIC_DRAW);
+    } else if (std::memcmp(&frame, &frame_, sizeof(frame)) == 0) {
+      return false;
+    } else {
+      glBindBuffer(GL_UNIFORM_BUFFER, id_);
+    }
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, kBinding, id_);
+    frame_ = frame;
+    return true;
+  }
+
+  FrameUniformBuffer() {}
+  static std::shared_ptr<FrameUniformBuffer> instance() {
+    static auto ptr = std::make_shared<FrameUniformBuffer>();
+    return ptr;
+  }
+  GLuint id_ = 0;
+
+ private:
+  /// Content of the last upload.
+  FrameUniforms frame_;
+};
+
 /**
  * @brief APIs for shader
 */
 class Shader {
  public:
+  /**
+   * @brief Compile and link the program from source files.
+   * @param vert_path[in] - Vertex shader.
+   * @param frag_path[in] - Fragment shader.
+   * @param geom_path[in] - Geometry shader, optional.
+   * @param defines[in] - Lines inserted after the #version line of
+   *                      every stage, e.g. "#define WIREFRAME\n", so
+   *                      that one source builds several variants.
+   * @return Success?
+  */
   bool LoadFromFile(const char* vert_path, const char* frag_path,
-                    const char* geom_path = nullptr) {
+                    const char* geom_path = nullptr,
+                    const char* defines = nullptr) {
     // 1. retrieve the vertex/fragment source code from filePath
     std::string vertexCode;
     std::string fragmentCode;
@@ -58,6 +155,11 @@ class Shader {
       printf("ERROR::Shader::File not successfully read.\n\n");
       return false;
     }
+    if (defines != nullptr) {
+      InsertDefines(vertexCode, defines);
+      InsertDefines(fragmentCode, defines);
+      InsertDefines(geometryCode, defines);
+    }
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
     // 2. compile shaders
@@ -90,85 +192,235 @@ class Shader {
     glDeleteShader(fragment);
     if (geom_path != nullptr)
       glDeleteShader(geometry);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(id_, GL_LINK_STATUS, &linked);
+    if (!linked) {
+      char log[1024];
+      glGetProgramInfoLog(id_, sizeof(log), NULL, log);
+      printf("ERROR::Shader::Failed to link program.\n%s\n\n", log);
+      return false;
+    }
+    // 3. resolve the uniforms once
+    ResolveUniforms();
     return true;
   }
   void Use() const { glUseProgram(id_); }
+  /**
+   * @return Location of a uniform resolved when linking, -1 if the
+   *  program has no such active uniform (glUniform* ignores it).
+  */
+  GLint location(const char* name) const {
+    const auto it = locations_.find(name);
+    return it == locations_.end() ? -1 : it->second;
+  }
 
   void set_bool(const char* name, bool value) const {
-    glUniform1i(glGetUniformLocation(id_, name), (int)value);
+    glUniform1i(location(name), (int)value);
   }
   void set_int(const char* name, int value) const {
-    glUniform1i(glGetUniformLocation(id_, name), value);
+    glUniform1i(location(name), value);
   }
   void set_float(const char* name, float value) const {
-    glUniform1f(glGetUniformLocation(id_, name), value);
+    glUniform1f(location(name), value);
   }
   void set_vec2(const char* name, const glm::vec2& value) const {
-    glUniform2fv(glGetUniformLocation(id_, name), 1, &value[0]);
+    glUniform2fv(location(name), 1, &value[0]);
   }
   void set_vec3(const char* name, const glm::vec3& value) const {
-    glUniform3fv(glGetUniformLocation(id_, name), 1, &value[0]);
+    glUniform3fv(location(name), 1, &value[0]);
   }
   void set_vec4(const char* name, const glm::vec4& value) const {
-    glUniform4fv(glGetUniformLocation(id_, name), 1, &value[0]);
+    glUniform4fv(location(name), 1, &value[0]);
   }
   void set_mat2(const char* name, const glm::mat2& mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(id_, name), 1, GL_FALSE,
-                       &mat[0][0]);
+    glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
   }
   void set_mat3(const char* name, const glm::mat3& mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(id_, name), 1, GL_FALSE,
-                       &mat[0][0]);
+    glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
   }
   void set_mat4(const char* name, const glm::mat4& mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(id_, name), 1, GL_FALSE,
-                       &mat[0][0]);
+    glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
   }
 
   Shader() {}
   GLuint id_ = 0;
+
+ private:
+  /**
+   * @brief Look up the locations of the active uniforms and bind the
+   *  @c Frame block to @c FrameUniformBuffer::kBinding.
+  */
+  void ResolveUniforms() {
+    locations_.clear();
+    GLint n_uniforms = 0, max_length = 0;
+    glGetProgramiv(id_, GL_ACTIVE_UNIFORMS, &n_uniforms);
+    glGetProgramiv(id_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    std::vector<char> name(std::max(max_length, 1));
+    for (GLint i = 0; i < n_uniforms; ++i) {
+      GLsizei length = 0;
+      GLint size = 0;
+      GLenum type = 0;
+      glGetActiveUniform(id_, static_cast<GLuint>(i), max_length, &length,
+                         &size, &type, name.data());
+      // Members of blocks have no location
+      const GLint location = glGetUniformLocation(id_, name.data());
+      if (location < 0)
+        continue;
+      // Arrays are listed as "name[0]"
+      std::string key(name.data(), length);
+      if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0)
+        key.resize(key.size() - 3);
+      locations_[key] = location;
+    }
+    const GLuint block = glGetUniformBlockIndex(id_, "Frame");
+    if (block != GL_INVALID_INDEX)
+      glUniformBlockBinding(id_, block, FrameUniformBuffer::kBinding);
+  }
+  /**
+   * @brief Insert lines after the #version line, which must stay the
+   *  first one of the source.
+  */
+  static void InsertDefines(std::string& code, const char* defines) {
+    if (code.empty())
+      return;
+    size_t line = 0;
+    if (code.compare(0, 8, "#version") == 0) {
+      line = code.find('\n');
+      if (line == std::string::npos) {
+        code += '\n';
+        line = code.size() - 1;
+      }
+      ++line;
+    }
+    code.insert(line, defines);
+  }
+  /// Locations of the active uniforms by name.
+  std::unordered_map<std::string, GLint> locations_;
 };
 
-class MeshFillShader : public Shader {
+/**
+ * @brief Uniforms of a draw shared by the mesh shaders, the camera and
+ *  the light are in the @c Frame block. The locations are resolved
+ *  once, so a draw sends them without any lookup by name.
+ *
+ *  The variants built with SCENE read the model matrices and the
+ *  decoding of the positions from the buffer textures of
+ *  @c SceneRenderer instead, see @c scene_instance().
+*/
+class MeshShader : public Shader {
  public:
-  MeshFillShader() {
-    LoadFromFile(GEOMETRY_LAB_MESH_FILL_VERT, GEOMETRY_LAB_MESH_FILL_FRAG);
+  /// Texture units of the buffers of @c SceneRenderer.
+  static constexpr GLint kMeshUnit = 0, kInstanceUnit = 1;
+  /**
+   * @brief Set the uniforms of a draw, the program must be in use.
+   * @param model[in] - Model matrix.
+   * @param position_offset[in] - The positions in the model frame
+   *                              are offset + scale * v_pos.
+   * @param position_scale[in] - See position_offset.
+  */
+  void set_parameters(const glm::mat4& model,
+                      const glm::vec3& position_offset,
+                      const glm::vec3& position_scale) const {
+    glUniformMatrix4fv(model_, 1, GL_FALSE, &model[0][0]);
+    glUniform3fv(position_offset_, 1, &position_offset[0]);
+    glUniform3fv(position_scale_, 1, &position_scale[0]);
+  }
+
+ protected:
+  MeshShader(const char* vert_path, const char* frag_path,
+             const char* geom_path = nullptr,
+             const char* defines = nullptr) {
+    LoadFromFile(vert_path, frag_path, geom_path, defines);
+    model_ = location("model");
+    position_offset_ = location("position_offset");
+    position_scale_ = location("position_scale");
+    // Units of the buffer textures, they never change
+    const GLint meshes = location("meshes");
+    if (meshes >= 0) {
+      Use();
+      glUniform1i(meshes, kMeshUnit);
+      glUniform1i(location("instances"), kInstanceUnit);
+      glUseProgram(0);
+    }
   }
+
+ private:
+  GLint model_ = -1, position_offset_ = -1, position_scale_ = -1;
+};
+
+class MeshFillShader : public MeshShader {
+ public:
+  explicit MeshFillShader(bool scene = false)
+      : MeshShader(GEOMETRY_LAB_MESH_FILL_VERT, GEOMETRY_LAB_MESH_FILL_FRAG,
+                   nullptr, scene ? "#define SCENE\n" : nullptr) {}
   static std::shared_ptr<MeshFillShader> instance() {
     static auto ptr = std::make_shared<MeshFillShader>();
     return ptr;
   }
-  void set_parameters(const glm::mat4& model, const glm::mat4& view,
-                      const glm::mat4& proj, const glm::vec3& view_pos,
-                      const glm::vec3& light_pos,
-                      const glm::vec3& light_color) const {
-    set_mat4("model", model);
-    set_mat4("view", view);
-    set_mat4("projection", proj);
-    set_vec3("light_color", light_color);
-    set_vec3("light_pos", light_pos);
-    set_vec3("view_pos", view_pos);
+  static std::shared_ptr<MeshFillShader> scene_instance() {
+    static auto ptr = std::make_shared<MeshFillShader>(true);
+    return ptr;
+  }
+};
+
+/**
+ * @brief The fill shader with the wires of the triangles blended in
+ *  the same pass, a geometry shader gives each fragment its distance
+ *  in pixels to the edges of its triangle.
+*/
+class MeshWireShader : public MeshShader {
+ public:
+  explicit MeshWireShader(bool scene = false)
+      : MeshShader(GEOMETRY_LAB_MESH_FILL_VERT, GEOMETRY_LAB_MESH_FILL_FRAG,
+                   GEOMETRY_LAB_MESH_WIRE_GEOM,
+                   scene ? "#define WIREFRAME\n#define SCENE\n"
+                         : "#define WIREFRAME\n") {
+    line_width_ = location("line_width");
+    line_color_ = location("line_color");
+  }
+  static std::shared_ptr<MeshWireShader> instance() {
+    static auto ptr = std::make_shared<MeshWireShader>();
+    return ptr;
   }
+  static std::shared_ptr<MeshWireShader> scene_instance() {
+    static auto ptr = std::make_shared<MeshWireShader>(true);
+    return ptr;
+  }
+  /**
+   * @brief Look of the wires.
+   * @param width[in] - Width of the lines in pixels.
+   * @param color[in] - Color of the lines.
+  */
+  void set_wire(float width, const glm::vec3& color) const {
+    glUniform1f(line_width_, width);
+    glUniform3fv(line_color_, 1, &color[0]);
+  }
+
+ private:
+  GLint line_width_ = -1, line_color_ = -1;
 };
 
-class MeshLineShader : public Shader {
+class MeshLineShader : public MeshShader {
  public:
-  MeshLineShader() {
-    LoadFromFile(GEOMETRY_LAB_MESH_LINE_VERT, GEOMETRY_LAB_MESH_LINE_FRAG);
+  explicit MeshLineShader(bool scene = false)
+      : MeshShader(GEOMETRY_LAB_MESH_LINE_VERT, GEOMETRY_LAB_MESH_LINE_FRAG,
+                   nullptr, scene ? "#define SCENE\n" : nullptr) {
+    bias_ = location("bias");
   }
   static std::shared_ptr<MeshLineShader> instance() {
     static auto ptr = std::make_shared<MeshLineShader>();
     return ptr;
   }
-  void set_parameters(const glm::mat4& model, const glm::mat4& view,
-                      const glm::mat4& proj, const glm::vec3& view_pos,
-                      float bias) const {
-    set_mat4("model", model);
-    set_mat4("view", view);
-    set_mat4("projection", proj);
-    set_vec3("view_pos", view_pos);
-    set_float("bias", bias);
+  static std::shared_ptr<MeshLineShader> scene_instance() {
+    static auto ptr = std::make_shared<MeshLineShader>(true);
+    return ptr;
   }
+  /// Offset of the lines along the normals, in units of the offset of
+  /// each mesh for the variant of @c SceneRenderer.
+  void set_bias(float bias) const { glUniform1f(bias_, bias); }
+
+ private:
+  GLint bias_ = -1;
 };
 
 }  // namespace geometry_lab
@@ -1,34 +1,58 @@
 #version 330 core
 out vec4 FragColor;
 
-in vec3 normal;  
-in vec3 pos; 
-in vec3 color;
+in VertexData {
+    vec3 pos;
+    vec3 normal;
+    vec3 color;
+#ifdef WIREFRAME
+    // Distance in pixels to the three edges of the triangle
+    noperspective vec3 edge_distance;
+#endif
+} fs_in;
   
-uniform vec3 light_pos; 
-uniform vec3 view_pos; 
-uniform vec3 light_color;
+// Camera and light of the frame, FrameUniforms in shader.hpp
+layout (std140) uniform Frame {
+    mat4 view_projection;
+    vec4 view_pos;
+    vec4 light_pos;
+    vec4 light_color;
+    vec4 viewport;
+};
+#ifdef WIREFRAME
+// Width in pixels and color of the wires
+uniform float line_width;
+uniform vec3 line_color;
+#endif
 
 void main()
 {
     // ambient
     float ambientStrength = 0.1;
-    vec3 ambient = ambientStrength * light_color;
+    vec3 ambient = ambientStrength * light_color.rgb;
   	
     // diffuse 
     float diffuseStrength = 0.8;
-    vec3 norm = normalize(normal);
-    vec3 lightDir = normalize(light_pos - pos);
+    vec3 norm = normalize(fs_in.normal);
+    vec3 lightDir = normalize(light_pos.xyz - fs_in.pos);
     float diff = abs(dot(norm, lightDir));
-    vec3 diffuse = diffuseStrength * diff * light_color;
+    vec3 diffuse = diffuseStrength * diff * light_color.rgb;
     
     // specular
     float specularStrength = 0.1;
-    vec3 viewDir = normalize(view_pos - pos);
+    vec3 viewDir = normalize(view_pos.xyz - fs_in.pos);
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 16);
-    vec3 specular = specularStrength * spec * light_color;  
+    vec3 specular = specularStrength * spec * light_color.rgb;
         
-    vec3 result = (ambient + diffuse + specular) * color;
+    vec3 result = (ambient + diffuse + specular) * fs_in.color;
+#ifdef WIREFRAME
+    // Blend the closest edge over the shading, one pixel of falloff
+    float d = min(fs_in.edge_distance.x,
+                  min(fs_in.edge_distance.y, fs_in.edge_distance.z));
+    float wire = 1.0 - smoothstep(0.5 * line_width - 0.5,
+                                  0.5 * line_width + 0.5, d);
+    result = mix(result, line_color, wire);
+#endif
     FragColor = vec4(result, 1.f);
 }
\ No newline at end of file
@@ -1,20 +1,55 @@
 #version 330 core
-layout (location = 0) in vec3 v_pos;
-layout (location = 1) in vec3 v_normal;
-layout (location = 2) in vec3 v_color;
+// Packed attributes, the missing components read as (0, 0, 1)
+layout (location = 0) in vec4 v_pos;
+layout (location = 1) in vec4 v_normal;
+layout (location = 2) in vec4 v_color;
 
-out vec3 pos;
-out vec3 normal;
-out vec3 color;
+// A block, so that mesh_wire.geom can sit between the stages
+out VertexData {
+    vec3 pos;
+    vec3 normal;
+    vec3 color;
+} vs_out;
 
+// Camera and light of the frame, FrameUniforms in shader.hpp
+layout (std140) uniform Frame {
+    mat4 view_projection;
+    vec4 view_pos;
+    vec4 light_pos;
+    vec4 light_color;
+    vec4 viewport;
+};
+#ifdef SCENE
+// Mesh of the vertex in the shared buffers of SceneRenderer, its
+// texels in meshes are (offset, first instance) and (scale, line
+// offset), the model matrix of an instance is 4 texels of instances
+layout (location = 3) in uint v_mesh;
+uniform samplerBuffer meshes;
+uniform samplerBuffer instances;
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Position in the model frame, offset + scale * v_pos
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+#endif
 
 void main()
 {
-    pos = (model * vec4(v_pos, 1.0)).xyz;
-    normal = (model * vec4(v_normal, 0.0)).xyz;  
-    color = v_color;
-    gl_Position = projection * view * vec4(pos, 1.0);
+#ifdef SCENE
+    int m = 2 * int(v_mesh);
+    vec4 position_offset = texelFetch(meshes, m);
+    vec4 position_scale = texelFetch(meshes, m + 1);
+    int instance = 4 * (int(position_offset.w) + gl_InstanceID);
+    mat4 model = mat4(texelFetch(instances, instance),
+                      texelFetch(instances, instance + 1),
+                      texelFetch(instances, instance + 2),
+                      texelFetch(instances, instance + 3));
+    vec3 p = position_offset.xyz + position_scale.xyz * v_pos.xyz;
+#else
+    vec3 p = position_offset + position_scale * v_pos.xyz;
+#endif
+    vs_out.pos = (model * vec4(p, 1.0)).xyz;
+    vs_out.normal = (model * vec4(v_normal.xyz, 0.0)).xyz;
+    vs_out.color = v_color.rgb;
+    gl_Position = view_projection * vec4(vs_out.pos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <core/curvature.hpp>
+#include <core/trimesh.hpp>
+
+#include "test_util.hpp"
+
+using geometry_lab::CurvatureEngine;
+using geometry_lab::TriMesh;
+using geometry_lab::test::Check;
+using geometry_lab::test::kPi;
+
+namespace {
+/// An open cylinder of radius r and height 2 around the z axis,
+/// normals outward
+void BuildCylinder(int segments, int rows, float r, TriMesh& mesh) {
+  std::vector<float> positions;
+  std::vector<int> indices;
+  for (int j = 0; j < rows; ++j) {
+    for (int s = 0; s < segments; ++s) {
+      const double phi = 2.0 * kPi * s / segments;
+      positions.insert(positions.end(),
+                       {static_cast<float>(r * std::cos(phi)),
+                        static_cast<float>(r * std::sin(phi)),
+                        2.0f * j / (rows - 1)});
+    }
+  }
+  for (int j = 0; j + 1 < rows; ++j) {
+    for (int s = 0; s < segments; ++s) {
+      const int a = j * segments + s, b = j * segments + (s + 1) % segments;
+      indices.insert(indices.end(), {a, b, b + segments, a, b + segments,
+                                     a + segments});
+    }
+  }
+  mesh.BuildFromPolygons(positions, indices);
+}
+/// The graph z = -(k1 x^2 + k2 y^2) / 2 over [-0.2, 0.2]^2 on an
+/// n x n grid, normal +z and principal curvatures k1, k2 at the
+/// center vertex
+void BuildParaboloid(int n, double k1, double k2, TriMesh& mesh) {
+  geometry_lab::test::BuildGrid(
+      n,
+      [&](int i, int j) {
+        const double x = 0.4 * i / (n - 1) - 0.2;
+        const double y = 0.4 * j / (n - 1) - 0.2;
+        return std::array<float, 3>{
+            static_cast<float>(x), static_cast<float>(y),
+            static_cast<float>(-(k1 * x * x + k2 * y * y) / 2)};
+      },
+      mesh);
+}
+bool IsBoundary(const TriMesh& mesh, size_t v) {
+  return mesh.is_boundary(TriMesh::VertexHandle(static_cast<int>(v)));
+}
+}  // namespace
+
+// Total Gaussian curvature 4 pi (Gauss-Bonnet, exact up to rounding),
+// K = 1 / r^2 and H = 1 / r at every vertex, poles included. The
+// largest relative errors measured are 0.009 for K and 0.0035 for H
+void TestSphere() {
+  TriMesh mesh;
+  const double r = 2.0;
+  geometry_lab::test::BuildSphere(16, static_cast<float>(r), mesh);
+  mesh.ComputeCurvature();
+  const CurvatureEngine& engine = mesh.curvature_engine();
+  Check(engine.gaussian_.size() == mesh.n_vertices(), "cover the sphere");
+  double total = 0.0, gaussian = 0.0, mean = 0.0;
+  for (size_t v = 0; v < engine.gaussian_.size(); ++v) {
+    total += engine.gaussian_[v] * engine.areas_[v];
+    gaussian = std::max(gaussian, std::abs(engine.gaussian_[v] * r * r - 1.0));
+    mean = std::max(mean, std::abs(engine.mean_[v] * r - 1.0));
+  }
+  Check(std::abs(total - 4.0 * kPi) < 1e-9, "integrate K to 4 pi");
+  Check(gaussian < 0.015, "give K = 1 / r^2 on the sphere");
+  Check(mean < 0.005, "give H = 1 / r on the sphere");
+}
+
+// K = 0, H = 1 / (2r) and k1 = 1 / r around the axis inside a cylinder,
+// exact up to rounding as the triangles of a row make a flat strip
+void TestCylinder() {
+  TriMesh mesh;
+  const double r = 0.5;
+  BuildCylinder(48, 25, static_cast<float>(r), mesh);
+  mesh.ComputeCurvature();
+  const CurvatureEngine& engine = mesh.curvature_engine();
+  Check(engine.gaussian_.size() == mesh.n_vertices(), "cover the cylinder");
+  double gaussian = 0.0, mean = 0.0, k1 = 0.0, k2 = 0.0, axial = 0.0;
+  for (size_t v = 0; v < engine.gaussian_.size(); ++v) {
+    if (IsBoundary(mesh, v))
+      continue;
+    gaussian = std::max(gaussian, std::abs(engine.gaussian_[v] * r * r));
+    mean = std::max(mean, std::abs(2.0 * engine.mean_[v] * r - 1.0));
+    k1 = std::max(k1, std::abs(engine.principal_[2 * v] * r - 1.0));
+    k2 = std::max(k2, std::abs(engine.principal_[2 * v + 1] * r));
+    axial = std::max(axial, std::abs(engine.direction(v)[2]));
+  }
+  Check(gaussian < 1e-9, "give K = 0 on the cylinder");
+  Check(mean < 1e-4, "give H = 1 / (2r) on the cylinder");
+  Check(k1 < 1e-4 && k2 < 1e-4, "give k1 = 1 / r and k2 = 0");
+  Check(axial < 1e-4, "turn k1 around the axis");
+}
+
+// Principal curvatures and direction at the apex of an elliptic and
+// a hyperbolic paraboloid, the errors measured stay below 1e-4
+void TestParaboloids() {
+  constexpr double kTolerance = 1e-3;
+  for (const double k2 : {0.5, -1.0}) {
+    TriMesh mesh;
+    const int n = 41, apex = (n / 2) * n + n / 2;
+    BuildParaboloid(n, 1.0, k2, mesh);
+    mesh.ComputeCurvature();
+    const CurvatureEngine& engine = mesh.curvature_engine();
+    if (engine.gaussian_.size() != mesh.n_vertices()) {
+      Check(false, "cover the paraboloid");
+      continue;
+    }
+    Check(std::abs(engine.gaussian_[apex] - k2) < kTolerance,
+          "give K = k1 k2 at the apex");
+    Check(std::abs(engine.mean_[apex] - 0.5 * (1.0 + k2)) < kTolerance,
+          "give H = (k1 + k2) / 2 at the apex");
+    Check(std::abs(engine.principal_[2 * apex] - 1.0) < kTolerance &&
+              std::abs(engine.principal_[2 * apex + 1] - k2) < kTolerance,
+          "give the principal curvatures at the apex");
+    Check(std::abs(engine.direction(apex)[0]) > 1.0 - kTolerance,
+          "align k1 with the x axis at the apex");
+  }
+}
+
+int main() {
+  TestSphere();
+  TestCylinder();
+  TestParaboloids();
+  return geometry_lab::test::Finish("curvature_test");
+}
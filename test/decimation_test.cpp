@@ -0,0 +1,34 @@
+#include <cstdio>
+
+#include <core/decimation.hpp>
+#include <core/trimesh.hpp>
+
+#include "test_util.hpp"
+
+using geometry_lab::QuadricDecimater;
+using geometry_lab::TriMesh;
+using geometry_lab::test::Check;
+
+// A normalized mesh stays in the frame of its source
+void TestSourceTransform() {
+  TriMesh mesh;
+  geometry_lab::test::BuildSphere(16, 2.0f, mesh);
+  mesh.NormalizePositions(1.0f);
+  const float normalized_scale = mesh.normalized_scale_;
+  const Eigen::Vector3f source_offset = mesh.source_offset_;
+  const float source_scale = mesh.source_scale_;
+  Check(source_scale != 1.0f, "normalize the sphere");
+  const size_t n_faces = mesh.n_faces();
+  QuadricDecimater decimater;
+  Check(decimater.Decimate(mesh, n_faces / 2), "decimate the sphere");
+  Check(mesh.n_faces() <= n_faces / 2, "reach the target");
+  Check(mesh.normalized_scale_ == normalized_scale &&
+            mesh.source_offset_ == source_offset &&
+            mesh.source_scale_ == source_scale,
+        "keep the source transform");
+}
+
+int main() {
+  TestSourceTransform();
+  return geometry_lab::test::Finish("decimation_test");
+}
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <core/face_frames.hpp>
+#include <core/simd.hpp>
+#include <core/trimesh.hpp>
+
+#include "test_util.hpp"
+
+using geometry_lab::FaceFrames;
+using geometry_lab::SimdLevel;
+using geometry_lab::TriMesh;
+using geometry_lab::test::Check;
+
+namespace {
+/// A bumpy n x n grid of triangles, the face count is not a multiple
+/// of the vector width so the scalar tails run too
+void BuildBumpyGrid(int n, TriMesh& mesh) {
+  geometry_lab::test::BuildGrid(
+      n,
+      [n](int i, int j) {
+        const float x = static_cast<float>(i) / (n - 1);
+        const float y = static_cast<float>(j) / (n - 1);
+        return std::array<float, 3>{
+            x + 0.002f * std::sin(7.0f * j), y,
+            0.1f * std::sin(5.0f * x) * std::cos(3.0f * y)};
+      },
+      mesh);
+}
+float MaxDifference(const geometry_lab::AlignedVector<float>& a,
+                    const geometry_lab::AlignedVector<float>& b) {
+  float rst = 0.0f;
+  for (size_t i = 0; i < a.size(); ++i)
+    rst = std::max(rst, std::abs(a[i] - b[i]));
+  return rst;
+}
+}  // namespace
+
+// Every instruction set gives the frames of the scalar kernel, and
+// they match the double-precision properties of the mesh
+void TestLevels() {
+  TriMesh mesh;
+  BuildBumpyGrid(36, mesh);
+  Check(mesh.n_faces() % 8 != 0, "leave a scalar tail");
+  FaceFrames scalar;
+  scalar.Compute(mesh.soa(), SimdLevel::kScalar);
+  Check(scalar.size() == mesh.n_faces(), "compute all the faces");
+  Check(scalar.Deviation(mesh) < FaceFrames::kTolerance,
+        "match the properties with the scalar kernel");
+  for (const SimdLevel level : {SimdLevel::kSSE, SimdLevel::kAVX2}) {
+    FaceFrames frames;
+    frames.Compute(mesh.soa(), level);
+    const float bound = static_cast<float>(FaceFrames::kTolerance) / 10;
+    Check(frames.size() == scalar.size(), "compute all the faces");
+    Check(MaxDifference(frames.x0_, scalar.x0_) < bound &&
+              MaxDifference(frames.x1_, scalar.x1_) < bound &&
+              MaxDifference(frames.y1_, scalar.y1_) < bound &&
+              MaxDifference(frames.area_, scalar.area_) < bound,
+          "match the scalar kernel");
+    Check(frames.Deviation(mesh) < FaceFrames::kTolerance,
+          "match the properties");
+  }
+}
+
+int main() {
+  TestLevels();
+  return geometry_lab::test::Finish("face_frames_test");
+}
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <core/geodesics.hpp>
+#include <core/trimesh.hpp>
+
+#include "test_util.hpp"
+
+using geometry_lab::HeatGeodesics;
+using geometry_lab::TriMesh;
+using geometry_lab::test::Check;
+using geometry_lab::test::kPi;
+
+namespace {
+/// Bound of the mean absolute error, the tests measure 0.0068 on the
+/// plane and 0.0063 on the sphere
+constexpr double kMeanError = 0.01;
+}  // namespace
+
+// Euclidean distances to the center of a plane, the isolated vertex
+// is factorized and is out of reach
+void TestPlane() {
+  const int n = 41, n_grid = n * n, center = (n / 2) * n + n / 2;
+  std::vector<float> positions;
+  std::vector<int> indices;
+  geometry_lab::test::GridPolygons(
+      n,
+      [n](int i, int j) {
+        return std::array<float, 3>{2.0f * i / (n - 1) - 1.0f,
+                                    2.0f * j / (n - 1) - 1.0f, 0.0f};
+      },
+      positions, indices);
+  // A vertex used by no face
+  positions.insert(positions.end(), {5.0f, 5.0f, 0.0f});
+  TriMesh mesh;
+  mesh.BuildFromPolygons(positions, indices);
+  Check(mesh.n_vertices() == size_t(n_grid) + 1, "keep the isolated vertex");
+  HeatGeodesics geodesics;
+  Check(geodesics.Compute(mesh, std::vector<int32_t>{center}),
+        "solve with an isolated vertex");
+  if (geodesics.distance_.rows() != n_grid + 1)
+    return;
+  Check(std::isinf(geodesics.distance_(n_grid, 0)),
+        "put the isolated vertex out of reach");
+  // Away from the boundary, where the heat method smooths the distance
+  const auto c = mesh.point(TriMesh::VertexHandle(center));
+  double error = 0.0;
+  int count = 0;
+  for (int v = 0; v < n_grid; ++v) {
+    const auto p = mesh.point(TriMesh::VertexHandle(v));
+    const double d = std::hypot(p[0] - c[0], p[1] - c[1]);
+    if (d > 0.8)
+      continue;
+    error += std::abs(geodesics.distance_(v, 0) - d);
+    ++count;
+  }
+  Check(geodesics.distance_(center, 0) == 0.0, "start at the source");
+  Check(error / count < kMeanError, "match the Euclidean distance");
+}
+
+// Great-circle distances to each pole of a sphere, in one batch
+void TestSphere() {
+  TriMesh mesh;
+  geometry_lab::test::BuildSphere(16, 1.0f, mesh);
+  const int south = static_cast<int>(mesh.n_vertices()) - 1;
+  HeatGeodesics geodesics;
+  const std::vector<std::vector<int32_t>> poles = {{0}, {south}};
+  Check(geodesics.Compute(mesh, poles), "solve two columns");
+  if (geodesics.distance_.cols() != 2)
+    return;
+  double error[2] = {0.0, 0.0};
+  for (int v = 0; v <= south; ++v) {
+    const double z = mesh.point(TriMesh::VertexHandle(v))[2];
+    const double d = std::acos(std::clamp(z, -1.0, 1.0));
+    error[0] += std::abs(geodesics.distance_(v, 0) - d);
+    error[1] += std::abs(geodesics.distance_(v, 1) - (kPi - d));
+  }
+  Check(error[0] / (south + 1) < kMeanError,
+        "match the distance to the north");
+  Check(error[1] / (south + 1) < kMeanError,
+        "match the distance to the south");
+}
+
+int main() {
+  TestPlane();
+  TestSphere();
+  return geometry_lab::test::Finish("geodesics_test");
+}
@@ -0,0 +1,76 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <core/obj_reader.hpp>
+#include <core/trimesh.hpp>
+
+#include "test_util.hpp"
+
+using geometry_lab::ObjReader;
+using geometry_lab::TriMesh;
+using geometry_lab::test::Check;
+
+// More vertices than corners, e.g. a scan with a few stray points
+void TestUnreferencedVertices() {
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "unreferenced.obj").string();
+  {
+    std::ofstream file(path);
+    for (int i = 0; i < 64; ++i)
+      file << "v " << i << " " << (i % 7) << " " << (i % 3) << "\n";
+    file << "f 1 2 3\nf 1 3 4\n";
+  }
+  ObjReader reader;
+  Check(reader.Read(path), "read the file");
+  Check(reader.positions_.size() == 3 * 64, "read all the vertices");
+  TriMesh mesh;
+  Check(mesh.BuildFromPolygons(reader.positions_, reader.face_indices_,
+                               reader.face_offsets_),
+        "build the connectivity");
+  Check(mesh.n_vertices() == 64, "keep the unreferenced vertices");
+  Check(mesh.n_faces() == 2 && mesh.n_edges() == 5, "build the faces");
+  Check(!mesh.halfedge_handle(TriMesh::VertexHandle(63)).is_valid(),
+        "leave the unreferenced vertices isolated");
+  Check(mesh.LoadFromFile(path, false, true) && mesh.n_vertices() == 64,
+        "load the file");
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+}
+
+// Quads are fanned into triangles, so the snapshot keeps all the faces
+void TestQuads() {
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "quads.obj").string();
+  {
+    // A 3x3 grid of quads
+    std::ofstream file(path);
+    for (int j = 0; j < 4; ++j)
+      for (int i = 0; i < 4; ++i)
+        file << "v " << i << " " << j << " 0\n";
+    for (int j = 0; j < 3; ++j) {
+      for (int i = 0; i < 3; ++i) {
+        const int v = 4 * j + i + 1;
+        file << "f " << v << " " << v + 1 << " " << v + 5 << " " << v + 4
+             << "\n";
+      }
+    }
+  }
+  for (const bool fast_obj : {true, false}) {
+    TriMesh mesh;
+    Check(mesh.LoadFromFile(path, false, fast_obj), "load the quads");
+    Check(mesh.n_faces() == 18, "split the quads into triangles");
+    Check(mesh.soa().n_faces() == mesh.n_faces(), "keep the faces in soa()");
+    Check(mesh.ComputeBoundaryLoops().size() == 1, "find one boundary loop");
+    Check(!mesh.Triangulate(), "leave the triangles untouched");
+  }
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+}
+
+int main() {
+  TestUnreferencedVertices();
+  TestQuads();
+  return geometry_lab::test::Finish("obj_reader_test");
+}
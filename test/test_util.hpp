@@ -0,0 +1,128 @@
+#pragma once
+
+#ifndef GEOMETRY_LAB_TEST_TEST_UTIL_HPP_
+#define GEOMETRY_LAB_TEST_TEST_UTIL_HPP_
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <core/trimesh.hpp>
+
+namespace geometry_lab {
+namespace test {
+
+constexpr double kPi = 3.14159265358979323846;
+
+/// Number of failed checks, see @c Finish().
+inline int failures = 0;
+/**
+ * @brief Print a failed check, the test goes on with the next one.
+ * @param condition[in] - Expected to hold.
+ * @param what[in] - What the check expects.
+*/
+inline void Check(bool condition, const char* what) {
+  if (!condition) {
+    printf("FAILED: %s\n", what);
+    ++failures;
+  }
+}
+/**
+ * @brief End of a test, to return from main().
+ * @param name[in] - Name of the test.
+ * @return Exit code, 0 when every check held.
+*/
+inline int Finish(const char* name) {
+  if (failures == 0)
+    printf("%s passed\n", name);
+  return failures == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Triangles of an n x n grid of vertices, with the diagonals of
+ *  the squares alternating so that no direction is favored.
+ * @param n[in] - Vertices on a side.
+ * @param position[in] - Position {x, y, z} of the vertex (i, j).
+ * @param positions[out] - Positions, vertex (i, j) at j * n + i.
+ * @param indices[out] - 3 vertex indices per triangle.
+*/
+template <typename F>
+void GridPolygons(int n, F&& position, std::vector<float>& positions,
+                  std::vector<int>& indices) {
+  positions.clear();
+  indices.clear();
+  for (int j = 0; j < n; ++j) {
+    for (int i = 0; i < n; ++i) {
+      const std::array<float, 3> p = position(i, j);
+      positions.insert(positions.end(), p.begin(), p.end());
+    }
+  }
+  for (int j = 0; j + 1 < n; ++j) {
+    for (int i = 0; i + 1 < n; ++i) {
+      const int v = j * n + i;
+      if ((i + j) % 2 == 0) {
+        indices.insert(indices.end(),
+                       {v, v + 1, v + n + 1, v, v + n + 1, v + n});
+      } else {
+        indices.insert(indices.end(),
+                       {v, v + 1, v + n, v + 1, v + n + 1, v + n});
+      }
+    }
+  }
+}
+/**
+ * @brief Mesh of @c GridPolygons().
+*/
+template <typename F>
+bool BuildGrid(int n, F&& position, TriMesh& mesh) {
+  std::vector<float> positions;
+  std::vector<int> indices;
+  GridPolygons(n, position, positions, indices);
+  return mesh.BuildFromPolygons(positions, indices);
+}
+/**
+ * @brief UV sphere around the origin with outward normals.
+ * @param n[in] - Number of rings, 2n vertices around each of them.
+ * @param r[in] - Radius.
+ * @param mesh[out] - The sphere, the north pole is the first vertex
+ *                    and the south pole the last one.
+*/
+inline bool BuildSphere(int n, float r, TriMesh& mesh) {
+  const int segments = 2 * n;
+  std::vector<float> positions = {0.0f, 0.0f, r};
+  std::vector<int> indices;
+  for (int i = 1; i < n; ++i) {
+    for (int s = 0; s < segments; ++s) {
+      const double theta = kPi * i / n, phi = 2.0 * kPi * s / segments;
+      positions.insert(
+          positions.end(),
+          {static_cast<float>(r * std::sin(theta) * std::cos(phi)),
+           static_cast<float>(r * std::sin(theta) * std::sin(phi)),
+           static_cast<float>(r * std::cos(theta))});
+    }
+  }
+  positions.insert(positions.end(), {0.0f, 0.0f, -r});
+  const int south = static_cast<int>(positions.size() / 3) - 1;
+  auto ring = [&](int i, int s) {
+    return 1 + (i - 1) * segments + s % segments;
+  };
+  for (int s = 0; s < segments; ++s) {
+    indices.insert(indices.end(), {0, ring(1, s), ring(1, s + 1)});
+    indices.insert(indices.end(),
+                   {south, ring(n - 1, s + 1), ring(n - 1, s)});
+  }
+  for (int i = 1; i + 1 < n; ++i) {
+    for (int s = 0; s < segments; ++s) {
+      indices.insert(indices.end(), {ring(i, s), ring(i + 1, s),
+                                     ring(i + 1, s + 1), ring(i, s),
+                                     ring(i + 1, s + 1), ring(i, s + 1)});
+    }
+  }
+  return mesh.BuildFromPolygons(positions, indices);
+}
+
+}  // namespace test
+}  // namespace geometry_lab
+
+#endif  // !GEOMETRY_LAB_TEST_TEST_UTIL_HPP_